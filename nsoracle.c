@@ -83,7 +83,10 @@ DynamicBindIn(dvoid * ictxp,
  * DynamicBindOut --
  *
  *      Used to dynamically allocate more memory for IN/OUT and
- *      OUT parameters in OraclePLSQLObjCmd.
+ *      OUT parameters in OraclePLSQLObjCmd.  The buffer doubles
+ *      whenever it is half full, up to MaxPLSQLBufferSize, so a large
+ *      value costs a handful of reallocs rather than one every
+ *      EXEC_PLSQL_BUFFER_SIZE bytes.
  *
  *----------------------------------------------------------------------
  */
@@ -103,24 +106,31 @@ DynamicBindOut (dvoid * ctxp, OCIBind * bindp,
     }
 
     if (*piecep == OCI_ONE_PIECE || *piecep == OCI_FIRST_PIECE) {
-        fetchbuf->fetch_length = 0;
+        fetchbuf->out_length = 0;
     } else if (*piecep == OCI_NEXT_PIECE) {
-        fetchbuf->fetch_length += fetchbuf->piecewise_fetch_length;
+        fetchbuf->out_length += fetchbuf->piecewise_fetch_length;
     }
 
-    if (fetchbuf->fetch_length >= fetchbuf->buf_size / 2) {
-        fetchbuf->buf_size += EXEC_PLSQL_BUFFER_SIZE;
+    if (fetchbuf->buf == NULL 
+        || fetchbuf->out_length >= fetchbuf->buf_size / 2) {
+        fetchbuf->buf_size = plsql_buffer_size(fetchbuf->buf_size * 2);
         fetchbuf->buf = Ns_Realloc (fetchbuf->buf, fetchbuf->buf_size);
     }
 
-    fetchbuf->piecewise_fetch_length = fetchbuf->buf_size - fetchbuf->fetch_length;
+    if (fetchbuf->out_length >= fetchbuf->buf_size) {
+        error(lexpos(), "OUT value exceeds MaxPLSQLBufferSize (%d)", 
+              max_plsql_buffer_size);
+        return NS_ERROR;
+    }
+
+    fetchbuf->piecewise_fetch_length = fetchbuf->buf_size - fetchbuf->out_length;
 
     ns_ora_log (lexpos (), "%d, %d, %d",
         fetchbuf->buf_size,
-        fetchbuf->fetch_length,
+        fetchbuf->out_length,
         fetchbuf->piecewise_fetch_length);
 
-    *bufpp = &fetchbuf->buf[fetchbuf->fetch_length];
+    *bufpp = &fetchbuf->buf[fetchbuf->out_length];
     *alenpp = &fetchbuf->piecewise_fetch_length;
     *indpp = &fetchbuf->is_null;
     *rcodepp = &rc;
@@ -158,6 +168,9 @@ OracleObjCmd (ClientData clientData, Tcl_Interp *interp,
         "clob_dml", "clob_dml_file", 
         "blob_dml", "blob_dml_file",
         "write_clob", "write_blob",
+        "load", "load_file", "fetch", "fetch_dbo", "call", "desc_cached",
+        "blob_read", "blob_dml_conn", "stats",
+        "clob_get_channel", "blob_get_channel",
         NULL
     };
 
@@ -169,7 +182,10 @@ OracleObjCmd (ClientData clientData, Tcl_Interp *interp,
         CBlobDMLBind, CBlobDMLFileBind,
         CClobDML, CClobDMLFile, 
         CBlobDML, CBlobDMLFile,
-        CWriteClob, CWriteBlob
+        CWriteClob, CWriteBlob,
+        CLoad, CLoadFile, CFetch, CFetchDbo, CCall, CDescCached,
+        CBlobRead, CBlobDMLConn, CStats,
+        CClobGetChannel, CBlobGetChannel
     } subcmd;
 
     if (objc < 2) {
@@ -182,6 +198,15 @@ OracleObjCmd (ClientData clientData, Tcl_Interp *interp,
         return TCL_ERROR;
     }
 
+    if (subcmd == CDescCached) {
+        /* no handle: it only looks in the describe cache */
+        return OracleDescCached(interp, objc, objv, NULL);
+    }
+
+    if (subcmd == CStats) {
+        return OracleStats(interp, objc, objv, NULL);
+    }
+
     if (Ns_TclDbGetHandle(interp, Tcl_GetString(objv[2]), &dbh) != TCL_OK) {
         return TCL_ERROR;
     }
@@ -241,6 +266,7 @@ OracleObjCmd (ClientData clientData, Tcl_Interp *interp,
         case CClobDMLFile:
         case CBlobDML:
         case CBlobDMLFile:
+        case CBlobDMLConn:
 
             Ns_OracleFlush(dbh);
             return OracleLobDML(interp, objc, objv, dbh);
@@ -257,10 +283,38 @@ OracleObjCmd (ClientData clientData, Tcl_Interp *interp,
         case CBlobGetFile:
         case CWriteClob:
         case CWriteBlob:
+        case CBlobRead:
+        case CClobGetChannel:
+        case CBlobGetChannel:
 
             Ns_OracleFlush(dbh);
             return OracleLobSelect(interp, objc, objv, dbh);
 
+        case CLoad:
+
+            Ns_OracleFlush(dbh);
+            return OracleLoad(interp, objc, objv, dbh);
+
+        case CLoadFile:
+
+            Ns_OracleFlush(dbh);
+            return OracleLoadFile(interp, objc, objv, dbh);
+
+        case CFetch:
+
+            Ns_OracleFlush(dbh);
+            return OracleFetch(interp, objc, objv, dbh);
+
+        case CFetchDbo:
+
+            /* no flush: the REF CURSOR may be the handle's statement */
+            return OracleFetchDbo(interp, objc, objv, dbh);
+
+        case CCall:
+
+            Ns_OracleFlush(dbh);
+            return OracleCall(interp, objc, objv, dbh);
+
         default:
 
             Tcl_AppendStringsToObj(Tcl_GetObjResult(interp), 
@@ -283,7 +337,35 @@ OracleObjCmd (ClientData clientData, Tcl_Interp *interp,
  *
  *      Implements [ns_ora plsql] command.  
  *
- *      ns_oracle plsql dbhandle sql ?ref?
+ *      ns_oracle plsql dbhandle ?-array tables? ?-clob lobs? ?-blob lobs?
+ *                       ?-cursors names? ?-prefetch rows? ?-fetchsize rows?
+ *                       ?-materialize list|dict? ?-results varName?
+ *                       sql ?ref?
+ *
+ *      Each element of the -array list names a bind variable that is
+ *      a PL/SQL index-by table, optionally followed by the most
+ *      elements it can hold and the size of each element: 
+ *      {name ?max_elements? ?element_size?}.  The Tcl variable holds
+ *      the table as a list, and is set to the returned table as a
+ *      list after the call.
+ *
+ *      Each element of the -clob and -blob lists names a bind variable
+ *      that is passed as a temporary LOB, optionally followed by its
+ *      mode (in, out or inout, the default) and for OUT LOBs a file
+ *      to write the value to instead of the variable:
+ *      {name ?mode? ?file?}.
+ *
+ *      Each variable named in -cursors is a REF CURSOR.  With
+ *      -materialize the cursor's rows are fetched, -fetchsize rows at
+ *      a time, into the variable; otherwise the variable is set to a
+ *      cursor id for [ns_ora fetch], good until the next plsql call.
+ *      The older ref argument instead replaces the handle's statement
+ *      so that the cursor can be read with ns_db getrow.
+ *
+ *      -results names a variable to set to the list of implicit result
+ *      sets the block returned with DBMS_SQL.RETURN_RESULT, each
+ *      fetched as with -materialize (list format by default).  This
+ *      needs Oracle 12c client libraries.
  *
  * Results:
  *
@@ -307,15 +389,78 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
     char              *query;
     char              *ref;
     int                i, refcursor_count = 0;
+    int                argi;
+    int                n_tables = 0, n_clobs = 0, n_blobs = 0;
+    int                n_cursors = 0;
+    Tcl_Obj          **tables = NULL, **clobs = NULL, **blobs = NULL;
+    Tcl_Obj          **cursors = NULL;
+    int                prefetch = prefetch_rows, fetch_size = array_fetch_size;
+    int                materialize = -1;
+    Tcl_Obj           *results = NULL;
+    static CONST char *formats[] = {"list", "dict", NULL};
+
+    for (argi = 3; argi < objc - 1; argi += 2) {
+        char      *option = Tcl_GetString(objv[argi]);
+        Tcl_Obj ***specs;
+        int       *n_specs;
+
+        if (!strcmp(option, "-prefetch")) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &prefetch) 
+                    != TCL_OK) {
+                return TCL_ERROR;
+            }
+            continue;
+        } else if (!strcmp(option, "-fetchsize")) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &fetch_size) 
+                    != TCL_OK) {
+                return TCL_ERROR;
+            }
+            continue;
+        } else if (!strcmp(option, "-materialize")) {
+            if (Tcl_GetIndexFromObj(interp, objv[argi + 1], formats, 
+                                    "format", 0, &materialize) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            continue;
+        } else if (!strcmp(option, "-results")) {
+            results = objv[argi + 1];
+            continue;
+        } else if (!strcmp(option, "-cursors")) {
+            specs = &cursors;
+            n_specs = &n_cursors;
+        } else if (!strcmp(option, "-array")) {
+            specs = &tables;
+            n_specs = &n_tables;
+        } else if (!strcmp(option, "-clob")) {
+            specs = &clobs;
+            n_specs = &n_clobs;
+        } else if (!strcmp(option, "-blob")) {
+            specs = &blobs;
+            n_specs = &n_blobs;
+        } else {
+            break;
+        }
 
-    if (objc < 4) {
-        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle sql ?ref?");
+        if (Tcl_ListObjGetElements(interp, objv[argi + 1], n_specs, specs) 
+                != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+
+    if (objc < argi + 1 || objc > argi + 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                "dbhandle ?-array tables? ?-clob lobs? ?-blob lobs? "
+                "?-cursors names? ?-prefetch rows? ?-fetchsize rows? "
+                "?-materialize list|dict? ?-results varName? sql ?ref?");
         return TCL_ERROR;
     }
 
     connection = dbh->connection;
     connection->interp = interp;
-    query = Tcl_GetString(objv[3]);
+    query = Tcl_GetString(objv[argi]);
+
+    /* Cursors from the last call are only good until this one */
+    free_cursors(connection);
 
     oci_status = OCIHandleAlloc(connection->env,
                                 (oci_handle_t **) & connection->stmt,
@@ -336,8 +481,8 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
         return TCL_ERROR;
     }
 
-    if (objc == 5) {
-        ref = Tcl_GetString(objv[4]);
+    if (objc == argi + 2) {
+        ref = Tcl_GetString(objv[argi + 1]);
     } else {
         ref = "";
     }
@@ -357,14 +502,42 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
 
         fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
         char *value = NULL;
+        Tcl_Obj *spec;
 
         fetchbuf->type = -1;
 
         value = Tcl_GetVar(interp, var_p->string, 0);
         fetchbuf->name = var_p->string;
 
-        if ( (value == NULL) && 
-             (strcmp(var_p->string, ref) != 0) ) {
+        if ((spec = bind_spec(tables, n_tables, var_p->string)) != NULL) {
+            /* Handle PL/SQL index-by table */
+
+            if (bind_plsql_table(interp, dbh, fetchbuf, spec, query) 
+                    != TCL_OK) {
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                free_fetch_buffers(connection);
+                return TCL_ERROR;
+            }
+
+        } else if ((spec = bind_spec(clobs, n_clobs, var_p->string)) != NULL
+                   || (spec = bind_spec(blobs, n_blobs, var_p->string)) 
+                          != NULL) {
+            /* Handle CLOB or BLOB passed as a temporary LOB */
+
+            if (bind_plsql_lob(interp, dbh, fetchbuf, spec, 
+                               bind_spec(blobs, n_blobs, var_p->string) 
+                                   != NULL,
+                               query) != TCL_OK) {
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                free_fetch_buffers(connection);
+                return TCL_ERROR;
+            }
+
+        } else if ( (value == NULL) && 
+             (strcmp(var_p->string, ref) != 0) &&
+             (bind_spec(cursors, n_cursors, var_p->string) == NULL) ) {
             /* The only time a bind variable can not exist is if its strictly
                an OUT variable, or if its a REF CURSOR.  */
             Tcl_AppendResult(interp, " bind variable :", var_p->string, 
@@ -373,10 +546,13 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
             string_list_free_list(bind_variables);
             free_fetch_buffers(connection);
             return TCL_ERROR;
-        } else if ( strcmp(var_p->string, ref) == 0 ) {
+        } else if ( strcmp(var_p->string, ref) == 0 ||
+                    bind_spec(cursors, n_cursors, var_p->string) != NULL ) {
             /* Handle REF CURSOR */
 
-            if ( refcursor_count == 1 ) {
+            if ( strcmp(var_p->string, ref) != 0 ) {
+                /* one of the -cursors; any number of those */
+            } else if ( refcursor_count == 1 ) {
                 Tcl_SetResult(interp, " invalid plsql statement, you\
                         can only have a single ref cursors. ", TCL_STATIC);
                 return TCL_ERROR;
@@ -445,6 +621,11 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
             fetchbuf->external_type = SQLT_STR;
             fetchbuf->is_null = 0;
 
+            /* An anonymous block has no describe metadata for its binds,
+             * so start the OUT buffer from the size of the IN value. */
+            fetchbuf->buf_size = plsql_buffer_size(strlen(value) + 1);
+            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+
             oci_status = OCIBindByName(connection->stmt,
                                        &fetchbuf->bind,
                                        connection->err,
@@ -452,7 +633,7 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
                                        strlen(var_p->string),
 
                                        NULL,                     /* valuep */
-                                       MAX_DYNAMIC_BUFFER,       /* value_sz */
+                                       max_plsql_buffer_size,    /* value_sz */
                                        fetchbuf->external_type,  /* dty */
                                        &fetchbuf->is_null,       /* indp */
                                        0,                        /* alenp */ 
@@ -489,17 +670,27 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
 
     }
 
-    oci_status = OCIStmtExecute(connection->svc,
-                                connection->stmt,
-                                connection->err,
-                                1,
-                                0, NULL, NULL,
-                                (connection->mode == autocommit
-                                 ? OCI_COMMIT_ON_SUCCESS :
-                                 OCI_DEFAULT));
+    oci_status = execute_statement(dbh, connection->stmt, 1,
+                                   (connection->mode == autocommit
+                                    ? OCI_COMMIT_ON_SUCCESS :
+                                    OCI_DEFAULT), query);
 
     if (oci_error_p (lexpos (), dbh, "OCIStmtExecute", query, oci_status)) {
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+        Ns_OracleFlush(dbh);
+        string_list_free_list(bind_variables);
+        free_fetch_buffers(connection);
+        return TCL_ERROR;
+    }
+
+    /* Implicit results belong to the block's statement, so fetch them
+     * before a REF CURSOR takes its place below. */
+    if (results != NULL 
+        && plsql_implicit_results(interp, dbh, results, 
+                                  prefetch, fetch_size, 
+                                  materialize) != TCL_OK) {
         Ns_OracleFlush(dbh);
+        string_list_free_list(bind_variables);
         free_fetch_buffers(connection);
         return TCL_ERROR;
     }
@@ -520,8 +711,36 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
                     Tcl_SetVar(interp, var_p->string, fetchbuf->buf, 0);
                     break;
 
+                case SQLT_CHR:
+                    Tcl_SetVar2Ex(interp, var_p->string, NULL,
+                                  plsql_table_list(fetchbuf), 0);
+                    break;
+
+                case SQLT_CLOB:
+                case SQLT_BLOB:
+                    if (plsql_lob_result(interp, dbh, fetchbuf) != TCL_OK) {
+                        Ns_OracleFlush(dbh);
+                        string_list_free_list(bind_variables);
+                        free_fetch_buffers(connection);
+                        lob_reopen(dbh);
+                        return TCL_ERROR;
+                    }
+                    break;
+
                 case SQLT_RSET:
 
+                    if (strcmp(var_p->string, ref) != 0) {
+                        if (plsql_cursor_result(interp, dbh, fetchbuf, 
+                                                prefetch, fetch_size,
+                                                materialize) != TCL_OK) {
+                            Ns_OracleFlush(dbh);
+                            string_list_free_list(bind_variables);
+                            free_fetch_buffers(connection);
+                            return TCL_ERROR;
+                        }
+                        break;
+                    }
+
                     oci_status = OCIHandleFree (connection->stmt,
                                                 OCI_HTYPE_STMT);
                     if (tcl_error_p
@@ -532,6 +751,7 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
                     }
 
                     connection->stmt = fetchbuf->stmt;
+                    fetchbuf->stmt = NULL;
                     break;
             }
         }
@@ -544,692 +764,808 @@ OraclePLSQL (Tcl_Interp *interp, int objc,
 }
 /*}}}*/
 
-/*{{{ OracleExecPLSQL
+/*{{{ plsql_cursor_result
  *----------------------------------------------------------------------
- * OracleExecPLSQL --
+ * plsql_cursor_result --
  *
- *      Implements [ns_ora exec_plsql]
- *
- *      ns_ora exec_plsql dbhandle sql
+ *      Helper for [ns_ora plsql]: hands back one of the -cursors.  With
+ *      materialize (0 for list, 1 for dict) the whole cursor is
+ *      fetched into the variable; otherwise the cursor is kept on the
+ *      connection and the variable is set to its id for [ns_ora fetch].
  *
  * Results:
  *
- *      Nothing.
+ *      TCL_OK, or TCL_ERROR with a message in the interp.
+ *
+ * Side effects:
+ *
+ *      Takes the statement handle out of fetchbuf when the cursor is
+ *      kept.
  *
  *----------------------------------------------------------------------
  */
-int
-OracleExecPLSQL (Tcl_Interp *interp, int objc, 
-                 Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+static int
+plsql_cursor_result(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+                    fetch_buffer_t *fetchbuf, int prefetch, int fetch_size, 
+                    int materialize)
 {
-    OCIBind           *bind;
-    ora_connection_t  *connection;
-    oci_status_t       oci_status;
-    char              *query, *buf;
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    Tcl_Obj          *rows;
+    ub4               rows_attr = prefetch;
+    int               done;
+    char              id[32];
+
+    if (prefetch > 0) {
+        oci_status = OCIAttrSet(fetchbuf->stmt,
+                                OCI_HTYPE_STMT,
+                                (dvoid *) &rows_attr,
+                                0,
+                                OCI_ATTR_PREFETCH_ROWS,
+                                connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", 0, 
+                        oci_status)) {
+            return TCL_ERROR;
+        }
+    }
 
-    /* This indicator variable is a dummy.  We don't actually check the
-     * status.  Previously, we set the indp parameter to OCIBindByPos to
-     * 0.  Oracle would throw ORA-01405 and we would specifically ignore
-     * it in tcl_error_p.  Now we pass this dummy variable, and Oracle
-     * returns OCI_SUCCESS whether or not the returned value is NULL.
-     * This eliminates the need for explicitly handling ORA-01405 in
-     * tcl_error_p. */
+    if (materialize >= 0) {
+        rows = Tcl_NewListObj(0, NULL);
+        Tcl_IncrRefCount(rows);
 
-    sb2               null_indicator = OCI_IND_NULL;
+        if (fetch_cursor_rows(interp, dbh, fetchbuf->stmt, fetch_size, 0, 
+                              materialize, rows, &done) != TCL_OK) {
+            Tcl_DecrRefCount(rows);
+            return TCL_ERROR;
+        }
 
-    if (objc != 4) {
-        Tcl_WrongNumArgs(interp, 2, objv, 
-                "dbhandle dbId sql");
-	return TCL_ERROR;
-    }
-      
-    connection = dbh->connection;
-    query = Tcl_GetString(objv[3]);
-      
-    if (!allow_sql_p(dbh, query, NS_TRUE)) {
-        Tcl_AppendResult (interp, "SQL ", query, " has been rejected "
-	        "by the Oracle driver", NULL);
-	return TCL_ERROR;
-    }
+        Tcl_SetVar2Ex(interp, fetchbuf->name, NULL, rows, 0);
+        Tcl_DecrRefCount(rows);
 
-    if (dbh->verbose) {
-	Ns_Log (Notice, "SQL():  %s", query);
-    }
-      
-    oci_status = OCIHandleAlloc (connection->env,
-                                 (oci_handle_t **) &connection->stmt,
-				 OCI_HTYPE_STMT,
-				 0, NULL);
-    if (tcl_error_p (lexpos (), interp, dbh, "OCIHandleAlloc",
-                query, oci_status)) {
-        Ns_OracleFlush (dbh);
-	return TCL_ERROR;
-    }
-      
-    oci_status = OCIStmtPrepare (connection->stmt,
-				 connection->err,
-				 query, strlen (query),
-				 OCI_NTV_SYNTAX,
-				 OCI_DEFAULT);
-    if (tcl_error_p (lexpos (), interp, dbh, "OCIStmtPrepare", 
-                query, oci_status)) {
-        Ns_OracleFlush (dbh);
-        return TCL_ERROR;
+        return TCL_OK;
     }
-      
-    buf = Ns_Malloc(EXEC_PLSQL_BUFFER_SIZE);
 
-    oci_status = OCIBindByPos (connection->stmt,
-			       &bind,
-			       connection->err,
-			       1,
-			       buf,
-			       EXEC_PLSQL_BUFFER_SIZE,
-			       SQLT_STR,
-			       &null_indicator,
-			       0,
-			       0,
-			       0,
-			       0,
-			       OCI_DEFAULT);
-    if (tcl_error_p (lexpos (), interp, dbh, "OCIBindByPos", 
-                query, oci_status)) {
-	Ns_OracleFlush (dbh);
-        Ns_Free(buf);
+    connection->cursors = Ns_Realloc(connection->cursors, 
+            (connection->n_cursors + 1) * sizeof *connection->cursors);
+    connection->cursors[connection->n_cursors] = fetchbuf->stmt;
+    fetchbuf->stmt = NULL;
 
-        return TCL_ERROR;
-    }
-      
-    oci_status = OCIStmtExecute (connection->svc,
-				 connection->stmt,
-				 connection->err,
-				 1,
-				 0, NULL, NULL,
-				 (connection->mode == autocommit
-				  ? OCI_COMMIT_ON_SUCCESS
-				  : OCI_DEFAULT));
-    if (tcl_error_p (lexpos (), interp, dbh, "OCIStmtExecute", 
-                query, oci_status)) {
-	Ns_OracleFlush (dbh);
-        Ns_Free(buf);
-	  
-        return TCL_ERROR;
-    }
-      
-    Tcl_AppendResult (interp, buf, NULL);
-    Ns_Free(buf);
+    sprintf(id, "cursor%d", connection->n_cursors++);
+    Tcl_SetVar(interp, fetchbuf->name, id, 0);
 
-    return NS_OK;
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ OracleExecPLSQLBind
+/*{{{ plsql_implicit_results
  *----------------------------------------------------------------------
- * OracleExecPLSQLBind --
+ * plsql_implicit_results --
  *
- *      Implements [ns_ora exec_plsql_bind]
- *
- *      ns_ora exec_plsql_bind dbhandle sql return_var ?arg1 ... argn?
+ *      Helper for [ns_ora plsql -results]: fetches each result set the
+ *      block returned with DBMS_SQL.RETURN_RESULT, in the format
+ *      materialize asks for (list unless 1 for dict), and sets the
+ *      variable to the list of them.
  *
  * Results:
  *
- *      Nothing.
+ *      TCL_OK, or TCL_ERROR with a message in the interp.
+ *
+ * Side effects:
+ *
+ *      None; the result sets are freed with the block's statement.
  *
  *----------------------------------------------------------------------
  */
-int
-OracleExecPLSQLBind (Tcl_Interp *interp, int objc, 
-                     Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+static int
+plsql_implicit_results(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+                       Tcl_Obj *varName, int prefetch, int fetch_size,
+                       int materialize)
 {
-    ora_connection_t  *connection;
-    oci_status_t       oci_status;
-    string_list_elt_t *bind_variables, *var_p;
-    int                argv_base, i;
-    char               *retvar, *retbuf, *nbuf, *query;;
-      
-    if (objc < 5) {
-        Tcl_AppendResult (interp, "wrong number of args: should be `",
-	        Tcl_GetString(objv[0]), 
-                " exec_plsql_bind dbId sql retvar <args>'", NULL);
-	return TCL_ERROR;
-    }
-      
-    connection = dbh->connection;
-    query = Tcl_GetString(objv[3]);
-    retvar = Tcl_GetString(objv[4]);
-    
-    if (!allow_sql_p(dbh, query, NS_TRUE)) {
-        Tcl_AppendResult (interp, "SQL ", query, " has been rejected " 
-                "by the Oracle driver", NULL);
-        return TCL_ERROR;
-    }
+#ifdef OCI_ATTR_IMPLICIT_RESULT_COUNT
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    Tcl_Obj          *sets, *rows;
+    dvoid            *result;
+    ub4               rtype, rows_attr = prefetch;
+    int               done;
 
-    if (dbh->verbose) {
-        Ns_Log (Notice, "SQL():  %s", query);
-    }
-      
-    oci_status = OCIHandleAlloc (connection->env,
-                                 (oci_handle_t **) &connection->stmt,
-                                 OCI_HTYPE_STMT,
-                                 0, NULL);
-    if (tcl_error_p (lexpos (), interp, dbh, "OCIHandleAlloc", 
-                query, oci_status)) {
-        Ns_OracleFlush (dbh);
-        return TCL_ERROR;
-    }
-      
-    oci_status = OCIStmtPrepare (connection->stmt,
-                                 connection->err,
-				 query, strlen (query),
-				 OCI_NTV_SYNTAX,
-				 OCI_DEFAULT);
-    if (tcl_error_p (lexpos (), interp, dbh, "OCIStmtPrepare", 
-                query, oci_status)) {
-        Ns_OracleFlush (dbh);
-        return TCL_ERROR;
-    }
-      
-    argv_base = 4;
-    retbuf = NULL;
+    sets = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(sets);
 
-    bind_variables = parse_bind_variables(query);
-    connection->n_columns = string_list_len(bind_variables);
-      
-    ns_ora_log(lexpos(), "%d bind variables", connection->n_columns);
+    for (;;) {
+        oci_status = OCIStmtGetNextResult(connection->stmt, connection->err,
+                                          &result, &rtype, OCI_DEFAULT);
+        if (oci_status == OCI_NO_DATA) {
+            break;
+        }
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtGetNextResult", 0,
+                        oci_status)) {
+            Tcl_DecrRefCount(sets);
+            return TCL_ERROR;
+        }
 
-    malloc_fetch_buffers (connection);
+        if (rtype != OCI_RESULT_TYPE_SELECT) {
+            continue;
+        }
 
-    for (var_p = bind_variables, i=0; var_p != NULL; var_p = var_p->next, i++) {
-        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
-	char           *value = NULL;
-        int             index;
+        if (prefetch > 0) {
+            oci_status = OCIAttrSet(result, OCI_HTYPE_STMT,
+                                    (dvoid *) &rows_attr, 0,
+                                    OCI_ATTR_PREFETCH_ROWS, connection->err);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", 0, 
+                            oci_status)) {
+                Tcl_DecrRefCount(sets);
+                return TCL_ERROR;
+            }
+        }
 
-        fetchbuf->type = -1;
-        index = strtol(var_p->string, &nbuf, 10);
+        rows = Tcl_NewListObj(0, NULL);
+        Tcl_ListObjAppendElement(NULL, sets, rows);
 
-        if (*nbuf == '\0') {
-             /*  It was a valid number.
-              *  Pick out one of the remaining arguments,
-              *  where ":1" is the first remaining arg. 
-              */
-            if ((index < 1) || (index > (objc - argv_base - 1))) {
-
-                if (index < 1) {
-                    Tcl_AppendResult (interp, 
-                            "invalid positional variable `:",
-                            var_p->string, 
-                            "', valid values start with 1", NULL);
-                } else {
-                    Tcl_AppendResult (interp, 
-                            "not enough arguments for positional variable ':",
-                            var_p->string, "'", NULL);
-                }
-
-                Ns_OracleFlush(dbh);
-                string_list_free_list(bind_variables);
-                  
-                return TCL_ERROR;
-            }
-
-            value = Tcl_GetString(objv[argv_base + index]);
-
-        } else {
+        if (fetch_cursor_rows(interp, dbh, (OCIStmt *) result, fetch_size, 
+                              0, materialize == 1, rows, &done) != TCL_OK) {
+            Tcl_DecrRefCount(sets);
+            return TCL_ERROR;
+        }
+    }
 
-            value = Tcl_GetVar(interp, var_p->string, 0);
+    Tcl_ObjSetVar2(interp, varName, NULL, sets, 0);
+    Tcl_DecrRefCount(sets);
 
-            if (value == NULL) {
-                if (strcmp(var_p->string, retvar) == 0) {
-                      /*  It's OK if it's undefined, since this is 
-                       *  the return variable.
-                       */
-                    value = "";
-                } else {
-                    
-                    Tcl_AppendResult (interp, "undefined variable `", 
-                            var_p->string,
-                            "'", NULL);
+    return TCL_OK;
+#else
+    Tcl_AppendResult(interp, "implicit results need Oracle 12c or later "
+            "client libraries; this driver was built without them", NULL);
+    return TCL_ERROR;
+#endif
+}
+/*}}}*/
 
-                    Ns_OracleFlush(dbh);
-                    string_list_free_list(bind_variables);
+/*{{{ bind_spec */
+/*
+ * bind_spec returns the element of a list of {name ...} bind option
+ * specs that belongs to the named bind variable, or NULL.
+ */
+static Tcl_Obj *
+bind_spec(Tcl_Obj **specs, int n_specs, char *name)
+{
+    Tcl_Obj *first;
+    int      i;
 
-                    return TCL_ERROR;
-                }
-            }
+    for (i = 0; i < n_specs; i++) {
+        if (Tcl_ListObjIndex(NULL, specs[i], 0, &first) == TCL_OK
+            && first != NULL && !strcmp(Tcl_GetString(first), name)) {
+            return specs[i];
         }
+    }
 
-        if (strcmp(var_p->string, retvar) == 0) {
-
-            /*  This is the variable we're going to return
-             *  as the result.
-             */
-            retbuf = fetchbuf->buf = Ns_Malloc(EXEC_PLSQL_BUFFER_SIZE);
-            memset(retbuf, (int)'\0', (size_t)EXEC_PLSQL_BUFFER_SIZE);
-            strncpy(retbuf, value, EXEC_PLSQL_BUFFER_SIZE);
-            fetchbuf->fetch_length = EXEC_PLSQL_BUFFER_SIZE;
-            fetchbuf->is_null = 0;
+    return NULL;
+}
+/*}}}*/
 
-        } else {
-            fetchbuf->buf = Ns_StrDup(value);
-            fetchbuf->fetch_length = strlen(fetchbuf->buf) + 1;
-            fetchbuf->is_null = 0;
-        }
+/*{{{ plsql_buffer_size */
+/*
+ * plsql_buffer_size returns the size of a dynamically bound PL/SQL
+ * buffer big enough for wanted bytes: the next power of two, at least
+ * EXEC_PLSQL_BUFFER_SIZE and at most MaxPLSQLBufferSize plus room for
+ * the terminating null.
+ */
+static unsigned
+plsql_buffer_size(unsigned wanted)
+{
+    unsigned size = EXEC_PLSQL_BUFFER_SIZE;
 
-        if (dbh->verbose) {
-            Ns_Log(Notice, "bind variable '%s' = '%s'", var_p->string, value);
-        }
+    while (size < wanted && size <= (unsigned) max_plsql_buffer_size) {
+        size *= 2;
+    }
 
-        ns_ora_log(lexpos(), "ns_ora exec_plsql_bind:  binding variable %s", 
-                var_p->string);
+    if (size > (unsigned) max_plsql_buffer_size + 1) {
+        size = max_plsql_buffer_size + 1;
+    }
 
-        oci_status = OCIBindByName(connection->stmt,
-                                   &fetchbuf->bind,
-                                   connection->err,
-                                   var_p->string,
-                                   strlen(var_p->string),
-                                   fetchbuf->buf,
-                                   fetchbuf->fetch_length,
-                                   SQLT_STR,
-                                   &fetchbuf->is_null,
-                                   0,
-                                   0,
-                                   0,
-                                   0,
-                                   OCI_DEFAULT);
+    return size;
+}
+/*}}}*/
 
-        if (oci_error_p (lexpos (), dbh, "OCIBindByName", query, oci_status)) {
-            Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
-	    Ns_OracleFlush (dbh);
-            string_list_free_list(bind_variables);
+/*{{{ bind_plsql_table
+ *----------------------------------------------------------------------
+ * bind_plsql_table --
+ *
+ *      Helper for [ns_ora plsql]: binds a Tcl list as a PL/SQL
+ *      index-by table.  spec is {name ?max_elements? ?element_size?};
+ *      by default the table can hold the larger of the list's length
+ *      and PLSQL_TABLE_SIZE elements, each the larger of the longest
+ *      value and PLSQL_TABLE_ELEMENT_SIZE bytes.
+ *
+ * Results:
+ *
+ *      TCL_OK, or TCL_ERROR with a message in the interp.
+ *
+ * Side effects:
+ *
+ *      Allocates the element arrays in fetchbuf.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+bind_plsql_table(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+                 fetch_buffer_t *fetchbuf, Tcl_Obj *spec, char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    Tcl_Obj          *value, **elements = NULL, **options;
+    int               n_elements = 0, n_options, max_elements, element_size;
+    int               j, length;
+    char             *string;
 
-	    return TCL_ERROR;
-	}
+    if (Tcl_ListObjGetElements(interp, spec, &n_options, &options) != TCL_OK) {
+        return TCL_ERROR;
+    }
 
+    value = Tcl_GetVar2Ex(interp, fetchbuf->name, NULL, 0);
+    if (value != NULL 
+        && Tcl_ListObjGetElements(interp, value, &n_elements, &elements) 
+               != TCL_OK) {
+        return TCL_ERROR;
     }
 
-    if (retbuf == NULL) {
-        Tcl_AppendResult(interp, "return variable '", retvar, 
-                "' not found in statement bind variables", NULL);
-        Ns_OracleFlush (dbh);
-        string_list_free_list(bind_variables);
+    max_elements = n_elements > PLSQL_TABLE_SIZE ? n_elements 
+                                                 : PLSQL_TABLE_SIZE;
+    element_size = PLSQL_TABLE_ELEMENT_SIZE;
+    for (j = 0; j < n_elements; j++) {
+        Tcl_GetStringFromObj(elements[j], &length);
+        if (length + 1 > element_size) {
+            element_size = length + 1;
+        }
+    }
 
+    if ((n_options > 1 
+         && Tcl_GetIntFromObj(interp, options[1], &max_elements) != TCL_OK)
+        || (n_options > 2 
+            && Tcl_GetIntFromObj(interp, options[2], &element_size) != TCL_OK)) {
         return TCL_ERROR;
     }
 
-    oci_status = OCIStmtExecute (connection->svc,
-                                 connection->stmt,
-				 connection->err,
-				 1,
-				 0, NULL, NULL,
-				 (connection->mode == autocommit
-				 ? OCI_COMMIT_ON_SUCCESS
-				 : OCI_DEFAULT));
+    if (max_elements < n_elements || element_size < 1 
+        || element_size > UB2MAXVAL) {
+        Tcl_AppendResult(interp, "index-by table :", fetchbuf->name,
+                " does not fit in the given max_elements or element_size", 
+                NULL);
+        return TCL_ERROR;
+    }
 
-    string_list_free_list(bind_variables);
+    fetchbuf->external_type = SQLT_CHR;
+    fetchbuf->inout = BIND_OUT;
+    fetchbuf->buf_size = max_elements * element_size;
+    fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+    fetchbuf->size = element_size;
+    fetchbuf->max_elements = max_elements;
+    fetchbuf->n_elements = n_elements;
+    fetchbuf->indicators = Ns_Malloc(max_elements * sizeof(sb2));
+    fetchbuf->lengths = Ns_Malloc(max_elements * sizeof(ub2));
+    fetchbuf->rcodes = Ns_Malloc(max_elements * sizeof(ub2));
+
+    for (j = 0; j < n_elements; j++) {
+        string = Tcl_GetStringFromObj(elements[j], &length);
+        memcpy(fetchbuf->buf + j * element_size, string, length);
+        fetchbuf->lengths[j] = length;
+        fetchbuf->indicators[j] = length == 0 ? -1 : 0;
+    }
+
+    oci_status = OCIBindByName(connection->stmt,
+                               &fetchbuf->bind,
+                               connection->err,
+                               fetchbuf->name,
+                               strlen(fetchbuf->name),
+                               fetchbuf->buf,
+                               element_size,
+                               SQLT_CHR,
+                               fetchbuf->indicators,
+                               fetchbuf->lengths,
+                               fetchbuf->rcodes,
+                               max_elements,          /* maxarr_len */
+                               &fetchbuf->n_elements, /* curelep */
+                               OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByName", query, 
+                    oci_status)) {
+        return TCL_ERROR;
+    }
 
-    if (tcl_error_p (lexpos (), interp, dbh, "OCIStmtExecute", 
-                query, oci_status)) {
-        Ns_OracleFlush (dbh);
+    oci_status = OCIBindArrayOfStruct(fetchbuf->bind, connection->err,
+                                      element_size, sizeof(sb2),
+                                      sizeof(ub2), sizeof(ub2));
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIBindArrayOfStruct", query, 
+                    oci_status)) {
         return TCL_ERROR;
     }
-      
-    Tcl_AppendResult (interp, retbuf, NULL);
-      
-    /* Check to see if return variable was a Tcl variable */
-      
-    (void) strtol(retvar, &nbuf, 10);
-      
-    if (*nbuf != '\0') {
-          /* It was a variable name. */
-        Tcl_SetVar(interp, retvar, retbuf, 0);
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ plsql_table_list */
+/*
+ * plsql_table_list turns an index-by table bound by bind_plsql_table
+ * back into a Tcl list, using the element count Oracle returned.
+ */
+static Tcl_Obj *
+plsql_table_list(fetch_buffer_t *fetchbuf)
+{
+    Tcl_Obj *list = Tcl_NewListObj(0, NULL);
+    ub4      j;
+
+    for (j = 0; j < fetchbuf->n_elements && j < fetchbuf->max_elements; j++) {
+        if (fetchbuf->indicators[j] == -1) {
+            Tcl_ListObjAppendElement(NULL, list, Tcl_NewObj());
+        } else {
+            Tcl_ListObjAppendElement(NULL, list,
+                    Tcl_NewStringObj(fetchbuf->buf + j * fetchbuf->size,
+                                     fetchbuf->lengths[j]));
+        }
     }
 
-    return NS_OK;
+    return list;
 }
 /*}}}*/
 
-/*{{{ OracleSelect
+/*{{{ bind_plsql_lob
  *----------------------------------------------------------------------
- * OracleSelect --
- *
- *      Implements [ns_ora select]
- *                 [ns_ora dml]
- *                 [ns_ora array_dml]
- *                 [ns_ora 1row]
- *                 [ns_ora 0or1row]
+ * bind_plsql_lob --
  *
- *      ns_ora select dbhandle sql 
- *      ns_ora dml dbhandle sql 
- *      ns_ora array_dml dbhandle sql 
- *      ns_ora 1row dbhandle sql 
- *      ns_ora 0or1row dbhandle sql 
+ *      Helper for [ns_ora plsql]: binds a variable as a temporary CLOB
+ *      or BLOB.  spec is {name ?in|out|inout? ?file?}.  Unless the mode
+ *      is out the variable's value is written to the LOB, lob_buffer_size
+ *      bytes at a time, before the call.
  *
  * Results:
  *
- *      Nothing.
+ *      TCL_OK, or TCL_ERROR with a message in the interp.
+ *
+ * Side effects:
+ *
+ *      Allocates fetchbuf->lob and creates a temporary LOB in the
+ *      session, freed with the fetch buffers.
  *
  *----------------------------------------------------------------------
  */
-int
-OracleSelect (Tcl_Interp *interp, int objc, 
-              Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+static int
+bind_plsql_lob(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+               fetch_buffer_t *fetchbuf, Tcl_Obj *spec, int blob_p, 
+               char *query)
 {
-    ora_connection_t  *connection;
-    oci_status_t       oci_status;
-    string_list_elt_t *bind_variables, 
-                      *var_p;
-    char              *query, *command, *subcommand;
-    int                i;
-    ub4                iters;
-    ub2                type;
-    int                dml_p;
-    int                array_p;      /* Array DML */
-    int                argv_base;    /* Index of the SQL statement argument (necessary to support -bind) */
-    Ns_Set            *set = NULL;   /* If we're binding to an ns_set, a pointer to the struct */
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    Tcl_Obj         **options, *value;
+    int               n_options;
+    char             *mode = "inout";
 
-    if (objc < 4 || (!strcmp("-bind", Tcl_GetString(objv[3])) && objc < 6)) {
-        Tcl_WrongNumArgs(interp, 2, objv, 
-                "dbhandle ?-bind set? sql ?arg1 .. argN?");
+    if (Tcl_ListObjGetElements(interp, spec, &n_options, &options) != TCL_OK) {
         return TCL_ERROR;
     }
 
-    command = Tcl_GetString(objv[0]);
-    subcommand = Tcl_GetString(objv[1]);
+    if (n_options > 1) {
+        mode = Tcl_GetString(options[1]);
+    }
+    if (strcmp(mode, "in") && strcmp(mode, "out") && strcmp(mode, "inout")) {
+        Tcl_AppendResult(interp, "invalid mode \"", mode, "\" for LOB :", 
+                fetchbuf->name, ": should be in, out or inout", NULL);
+        return TCL_ERROR;
+    }
 
-    connection = dbh->connection;
-    connection->interp = interp;
+    fetchbuf->external_type = blob_p ? SQLT_BLOB : SQLT_CLOB;
+    fetchbuf->inout = strcmp(mode, "in") ? BIND_OUT : BIND_IN;
+    fetchbuf->lob_path = n_options > 2 ? Tcl_GetString(options[2]) : NULL;
+    fetchbuf->is_null = 0;
 
-    if (!connection) {
-        Tcl_SetResult(interp, "error: no connection", NULL);
+    value = Tcl_GetVar2Ex(interp, fetchbuf->name, NULL, 0);
+    if (value == NULL && strcmp(mode, "out")) {
+        Tcl_AppendResult(interp, " bind variable :", fetchbuf->name, 
+                " does not exist. ", NULL);
         return TCL_ERROR;
     }
 
-    if (!strcmp(subcommand, "dml")) {
-        dml_p = 1;
-        array_p = 0;
-    } else if (!strcmp(subcommand, "array_dml")) {
-        dml_p = 1;
-        array_p = 1;
-    } else {
-        dml_p = 0;
-        array_p = 0;
+    if (create_temporary_lob(interp, dbh, fetchbuf, blob_p, 
+                             strcmp(mode, "out") ? value : NULL, query) 
+            != TCL_OK) {
+        return TCL_ERROR;
     }
 
-    if (!strcmp("-bind", Tcl_GetString(objv[3]))) {
-        /* Binding to a set. The query is argv[5]. */
-        argv_base = 5;
-        set = Ns_TclGetSet(interp, Tcl_GetString(objv[4]));
-        if (set == NULL) {
-            Tcl_AppendResult(interp, "invalid set id `", Tcl_GetString(objv[4]), "'", NULL);
-            return TCL_ERROR;
-        }
-    } else {
-        /* Not binding to a set. The query is argv[3]. */
-        argv_base = 3;
+    oci_status = OCIBindByName(connection->stmt,
+                               &fetchbuf->bind,
+                               connection->err,
+                               fetchbuf->name,
+                               strlen(fetchbuf->name),
+                               &fetchbuf->lob,
+                               -1,
+                               fetchbuf->external_type,
+                               &fetchbuf->is_null,
+                               0, 0, 0, 0, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByName", query, 
+                    oci_status)) {
+        return TCL_ERROR;
     }
 
-    query = Tcl_GetString(objv[argv_base]);
+    return TCL_OK;
+}
+/*}}}*/
 
-    if (!allow_sql_p(dbh, query, NS_TRUE)) {
-        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
-                "by the Oracle driver", NULL);
+/*{{{ create_temporary_lob */
+/*
+ * create_temporary_lob gives fetchbuf->lob a temporary CLOB or BLOB
+ * for a PL/SQL bind and writes value, if not NULL, to it.  The LOB is
+ * freed with the fetch buffers.
+ */
+static int
+create_temporary_lob(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+                     fetch_buffer_t *fetchbuf, int blob_p, Tcl_Obj *value,
+                     char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    int               length;
+    char             *data;
+
+    oci_status = OCIDescriptorAlloc(connection->env,
+                                    (dvoid **) &fetchbuf->lob,
+                                    OCI_DTYPE_LOB, 0, 0);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIDescriptorAlloc", query, 
+                    oci_status)) {
         return TCL_ERROR;
     }
 
-    if (dbh->verbose)
-        Ns_Log(Notice, "SQL():  %s", query);
+    oci_status = OCILobCreateTemporary(connection->svc, connection->err,
+                                       fetchbuf->lob, 
+                                       OCI_DEFAULT, OCI_DEFAULT,
+                                       blob_p ? OCI_TEMP_BLOB : OCI_TEMP_CLOB,
+                                       FALSE, OCI_DURATION_SESSION);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCILobCreateTemporary", query, 
+                    oci_status)) {
+        return TCL_ERROR;
+    }
+    fetchbuf->is_temporary = 1;
 
-    /* In order to handle transactions we check now for our
-     * custom SQL-like commands.  If query is one of those
-     * commands then we are done after calling handle_builtins.
-     */
-    switch (handle_builtins(dbh, query)) {
-        case NS_DML:
-            return TCL_OK;
+    if (value != NULL) {
+        if (blob_p) {
+            data = (char *) Tcl_GetByteArrayFromObj(value, &length);
+        } else {
+            data = Tcl_GetStringFromObj(value, &length);
+        }
 
-        case NS_ERROR:
-            Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                          TCL_VOLATILE);
+        if (write_lob_buffer(interp, dbh, fetchbuf->lob, data, length) 
+                != NS_OK) {
             return TCL_ERROR;
+        }
+    }
 
-        case NS_OK:
-            break;
+    return TCL_OK;
+}
+/*}}}*/
 
-        default:
-            error(lexpos(), "internal error");
-            Tcl_AppendResult(interp, "internal error", NULL);
+/*{{{ plsql_lob_result */
+/*
+ * plsql_lob_result hands back an OUT LOB bound by bind_plsql_lob: it
+ * sets the variable to the LOB's value, or writes the value to the
+ * file named in the bind spec.  A NULL LOB is the empty string.  If
+ * writing the file fails the caller must lob_reopen the handle once
+ * it has freed the fetch buffers.
+ */
+static int
+plsql_lob_result(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+                 fetch_buffer_t *fetchbuf)
+{
+    ora_connection_t *connection = dbh->connection;
+    Tcl_Obj          *value;
+    FILE             *fp;
+
+    if (fetchbuf->lob_path != NULL) {
+        if (fetchbuf->is_null == -1) {
+            if ((fp = fopen(fetchbuf->lob_path, "w")) == NULL) {
+                Tcl_AppendResult(interp, "can't open file ", 
+                        fetchbuf->lob_path, " for writing. ", 
+                        "received error ", strerror(errno), NULL);
+                return TCL_ERROR;
+            }
+            fclose(fp);
+        } else if (stream_write_lob(interp, dbh, 0, fetchbuf->lob, 1, 0,
+                                    fetchbuf->lob_path, 0, connection->svc, 
+                                    connection->err) != STREAM_WRITE_LOB_OK) {
             return TCL_ERROR;
+        }
+        return TCL_OK;
     }
 
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) &connection->stmt,
-                                OCI_HTYPE_STMT, 0, NULL);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
-        Ns_OracleFlush(dbh);
+    if (fetchbuf->is_null == -1) {
+        value = Tcl_NewObj();
+    } else if ((value = read_lob_value(interp, dbh, fetchbuf->lob, 
+                       fetchbuf->external_type == SQLT_BLOB)) == NULL) {
         return TCL_ERROR;
     }
 
-    oci_status = OCIStmtPrepare(connection->stmt,
-                                connection->err,
-                                query, strlen(query),
-                                OCI_NTV_SYNTAX, OCI_DEFAULT);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
-        Ns_OracleFlush(dbh);
+    Tcl_SetVar2Ex(interp, fetchbuf->name, NULL, value, 0);
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleExecPLSQL
+ *----------------------------------------------------------------------
+ * OracleExecPLSQL --
+ *
+ *      Implements [ns_ora exec_plsql]
+ *
+ *      ns_ora exec_plsql dbhandle sql
+ *
+ * Results:
+ *
+ *      Nothing.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleExecPLSQL (Tcl_Interp *interp, int objc, 
+                 Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection;
+    fetch_buffer_t    *fetchbuf;
+    oci_status_t       oci_status;
+    char              *query;
+
+    /* The indicator variable in the fetch buffer is only there so that
+     * Oracle returns OCI_SUCCESS rather than ORA-01405 when the returned
+     * value is NULL, which then comes back as the empty string. */
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                "dbhandle dbId sql");
+	return TCL_ERROR;
+    }
+      
+    connection = dbh->connection;
+    query = Tcl_GetString(objv[3]);
+      
+    if (!allow_sql_p(dbh, query, NS_TRUE)) {
+        Tcl_AppendResult (interp, "SQL ", query, " has been rejected "
+	        "by the Oracle driver", NULL);
+	return TCL_ERROR;
+    }
+
+    if (dbh->verbose) {
+	Ns_Log (Notice, "SQL():  %s", query);
+    }
+      
+    oci_status = OCIHandleAlloc (connection->env,
+                                 (oci_handle_t **) &connection->stmt,
+				 OCI_HTYPE_STMT,
+				 0, NULL);
+    if (tcl_error_p (lexpos (), interp, dbh, "OCIHandleAlloc",
+                query, oci_status)) {
+        Ns_OracleFlush (dbh);
+	return TCL_ERROR;
+    }
+      
+    oci_status = OCIStmtPrepare (connection->stmt,
+				 connection->err,
+				 query, strlen (query),
+				 OCI_NTV_SYNTAX,
+				 OCI_DEFAULT);
+    if (tcl_error_p (lexpos (), interp, dbh, "OCIStmtPrepare", 
+                query, oci_status)) {
+        Ns_OracleFlush (dbh);
         return TCL_ERROR;
     }
+      
+    /* The result is bound dynamically so that it is not limited to
+     * EXEC_PLSQL_BUFFER_SIZE; see DynamicBindOut. */
 
-    /* Check what type of statment it is, this will affect how
-     * many times we expect to execute it.
-     */
-    oci_status = OCIAttrGet(connection->stmt,
-                            OCI_HTYPE_STMT,
-                            (oci_attribute_t *) & type,
-                            NULL, OCI_ATTR_STMT_TYPE, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", query, oci_status)) {
-        Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                      TCL_VOLATILE);
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+    connection->n_columns = 1;
+    malloc_fetch_buffers(connection);
+
+    fetchbuf = &connection->fetch_buffers[0];
+    fetchbuf->buf_size = plsql_buffer_size(0);
+    fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+    fetchbuf->buf[0] = '\0';
+
+    oci_status = OCIBindByPos (connection->stmt,
+			       &fetchbuf->bind,
+			       connection->err,
+			       1,
+			       NULL,
+			       max_plsql_buffer_size,
+			       SQLT_STR,
+			       &fetchbuf->is_null,
+			       0,
+			       0,
+			       0,
+			       0,
+			       OCI_DATA_AT_EXEC);
+    if (tcl_error_p (lexpos (), interp, dbh, "OCIBindByPos", 
+                query, oci_status)) {
+	Ns_OracleFlush (dbh);
+
+        return TCL_ERROR;
     }
 
-    /* For SELECT statements we can set a couple extra attributes
-     * that may help speed up the query.
-     */
-    if (type == OCI_STMT_SELECT) {
-        iters = 0;
-        if (prefetch_rows > 0) {
-            /* Set prefetch rows attr for selects. */
-            oci_status = OCIAttrSet(connection->stmt,
-                                    OCI_HTYPE_STMT,
-                                    (dvoid *) & prefetch_rows,
-                                    0,
-                                    OCI_ATTR_PREFETCH_ROWS,
-                                    connection->err);
-            if (oci_error_p
-                (lexpos(), dbh, "OCIAttrSet", query, oci_status)) {
-                Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                              TCL_VOLATILE);
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            }
-        }
-        if (prefetch_memory > 0) {
-            /* Set prefetch memory attr for selects. */
-            oci_status = OCIAttrSet(connection->stmt,
-                                    OCI_HTYPE_STMT,
-                                    (dvoid *) & prefetch_memory,
-                                    0,
-                                    OCI_ATTR_PREFETCH_MEMORY,
-                                    connection->err);
-            if (oci_error_p
-                (lexpos(), dbh, "OCIAttrSet", query, oci_status)) {
-                Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                              TCL_VOLATILE);
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            }
-        }
-    } else {
-        iters = 1;
+    oci_status = OCIBindDynamic(fetchbuf->bind,
+                                connection->err,
+                                fetchbuf, DynamicBindIn,
+                                fetchbuf, DynamicBindOut);
+    if (tcl_error_p (lexpos (), interp, dbh, "OCIBindDynamic", 
+                query, oci_status)) {
+	Ns_OracleFlush (dbh);
+
+        return TCL_ERROR;
+    }
+      
+    oci_status = execute_statement (dbh, connection->stmt, 1,
+				    (connection->mode == autocommit
+				     ? OCI_COMMIT_ON_SUCCESS
+				     : OCI_DEFAULT), query);
+    if (tcl_error_p (lexpos (), interp, dbh, "OCIStmtExecute", 
+                query, oci_status)) {
+	Ns_OracleFlush (dbh);
+	  
+        return TCL_ERROR;
+    }
+      
+    if (fetchbuf->is_null != -1) {
+        Tcl_AppendResult (interp, fetchbuf->buf, NULL);
     }
+    free_fetch_buffers(connection);
 
-    /* Check for statement type mismatch */
-    if (type != OCI_STMT_SELECT && !dml_p) {
-        Ns_DbSetException(dbh, "ORA", 
-                "Query was not a statement returning rows.");
-        Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                TCL_VOLATILE);
-        Ns_OracleFlush(dbh);
+    return NS_OK;
+}
+/*}}}*/
 
+/*{{{ OracleExecPLSQLBind
+ *----------------------------------------------------------------------
+ * OracleExecPLSQLBind --
+ *
+ *      Implements [ns_ora exec_plsql_bind]
+ *
+ *      ns_ora exec_plsql_bind dbhandle sql return_var ?arg1 ... argn?
+ *
+ * Results:
+ *
+ *      Nothing.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleExecPLSQLBind (Tcl_Interp *interp, int objc, 
+                     Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection;
+    oci_status_t       oci_status;
+    string_list_elt_t *bind_variables, *var_p;
+    int                argv_base, i;
+    char               *retvar, *nbuf, *query;
+    fetch_buffer_t     *retfetchbuf;
+      
+    if (objc < 5) {
+        Tcl_AppendResult (interp, "wrong number of args: should be `",
+	        Tcl_GetString(objv[0]), 
+                " exec_plsql_bind dbId sql retvar <args>'", NULL);
+	return TCL_ERROR;
+    }
+      
+    connection = dbh->connection;
+    query = Tcl_GetString(objv[3]);
+    retvar = Tcl_GetString(objv[4]);
+    
+    if (!allow_sql_p(dbh, query, NS_TRUE)) {
+        Tcl_AppendResult (interp, "SQL ", query, " has been rejected " 
+                "by the Oracle driver", NULL);
         return TCL_ERROR;
-    } else if (type == OCI_STMT_SELECT && dml_p) {
-        Ns_DbSetException(dbh, "ORA", 
-                "Query was not a DML statement.");
-        Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                TCL_VOLATILE);
-        Ns_OracleFlush(dbh);
+    }
 
+    if (dbh->verbose) {
+        Ns_Log (Notice, "SQL():  %s", query);
+    }
+      
+    oci_status = OCIHandleAlloc (connection->env,
+                                 (oci_handle_t **) &connection->stmt,
+                                 OCI_HTYPE_STMT,
+                                 0, NULL);
+    if (tcl_error_p (lexpos (), interp, dbh, "OCIHandleAlloc", 
+                query, oci_status)) {
+        Ns_OracleFlush (dbh);
+        return TCL_ERROR;
+    }
+      
+    oci_status = OCIStmtPrepare (connection->stmt,
+                                 connection->err,
+				 query, strlen (query),
+				 OCI_NTV_SYNTAX,
+				 OCI_DEFAULT);
+    if (tcl_error_p (lexpos (), interp, dbh, "OCIStmtPrepare", 
+                query, oci_status)) {
+        Ns_OracleFlush (dbh);
         return TCL_ERROR;
     }
+      
+    argv_base = 4;
+    retfetchbuf = NULL;
 
     bind_variables = parse_bind_variables(query);
     connection->n_columns = string_list_len(bind_variables);
-
+      
     ns_ora_log(lexpos(), "%d bind variables", connection->n_columns);
 
-    if (connection->n_columns > 0) {
-        malloc_fetch_buffers(connection);
-    }
-
-    /* Process bind variables. 
-     */
-    for (var_p = bind_variables, i = 0; var_p != NULL; 
-            var_p = var_p->next, i++) {
+    malloc_fetch_buffers (connection);
 
+    for (var_p = bind_variables, i=0; var_p != NULL; var_p = var_p->next, i++) {
         fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
-        char *nbuf;
-        char *value = NULL;
-        int index, max_length = 0;
+	char           *value = NULL;
+        int             index;
 
         fetchbuf->type = -1;
         index = strtol(var_p->string, &nbuf, 10);
 
-        /* Depending on how this proc was called we will get
-         * the values used in binding from one of three places:
-         * Tcl variable (if named bind), ns_set (if -bind was set), or 
-         * from the arguments (fi positional bind).
-         */
         if (*nbuf == '\0') {
-
-            /* It was a valid number.
-             * Pick out one of the remaining arguments,
-             * where ":1" is the first remaining arg. 
-             */
-
+             /*  It was a valid number.
+              *  Pick out one of the remaining arguments,
+              *  where ":1" is the first remaining arg. 
+              */
             if ((index < 1) || (index > (objc - argv_base - 1))) {
 
                 if (index < 1) {
-                    Tcl_AppendResult(interp,
+                    Tcl_AppendResult (interp, 
                             "invalid positional variable `:",
-                            var_p->string,
-                            "', valid values start with 1",
-                            NULL);
+                            var_p->string, 
+                            "', valid values start with 1", NULL);
                 } else {
-                    Tcl_AppendResult(interp,
+                    Tcl_AppendResult (interp, 
                             "not enough arguments for positional variable ':",
                             var_p->string, "'", NULL);
                 }
 
                 Ns_OracleFlush(dbh);
                 string_list_free_list(bind_variables);
+                  
                 return TCL_ERROR;
             }
 
-            value = Tcl_GetString(objv[index + argv_base]);
+            value = Tcl_GetString(objv[argv_base + index]);
 
         } else {
 
-            if (set == NULL) {
+            value = Tcl_GetVar(interp, var_p->string, 0);
 
-                /* Look for bind value in Tcl variable. */
-                fetchbuf->name = var_p->string;
-                value = Tcl_GetVar(interp, var_p->string, 0);
+            if (value == NULL) {
+                if (strcmp(var_p->string, retvar) == 0) {
+                      /*  It's OK if it's undefined, since this is 
+                       *  the return variable.
+                       */
+                    value = "";
+                } else {
+                    
+                    Tcl_AppendResult (interp, "undefined variable `", 
+                            var_p->string,
+                            "'", NULL);
 
-                if (value == NULL) {
-                    Tcl_AppendResult(interp, "undefined variable `",
-                            var_p->string, "'", NULL);
                     Ns_OracleFlush(dbh);
                     string_list_free_list(bind_variables);
-                    return TCL_ERROR;
-                }
-
-            } else {
-
-                /* Look for bind value in Ns_Set. */
-                //fetchbuf->name = var_p->string;
-                value = Ns_SetGet(set, var_p->string);
 
-                if (value == NULL) {
-                    Tcl_AppendResult(interp, "undefined set element `",
-                            var_p->string, "'", NULL);
-                    Ns_OracleFlush(dbh);
-                    string_list_free_list(bind_variables);
                     return TCL_ERROR;
                 }
-
             }
         }
 
-        if (array_p) {
-            int j;
-
-            /* 
-             * We are using array dml so attempt to split the value
-             * into a list.
-             */
-
-            if ((Tcl_SplitList(interp, value,
-                               &fetchbuf->array_count,
-                               &fetchbuf->array_values)) != TCL_OK) {
-                Ns_OracleFlush(dbh);
-                string_list_free_list(bind_variables);
-                return TCL_ERROR;
-            }
+        if (strcmp(var_p->string, retvar) == 0) {
 
-            /*
-             * All lists need to be of the same length, so we keep
-             * track of that here.
+            /*  This is the variable we're going to return
+             *  as the result.  It is bound dynamically so that
+             *  DynamicBindOut can grow it to fit.
              */
-
-            if (i == 0) {
-                iters = fetchbuf->array_count;
-            } else {
-
-                if ((int) iters != fetchbuf->array_count) {
-                    Tcl_AppendResult(interp,
-                                     "non-matching numbers of rows",
-                                     NULL);
-                    Ns_OracleFlush(dbh);
-                    string_list_free_list(bind_variables);
-                    return TCL_ERROR;
-                }
-
-            }
-
-            for (j = 0; j < (int) iters; ++j) {
-                int len = strlen(fetchbuf->array_values[j]);
-                if (len > max_length) {
-                    max_length = len;
-                }
+            retfetchbuf = fetchbuf;
+            fetchbuf->buf_size = plsql_buffer_size(strlen(value) + 1);
+            if (fetchbuf->buf_size < strlen(value) + 1) {
+                fetchbuf->buf_size = strlen(value) + 1;
             }
-
-        } else if (dml_p) {
-            fetchbuf->buf = Ns_Malloc(DML_BUFFER_SIZE);
-            memset(fetchbuf->buf, (int) '\0', (size_t) DML_BUFFER_SIZE);
-            strncpy(fetchbuf->buf, value, DML_BUFFER_SIZE);
-            fetchbuf->fetch_length = DML_BUFFER_SIZE;
+            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+            strcpy(fetchbuf->buf, value);
             fetchbuf->is_null = 0;
+
         } else {
             fetchbuf->buf = Ns_StrDup(value);
             fetchbuf->fetch_length = strlen(fetchbuf->buf) + 1;
@@ -1237,25 +1573,34 @@ OracleSelect (Tcl_Interp *interp, int objc,
         }
 
         if (dbh->verbose) {
-            Ns_Log(Notice, "bind variable '%s' = '%s'", var_p->string,
-                    value);
+            Ns_Log(Notice, "bind variable '%s' = '%s'", var_p->string, value);
         }
 
-        ns_ora_log(lexpos(), "ns_ora dml:  binding variable %s", var_p->string);
+        ns_ora_log(lexpos(), "ns_ora exec_plsql_bind:  binding variable %s", 
+                var_p->string);
 
-        if (array_p || dml_p) {
+        if (fetchbuf == retfetchbuf) {
             oci_status = OCIBindByName(connection->stmt,
                                        &fetchbuf->bind,
                                        connection->err,
                                        var_p->string,
                                        strlen(var_p->string),
                                        NULL,
-                                       array_p ? max_length : 
-                                                fetchbuf->fetch_length,
-                                       array_p ? SQLT_CHR : 
-                                                 SQLT_STR,
-                                       0, 0, 0, 0, 0,
+                                       max_plsql_buffer_size,
+                                       SQLT_STR,
+                                       &fetchbuf->is_null,
+                                       0,
+                                       0,
+                                       0,
+                                       0,
                                        OCI_DATA_AT_EXEC);
+
+            if (oci_status == OCI_SUCCESS) {
+                oci_status = OCIBindDynamic(fetchbuf->bind,
+                                            connection->err,
+                                            fetchbuf, DynamicBindIn,
+                                            fetchbuf, DynamicBindOut);
+            }
         } else {
             oci_status = OCIBindByName(connection->stmt,
                                        &fetchbuf->bind,
@@ -1266,228 +1611,80 @@ OracleSelect (Tcl_Interp *interp, int objc,
                                        fetchbuf->fetch_length,
                                        SQLT_STR,
                                        &fetchbuf->is_null,
-                                       0, 0, 0, 0,
+                                       0,
+                                       0,
+                                       0,
+                                       0,
                                        OCI_DEFAULT);
         }
 
-        if (oci_error_p
-            (lexpos(), dbh, "OCIBindByName", query, oci_status)) {
-            Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                          TCL_VOLATILE);
-            Ns_OracleFlush(dbh);
+        if (oci_error_p (lexpos (), dbh, "OCIBindByName", query, oci_status)) {
+            Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+	    Ns_OracleFlush (dbh);
             string_list_free_list(bind_variables);
-            return TCL_ERROR;
-        }
-
-        if (array_p) {
-
-            /* Array DML - dynamically bind, using list_element_put_data (which will
-             * return the right item for each iteration). 
-             */
-            oci_status = OCIBindDynamic(fetchbuf->bind,
-                                        connection->err,
-                                        fetchbuf, list_element_put_data,
-                                        fetchbuf, get_data);
-            if (tcl_error_p
-                (lexpos(), interp, dbh, "OCIBindDynamic", query,
-                 oci_status)) {
-                Ns_OracleFlush(dbh);
-                string_list_free_list(bind_variables);
-                return TCL_ERROR;
-            }
-
-        } else if (dml_p) {
 
-            oci_status = OCIBindDynamic(fetchbuf->bind,
-                                        connection->err,
-                                        fetchbuf, DynamicBindIn,
-                                        fetchbuf, DynamicBindOut);
-            if (tcl_error_p
-                (lexpos(), interp, dbh, "OCIBindDynamic", query,
-                 oci_status)) {
-                Ns_OracleFlush(dbh);
-                string_list_free_list(bind_variables);
-                return TCL_ERROR;
-            }
-        }
+	    return TCL_ERROR;
+	}
 
     }
 
-    ns_ora_log(lexpos(), "ns_ora dml:  executing statement %s", nilp(query));
-
-    oci_status = OCIStmtExecute(connection->svc,
-                                connection->stmt,
-                                connection->err,
-                                iters, 0, NULL, NULL, 
-                                OCI_DEFAULT);
+    if (retfetchbuf == NULL) {
+        Tcl_AppendResult(interp, "return variable '", retvar, 
+                "' not found in statement bind variables", NULL);
+        Ns_OracleFlush (dbh);
+        string_list_free_list(bind_variables);
 
-    /*
-     * Handle DML with "RETURNING INTO" clause.  Currently will
-     * not work for array DML.
-     */
+        return TCL_ERROR;
+    }
 
-    if (dml_p && !array_p) {
-        for (var_p = bind_variables, 
-            i = 0; var_p != NULL; 
-             var_p = var_p->next, i++) {
+    oci_status = execute_statement (dbh, connection->stmt, 1,
+				    (connection->mode == autocommit
+				     ? OCI_COMMIT_ON_SUCCESS
+				     : OCI_DEFAULT), query);
 
-            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
-            
-            if (fetchbuf->inout == BIND_OUT) {
-                if (set == NULL) {
-                    Tcl_SetVar(interp, var_p->string, fetchbuf->buf, 0);
-                } else {
-                    Ns_SetUpdate(set, var_p->string, fetchbuf->buf);
-                }
-            }
-        }
-    }
-            
     string_list_free_list(bind_variables);
-    if (connection->n_columns > 0) {
-        if (connection->fetch_buffers != NULL) {
-            for (i = 0; i < connection->n_columns; i++) {
-                Ns_Free(connection->fetch_buffers[i].buf);
-                connection->fetch_buffers[i].buf = NULL;
-                Ns_Free(connection->fetch_buffers[i].array_values);
-                if (connection->fetch_buffers[i].array_values != 0) {
-                    ns_ora_log(lexpos(), "*** Freeing buffer %p",
-                        connection->fetch_buffers[i].array_values);
-                }
-                connection->fetch_buffers[i].array_values = NULL;
-            }
-            Ns_Free(connection->fetch_buffers);
-            connection->fetch_buffers = 0;
-        }
-    }
 
-    if (oci_error_p
-        (lexpos(), dbh, "OCIStmtExecute", query, oci_status)) {
-        Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                      TCL_VOLATILE);
-        Ns_OracleFlush(dbh);
+    if (tcl_error_p (lexpos (), interp, dbh, "OCIStmtExecute", 
+                query, oci_status)) {
+        Ns_OracleFlush (dbh);
         return TCL_ERROR;
     }
+      
+    if (retfetchbuf->is_null == -1) {
+        retfetchbuf->buf[0] = '\0';
+    }
 
-    if (dml_p) {
-        if (connection->mode == autocommit) {
-            oci_status = OCITransCommit(connection->svc,
-                                        connection->err, OCI_DEFAULT);
-            if (oci_error_p
-                (lexpos(), dbh, "OCITransCommit", query, oci_status)) {
-                Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                              TCL_VOLATILE);
-                Ns_OracleFlush(dbh);
-                return TCL_ERROR;
-            }
-        }
-    } else {  
-
-        Ns_Set *setPtr;
-        int dynamic_p = 0;
-
-        ns_ora_log(lexpos(), "ns_ora dml:  doing bind for select");
-        Ns_SetTrunc(dbh->row, 0);
-        setPtr = Ns_OracleBindRow(dbh);
-
-        if (!strcmp(subcommand, "1row") || 
-            !strcmp(subcommand, "0or1row")) {
-            Ns_Set *row;
-            int nrows;
+    Tcl_AppendResult (interp, retfetchbuf->buf, NULL);
+      
+    /* Check to see if return variable was a Tcl variable */
+      
+    (void) strtol(retvar, &nbuf, 10);
+      
+    if (*nbuf != '\0') {
+          /* It was a variable name. */
+        Tcl_SetVar(interp, retvar, retfetchbuf->buf, 0);
+    }
 
-            row = Oracle0or1Row(interp, dbh, setPtr, &nrows);
-            dynamic_p = 1;
+    return NS_OK;
+}
+/*}}}*/
 
-            if (row != NULL) {
-                if (!strcmp(subcommand, "1row") && nrows != 1) {
-                    Ns_DbSetException(dbh, "ORA",
-                                      "Query did not return a row.");
-                    /* XXX doesn't this leak a row? */
-                    row = NULL;
-                    Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
-                                  TCL_VOLATILE);
-                }
-            }
-            if (row == NULL) {
-                error(lexpos(), "Database operation \"%s\" failed",
-                      command);
-                Ns_OracleFlush(dbh);
-                return TCL_ERROR;
-            }
-            if (nrows == 0) {
-                Ns_SetFree(row);
-                row = NULL;
-            }
-            setPtr = row;
-        }
-
-        if (setPtr != NULL)
-            Ns_TclEnterSet(interp, setPtr, dynamic_p);
-    }
-
-    return TCL_OK;
-}
-/*}}}*/
-
-/*{{{ Oracle0or1Row */
-/*----------------------------------------------------------------------
- * Ns_Oracle0or1Row --
- *
- *      Helper for [ns_ora 0or1row] 
- *
+/*{{{ OracleSelect
  *----------------------------------------------------------------------
- */
-static Ns_Set *
-Oracle0or1Row (Tcl_Interp *interp, Ns_DbHandle *handle, 
-               Ns_Set *row, int *nrows)
-{
-    ns_ora_log(lexpos(), "entry");
-
-    if (row != NULL) {
-        if (Ns_OracleGetRow(handle, row) == NS_END_DATA) {
-            *nrows = 0;
-        } else {
-            switch (Ns_OracleGetRow(handle, row)) {
-            case NS_END_DATA:
-                *nrows = 1;
-                break;
-
-            case NS_OK:
-                Ns_DbSetException(handle, "ORA",
-                                  "Query returned more than one row.");
-                Tcl_SetResult(interp, handle->dsExceptionMsg.string,
-                              TCL_VOLATILE);
-                Ns_DbFlush(handle);
-                /* FALLTHROUGH */
-
-            case NS_ERROR:
-                /* FALLTHROUGH */
-
-            default:
-                return NULL;
-                break;
-            }
-        }
-        row = Ns_SetCopy(row);
-    }
-
-    return row;
-}
-/*}}}*/
-
-/*{{{ OracleLobDML */
-/*----------------------------------------------------------------------
- * OracleLobDML --
+ * OracleSelect --
  *
- *      Implements [ns_ora clob_dml]
- *                 [ns_ora clob_dml_file]
- *                 [ns_ora blob_dml]
- *                 [ns_ora blob_dml_file]
+ *      Implements [ns_ora select]
+ *                 [ns_ora dml]
+ *                 [ns_ora array_dml]
+ *                 [ns_ora 1row]
+ *                 [ns_ora 0or1row]
  *
- *      ns_ora clob_dml dbhandle sql clob1 ?clob2 ... clobN?
- *      ns_ora clob_dml_file dbhandle sql path1 ?path2 ... pathN?
- *      ns_ora blob_dml dbhandle sql blob1 ?blob2 ... blobN?
- *      ns_ora blob_dml_file dbhandle sql path1 ?path2 ... pathN?
+ *      ns_ora select dbhandle ?-bind set? sql ?arg1 .. argN?
+ *      ns_ora dml dbhandle ?-bind set? sql ?arg1 .. argN?
+ *      ns_ora array_dml dbhandle ?-bind set|-rows rows|-sets sets? 
+ *          ?-chunk n? sql ?arg1 .. argN?
+ *      ns_ora 1row dbhandle ?-bind set? sql ?arg1 .. argN?
+ *      ns_ora 0or1row dbhandle ?-bind set? sql ?arg1 .. argN?
  *
  * Results:
  *
@@ -1496,44 +1693,149 @@ Oracle0or1Row (Tcl_Interp *interp, Ns_DbHandle *handle,
  *----------------------------------------------------------------------
  */
 int
-OracleLobDML (Tcl_Interp *interp, int objc, 
+OracleSelect (Tcl_Interp *interp, int objc, 
               Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
 {
-    Tcl_Obj          **data;
-    oci_status_t       oci_status;
     ora_connection_t  *connection;
-    char              *query;
-    int                i,k;
-    int                files_p = NS_FALSE;
-    int                blob_p = NS_FALSE;
+    oci_status_t       oci_status;
+    string_list_elt_t *bind_variables, 
+                      *returning_variables = NULL,
+                      *var_p, *ret_p;
+    char              *query, *command, *subcommand, *returning, *usage;
+    char              *exprs;
+    int                i;
+    int                iters_set = 0;
+    ub4                iters;
+    ub2                type;
+    int                dml_p;
+    int                array_p;      /* Array DML */
+    int                argv_base;    /* Index of the SQL statement argument (necessary to support -bind) */
+    Ns_Set            *set = NULL;   /* If we're binding to an ns_set, a pointer to the struct */
+    Tcl_Obj          **rows = NULL;  /* Row-major array DML: one dict or ns_set per row */
+    int                n_rows = 0;
+    int                sets_p = 0;
+    int                chunk = array_dml_chunk_size;
+    ub4                offset;
 
-    if (objc < 5) {
-        Tcl_WrongNumArgs(interp, 2, objv, \
-                "dbId query clobList [clobValues | filenames] ...");
+    command = Tcl_GetString(objv[0]);
+    subcommand = Tcl_GetString(objv[1]);
+
+    if (!strcmp(subcommand, "array_dml")) {
+        usage = "dbhandle ?-bind set|-rows rows|-sets sets? ?-chunk n? "
+                "sql ?arg1 .. argN?";
+    } else {
+        usage = "dbhandle ?-bind set? sql ?arg1 .. argN?";
+    }
+
+    if (objc < 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, usage);
         return TCL_ERROR;
     }
 
     connection = dbh->connection;
-    query = Tcl_GetString(objv[3]);
+    connection->interp = interp;
 
-    if (!strcmp(Tcl_GetString(objv[1]), "clob_dml_file") || 
-        !strcmp(Tcl_GetString(objv[1]), "blob_dml_file"))
-        files_p = NS_TRUE;
+    if (!connection) {
+        Tcl_SetResult(interp, "error: no connection", NULL);
+        return TCL_ERROR;
+    }
 
-    if (!strncmp(Tcl_GetString(objv[1]), "blob", 4))
-        blob_p = NS_TRUE;
+    if (!strcmp(subcommand, "dml")) {
+        dml_p = 1;
+        array_p = 0;
+    } else if (!strcmp(subcommand, "array_dml")) {
+        dml_p = 1;
+        array_p = 1;
+    } else {
+        dml_p = 0;
+        array_p = 0;
+    }
+
+    /* Options come before the query; each takes one value. */
+    for (argv_base = 3; argv_base < objc; argv_base += 2) {
+        char *option = Tcl_GetString(objv[argv_base]);
+
+        if (strcmp("-bind", option) && strcmp("-rows", option)
+            && strcmp("-sets", option) && strcmp("-chunk", option)) {
+            break;
+        }
+
+        if (argv_base + 2 >= objc) {
+            Tcl_WrongNumArgs(interp, 2, objv, usage);
+            return TCL_ERROR;
+        }
+
+        if (strcmp("-bind", option) && !array_p) {
+            Tcl_AppendResult(interp, option, 
+                    " is only supported by array_dml", NULL);
+            return TCL_ERROR;
+        }
+
+        if (!strcmp("-bind", option)) {
+            /* Binding to a set. */
+            set = Ns_TclGetSet(interp, Tcl_GetString(objv[argv_base + 1]));
+            if (set == NULL) {
+                Tcl_AppendResult(interp, "invalid set id `", 
+                        Tcl_GetString(objv[argv_base + 1]), "'", NULL);
+                return TCL_ERROR;
+            }
+        } else if (!strcmp("-chunk", option)) {
+            /* Execute this many rows at a time. */
+            if (Tcl_GetIntFromObj(interp, objv[argv_base + 1], &chunk) 
+                    != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else {
+            /* Row-major array DML: a list of dicts or of ns_sets, one
+             * per row. */
+            sets_p = !strcmp("-sets", option);
+            if (Tcl_ListObjGetElements(interp, objv[argv_base + 1], 
+                        &n_rows, &rows) != TCL_OK) {
+                return TCL_ERROR;
+            }
+        }
+    }
+
+    if (argv_base >= objc) {
+        Tcl_WrongNumArgs(interp, 2, objv, usage);
+        return TCL_ERROR;
+    }
+
+    query = Tcl_GetString(objv[argv_base]);
 
     if (!allow_sql_p(dbh, query, NS_TRUE)) {
         Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
-                         "by the Oracle driver", NULL);
+                "by the Oracle driver", NULL);
         return TCL_ERROR;
     }
 
     if (dbh->verbose)
         Ns_Log(Notice, "SQL():  %s", query);
 
+    /* In order to handle transactions we check now for our
+     * custom SQL-like commands.  If query is one of those
+     * commands then we are done after calling handle_builtins.
+     */
+    switch (handle_builtins(dbh, query)) {
+        case NS_DML:
+            return TCL_OK;
+
+        case NS_ERROR:
+            Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                          TCL_VOLATILE);
+            return TCL_ERROR;
+
+        case NS_OK:
+            break;
+
+        default:
+            error(lexpos(), "internal error");
+            Tcl_AppendResult(interp, "internal error", NULL);
+            return TCL_ERROR;
+    }
+
     oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->stmt,
+                                (oci_handle_t **) &connection->stmt,
                                 OCI_HTYPE_STMT, 0, NULL);
     if (tcl_error_p
         (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
@@ -1551,2352 +1853,8204 @@ OracleLobDML (Tcl_Interp *interp, int objc,
         return TCL_ERROR;
     }
 
-    data = &objv[4];
-    connection->n_columns = objc - 4;
+    /* Check what type of statment it is, this will affect how
+     * many times we expect to execute it.
+     */
+    oci_status = OCIAttrGet(connection->stmt,
+                            OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & type,
+                            NULL, OCI_ATTR_STMT_TYPE, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", query, oci_status)) {
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                      TCL_VOLATILE);
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
 
-    if (files_p) {
-        for (i = 0; i < connection->n_columns; i++) {
-            if (access(Tcl_GetString(data[i]), R_OK) != 0) {
-                Tcl_AppendResult(interp, "could not access file", 
-                        Tcl_GetString(data[i]), NULL);
+    /* For SELECT statements we can set a couple extra attributes
+     * that may help speed up the query.
+     */
+    if (type == OCI_STMT_SELECT) {
+        iters = 0;
+        if (prefetch_rows > 0) {
+            /* Set prefetch rows attr for selects. */
+            oci_status = OCIAttrSet(connection->stmt,
+                                    OCI_HTYPE_STMT,
+                                    (dvoid *) & prefetch_rows,
+                                    0,
+                                    OCI_ATTR_PREFETCH_ROWS,
+                                    connection->err);
+            if (oci_error_p
+                (lexpos(), dbh, "OCIAttrSet", query, oci_status)) {
+                Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                              TCL_VOLATILE);
                 Ns_OracleFlush(dbh);
-                return TCL_ERROR;
+                return NS_ERROR;
+            }
+        }
+        if (prefetch_memory > 0) {
+            /* Set prefetch memory attr for selects. */
+            oci_status = OCIAttrSet(connection->stmt,
+                                    OCI_HTYPE_STMT,
+                                    (dvoid *) & prefetch_memory,
+                                    0,
+                                    OCI_ATTR_PREFETCH_MEMORY,
+                                    connection->err);
+            if (oci_error_p
+                (lexpos(), dbh, "OCIAttrSet", query, oci_status)) {
+                Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                              TCL_VOLATILE);
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
             }
         }
+    } else {
+        iters = 1;
     }
 
-    malloc_fetch_buffers(connection);
-
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+    /* Check for statement type mismatch */
+    if (type != OCI_STMT_SELECT && !dml_p) {
+        Ns_DbSetException(dbh, "ORA", 
+                "Query was not a statement returning rows.");
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                TCL_VOLATILE);
+        Ns_OracleFlush(dbh);
 
-        fetchbuf->type = -1;
+        return TCL_ERROR;
+    } else if (type == OCI_STMT_SELECT && dml_p) {
+        Ns_DbSetException(dbh, "ORA", 
+                "Query was not a DML statement.");
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                TCL_VOLATILE);
+        Ns_OracleFlush(dbh);
 
-        oci_status = OCIBindByPos(connection->stmt,
-                                  &fetchbuf->bind,
-                                  connection->err,
-                                  i + 1,
-                                  0,
-                                  -1,
-                                  (blob_p) ? SQLT_BLOB : SQLT_CLOB,
-                                  0, 0, 0, 0, 0, OCI_DATA_AT_EXEC);
-        if (tcl_error_p
-            (lexpos(), interp, dbh, "OCIBindByPos", query, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
-        }
+        return TCL_ERROR;
+    }
 
-        oci_status = OCIBindDynamic(fetchbuf->bind,
-                                    connection->err,
-                                    0, no_data, fetchbuf, get_data);
-        if (tcl_error_p
-            (lexpos(), interp, dbh, "OCIBindDynamic", query, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
-        }
+    bind_variables = parse_bind_variables(query);
+    connection->n_columns = string_list_len(bind_variables);
+
+    ns_ora_log(lexpos(), "%d bind variables", connection->n_columns);
+
+    /* For array DML, the variables in a RETURNING INTO clause are
+     * outputs and get one list element per returned row.
+     */
+    if (array_p 
+        && (returning = returning_into_clause(query, &exprs)) != NULL) {
+        returning_variables = parse_bind_variables(returning);
     }
 
-    oci_status = OCIStmtExecute(connection->svc,
-                                connection->stmt,
-                                connection->err,
-                                1, 0, NULL, NULL, OCI_DEFAULT);
+    if (connection->n_columns > 0) {
+        malloc_fetch_buffers(connection);
+    }
 
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
+    if (rows != NULL) {
+        iters = n_rows;
+        iters_set = 1;
     }
 
+    /* Process bind variables. 
+     */
+    for (var_p = bind_variables, i = 0; var_p != NULL; 
+            var_p = var_p->next, i++) {
 
-    for (i = 0; i < connection->n_columns; i++) {
         fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+        char *nbuf;
+        char *value = NULL;
+        Tcl_Obj *value_obj = NULL;
+        int index, max_length = 0;
 
-        ub4 length = -1;
-
-        if (!files_p)
-            length = strlen(Tcl_GetString(data[i]));
+        fetchbuf->type = -1;
+        index = strtol(var_p->string, &nbuf, 10);
 
-        if (dbh->verbose) {
-            if (files_p) {
-                Ns_Log(Notice, "  CLOB # %d, file name %s", i, 
-                        Tcl_GetString(data[i]));
-            } else {
-                Ns_Log(Notice, "  CLOB # %d, length %d: %s", i, length,
-                        (length == 0) ? "(NULL)" : 
-                        Tcl_GetString(data[i]));
+        for (ret_p = returning_variables; ret_p != NULL; ret_p = ret_p->next) {
+            if (!strcmp(ret_p->string, var_p->string)) {
+                break;
             }
         }
 
-        /* if length is zero, that's an empty string.  Bypass the LobWrite
-         * to have it insert a NULL value
-         */
-        if (length == 0)
-            continue;
+        if (ret_p != NULL) {
 
-        for (k = 0; k < (int) fetchbuf->n_rows; k++) {
-            if (files_p) {
-                if (stream_read_lob
-                    (interp, dbh, 1, fetchbuf->lobs[k], Tcl_GetString(data[i]),
-                     connection)
-                    != NS_OK) {
-                    tcl_error_p(lexpos(), interp, dbh, "stream_read_lob",
-                                query, oci_status);
-                    return TCL_ERROR;
-                }
-                continue;
+            if (*nbuf == '\0') {
+                Tcl_AppendResult(interp, "RETURNING INTO variable `:",
+                        var_p->string, "' must be a named bind variable "
+                        "for array DML", NULL);
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                string_list_free_list(returning_variables);
+                return TCL_ERROR;
             }
 
-            oci_status = OCILobWrite(connection->svc,
-                                     connection->err,
-                                     fetchbuf->lobs[k],
-                                     &length,
-                                     1,
-                                     Tcl_GetString(data[i]),
-                                     length,
-                                     OCI_ONE_PIECE, 0, 0, 0,
-                                     SQLCS_IMPLICIT);
+            ns_ora_log(lexpos(), "ns_ora array_dml:  binding returning variable %s", 
+                    var_p->string);
+
+            fetchbuf->name = var_p->string;
+            fetchbuf->inout = BIND_OUT;
 
+            oci_status = OCIBindByName(connection->stmt,
+                                       &fetchbuf->bind,
+                                       connection->err,
+                                       var_p->string,
+                                       strlen(var_p->string),
+                                       NULL,
+                                       DML_BUFFER_SIZE,
+                                       SQLT_CHR,
+                                       0, 0, 0, 0, 0,
+                                       OCI_DATA_AT_EXEC);
             if (tcl_error_p
-                (lexpos(), interp, dbh, "OCILobWrite", query,
+                (lexpos(), interp, dbh, "OCIBindByName", query, 
                  oci_status)) {
                 Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                string_list_free_list(returning_variables);
                 return TCL_ERROR;
             }
-        }
-    }
 
-    if (connection->mode == autocommit) {
-        oci_status = OCITransCommit(connection->svc,
-                                    connection->err, OCI_DEFAULT);
-        if (tcl_error_p
-            (lexpos(), interp, dbh, "OCITransCommit", query, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
+            oci_status = OCIBindDynamic(fetchbuf->bind,
+                                        connection->err,
+                                        fetchbuf, no_data,
+                                        fetchbuf, returning_get_data);
+            if (tcl_error_p
+                (lexpos(), interp, dbh, "OCIBindDynamic", query,
+                 oci_status)) {
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                string_list_free_list(returning_variables);
+                return TCL_ERROR;
+            }
+
+            continue;
         }
-    }
 
-    /* all done */
-    free_fetch_buffers(connection);
+        /* Depending on how this proc was called we will get
+         * the values used in binding from one of four places:
+         * Tcl variable (if named bind), ns_set (if -bind was set),
+         * each of the rows (if -rows or -sets was given), or 
+         * from the arguments (fi positional bind).
+         */
+        if (*nbuf == '\0' && rows != NULL) {
 
-    return TCL_OK;
-}
-/*}}}*/
+            Tcl_AppendResult(interp, "positional variable `:",
+                    var_p->string, "' cannot be used with -rows or -sets",
+                    NULL);
+            Ns_OracleFlush(dbh);
+            string_list_free_list(bind_variables);
+            string_list_free_list(returning_variables);
+            return TCL_ERROR;
 
-/*{{{ OracleLobDMLBind*/
-/*----------------------------------------------------------------------
- * OracleLobDMLBind --
- *
- *      Implements [ns_ora clob_dml_bind]
- *                 [ns_ora clob_dml_file_bind]
- *                 [ns_ora blob_dml_bind]
- *                 [ns_ora blob_dml_file_bind]
- *
- *      ns_ora clob_dml_bind dbhandle sql list_of_lobs ?clob1 ... clobN?
- *      ns_ora clob_dml_file_bind dbhandle sql list_of_lobs ?clob1 ... clobN?
- *      ns_ora blob_dml_bind dbhandle sql list_of_lobs ?blob1 ... blobN?
- *      ns_ora blob_dml_file_bind dbhandle sql list_of_lobs ?clob1 ... clobN?
- *
- * Results:
- *
- *      Nothing.
- *
- *----------------------------------------------------------------------
- */
-int
-OracleLobDMLBind (Tcl_Interp *interp, int objc, 
-                  Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
-{
-    Tcl_Obj          **data;
-    oci_status_t       oci_status;
-    ora_connection_t  *connection;
-    string_list_elt_t *bind_variables, *var_p;
-    char              *query;
-    int                i,k;
-    int                files_p = NS_FALSE;
-    int                blob_p = NS_FALSE;
-    char             **lob_argv;
-    int                lob_argc;
-    int                argv_base;
+        } else if (rows != NULL) {
 
-    if (objc < 5) {
-        Tcl_WrongNumArgs(interp, 2, objv, \
-                "dbId query clobList [clobValues | filenames] ...");
-        return TCL_ERROR;
-    }
+            /* Look for bind value by name in every row. */
+            if (row_bind_values(interp, fetchbuf, var_p->string,
+                        rows, n_rows, sets_p, &max_length) != TCL_OK) {
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                string_list_free_list(returning_variables);
+                return TCL_ERROR;
+            }
 
-    query = Tcl_GetString(objv[3]);
-    connection = dbh->connection;
+        } else if (*nbuf == '\0') {
 
-    if (!strcmp(Tcl_GetString(objv[1]), "clob_dml_file_bind") || 
-        !strcmp(Tcl_GetString(objv[1]), "blob_dml_file_bind"))
-        files_p = NS_TRUE;
+            /* It was a valid number.
+             * Pick out one of the remaining arguments,
+             * where ":1" is the first remaining arg. 
+             */
 
-    if (!strncmp(Tcl_GetString(objv[1]), "blob", 4))
-        blob_p = NS_TRUE;
+            if ((index < 1) || (index > (objc - argv_base - 1))) {
 
-    if (!allow_sql_p(dbh, query, NS_TRUE)) {
-        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
-                         "by the Oracle driver", NULL);
-        return TCL_ERROR;
-    }
+                if (index < 1) {
+                    Tcl_AppendResult(interp,
+                            "invalid positional variable `:",
+                            var_p->string,
+                            "', valid values start with 1",
+                            NULL);
+                } else {
+                    Tcl_AppendResult(interp,
+                            "not enough arguments for positional variable ':",
+                            var_p->string, "'", NULL);
+                }
 
-    if (dbh->verbose)
-        Ns_Log(Notice, "SQL():  %s", query);
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                string_list_free_list(returning_variables);
+                return TCL_ERROR;
+            }
 
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->stmt,
-                                OCI_HTYPE_STMT, 0, NULL);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
-    }
+            value_obj = objv[index + argv_base];
 
-    oci_status = OCIStmtPrepare(connection->stmt,
-                                connection->err,
-                                query, strlen(query),
-                                OCI_NTV_SYNTAX, OCI_DEFAULT);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
-    }
+        } else {
 
-    data = &objv[4];
-    connection->n_columns = objc - 4;
+            if (set == NULL) {
 
-    Tcl_SplitList(interp, Tcl_GetString(objv[4]), &lob_argc, &lob_argv);
+                /* Look for bind value in Tcl variable. */
+                fetchbuf->name = var_p->string;
+                value_obj = Tcl_GetVar2Ex(interp, var_p->string, NULL, 0);
 
-    bind_variables = parse_bind_variables(query);
+                if (value_obj == NULL) {
+                    Tcl_AppendResult(interp, "undefined variable `",
+                            var_p->string, "'", NULL);
+                    Ns_OracleFlush(dbh);
+                    string_list_free_list(bind_variables);
+                    string_list_free_list(returning_variables);
+                    return TCL_ERROR;
+                }
 
-    connection->n_columns = string_list_len(bind_variables);
+            } else {
 
-    ns_ora_log(lexpos(), "%d bind variables", connection->n_columns);
+                /* Look for bind value in Ns_Set. */
+                //fetchbuf->name = var_p->string;
+                value = Ns_SetGet(set, var_p->string);
 
-    malloc_fetch_buffers(connection);
+                if (value == NULL) {
+                    Tcl_AppendResult(interp, "undefined set element `",
+                            var_p->string, "'", NULL);
+                    Ns_OracleFlush(dbh);
+                    string_list_free_list(bind_variables);
+                    string_list_free_list(returning_variables);
+                    return TCL_ERROR;
+                }
 
-    argv_base = 4;
+            }
+        }
 
-    for (var_p = bind_variables, i = 0; var_p != NULL;
-         var_p = var_p->next, i++) {
+        if (value_obj != NULL && !array_p) {
+            value = Tcl_GetString(value_obj);
+        }
 
-        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
-        char           *nbuf, *value = NULL;
-        int             index, lob_i;
+        if (array_p && rows == NULL) {
+            Tcl_Obj **elements;
+            int       j;
 
-        fetchbuf->type = -1;
-        index = strtol(var_p->string, &nbuf, 10);
-        if (*nbuf == '\0') {
-            /* It was a valid number.
-               Pick out one of the remaining arguments,
-               where ":1" is the first remaining arg. */
-            if ((index < 1) || (index > (objc - argv_base - 1))) {
-                if (index < 1) {
-                    Tcl_AppendResult(interp,
-                                     "invalid positional variable `:",
-                                     var_p->string,
-                                     "', valid values start with 1", NULL);
-                } else {
-                    Tcl_AppendResult(interp,
-                                     "not enough arguments for positional variable ':",
-                                     var_p->string, "'", NULL);
-                }
-                Ns_OracleFlush(dbh);
-                string_list_free_list(bind_variables);
-                Tcl_Free((char *) lob_argv);
-                return TCL_ERROR;
+            /* 
+             * We are using array dml so attempt to split the value
+             * into a list.  Lists from Tcl are used in place rather
+             * than copied; array_fill_chunk picks out a chunk's
+             * values as it is executed.
+             */
+
+            if (value_obj == NULL) {
+                value_obj = Tcl_NewStringObj(value, -1);
             }
-            value = Tcl_GetString(objv[argv_base + index]);
-        } else {
-            value = Tcl_GetVar(interp, var_p->string, 0);
-            if (value == NULL) {
-                Tcl_AppendResult(interp, "undefined variable `",
-                                 var_p->string, "'", NULL);
+            fetchbuf->array_list = value_obj;
+            Tcl_IncrRefCount(value_obj);
+
+            if (Tcl_ListObjGetElements(interp, value_obj,
+                                       &fetchbuf->array_count,
+                                       &elements) != TCL_OK) {
                 Ns_OracleFlush(dbh);
                 string_list_free_list(bind_variables);
-                Tcl_Free((char *) lob_argv);
+                string_list_free_list(returning_variables);
                 return TCL_ERROR;
             }
-        }
 
+            /*
+             * All lists need to be of the same length, so we keep
+             * track of that here.
+             */
 
-        fetchbuf->buf = Ns_StrDup(value);
-        fetchbuf->fetch_length = strlen(fetchbuf->buf) + 1;
-        fetchbuf->is_null = 0;
+            if (!iters_set) {
+                iters = fetchbuf->array_count;
+                iters_set = 1;
+            } else {
 
-        if (dbh->verbose)
-            Ns_Log(Notice, "bind variable '%s' = '%s'", var_p->string,
-                   value);
+                if ((int) iters != fetchbuf->array_count) {
+                    Tcl_AppendResult(interp,
+                                     "non-matching numbers of rows",
+                                     NULL);
+                    Ns_OracleFlush(dbh);
+                    string_list_free_list(bind_variables);
+                    string_list_free_list(returning_variables);
+                    return TCL_ERROR;
+                }
 
-        ns_ora_log(lexpos(), "ns_ora clob_dml:  binding variable %s",
-            var_p->string);
+            }
 
-        for (lob_i = 0; lob_i < lob_argc; lob_i++) {
-            if (strcmp(lob_argv[lob_i], var_p->string) == 0) {
-                fetchbuf->is_lob = 1;
-                ns_ora_log(lexpos(), "bind variable %s is a lob", var_p->string);
-                break;
+            for (j = 0; j < (int) iters; ++j) {
+                int len;
+
+                Tcl_GetStringFromObj(elements[j], &len);
+                if (len > max_length) {
+                    max_length = len;
+                }
             }
+
+        } else if (dml_p) {
+            fetchbuf->buf = Ns_Malloc(DML_BUFFER_SIZE);
+            memset(fetchbuf->buf, (int) '\0', (size_t) DML_BUFFER_SIZE);
+            strncpy(fetchbuf->buf, value, DML_BUFFER_SIZE);
+            fetchbuf->fetch_length = DML_BUFFER_SIZE;
+            fetchbuf->is_null = 0;
+        } else {
+            fetchbuf->buf = Ns_StrDup(value);
+            fetchbuf->fetch_length = strlen(fetchbuf->buf) + 1;
+            fetchbuf->is_null = 0;
         }
 
-        oci_status = OCIBindByName(connection->stmt,
-                                   &fetchbuf->bind,
-                                   connection->err,
-                                   var_p->string,
-                                   strlen(var_p->string),
-                                   fetchbuf->buf,
-                                   fetchbuf->fetch_length,
-                                   fetchbuf->is_lob ?
-                                   (blob_p ? SQLT_BLOB : SQLT_CLOB)
-                                   : SQLT_STR,
-                                   &fetchbuf->is_null,
-                                   0,
-                                   0,
-                                   0,
-                                   0,
-                                   fetchbuf->is_lob ?
-                                   OCI_DATA_AT_EXEC : OCI_DEFAULT);
+        if (dbh->verbose && value != NULL) {
+            Ns_Log(Notice, "bind variable '%s' = '%s'", var_p->string,
+                    value);
+        }
 
-        if (oci_error_p(lexpos(), dbh, "OCIBindByName", query, oci_status)) {
+        ns_ora_log(lexpos(), "ns_ora dml:  binding variable %s", var_p->string);
+
+        if (array_p || dml_p) {
+            oci_status = OCIBindByName(connection->stmt,
+                                       &fetchbuf->bind,
+                                       connection->err,
+                                       var_p->string,
+                                       strlen(var_p->string),
+                                       NULL,
+                                       array_p ? max_length : 
+                                                fetchbuf->fetch_length,
+                                       array_p ? SQLT_CHR : 
+                                                 SQLT_STR,
+                                       0, 0, 0, 0, 0,
+                                       OCI_DATA_AT_EXEC);
+        } else {
+            oci_status = OCIBindByName(connection->stmt,
+                                       &fetchbuf->bind,
+                                       connection->err,
+                                       var_p->string,
+                                       strlen(var_p->string),
+                                       fetchbuf->buf,
+                                       fetchbuf->fetch_length,
+                                       SQLT_STR,
+                                       &fetchbuf->is_null,
+                                       0, 0, 0, 0,
+                                       OCI_DEFAULT);
+        }
+
+        if (oci_error_p
+            (lexpos(), dbh, "OCIBindByName", query, oci_status)) {
             Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
                           TCL_VOLATILE);
             Ns_OracleFlush(dbh);
             string_list_free_list(bind_variables);
-            Tcl_Free((char *) lob_argv);
+            string_list_free_list(returning_variables);
             return TCL_ERROR;
         }
 
-        if (fetchbuf->is_lob) {
+        if (array_p) {
+
+            /* Array DML - dynamically bind, using list_element_put_data (which will
+             * return the right item for each iteration). 
+             */
             oci_status = OCIBindDynamic(fetchbuf->bind,
                                         connection->err,
-                                        0, no_data, fetchbuf, get_data);
+                                        fetchbuf, list_element_put_data,
+                                        fetchbuf, get_data);
             if (tcl_error_p
                 (lexpos(), interp, dbh, "OCIBindDynamic", query,
                  oci_status)) {
                 Ns_OracleFlush(dbh);
-                Tcl_Free((char *) lob_argv);
                 string_list_free_list(bind_variables);
+                string_list_free_list(returning_variables);
                 return TCL_ERROR;
             }
-        }
-    }
 
-    Tcl_Free((char *) lob_argv);
+        } else if (dml_p) {
 
-    oci_status = OCIStmtExecute(connection->svc,
-                                connection->stmt,
-                                connection->err,
-                                1, 0, NULL, NULL, OCI_DEFAULT);
+            oci_status = OCIBindDynamic(fetchbuf->bind,
+                                        connection->err,
+                                        fetchbuf, DynamicBindIn,
+                                        fetchbuf, DynamicBindOut);
+            if (tcl_error_p
+                (lexpos(), interp, dbh, "OCIBindDynamic", query,
+                 oci_status)) {
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                string_list_free_list(returning_variables);
+                return TCL_ERROR;
+            }
+        }
 
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
-        Ns_OracleFlush(dbh);
-        string_list_free_list(bind_variables);
-        return TCL_ERROR;
     }
 
-    for (var_p = bind_variables, i = 0; var_p != NULL;
-         var_p = var_p->next, i++) {
+    /* RETURNING INTO values are kept in slots as wide as they can be */
+    if (returning_variables != NULL) {
+        int  n_returning = string_list_len(returning_variables);
+        ub4 *widths = Ns_Malloc(n_returning * sizeof *widths);
 
-        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
-        ub4             length = -1;
+        returning_widths(dbh, query, exprs, returning - 4, n_returning, 
+                         widths);
 
-        if (!fetchbuf->is_lob) {
-            ns_ora_log(lexpos(), "column %d is not a lob", i);
-            continue;
+        for (var_p = bind_variables, i = 0; var_p != NULL; 
+                var_p = var_p->next, i++) {
+            int k = 0;
+
+            for (ret_p = returning_variables; ret_p != NULL; 
+                    ret_p = ret_p->next, k++) {
+                if (!strcmp(ret_p->string, var_p->string)) {
+                    connection->fetch_buffers[i].returning_width = widths[k];
+                    break;
+                }
+            }
         }
 
-        if (!files_p)
-            length = strlen(fetchbuf->buf);
+        Ns_Free(widths);
+    }
 
-        if (dbh->verbose) {
-            if (files_p) {
-                Ns_Log(Notice, "  CLOB # %d, file name %s", i,
-                       fetchbuf->buf);
-            } else {
-                Ns_Log(Notice, "  CLOB # %d, length %d: %s", i, length,
-                       (length == 0) ? "(NULL)" : fetchbuf->buf);
+    ns_ora_log(lexpos(), "ns_ora dml:  executing statement %s", nilp(query));
+
+    if (array_p && iters == 0) {
+        /* Nothing to do; Oracle rejects a zero iteration count. */
+        oci_status = OCI_SUCCESS;
+    } else if (array_p) {
+        /* 
+         * Array DML is fed to Oracle a chunk at a time, so neither
+         * side has to hold the whole batch in one execute: only a
+         * chunk's worth of values is put in array_values for the bind
+         * callbacks.  In autocommit mode each chunk is committed as it
+         * completes, so a failure leaves the earlier chunks in place.
+         */
+        ub4 chunk_rows = chunk > 0 && iters > (ub4) chunk ? chunk : iters;
+
+        for (i = 0; i < connection->n_columns; i++) {
+            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+
+            if (fetchbuf->array_list != NULL || fetchbuf->array_rows != NULL) {
+                fetchbuf->array_values = 
+                    Ns_Malloc(chunk_rows * sizeof *fetchbuf->array_values);
             }
         }
 
-        /* if length is zero, that's an empty string.  Bypass the LobWrite
-         * to have it insert a NULL value
-         */
-        if (length == 0)
-            continue;
+        oci_status = OCI_SUCCESS;
+        for (offset = 0; offset < iters 
+                 && (oci_status == OCI_SUCCESS 
+                     || oci_status == OCI_SUCCESS_WITH_INFO); 
+             offset += chunk_rows) {
+            ub4 n = iters - offset < chunk_rows ? iters - offset : chunk_rows;
 
-        for (k = 0; k < (int) fetchbuf->n_rows; k++) {
-            if (files_p) {
-                if (stream_read_lob
-                    (interp, dbh, 1, fetchbuf->lobs[k], fetchbuf->buf,
-                     connection)
-                    != NS_OK) {
-                    tcl_error_p(lexpos(), interp, dbh, "stream_read_lob",
-                                query, oci_status);
-                    string_list_free_list(bind_variables);
-                    return TCL_ERROR;
-                }
-                continue;
+            for (i = 0; i < connection->n_columns; i++) {
+                array_fill_chunk(&connection->fetch_buffers[i], offset, n);
+                connection->fetch_buffers[i].returning_iters = n;
             }
 
-            ns_ora_log(lexpos(), "using lob %x", fetchbuf->lobs[k]);
-            oci_status = OCILobWrite(connection->svc,
-                                     connection->err,
-                                     fetchbuf->lobs[k],
-                                     &length,
-                                     1,
-                                     fetchbuf->buf,
-                                     length,
-                                     OCI_ONE_PIECE, 0, 0, 0,
-                                     SQLCS_IMPLICIT);
+            ns_ora_log(lexpos(), "ns_ora array_dml:  rows %d to %d", 
+                    offset, offset + n);
 
-            if (tcl_error_p
-                (lexpos(), interp, dbh, "OCILobWrite", query,
-                 oci_status)) {
-                string_list_free_list(bind_variables);
-                Ns_OracleFlush(dbh);
-                return TCL_ERROR;
+            oci_status = execute_statement(dbh, connection->stmt, n,
+                                           connection->mode == autocommit 
+                                               ? OCI_COMMIT_ON_SUCCESS 
+                                               : OCI_DEFAULT, query);
+
+            for (i = 0; i < connection->n_columns; i++) {
+                returned_values_append(&connection->fetch_buffers[i]);
             }
         }
+    } else {
+        oci_status = execute_statement(dbh, connection->stmt, iters, 
+                                       OCI_DEFAULT, query);
     }
 
-    if (connection->mode == autocommit) {
-        oci_status = OCITransCommit(connection->svc,
-                                    connection->err, OCI_DEFAULT);
-        if (tcl_error_p
-            (lexpos(), interp, dbh, "OCITransCommit", query, oci_status)) {
-            string_list_free_list(bind_variables);
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
-        }
-    }
-
-    /* all done */
-    free_fetch_buffers(connection);
-    string_list_free_list(bind_variables);
+    /*
+     * Handle DML with "RETURNING INTO" clause.  For array DML each
+     * output variable is set to a list with one element per returned
+     * row, in the order the rows were processed.
+     */
 
-    return TCL_OK;
-}
-/*}}}*/
+    if (array_p && (oci_status == OCI_SUCCESS 
+                    || oci_status == OCI_SUCCESS_WITH_INFO)) {
+        for (var_p = bind_variables, 
+            i = 0; var_p != NULL; 
+             var_p = var_p->next, i++) {
 
-/*{{{ OracleLobSelect
- *----------------------------------------------------------------------
- * OracleLobSelect --
- *
- *      Implements [ns_ora clob_get_file]
- *                 [ns_ora blob_get_file]
- *                 [ns_ora write_clob]
- *                 [ns_ora write_blob]
- *
- *      ns_ora clob_get_file dbhandle sql path
- *      ns_ora blob_get_file dbhandle sql path
- *      ns_ora write_clob dbhandle sql ?nbytes?
- *      ns_ora write_blob dbhandle sql ?nbytes?
- *
- * Results:
- *
- *      Nothing.
- *
- *----------------------------------------------------------------------
- */
-int
-OracleLobSelect (Tcl_Interp *interp, int objc, 
-                 Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
-{
-    oci_status_t       oci_status;
-    ora_connection_t  *connection;
-    OCILobLocator     *lob = NULL;
-    OCIDefine         *def;
-    char              *query;
-    char              *filename = NULL;
-    char              *command, *subcommand;
-    int                blob_p = NS_FALSE;
-    int                to_conn_p = NS_FALSE;
-    int                nbytes = INT_MAX;
-    int                result = TCL_ERROR;
-    int                write_lob_status = NS_ERROR;
+            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+            Tcl_Obj        *list;
 
-    if (objc < 4 ) {
-        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle ?-bind set? sql ?ref?");
-        return TCL_ERROR;
-    }
+            if (fetchbuf->inout != BIND_OUT) {
+                continue;
+            }
 
-    command = Tcl_GetString(objv[0]);
-    subcommand = Tcl_GetString(objv[1]);
-    connection = dbh->connection;
+            list = fetchbuf->returned_list;
+            if (list == NULL) {
+                list = Tcl_NewListObj(0, NULL);
+            }
+            Tcl_IncrRefCount(list);
 
-    if (!strncmp(subcommand, "write", 5))
-        to_conn_p = NS_TRUE;
+            if (set == NULL) {
+                Tcl_SetVar2Ex(interp, var_p->string, NULL, list, 0);
+            } else {
+                Ns_SetUpdate(set, var_p->string, Tcl_GetString(list));
+            }
 
-    if (to_conn_p) {
-        if (objc < 4 || objc > 5) {
-            Tcl_AppendResult(interp,
-                             "wrong number of args: should be '",
-                             Tcl_GetString(objv[0]), 
-                             subcommand, " dbId query ?nbytes?",
-                             NULL);
-            goto write_lob_cleanup;
+            Tcl_DecrRefCount(list);
         }
+    } else if (dml_p && !array_p) {
+        for (var_p = bind_variables, 
+            i = 0; var_p != NULL; 
+             var_p = var_p->next, i++) {
 
-        if (objc == 5) {
-            if (Tcl_GetIntFromObj(interp, objv[4], &nbytes) != TCL_OK) {
-                goto write_lob_cleanup;
+            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+            
+            if (fetchbuf->inout == BIND_OUT) {
+                if (set == NULL) {
+                    Tcl_SetVar(interp, var_p->string, fetchbuf->buf, 0);
+                } else {
+                    Ns_SetUpdate(set, var_p->string, fetchbuf->buf);
+                }
             }
         }
-    } else {
-        if (objc != 5) {
-            Tcl_AppendResult(interp,
-                             "wrong number of args: should be '",
-                             Tcl_GetString(objv[0]), 
-                             subcommand, " dbId query filename",
-                             NULL);
-            goto write_lob_cleanup;
-        }
-    }
-
-    if (!strncmp(subcommand, "blob", 4) || !strcmp(subcommand, "write_blob"))
-        blob_p = NS_TRUE;
-
-    query = Tcl_GetString(objv[3]);
-
-    if (!allow_sql_p(dbh, query, NS_TRUE)) {
-        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
-                         "by the Oracle driver", NULL);
-        goto write_lob_cleanup;
-    }
-
-    if (dbh->verbose)
-        Ns_Log(Notice, "SQL():  %s", query);
-
-    oci_status = OCIDescriptorAlloc(connection->env,
-                                    (dvoid **) & lob,
-                                    OCI_DTYPE_LOB, 0, 0);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIDescriptorAlloc",
-                    query, oci_status)) {
-        goto write_lob_cleanup;
-    }
-
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->stmt,
-                                OCI_HTYPE_STMT, 0, NULL);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
-        goto write_lob_cleanup;
-    }
-
-
-    oci_status = OCIStmtPrepare(connection->stmt,
-                                connection->err,
-                                query, strlen(query),
-                                OCI_NTV_SYNTAX, OCI_DEFAULT);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
-        goto write_lob_cleanup;
     }
-
-    oci_status = OCIDefineByPos(connection->stmt,
-                                &def,
-                                connection->err,
-                                1,
-                                &lob,
-                                -1,
-                                (blob_p) ? SQLT_BLOB : SQLT_CLOB,
-                                0, 0, 0, OCI_DEFAULT);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare",
-                    query, oci_status)) {
-        goto write_lob_cleanup;
+            
+    string_list_free_list(bind_variables);
+    string_list_free_list(returning_variables);
+    if (connection->n_columns > 0) {
+        if (connection->fetch_buffers != NULL) {
+            for (i = 0; i < connection->n_columns; i++) {
+                free_returned_values(&connection->fetch_buffers[i]);
+                Ns_Free(connection->fetch_buffers[i].buf);
+                connection->fetch_buffers[i].buf = NULL;
+                free_array_values(&connection->fetch_buffers[i]);
+            }
+            Ns_Free(connection->fetch_buffers);
+            connection->fetch_buffers = 0;
+        }
     }
 
-
-    oci_status = OCIStmtExecute(connection->svc,
-                                connection->stmt,
-                                connection->err,
-                                1, 0, 0, 0, OCI_DEFAULT);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute",
-                    query, oci_status)) {
-        goto write_lob_cleanup;
+    if (oci_error_p
+        (lexpos(), dbh, "OCIStmtExecute", query, oci_status)) {
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                      TCL_VOLATILE);
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
     }
 
-    if (!to_conn_p) {
-        filename = Tcl_GetString(objv[4]);
-    }
+    if (dml_p) {
+        /* array DML committed each chunk as it went */
+        if (connection->mode == autocommit && !array_p) {
+            oci_status = OCITransCommit(connection->svc,
+                                        connection->err, OCI_DEFAULT);
+            if (oci_error_p
+                (lexpos(), dbh, "OCITransCommit", query, oci_status)) {
+                Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                              TCL_VOLATILE);
+                Ns_OracleFlush(dbh);
+                return TCL_ERROR;
+            }
+        }
+    } else {  
 
-    write_lob_status =
-        stream_write_lob(interp, dbh, 0, lob, filename, to_conn_p,
-                         connection->svc, connection->err);
-    if (write_lob_status == STREAM_WRITE_LOB_ERROR) {
-        tcl_error_p(lexpos(), interp, dbh, "stream_write_lob",
-                    query, oci_status);
-        goto write_lob_cleanup;
-    }
+        Ns_Set *setPtr;
+        int dynamic_p = 0;
 
-    /* if we survived to here, we're golden */
-    result = TCL_OK;
+        ns_ora_log(lexpos(), "ns_ora dml:  doing bind for select");
+        Ns_SetTrunc(dbh->row, 0);
+        setPtr = Ns_OracleBindRow(dbh);
 
-  write_lob_cleanup:
+        if (!strcmp(subcommand, "1row") || 
+            !strcmp(subcommand, "0or1row")) {
+            Ns_Set *row;
+            int nrows;
 
-    if (lob != NULL) {
-        oci_status = OCIDescriptorFree(lob, OCI_DTYPE_LOB);
-        oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0, oci_status);
-    }
+            row = Oracle0or1Row(interp, dbh, setPtr, &nrows);
+            dynamic_p = 1;
 
-    Ns_OracleFlush(dbh);
+            if (row != NULL) {
+                if (!strcmp(subcommand, "1row") && nrows != 1) {
+                    Ns_DbSetException(dbh, "ORA",
+                                      "Query did not return a row.");
+                    /* XXX doesn't this leak a row? */
+                    row = NULL;
+                    Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                                  TCL_VOLATILE);
+                }
+            }
+            if (row == NULL) {
+                error(lexpos(), "Database operation \"%s\" failed",
+                      command);
+                Ns_OracleFlush(dbh);
+                return TCL_ERROR;
+            }
+            if (nrows == 0) {
+                Ns_SetFree(row);
+                row = NULL;
+            }
+            setPtr = row;
+        }
 
-    /* this is a hack.  If we don't drain a multi-part LOB, we'll get
-     * an error next time we use the handle.  This works around the problem
-     * for now until we find a better cleanup mechanism
-     */
-    if (write_lob_status != NS_OK) {
-        Ns_OracleCloseDb(dbh);
-        Ns_OracleOpenDb(dbh);
+        if (setPtr != NULL)
+            Ns_TclEnterSet(interp, setPtr, dynamic_p);
     }
 
-    return result;
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ OracleGetCols
+/*{{{ row_bind_values
  *----------------------------------------------------------------------
- * OracleGetCols --
+ * row_bind_values --
  *
- *      Implements [ns_ora getcols] command.
- *
- *      ns_ora getcols dbhandle sql
+ *      Helper for row-major [ns_ora array_dml].  Checks that every row
+ *      is a dict (a list of key/value pairs) or an ns_set id, and finds
+ *      the longest value of the named bind variable.  The values are
+ *      looked up again a chunk at a time by array_fill_chunk.
  *
  * Results:
  *
- *      Tcl list of columns in select-list.
+ *      TCL_OK, or TCL_ERROR with a message in the interp.
+ *
+ * Side effects:
+ *
+ *      Points fetchbuf at the rows and updates *max_length.
  *
  *----------------------------------------------------------------------
  */
-int
-OracleGetCols (Tcl_Interp *interp, int objc, 
-               Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+static int
+row_bind_values(Tcl_Interp *interp, fetch_buffer_t *fetchbuf, char *name,
+                Tcl_Obj **rows, int n_rows, int sets_p, int *max_length)
 {
-    ora_connection_t  *connection;
-    oci_status_t       oci_status;
-    char              *query;
-    int                i;
+    int j;
 
-    if (objc < 4) {
-        Tcl_AppendResult(interp, "wrong number of args: should be `",
-                         Tcl_GetString(objv[0]), " getcols dbId sql'", NULL);
-        return TCL_ERROR;
-    }
+    fetchbuf->name = name;
+    fetchbuf->array_rows = rows;
+    fetchbuf->array_sets_p = sets_p;
+    fetchbuf->array_count = n_rows;
 
-    query = Tcl_GetString(objv[3]);
+    for (j = 0; j < n_rows; j++) {
+        char *value;
 
-    connection = dbh->connection;
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->stmt,
-                                OCI_HTYPE_STMT, 0, NULL);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
-    }
+        if (row_bind_value(interp, rows[j], name, sets_p, &value) 
+                != TCL_OK) {
+            return TCL_ERROR;
+        }
 
-    oci_status = OCIStmtPrepare(connection->stmt,
-                                connection->err,
-                                query, strlen(query),
-                                OCI_NTV_SYNTAX, OCI_DEFAULT);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
+        if (value != NULL && (int) strlen(value) > *max_length) {
+            *max_length = strlen(value);
+        }
     }
 
-    /* Execute Query in DESCRIBE_ONLY mode. */
-    oci_status = OCIStmtExecute(connection->svc,
-                                connection->stmt,
-                                connection->err,
-                                1, 0, 0, 0, OCI_DESCRIBE_ONLY);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute",
-                    query, oci_status)) {
-        return TCL_ERROR;
-    }
+    return TCL_OK;
+}
+/*}}}*/
 
-    /* Get total number of columns. */
-    oci_status = OCIAttrGet(connection->stmt,
-                            OCI_HTYPE_STMT,
-                            (oci_attribute_t *) & connection->n_columns, 
-                            NULL, OCI_ATTR_PARAM_COUNT,
-                            connection->err);
+/*{{{ row_bind_value */
+/* the value of the named bind variable in one row of row-major array
+   DML, a dict or an ns_set id; NULL if the row doesn't have it. */
+static int
+row_bind_value(Tcl_Interp *interp, Tcl_Obj *row, char *name, int sets_p,
+               char **valuePtr)
+{
+    Tcl_Obj **pairs;
+    int       n_pairs, k;
 
-    for (i = 0; i < connection->n_columns; i++) {
-        OCIParam *param;
-        char name[512];
-        char *name1 = 0;
-        ub2 coltype;
-        sb4 name1_size = 0;
+    *valuePtr = NULL;
 
-        oci_status = OCIParamGet(connection->stmt,
-                                 OCI_HTYPE_STMT,
-                                 connection->err,
-                                 (oci_param_t *) & param, i + 1);
-        if (oci_error_p(lexpos(), dbh, "OCIParamGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
-        }
+    if (sets_p) {
+        Ns_Set *set = Ns_TclGetSet(interp, Tcl_GetString(row));
 
-        oci_status = OCIAttrGet(param,
-                                OCI_DTYPE_PARAM,
-                                (oci_attribute_t *) & name1,
-                                &name1_size,
-                                OCI_ATTR_NAME, connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
+        if (set == NULL) {
+            if (interp != NULL) {
+                Tcl_AppendResult(interp, "invalid set id `", 
+                                 Tcl_GetString(row), "'", NULL);
+            }
             return TCL_ERROR;
         }
+        *valuePtr = Ns_SetGet(set, name);
+        return TCL_OK;
+    }
 
-        oci_status = OCIAttrGet(param,
-                                OCI_DTYPE_PARAM,
-                                (oci_attribute_t *) &coltype,
-                                0,
-                                OCI_ATTR_DATA_TYPE, connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
+    if (Tcl_ListObjGetElements(interp, row, &n_pairs, &pairs) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    /* the last of duplicate keys wins, as with dict get */
+    for (k = n_pairs - n_pairs % 2 - 2; k >= 0; k -= 2) {
+        if (!strcmp(Tcl_GetString(pairs[k]), name)) {
+            *valuePtr = Tcl_GetString(pairs[k + 1]);
+            break;
         }
+    }
 
-        /* Oracle gives us back a pointer to a string that is not null-terminated
-         * so we copy it into our local var and add a 0 at the end.
-         */
-        memcpy(name, name1, name1_size);
-        name[name1_size] = 0;
-        downcase(name);
-
-        Tcl_ListObjAppendElement(interp, 
-                Tcl_GetObjResult(interp), Tcl_NewIntObj(coltype));
-
-        Tcl_ListObjAppendElement(interp, 
-                Tcl_GetObjResult(interp), Tcl_NewStringObj(name, name1_size));
+    return TCL_OK;
+}
+/*}}}*/
 
+/*{{{ array_fill_chunk */
+/* put the values of rows offset to offset + n - 1 in array_values, for
+   list_element_put_data.  The rows were checked by row_bind_values. */
+static void
+array_fill_chunk(fetch_buffer_t *fetchbuf, ub4 offset, ub4 n)
+{
+    Tcl_Interp *interp = fetchbuf->connection->interp;
+    Tcl_Obj **elements;
+    int       count;
+    ub4       j;
+
+    if (fetchbuf->array_list != NULL) {
+        Tcl_ListObjGetElements(NULL, fetchbuf->array_list, &count, &elements);
+        for (j = 0; j < n; j++) {
+            fetchbuf->array_values[j] = Tcl_GetString(elements[offset + j]);
+        }
+    } else if (fetchbuf->array_rows != NULL) {
+        for (j = 0; j < n; j++) {
+            row_bind_value(interp, fetchbuf->array_rows[offset + j], 
+                           fetchbuf->name, fetchbuf->array_sets_p, 
+                           &fetchbuf->array_values[j]);
+        }
     }
+}
+/*}}}*/
 
-    Ns_OracleFlush(dbh);
-
-    return TCL_OK;
+/*{{{ free_array_values */
+static void
+free_array_values(fetch_buffer_t *fetchbuf)
+{
+    if (fetchbuf->array_list != NULL) {
+        Tcl_DecrRefCount(fetchbuf->array_list);
+        fetchbuf->array_list = NULL;
+    }
+    Ns_Free(fetchbuf->array_values);
+    fetchbuf->array_values = NULL;
+    fetchbuf->array_rows = NULL;
+    fetchbuf->array_count = 0;
 }
 /*}}}*/
 
-/*{{{ OracleResultRows
- *----------------------------------------------------------------------
- * OracleResultRows --
- *
- *      Implements [ns_ora resultrows] command.
- *
- *      ns_ora resultrows dbhandle sql
- *
- * Results:
+/*{{{ Oracle0or1Row */
+/*----------------------------------------------------------------------
+ * Ns_Oracle0or1Row --
  *
- *      ...
+ *      Helper for [ns_ora 0or1row] 
  *
  *----------------------------------------------------------------------
  */
-int
-OracleResultRows (Tcl_Interp *interp, int objc, 
-                  Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+static Ns_Set *
+Oracle0or1Row (Tcl_Interp *interp, Ns_DbHandle *handle, 
+               Ns_Set *row, int *nrows)
 {
-    ora_connection_t  *connection;
-    oci_status_t       oci_status;
-    ub4                count;
-    char               buf[1024];
+    ns_ora_log(lexpos(), "entry");
 
-    if (objc != 3) {
-        Tcl_WrongNumArgs(interp, 2, objv, "dbId object");
-        return TCL_ERROR;
-    }
+    if (row != NULL) {
+        if (Ns_OracleGetRow(handle, row) == NS_END_DATA) {
+            *nrows = 0;
+        } else {
+            switch (Ns_OracleGetRow(handle, row)) {
+            case NS_END_DATA:
+                *nrows = 1;
+                break;
 
-    connection = dbh->connection;
-    if (connection->stmt == 0) {
-        Tcl_AppendResult(interp, "no active statement", NULL);
-        return TCL_ERROR;
-    }
+            case NS_OK:
+                Ns_DbSetException(handle, "ORA",
+                                  "Query returned more than one row.");
+                Tcl_SetResult(interp, handle->dsExceptionMsg.string,
+                              TCL_VOLATILE);
+                Ns_DbFlush(handle);
+                /* FALLTHROUGH */
 
-    oci_status = OCIAttrGet(connection->stmt,
-                            OCI_HTYPE_STMT,
-                            (oci_attribute_t *) &count,
-                            NULL, OCI_ATTR_ROW_COUNT, connection->err);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIAttrGet", 0, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
-    }
+            case NS_ERROR:
+                /* FALLTHROUGH */
 
-    snprintf(buf, 1024, "%ld", (long) count);
-    Tcl_AppendResult(interp, buf, NULL);
+            default:
+                return NULL;
+                break;
+            }
+        }
+        row = Ns_SetCopy(row);
+    }
 
-    return TCL_OK;
+    return row;
 }
 /*}}}*/
 
-/*{{{ OracleDesc
- *----------------------------------------------------------------------
- * OracleDesc --
+/*{{{ OracleLobDML */
+/*----------------------------------------------------------------------
+ * OracleLobDML --
  *
- *      Implements [ns_oracle desc] command.  
+ *      Implements [ns_ora clob_dml]
+ *                 [ns_ora clob_dml_file]
+ *                 [ns_ora blob_dml]
+ *                 [ns_ora blob_dml_file]
+ *                 [ns_ora blob_dml_conn]
+ *
+ *      ns_ora clob_dml dbhandle sql clob1 ?clob2 ... clobN?
+ *      ns_ora clob_dml_file dbhandle ?-piecesize bytes? ?-mmap? 
+ *                           sql path1 ?path2 ... pathN?
+ *      ns_ora blob_dml dbhandle sql blob1 ?blob2 ... blobN?
+ *      ns_ora blob_dml_file dbhandle ?-piecesize bytes? ?-mmap? 
+ *                           sql path1 ?path2 ... pathN?
  *
- *      ns_oracle desc_pkg dbhandle object_name
+ *      ns_ora blob_dml_conn dbhandle ?-piecesize bytes? ?-part name? sql
+ *
+ *      -piecesize and -mmap tune how the files are written; see
+ *      stream_read_lob.  blob_dml_conn writes the content of the
+ *      current request, or of its multipart/form-data part called
+ *      name, into the statement's one BLOB.
+ *
+ * Results:
+ *
+ *      Nothing.
  *
  *----------------------------------------------------------------------
  */
 int
-OracleDesc (Tcl_Interp *interp, int objc, 
-            Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+OracleLobDML (Tcl_Interp *interp, int objc, 
+              Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
 {
-    ora_connection_t  *connection;
+    Tcl_Obj          **data;
     oci_status_t       oci_status;
-    OCIDescribe       *descHandlePtr;
-    OCIParam          *paramHandlePtr;
-    char              *package;
-    ub1                ptype;
-    int                resolve;
+    ora_connection_t  *connection;
+    char              *query;
+    char              *option;
+    int                i,k;
+    int                files_p = NS_FALSE;
+    int                blob_p = NS_FALSE;
+    int                piece_size = 0;
+    int                mmap_p = NS_FALSE;
+    int                conn_p = NS_FALSE;
+    int                content_length = 0;
+    int                argi = 3;
+    char              *part = NULL;
+    char              *content = NULL;
+    Ns_Conn           *conn;
 
-    if (objc < 4) {
-        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle package");
-        return TCL_ERROR;
+    if (!strcmp(Tcl_GetString(objv[1]), "clob_dml_file") || 
+        !strcmp(Tcl_GetString(objv[1]), "blob_dml_file"))
+        files_p = NS_TRUE;
+
+    if (!strcmp(Tcl_GetString(objv[1]), "blob_dml_conn"))
+        conn_p = NS_TRUE;
+
+    while ((files_p || conn_p) && argi < objc) {
+        option = Tcl_GetString(objv[argi]);
+        if (!strcmp(option, "-piecesize") && argi + 1 < objc) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &piece_size) 
+                != TCL_OK)
+                return TCL_ERROR;
+            argi += 2;
+        } else if (files_p && !strcmp(option, "-mmap")) {
+            mmap_p = NS_TRUE;
+            argi++;
+        } else if (conn_p && !strcmp(option, "-part") && argi + 1 < objc) {
+            part = Tcl_GetString(objv[argi + 1]);
+            argi += 2;
+        } else {
+            break;
+        }
     }
 
-    if (objc == 5) {
-        Tcl_GetIntFromObj(interp, objv[4], &resolve);
-    } else {
-        resolve = 1;
+    if (conn_p) {
+        if (objc - argi != 1) {
+            Tcl_WrongNumArgs(interp, 2, objv, 
+                    "dbId ?-piecesize bytes? ?-part name? query");
+            return TCL_ERROR;
+        }
+
+        if ((conn = Ns_TclGetConn(interp)) == NULL) {
+            Tcl_AppendResult(interp, "No AOLserver conn available", NULL);
+            return TCL_ERROR;
+        }
+
+        content = Ns_ConnContent(conn);
+        content_length = Ns_ConnContentLength(conn);
+        if (content == NULL)
+            content_length = 0;
+
+        if (part != NULL
+            && multipart_part(content, content_length,
+                              Ns_SetIGet(Ns_ConnHeaders(conn), 
+                                         "Content-Type"), 
+                              part, &content, &content_length) != NS_OK) {
+            Tcl_AppendResult(interp, "no part named \"", part, 
+                             "\" in the request", NULL);
+            return TCL_ERROR;
+        }
+    } else if (objc - argi < 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, \
+                "dbId query clobList [clobValues | filenames] ...");
+        return TCL_ERROR;
     }
 
     connection = dbh->connection;
-    if (!connection) {
-        Tcl_SetResult(interp, "error: no connection", NULL);
+    query = Tcl_GetString(objv[argi]);
+
+    if (!strncmp(Tcl_GetString(objv[1]), "blob", 4))
+        blob_p = NS_TRUE;
+
+    if (!allow_sql_p(dbh, query, NS_TRUE)) {
+        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
+                         "by the Oracle driver", NULL);
         return TCL_ERROR;
     }
 
-    package = Tcl_GetString(objv[3]);
+    if (dbh->verbose)
+        Ns_Log(Notice, "SQL():  %s", query);
 
     oci_status = OCIHandleAlloc(connection->env,
-                                (dvoid *)&descHandlePtr,
-                                OCI_HTYPE_DESCRIBE, 0, NULL);
+                                (oci_handle_t **) & connection->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
     if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIHandleAlloc", package, oci_status)) {
+        (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
         Ns_OracleFlush(dbh);
         return TCL_ERROR;
     }
 
-    oci_status = OCIAttrSet(descHandlePtr,
-                            OCI_HTYPE_DESCRIBE,
-                            (dvoid *) 1, 0,
-                            OCI_ATTR_DESC_PUBLIC,
-                            connection->err);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIAttrSet", package, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
-    }
-
-    oci_status = OCIDescribeAny(connection->svc,
+    oci_status = OCIStmtPrepare(connection->stmt,
                                 connection->err,
-                                package,
-                                (ub4)strlen(package),
-                                OCI_OTYPE_NAME,
-                                (ub1) 0,
-                                OCI_PTYPE_UNK,
-                                descHandlePtr);
+                                query, strlen(query),
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
     if (tcl_error_p
-        (lexpos(), interp, dbh, "OCIDescribeAny", package, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
-    }
-
-    /* Get parameter handle */
-    oci_status = OCIAttrGet(descHandlePtr,
-                            OCI_HTYPE_DESCRIBE, 
-                            &paramHandlePtr, 
-                            (ub4 *)0, 
-                            OCI_ATTR_PARAM,
-                            connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
-    }
-
-    oci_status = OCIAttrGet(paramHandlePtr,
-                            OCI_DTYPE_PARAM, 
-                            &ptype, 
-                            (ub4 *)0, 
-                            OCI_ATTR_PTYPE,
-                            connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+        (lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
         Ns_OracleFlush(dbh);
         return TCL_ERROR;
     }
 
-    /* Resolve SYNONYM if necessary */
-    if (ptype == OCI_PTYPE_SYN && resolve) {
-        text *syn_name, *syn_schema;
-        char *syn_points_to, *syn_ptr;
-        ub4   syn_name_len, syn_schema_len;
+    data = &objv[argi + 1];
+    connection->n_columns = conn_p ? 1 : objc - argi - 1;
 
-        oci_status = OCIAttrGet(paramHandlePtr,
-                                OCI_DTYPE_PARAM, 
-                                (dvoid *) &syn_name,
-                                (ub4 *)   &syn_name_len, 
-                                OCI_ATTR_NAME,
-                                connection->err);
-        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
+    if (files_p) {
+        for (i = 0; i < connection->n_columns; i++) {
+            if (access(Tcl_GetString(data[i]), R_OK) != 0) {
+                Tcl_AppendResult(interp, "could not access file", 
+                        Tcl_GetString(data[i]), NULL);
+                Ns_OracleFlush(dbh);
+                return TCL_ERROR;
+            }
         }
+    }
 
-        oci_status = OCIAttrGet(paramHandlePtr,
-                                OCI_DTYPE_PARAM, 
-                                (dvoid *) &syn_schema, 
-                                (ub4 *)   &syn_schema_len, 
-                                OCI_ATTR_SCHEMA_NAME,
-                                connection->err);
-        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
-        }
+    malloc_fetch_buffers(connection);
 
-        syn_points_to = ns_malloc(syn_schema_len+syn_name_len+4);
-        strncpy(syn_points_to, syn_schema, syn_schema_len);
-        syn_ptr = syn_points_to + syn_schema_len;
-        *syn_ptr++ = '.';
-        strncpy(syn_ptr, syn_name, syn_name_len);
-        syn_ptr += syn_name_len;
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
 
-        *syn_ptr = '\0';
+        fetchbuf->type = -1;
 
-        oci_status = OCIDescribeAny(connection->svc,
-                                    connection->err,
-                                    (text *) syn_points_to,
-                                    (ub4) (syn_ptr - syn_points_to),
-                                    OCI_OTYPE_NAME,
-                                    (ub1) 0,
-                                    OCI_PTYPE_UNK,
-                                    descHandlePtr);
+        oci_status = OCIBindByPos(connection->stmt,
+                                  &fetchbuf->bind,
+                                  connection->err,
+                                  i + 1,
+                                  0,
+                                  -1,
+                                  (blob_p) ? SQLT_BLOB : SQLT_CLOB,
+                                  0, 0, 0, 0, 0, OCI_DATA_AT_EXEC);
         if (tcl_error_p
-            (lexpos(), interp, dbh, "OCIDescribeAny", package, oci_status)) {
+            (lexpos(), interp, dbh, "OCIBindByPos", query, oci_status)) {
             Ns_OracleFlush(dbh);
-            OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
             return TCL_ERROR;
         }
 
-        ns_free(syn_points_to);
-
-        /* Get parameter handle */
-        oci_status = OCIAttrGet(descHandlePtr,
-                                OCI_HTYPE_DESCRIBE, 
-                                &paramHandlePtr, 
-                                (ub4 *)0, 
-                                OCI_ATTR_PARAM,
-                                connection->err);
-        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+        oci_status = OCIBindDynamic(fetchbuf->bind,
+                                    connection->err,
+                                    0, no_data, fetchbuf, get_data);
+        if (tcl_error_p
+            (lexpos(), interp, dbh, "OCIBindDynamic", query, oci_status)) {
             Ns_OracleFlush(dbh);
-            OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
             return TCL_ERROR;
         }
     }
 
-    oci_status = OCIAttrGet(paramHandlePtr,
-                            OCI_DTYPE_PARAM, 
-                            &ptype, 
-                            (ub4 *)0, 
-                            OCI_ATTR_PTYPE,
-                            connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+    oci_status = OCIStmtExecute(connection->svc,
+                                connection->stmt,
+                                connection->err,
+                                1, 0, NULL, NULL, OCI_DEFAULT);
+
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
         Ns_OracleFlush(dbh);
-        OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
         return TCL_ERROR;
     }
 
-    switch (ptype) {
 
-        case OCI_PTYPE_PKG: 
-            OracleDescribePackage(descHandlePtr, 
-                                  paramHandlePtr, 
-                                  connection, dbh, package,
-                                  interp); 
-            break;
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
 
-        case OCI_PTYPE_SYN: 
-            OracleDescribeSynonym(descHandlePtr, 
-                                  paramHandlePtr, 
-                                  connection, dbh,
-                                  interp); 
-            break;
+        ub4 length = -1;
 
-        default: 
-            Ns_Log(Warning, "No desc handler, unable to describe object. %d", ptype); 
-    }
+        if (conn_p)
+            length = content_length;
+        else if (!files_p)
+            length = strlen(Tcl_GetString(data[i]));
 
-    OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
-    OCIHandleFree(paramHandlePtr, OCI_DTYPE_PARAM);
+        if (dbh->verbose) {
+            if (conn_p) {
+                Ns_Log(Notice, "  BLOB # %d, request content, length %d", 
+                        i, length);
+            } else if (files_p) {
+                Ns_Log(Notice, "  CLOB # %d, file name %s", i, 
+                        Tcl_GetString(data[i]));
+            } else {
+                Ns_Log(Notice, "  CLOB # %d, length %d: %s", i, length,
+                        (length == 0) ? "(NULL)" : 
+                        Tcl_GetString(data[i]));
+            }
+        }
 
-    return NS_OK;
-}
-/*}}}*/
+        /* if length is zero, that's an empty string.  Bypass the LobWrite
+         * to have it insert a NULL value
+         */
+        if (length == 0)
+            continue;
 
-/*{{{ OracleDescribeSynonym */
-void
-OracleDescribeSynonym ( OCIDescribe *descHandlePtr,
-                        OCIParam    *paramHandlePtr,
-                        ora_connection_t *connection,
-                        Ns_DbHandle *dbh,
-                        Tcl_Interp  *interp ) 
-{
-    oci_status_t       oci_status;
-    text *syn_name, *syn_schema;
-    ub4   syn_name_len, syn_schema_len;
+        for (k = 0; k < (int) fetchbuf->n_rows; k++) {
+            if (files_p) {
+                if (stream_read_lob
+                    (interp, dbh, 1, fetchbuf->lobs[k], Tcl_GetString(data[i]),
+                     connection, piece_size, mmap_p)
+                    != NS_OK) {
+                    tcl_error_p(lexpos(), interp, dbh, "stream_read_lob",
+                                query, oci_status);
+                    return TCL_ERROR;
+                }
+                continue;
+            }
 
-    oci_status = OCIAttrGet(paramHandlePtr,
-                            OCI_DTYPE_PARAM, 
-                            (dvoid *) &syn_name,
-                            (ub4 *)   &syn_name_len, 
-                            OCI_ATTR_NAME,
-                            connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
-        Ns_OracleFlush(dbh);
-        return;
+            if (conn_p) {
+                if (write_lob_content(interp, dbh, fetchbuf->lobs[k], 
+                                      content, length, piece_size)
+                    != NS_OK) {
+                    tcl_error_p(lexpos(), interp, dbh, "write_lob_content",
+                                query, oci_status);
+                    return TCL_ERROR;
+                }
+                continue;
+            }
+
+            oci_status = OCILobWrite(connection->svc,
+                                     connection->err,
+                                     fetchbuf->lobs[k],
+                                     &length,
+                                     1,
+                                     Tcl_GetString(data[i]),
+                                     length,
+                                     OCI_ONE_PIECE, 0, 0, 0,
+                                     SQLCS_IMPLICIT);
+
+            if (tcl_error_p
+                (lexpos(), interp, dbh, "OCILobWrite", query,
+                 oci_status)) {
+                Ns_OracleFlush(dbh);
+                return TCL_ERROR;
+            }
+        }
     }
 
-    oci_status = OCIAttrGet(paramHandlePtr,
-                            OCI_DTYPE_PARAM, 
-                            (dvoid *) &syn_schema, 
-                            (ub4 *)   &syn_schema_len, 
-                            OCI_ATTR_SCHEMA_NAME,
-                            connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
-        Ns_OracleFlush(dbh);
-        return;
+    if (connection->mode == autocommit) {
+        oci_status = OCITransCommit(connection->svc,
+                                    connection->err, OCI_DEFAULT);
+        if (tcl_error_p
+            (lexpos(), interp, dbh, "OCITransCommit", query, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return TCL_ERROR;
+        }
     }
 
-    Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp), Tcl_NewStringObj(syn_schema, syn_schema_len));
-    Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp), Tcl_NewStringObj(syn_name, syn_name_len));
+    /* all done */
+    free_fetch_buffers(connection);
 
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ OracleDescribePackage */
-void
-OracleDescribePackage ( OCIDescribe      *descHandlePtr,
-                        OCIParam         *paramHandlePtr,
-                        ora_connection_t *connection,
-                        Ns_DbHandle      *dbh,
-                        char             *package,
-                        Tcl_Interp       *interp ) 
+/*{{{ OracleLobDMLBind*/
+/*----------------------------------------------------------------------
+ * OracleLobDMLBind --
+ *
+ *      Implements [ns_ora clob_dml_bind]
+ *                 [ns_ora clob_dml_file_bind]
+ *                 [ns_ora blob_dml_bind]
+ *                 [ns_ora blob_dml_file_bind]
+ *
+ *      ns_ora clob_dml_bind dbhandle sql list_of_lobs ?clob1 ... clobN?
+ *      ns_ora clob_dml_file_bind dbhandle sql list_of_lobs ?clob1 ... clobN?
+ *      ns_ora blob_dml_bind dbhandle sql list_of_lobs ?blob1 ... blobN?
+ *      ns_ora blob_dml_file_bind dbhandle sql list_of_lobs ?clob1 ... clobN?
+ *
+ * Results:
+ *
+ *      Nothing.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleLobDMLBind (Tcl_Interp *interp, int objc, 
+                  Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
 {
-    OCIParam     *procListPtr, *arg, *arg1; 
-    oci_status_t  oci_status;
-    ub2           numProcs;
-    ub4           namelen;
-    text         *name;
-    int           i;
+    Tcl_Obj          **data;
+    oci_status_t       oci_status;
+    ora_connection_t  *connection;
+    string_list_elt_t *bind_variables, *var_p;
+    char              *query;
+    int                i,k;
+    int                files_p = NS_FALSE;
+    int                blob_p = NS_FALSE;
+    char             **lob_argv;
+    int                lob_argc;
+    int                argv_base;
 
-    oci_status = OCIAttrGet (paramHandlePtr, OCI_DTYPE_PARAM, &procListPtr, 0, 
-                             OCI_ATTR_LIST_SUBPROGRAMS, connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
-        Ns_OracleFlush(dbh);
-        return;
+    if (objc < 5) {
+        Tcl_WrongNumArgs(interp, 2, objv, \
+                "dbId query clobList [clobValues | filenames] ...");
+        return TCL_ERROR;
     }
 
-    oci_status = OCIAttrGet (procListPtr, OCI_DTYPE_PARAM, &numProcs, 0, OCI_ATTR_NUM_PARAMS, connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
-        Ns_OracleFlush(dbh);
-        return;
-    }
+    query = Tcl_GetString(objv[3]);
+    connection = dbh->connection;
 
-    for (i = 0; i < numProcs; i++) {
-        Tcl_Obj *procObj = Tcl_NewObj();
-        
-        OCIParamGet (procListPtr, OCI_DTYPE_PARAM, connection->err, (dvoid *)&arg, (ub4)i);
-        OCIAttrGet (arg, OCI_DTYPE_PARAM, &name, &namelen, OCI_ATTR_NAME, connection->err);
-        OCIAttrGet (arg, OCI_DTYPE_PARAM, &arg1, 0, OCI_ATTR_LIST_ARGUMENTS, connection->err);
+    if (!strcmp(Tcl_GetString(objv[1]), "clob_dml_file_bind") || 
+        !strcmp(Tcl_GetString(objv[1]), "blob_dml_file_bind"))
+        files_p = NS_TRUE;
 
-        Tcl_ListObjAppendElement(interp, procObj, Tcl_NewStringObj(name, namelen));
+    if (!strncmp(Tcl_GetString(objv[1]), "blob", 4))
+        blob_p = NS_TRUE;
 
-        OracleDescribeArguments(descHandlePtr, arg1, connection, dbh, interp, procObj);
+    if (!allow_sql_p(dbh, query, NS_TRUE)) {
+        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
+                         "by the Oracle driver", NULL);
+        return TCL_ERROR;
     }
 
-}
-/*}}}*/
+    if (dbh->verbose)
+        Ns_Log(Notice, "SQL():  %s", query);
 
-/*{{{ OracleDescribeArguments */
-void
-OracleDescribeArguments (OCIDescribe       *descHandlePtr,
-                         OCIParam          *paramHandlePtr,
-                         ora_connection_t  *connection,
-                         Ns_DbHandle       *dbh,
-                         Tcl_Interp        *interp,
-                         Tcl_Obj           *list) 
-{
-    OCIParam         *arg;
-    OCITypeParamMode  mode;
-    OCIParam         *arglst1;
-    OCITypeCode       data_type;
-    ub1               has_default;
-    oci_status_t      oci_status;
-    ub2               numargs;
-    ub4               namelen;
-    text             *name;
-    int               i;
-    Tcl_Obj          *argObj = Tcl_NewObj();
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
 
-    oci_status = OCIAttrGet (paramHandlePtr, OCI_DTYPE_PARAM, &numargs, 0, OCI_ATTR_NUM_PARAMS, connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
+    oci_status = OCIStmtPrepare(connection->stmt,
+                                connection->err,
+                                query, strlen(query),
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
         Ns_OracleFlush(dbh);
-        return;
+        return TCL_ERROR;
     }
-    
-    for (i = 0; i < numargs; i++) {
-        Tcl_Obj *argument = Tcl_NewObj();
 
-        oci_status = OCIParamGet (paramHandlePtr, OCI_DTYPE_PARAM, connection->err, (dvoid *)&arg, i);
-        if (oci_status == OCI_ERROR) {
-            numargs++;
-            continue;
-        }
+    data = &objv[4];
+    connection->n_columns = objc - 4;
 
-        OCIAttrGet (arg, OCI_DTYPE_PARAM, &name, &namelen, OCI_ATTR_NAME, connection->err);
-        OCIAttrGet (arg, OCI_DTYPE_PARAM, &arglst1, 0, OCI_ATTR_LIST_ARGUMENTS, connection->err);
-        OCIAttrGet (arg, OCI_DTYPE_PARAM, &mode, 0, OCI_ATTR_IOMODE, connection->err);
-        OCIAttrGet (arg, OCI_DTYPE_PARAM, &data_type, 0, OCI_ATTR_DATA_TYPE, connection->err);
-        OCIAttrGet (arg, OCI_DTYPE_PARAM, &has_default, 0, OCI_ATTR_HAS_DEFAULT, connection->err);
+    Tcl_SplitList(interp, Tcl_GetString(objv[4]), &lob_argc, &lob_argv);
 
-        Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj(name, namelen));
+    bind_variables = parse_bind_variables(query);
 
-        switch ((int)mode) {
-            case OCI_TYPEPARAM_IN:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("IN", -1));
-                break;
+    connection->n_columns = string_list_len(bind_variables);
 
-            case OCI_TYPEPARAM_OUT:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("OUT", -1));
-                break;
+    ns_ora_log(lexpos(), "%d bind variables", connection->n_columns);
 
-            case OCI_TYPEPARAM_INOUT:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("INOUT", -1));
-                break;
+    malloc_fetch_buffers(connection);
 
-            default:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("", -1));
-                
-        }
+    argv_base = 4;
 
-        switch (data_type) {
-            case OCI_TYPECODE_VARCHAR2:
-            case OCI_TYPECODE_VARCHAR:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("VARCHAR2", -1));
-                break;
+    for (var_p = bind_variables, i = 0; var_p != NULL;
+         var_p = var_p->next, i++) {
 
-            case OCI_TYPECODE_CHAR:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("CHAR", -1));
-                break;
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+        char           *nbuf, *value = NULL;
+        int             index, lob_i;
 
-            case OCI_TYPECODE_CLOB:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("CLOB", -1));
-                break;
+        fetchbuf->type = -1;
+        index = strtol(var_p->string, &nbuf, 10);
+        if (*nbuf == '\0') {
+            /* It was a valid number.
+               Pick out one of the remaining arguments,
+               where ":1" is the first remaining arg. */
+            if ((index < 1) || (index > (objc - argv_base - 1))) {
+                if (index < 1) {
+                    Tcl_AppendResult(interp,
+                                     "invalid positional variable `:",
+                                     var_p->string,
+                                     "', valid values start with 1", NULL);
+                } else {
+                    Tcl_AppendResult(interp,
+                                     "not enough arguments for positional variable ':",
+                                     var_p->string, "'", NULL);
+                }
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                Tcl_Free((char *) lob_argv);
+                return TCL_ERROR;
+            }
+            value = Tcl_GetString(objv[argv_base + index]);
+        } else {
+            value = Tcl_GetVar(interp, var_p->string, 0);
+            if (value == NULL) {
+                Tcl_AppendResult(interp, "undefined variable `",
+                                 var_p->string, "'", NULL);
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                Tcl_Free((char *) lob_argv);
+                return TCL_ERROR;
+            }
+        }
 
-            case OCI_TYPECODE_NUMBER:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("NUMBER", -1));
-                break;
 
-            case OCI_TYPECODE_DATE:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("DATE", -1));
-                break;
+        fetchbuf->buf = Ns_StrDup(value);
+        fetchbuf->fetch_length = strlen(fetchbuf->buf) + 1;
+        fetchbuf->is_null = 0;
 
-            case OCI_TYPECODE_OBJECT:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("OBJECT", -1));
-                break;
+        if (dbh->verbose)
+            Ns_Log(Notice, "bind variable '%s' = '%s'", var_p->string,
+                   value);
 
-            case SQLT_CUR:
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("REF CURSOR", -1));
-                break;
+        ns_ora_log(lexpos(), "ns_ora clob_dml:  binding variable %s",
+            var_p->string);
 
-            default:
-                Ns_Log(Warning, "Unknown Oracle Type: %d", data_type);
-                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("", -1));
-                
+        for (lob_i = 0; lob_i < lob_argc; lob_i++) {
+            if (strcmp(lob_argv[lob_i], var_p->string) == 0) {
+                fetchbuf->is_lob = 1;
+                ns_ora_log(lexpos(), "bind variable %s is a lob", var_p->string);
+                break;
+            }
         }
 
-        Tcl_ListObjAppendElement(interp, argument, Tcl_NewIntObj(has_default));
-        Tcl_ListObjAppendElement(interp, argObj, argument);
-    }
+        oci_status = OCIBindByName(connection->stmt,
+                                   &fetchbuf->bind,
+                                   connection->err,
+                                   var_p->string,
+                                   strlen(var_p->string),
+                                   fetchbuf->buf,
+                                   fetchbuf->fetch_length,
+                                   fetchbuf->is_lob ?
+                                   (blob_p ? SQLT_BLOB : SQLT_CLOB)
+                                   : SQLT_STR,
+                                   &fetchbuf->is_null,
+                                   0,
+                                   0,
+                                   0,
+                                   0,
+                                   fetchbuf->is_lob ?
+                                   OCI_DATA_AT_EXEC : OCI_DEFAULT);
 
-    if (list) {
-        Tcl_ListObjAppendElement(interp, list, argObj);
-        Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp), list);
-    }
-
-}
-/*}}}*/
+        if (oci_error_p(lexpos(), dbh, "OCIBindByName", query, oci_status)) {
+            Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                          TCL_VOLATILE);
+            Ns_OracleFlush(dbh);
+            string_list_free_list(bind_variables);
+            Tcl_Free((char *) lob_argv);
+            return TCL_ERROR;
+        }
 
-/* 
- * AOLserver [ns_db] implementation. 
- *
- */
+        if (fetchbuf->is_lob) {
+            oci_status = OCIBindDynamic(fetchbuf->bind,
+                                        connection->err,
+                                        0, no_data, fetchbuf, get_data);
+            if (tcl_error_p
+                (lexpos(), interp, dbh, "OCIBindDynamic", query,
+                 oci_status)) {
+                Ns_OracleFlush(dbh);
+                Tcl_Free((char *) lob_argv);
+                string_list_free_list(bind_variables);
+                return TCL_ERROR;
+            }
+        }
+    }
 
-/*{{{ Ns_DbDriverInit */
-/* Entry point (called by AOLserver when driver loaded) 
+    Tcl_Free((char *) lob_argv);
 
-   note that this does not leave behind any structures or state outside
-   of reading the configuraton parameters, as well as
-   initializing OCI and registering our functions
-*/
-NS_EXPORT int 
-Ns_DbDriverInit (char *hdriver, char *config_path) 
-{
-    int ns_status;
+    oci_status = OCIStmtExecute(connection->svc,
+                                connection->stmt,
+                                connection->err,
+                                1, 0, NULL, NULL, OCI_DEFAULT);
 
-    /* slurp any nsd.ini configuration parameters first */
-    if (!Ns_ConfigGetBool(config_path, "Debug", &debug_p))
-        debug_p = DEFAULT_DEBUG;
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
+        Ns_OracleFlush(dbh);
+        string_list_free_list(bind_variables);
+        return TCL_ERROR;
+    }
 
-    if (!Ns_ConfigGetInt
-        (config_path, "MaxStringLogLength", &max_string_log_length))
-        max_string_log_length = DEFAULT_MAX_STRING_LOG_LENGTH;
+    for (var_p = bind_variables, i = 0; var_p != NULL;
+         var_p = var_p->next, i++) {
 
-    if (max_string_log_length < 0)
-        max_string_log_length = INT_MAX;
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+        ub4             length = -1;
 
-    if (!Ns_ConfigGetInt (config_path, "CharExpansion", &char_expansion))
-         char_expansion = DEFAULT_CHAR_EXPANSION;
+        if (!fetchbuf->is_lob) {
+            ns_ora_log(lexpos(), "column %d is not a lob", i);
+            continue;
+        }
 
-    if (!Ns_ConfigGetInt(config_path, "LobBufferSize", &lob_buffer_size))
-        lob_buffer_size = 16384;
-    Ns_Log(Notice, "%s driver LobBufferSize = %d", hdriver, lob_buffer_size);
+        if (!files_p)
+            length = strlen(fetchbuf->buf);
 
-    if (!Ns_ConfigGetInt(config_path, "PrefetchRows", &prefetch_rows))
-        prefetch_rows = 0;
-    Ns_Log(Notice, "%s driver PrefetchRows = %d", hdriver, prefetch_rows);
+        if (dbh->verbose) {
+            if (files_p) {
+                Ns_Log(Notice, "  CLOB # %d, file name %s", i,
+                       fetchbuf->buf);
+            } else {
+                Ns_Log(Notice, "  CLOB # %d, length %d: %s", i, length,
+                       (length == 0) ? "(NULL)" : fetchbuf->buf);
+            }
+        }
 
-    if (!Ns_ConfigGetInt(config_path, "PrefetchMemory", &prefetch_memory))
-        prefetch_memory = 0;
-    Ns_Log(Notice, "%s driver PrefetchMemory = %d", hdriver,
-           prefetch_memory);
+        /* if length is zero, that's an empty string.  Bypass the LobWrite
+         * to have it insert a NULL value
+         */
+        if (length == 0)
+            continue;
 
+        for (k = 0; k < (int) fetchbuf->n_rows; k++) {
+            if (files_p) {
+                if (stream_read_lob
+                    (interp, dbh, 1, fetchbuf->lobs[k], fetchbuf->buf,
+                     connection, 0, NS_FALSE)
+                    != NS_OK) {
+                    tcl_error_p(lexpos(), interp, dbh, "stream_read_lob",
+                                query, oci_status);
+                    string_list_free_list(bind_variables);
+                    return TCL_ERROR;
+                }
+                continue;
+            }
 
-    ns_ora_log(lexpos(), "entry (hdriver %p, config_path %s)", hdriver,
-        nilp(config_path));
+            ns_ora_log(lexpos(), "using lob %x", fetchbuf->lobs[k]);
+            oci_status = OCILobWrite(connection->svc,
+                                     connection->err,
+                                     fetchbuf->lobs[k],
+                                     &length,
+                                     1,
+                                     fetchbuf->buf,
+                                     length,
+                                     OCI_ONE_PIECE, 0, 0, 0,
+                                     SQLCS_IMPLICIT);
 
-    ns_status = Ns_DbRegisterDriver(hdriver, ora_procs);
-    if (ns_status != NS_OK) {
-        error(lexpos(), "Could not register driver `%s'.",
-              nilp(ora_driver_name));
-        return NS_ERROR;
+            if (tcl_error_p
+                (lexpos(), interp, dbh, "OCILobWrite", query,
+                 oci_status)) {
+                string_list_free_list(bind_variables);
+                Ns_OracleFlush(dbh);
+                return TCL_ERROR;
+            }
+        }
     }
 
-    Ns_Log(Notice, "Loaded %s, built on %s/%s",
-           ora_driver_version, __TIME__, __DATE__);
-
-#if defined(FOR_CASSANDRACLE)
-    Ns_Log(Notice,
-           "    This Oracle Driver is a reduced-functionality Cassandracle driver");
-#endif
-
-    ns_ora_log(lexpos(), "driver `%s' loaded.", nilp(ora_driver_name));
-
-    return NS_OK;
-}
-/*}}}*/
-
-/*{{{ Ns_OracleInterpInit */
-static int 
-Ns_OracleInterpInit (Tcl_Interp *interp, void *dummy)
-{
-    Tcl_CreateObjCommand (interp, "ns_ora", OracleObjCmd, 
-            (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
-
-    Tcl_CreateObjCommand (interp, "ns_oracle", OracleObjCmd, 
-            (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
-
-#if defined(NS_AOLSERVER_3_PLUS)
-    Tcl_CreateCommand(interp, "ns_column", ora_column_command, NULL, NULL);
-    Tcl_CreateCommand(interp, "ns_table", ora_table_command, NULL, NULL);
-#endif
-
-    return NS_OK;
-}          
-/*}}}*/
+    if (connection->mode == autocommit) {
+        oci_status = OCITransCommit(connection->svc,
+                                    connection->err, OCI_DEFAULT);
+        if (tcl_error_p
+            (lexpos(), interp, dbh, "OCITransCommit", query, oci_status)) {
+            string_list_free_list(bind_variables);
+            Ns_OracleFlush(dbh);
+            return TCL_ERROR;
+        }
+    }
 
-/*{{{ Ns_OracleServerInit */
-static int 
-Ns_OracleServerInit(char *hserver, char *hmodule, char *hdriver)
-{
-    ns_ora_log(lexpos(), "entry (%s, %s, %s)", nilp(hserver), nilp(hmodule),
-        nilp(hdriver));
+    /* all done */
+    free_fetch_buffers(connection);
+    string_list_free_list(bind_variables);
 
-    return Ns_TclInitInterps(hserver, Ns_OracleInterpInit, NULL);
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleName */
-/*----------------------------------------------------------------------
- * Ns_OracleName --
+/*{{{ OracleLobSelect
+ *----------------------------------------------------------------------
+ * OracleLobSelect --
  *
- *      Return name of database driver.
+ *      Implements [ns_ora clob_get_file]
+ *                 [ns_ora blob_get_file]
+ *                 [ns_ora write_clob]
+ *                 [ns_ora write_blob]
+ *                 [ns_ora blob_read]
+ *                 [ns_ora clob_get_channel]
+ *                 [ns_ora blob_get_channel]
  *
- *----------------------------------------------------------------------
- */
-static char *
-Ns_OracleName (Ns_DbHandle *dummy) 
-{
-    ns_ora_log(lexpos(), "entry (dummy %p)", dummy);
-
-    return ora_driver_name;
-}
-/*}}}*/
-
-/*{{{ Ns_OracleDbType */
-/*----------------------------------------------------------------------
- * Ns_OracleDbType --
+ *      ns_ora clob_get_file dbhandle sql path
+ *      ns_ora blob_get_file dbhandle sql path
+ *      ns_ora clob_get_channel dbhandle ?-piecesize bytes? sql channel
+ *      ns_ora blob_get_channel dbhandle ?-piecesize bytes? sql channel
+ *      ns_ora write_clob dbhandle ?-spool? ?-release? ?-range? 
+ *                        ?-gzip? ?-type type? sql ?nbytes?
+ *      ns_ora write_blob dbhandle ?-spool? ?-release? ?-range? 
+ *                        ?-gzip? ?-cache key? ?-type type? sql ?nbytes?
+ *      ns_ora blob_read dbhandle sql offset length
  *
- *      This function returns the string which identifies the database
- *      type.  
+ *      -spool reads the whole LOB (see spool_lob) before anything is
+ *      written to the connection, so a slow client doesn't hold a
+ *      statement or LOB open on the handle.  -release is the same as
+ *      -spool: the handle stays the caller's, idle during the send,
+ *      to release with ns_db releasehandle as usual.
  *
- *      Implements [ns_db dbtype] 
+ *      -type and -range make the driver send the headers itself,
+ *      with Content-Length and Accept-Ranges.  -range honors the
+ *      request's Range and If-Range headers (see lob_range), reading
+ *      only the part of the LOB asked for and answering 206, or 416.
  *
- *----------------------------------------------------------------------
- */
-static char *
-Ns_OracleDbType (Ns_DbHandle *dummy) 
-{
-    ns_ora_log(lexpos(), "entry (dummy %p)", dummy);
-
-    return ora_driver_name;
-}
-/*}}}*/
-
-/*{{{ Ns_OracleOpenDb */
-/*----------------------------------------------------------------------
- * Ns_OracleOpenDb --
+ *      -gzip also sends the headers, and compresses the LOB on the way
+ *      out if the client takes gzip and it is at least GzipMinSize
+ *      bytes of one of the GzipTypes.  Ranges and spooled LOBs are
+ *      sent as they are.
  *
- *      Opens a database connection.
+ *      -cache serves the BLOB from BlobCacheDir if it holds key, without
+ *      running the query; otherwise the BLOB is read into the cache
+ *      and sent from there, as if spooled.  key should change whenever
+ *      the BLOB does.
  *
- *      Implements [ns_db open] 
+ *      blob_read returns length bytes of the BLOB, starting offset
+ *      bytes in, as a byte array.
+ *
+ *      The get_channel commands write the LOB to an open Tcl channel,
+ *      piecesize bytes (rounded to the LOB's chunks) at a time.
+ *
+ * Results:
+ *
+ *      Nothing.
  *
  *----------------------------------------------------------------------
  */
-static int 
-Ns_OracleOpenDb (Ns_DbHandle *dbh) 
+int
+OracleLobSelect (Tcl_Interp *interp, int objc, 
+                 Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
 {
-    oci_status_t oci_status;
-    ora_connection_t *connection;
-
-    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+    oci_status_t       oci_status;
+    ora_connection_t  *connection;
+    OCILobLocator     *lob = NULL;
+    OCIDefine         *def;
+    char              *query;
+    char              *filename = NULL;
+    char              *command, *subcommand;
+    int                blob_p = NS_FALSE;
+    int                to_conn_p = NS_FALSE;
+    int                nbytes = INT_MAX;
+    int                result = TCL_ERROR;
+    int                write_lob_status = NS_ERROR;
+    int                spool_p = NS_FALSE;
+    int                spooled = 0;
+    int                spool_fd = -1;
+    off_t              spool_length = 0;
+    int                argi = 3;
+    int                range_p = NS_FALSE;
+    int                read_p = NS_FALSE;
+    int                chan_p = NS_FALSE;
+    int                gzip_p = NS_FALSE;
+    int                cached_p = NS_FALSE;
+    char              *cache_key = NULL;
+    int                chan_mode;
+    int                http_status = 0;
+    int                read_offset = 0, read_length = 0;
+    char              *type = NULL;
+    char              *option;
+    ub4                oci_length;
+    off_t              loblen = 0, total, offset = 1, amount;
+    Ns_Conn           *conn = NULL;
+    Ns_DString         spool;
+    lob_sink_t         sink;
+
+    Ns_DStringInit(&spool);
+    memset(&sink, 0, sizeof sink);
+    sink.fd = -1;
 
-    if (!dbh) {
-        error(lexpos(), "invalid args.");
-        return NS_ERROR;
+    if (objc < 4 ) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle ?-bind set? sql ?ref?");
+        return TCL_ERROR;
     }
 
-    if (! dbh->password) {
-        error (lexpos (), 
-                "Missing Password parameter in configuration file for pool %s.", 
-                dbh->poolname );
-        return NS_ERROR;
-    }
+    command = Tcl_GetString(objv[0]);
+    subcommand = Tcl_GetString(objv[1]);
+    connection = dbh->connection;
 
-    if (! dbh->user) {
-        error (lexpos (), 
-                "Missing User parameter in configuration file for pool %s.", 
-                dbh->poolname);
-        return NS_ERROR;
-    }
+    if (!strncmp(subcommand, "write", 5))
+        to_conn_p = NS_TRUE;
 
-    connection = Ns_Malloc(sizeof *connection);
+    if (!strcmp(subcommand, "blob_read"))
+        read_p = NS_TRUE;
 
-    connection->dbh = dbh;
-    connection->env = NULL;
-    connection->err = NULL;
-    connection->srv = NULL;
-    connection->svc = NULL;
-    connection->auth = NULL;
-    connection->stmt = NULL;
-    connection->mode = autocommit;
-    connection->n_columns = 0;
-    connection->fetch_buffers = NULL;
+    if (!strcmp(subcommand + 4, "_get_channel"))
+        chan_p = NS_TRUE;
 
-    /*  AOLserver, in their database handle structure, gives us one field
-     *  to store our connection structure.
-     */
-    dbh->connection = connection;
+    if (to_conn_p) {
+        for (; argi < objc; argi++) {
+            option = Tcl_GetString(objv[argi]);
+            if (!strcmp(option, "-spool") || !strcmp(option, "-release")) {
+                spool_p = NS_TRUE;
+            } else if (!strcmp(option, "-range")) {
+                range_p = NS_TRUE;
+            } else if (!strcmp(option, "-gzip")) {
+                gzip_p = NS_TRUE;
+            } else if (!strcmp(option, "-cache") && argi + 1 < objc) {
+                cache_key = Tcl_GetString(objv[++argi]);
+            } else if (!strcmp(option, "-type") && argi + 1 < objc) {
+                type = Tcl_GetString(objv[++argi]);
+            } else {
+                break;
+            }
+        }
 
-    oci_status = OCIEnvCreate(&connection->env,
-                              OCI_THREADED|OCI_ENV_NO_MUTEX,
-                              NULL,
-                              Ns_OracleMalloc,
-                              Ns_OracleRealloc,
-                              Ns_OracleFree,
-                              0, 0);
-    if (oci_error_p(lexpos(), NULL, "OCIEnvCreate", 0, oci_status))
-        return NS_ERROR;
+        if (objc - argi < 1 || objc - argi > 2) {
+            Tcl_AppendResult(interp,
+                             "wrong number of args: should be '",
+                             Tcl_GetString(objv[0]), " ",
+                             subcommand, " dbId ?-spool? ?-release? "
+                             "?-range? ?-gzip? ?-cache key? ?-type type? "
+                             "query ?nbytes?", NULL);
+            goto write_lob_cleanup;
+        }
 
+        if (cache_key != NULL && strcmp(subcommand, "write_blob")) {
+            Tcl_AppendResult(interp, "only write_blob takes -cache", NULL);
+            goto write_lob_cleanup;
+        }
 
+        /* CLOB lengths and offsets count characters, but Range and
+           Content-Length count bytes */
+        if (range_p && strcmp(subcommand, "write_blob")) {
+            Tcl_AppendResult(interp, "only write_blob takes -range", NULL);
+            goto write_lob_cleanup;
+        }
 
-    /* sets connection->err */
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->err,
-                                OCI_HTYPE_ERROR, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
-        return NS_ERROR;
+        /* escaped, it has to fit in a file name */
+        if (cache_key != NULL && strlen(cache_key) > 80) {
+            Tcl_AppendResult(interp, "cache key \"", cache_key, 
+                             "\" is longer than 80 bytes", NULL);
+            goto write_lob_cleanup;
+        }
 
-    /* sets connection->srv */
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->srv,
-                                OCI_HTYPE_SERVER, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
-        return NS_ERROR;
+        /* without a BlobCacheDir there's no cache */
+        if (blob_cache_dir == NULL)
+            cache_key = NULL;
 
-    /* sets connection->svc */
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->svc,
-                                OCI_HTYPE_SVCCTX, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
-        return NS_ERROR;
+        if (objc - argi == 2) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &nbytes) 
+                != TCL_OK) {
+                goto write_lob_cleanup;
+            }
+        }
 
-    /* create association between server handle and access path (datasource; 
-       a string from the nsd.ini file) */
-    oci_status = OCIServerAttach(connection->srv, connection->err,
-                                 dbh->datasource,
-                                 strlen(dbh->datasource), OCI_DEFAULT);
-    if (oci_error_p(lexpos(), dbh, "OCIServerAttach", 0, oci_status))
-        return NS_ERROR;
+        if ((spool_p || range_p || gzip_p || cache_key != NULL 
+             || type != NULL) 
+            && (conn = Ns_TclGetConn(interp)) == NULL) {
+            Tcl_AppendResult(interp, "No AOLserver conn available", NULL);
+            goto write_lob_cleanup;
+        }
 
-    /* tell OCI to associate the server handle with the context handle */
-    oci_status = OCIAttrSet(connection->svc,
-                            OCI_HTYPE_SVCCTX,
-                            connection->srv,
-                            0, OCI_ATTR_SERVER, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
-        return NS_ERROR;
+        if ((range_p || gzip_p) && type == NULL) 
+            type = (!strcmp(subcommand, "write_blob")) 
+                ? "application/octet-stream" : "text/plain";
+    } else if (chan_p) {
+        if (objc > 4 && !strcmp(Tcl_GetString(objv[argi]), "-piecesize")) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &sink.piece_size)
+                != TCL_OK) {
+                goto write_lob_cleanup;
+            }
+            argi += 2;
+        }
 
-    /* allocate connection->auth */
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->auth,
-                                OCI_HTYPE_SESSION, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
-        return NS_ERROR;
+        if (objc - argi != 2) {
+            Tcl_AppendResult(interp,
+                             "wrong number of args: should be '",
+                             Tcl_GetString(objv[0]), " ",
+                             subcommand, " dbId ?-piecesize bytes? "
+                             "query channel", NULL);
+            goto write_lob_cleanup;
+        }
 
-    /* give OCI the username from the nsd.ini file */
-    oci_status = OCIAttrSet(connection->auth,
-                            OCI_HTYPE_SESSION,
-                            dbh->user,
-                            strlen(dbh->user),
-                            OCI_ATTR_USERNAME, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
-        return NS_ERROR;
+        sink.path = Tcl_GetString(objv[argi + 1]);
+        sink.chan = Tcl_GetChannel(interp, sink.path, &chan_mode);
+        if (sink.chan == NULL) 
+            goto write_lob_cleanup;
 
-    /* give OCI the password from the nsd.ini file */
-    oci_status = OCIAttrSet(connection->auth,
-                            OCI_HTYPE_SESSION,
-                            dbh->password,
-                            strlen(dbh->password),
-                            OCI_ATTR_PASSWORD, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
-        return NS_ERROR;
+        if (!(chan_mode & TCL_WRITABLE)) {
+            Tcl_AppendResult(interp, "channel \"", sink.path,
+                             "\" wasn't opened for writing", NULL);
+            goto write_lob_cleanup;
+        }
+    } else if (read_p) {
+        if (objc != 6) {
+            Tcl_AppendResult(interp,
+                             "wrong number of args: should be '",
+                             Tcl_GetString(objv[0]), " ",
+                             subcommand, " dbId query offset length",
+                             NULL);
+            goto write_lob_cleanup;
+        }
 
-    /* the OCI docs say this "creates a user sesion and begins a 
-       user session for a given server */
-    oci_status = OCISessionBegin(connection->svc,
-                                 connection->err,
-                                 connection->auth,
-                                 OCI_CRED_RDBMS, OCI_DEFAULT);
-    if (oci_error_p(lexpos(), dbh, "OCISessionBegin", 0, oci_status))
-        return NS_ERROR;
+        if (Tcl_GetIntFromObj(interp, objv[4], &read_offset) != TCL_OK
+            || Tcl_GetIntFromObj(interp, objv[5], &read_length) != TCL_OK) 
+            goto write_lob_cleanup;
 
-    /* associate the particular authentications with a particular context */
-    oci_status = OCIAttrSet(connection->svc,
-                            OCI_HTYPE_SVCCTX,
-                            connection->auth,
-                            0, OCI_ATTR_SESSION, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
-        return NS_ERROR;
+        if (read_offset < 0 || read_length < 0) {
+            Tcl_AppendResult(interp, "offset and length can't be negative",
+                             NULL);
+            goto write_lob_cleanup;
+        }
+    } else {
+        if (objc != 5) {
+            Tcl_AppendResult(interp,
+                             "wrong number of args: should be '",
+                             Tcl_GetString(objv[0]), 
+                             subcommand, " dbId query filename",
+                             NULL);
+            goto write_lob_cleanup;
+        }
+    }
 
-    ns_ora_log(lexpos(), "(dbh %p); return NS_OK;", dbh);
+    if (!strncmp(subcommand, "blob", 4) || !strcmp(subcommand, "write_blob"))
+        blob_p = NS_TRUE;
 
-    dbh->connected = NS_TRUE;
+    query = Tcl_GetString(objv[argi]);
 
-    return NS_OK;
-}
-/*}}}*/
+    if (cache_key != NULL
+        && blob_cache_get(cache_key, &spool_fd, &loblen) == NS_OK) {
+        cached_p = NS_TRUE;
+        goto have_length;
+    }
 
-/*{{{ Ns_OracleCloseDb */
-/*----------------------------------------------------------------------
- * Ns_OracleCloseDb --
- *
- *      Closes a database connection and clean up handle.
- *
- *      Implements [ns_db close] 
- *
- *----------------------------------------------------------------------
- */
-static int 
-Ns_OracleCloseDb (Ns_DbHandle *dbh) 
-{
-    oci_status_t oci_status;
-    ora_connection_t *connection;
+    if (!allow_sql_p(dbh, query, NS_TRUE)) {
+        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
+                         "by the Oracle driver", NULL);
+        goto write_lob_cleanup;
+    }
 
-    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+    if (dbh->verbose)
+        Ns_Log(Notice, "SQL():  %s", query);
 
-    if (!dbh) {
-        error(lexpos(), "invalid args.");
-        return NS_ERROR;
+    oci_status = OCIDescriptorAlloc(connection->env,
+                                    (dvoid **) & lob,
+                                    OCI_DTYPE_LOB, 0, 0);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIDescriptorAlloc",
+                    query, oci_status)) {
+        goto write_lob_cleanup;
     }
 
-    connection = dbh->connection;
-    if (!connection) {
-        error(lexpos(), "no connection.");
-        return NS_ERROR;
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
+        goto write_lob_cleanup;
     }
 
-    /* don't return on error; just clean up the best we can */
-    oci_status = OCIServerDetach(connection->srv,
-                                 connection->err, OCI_DEFAULT);
-    oci_error_p(lexpos(), dbh, "OCIServerDetach", 0, oci_status);
-
-    oci_status = OCIHandleFree(connection->svc, OCI_HTYPE_SVCCTX);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->svc = 0;
 
-    oci_status = OCIHandleFree(connection->srv, OCI_HTYPE_SERVER);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->srv = 0;
+    oci_status = OCIStmtPrepare(connection->stmt,
+                                connection->err,
+                                query, strlen(query),
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
+        goto write_lob_cleanup;
+    }
 
-    oci_status = OCIHandleFree(connection->err, OCI_HTYPE_ERROR);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->err = 0;
+    oci_status = OCIDefineByPos(connection->stmt,
+                                &def,
+                                connection->err,
+                                1,
+                                &lob,
+                                -1,
+                                (blob_p) ? SQLT_BLOB : SQLT_CLOB,
+                                0, 0, 0, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare",
+                    query, oci_status)) {
+        goto write_lob_cleanup;
+    }
 
-    oci_status = OCIHandleFree(connection->auth, OCI_HTYPE_SESSION);
-    oci_error_p (lexpos (), dbh, "OCIHandleFree", 0, oci_status);
-    connection->auth = 0;
 
-    oci_status = OCIHandleFree(connection->env, OCI_HTYPE_ENV);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->env = 0;
-
-    Ns_Free(connection);
-    dbh->connection = NULL;
-    dbh->connected = NS_FALSE;
+    oci_status = OCIStmtExecute(connection->svc,
+                                connection->stmt,
+                                connection->err,
+                                1, 0, 0, 0, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute",
+                    query, oci_status)) {
+        goto write_lob_cleanup;
+    }
 
-    return NS_OK;
-}
-/*}}}*/
+    oci_status = OCILobGetLength(connection->svc, connection->err, 
+                                 lob, &oci_length);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCILobGetLength",
+                    query, oci_status)) {
+        goto write_lob_cleanup;
+    }
+    loblen = oci_length;
 
-/*{{{ Ns_OracleSelect */
-/*----------------------------------------------------------------------
- * Ns_OracleSelect --
- *
- *      Execute a select statement and bindrow it.
- *
- *      Implements [ns_db select] 
- *
- *----------------------------------------------------------------------
- */
-static Ns_Set *
-Ns_OracleSelect (Ns_DbHandle *dbh, char *sql)
-{
-    int ns_status;
+    if (read_p) {
+        if ((off_t) read_offset < loblen) {
+            amount = loblen - read_offset;
+            if ((off_t) read_length < amount)
+                amount = read_length;
+            if (read_lob_dstring(interp, dbh, lob, read_offset + 1, 
+                                 (ub4) amount, &spool) != TCL_OK)
+                goto write_lob_cleanup;
+        }
+        Tcl_SetObjResult(interp, 
+                         Tcl_NewByteArrayObj((unsigned char *) spool.string,
+                                             spool.length));
+        write_lob_status = STREAM_WRITE_LOB_OK;
+        result = TCL_OK;
+        goto write_lob_cleanup;
+    }
 
-    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
+  have_length:
+    /* total is what the client is told the whole LOB is, and
+       offset/amount the part of it sent.  They're off_t because a
+       cached copy can be bigger than OCILobGetLength can count */
+    total = loblen;
+    if (to_conn_p && nbytes >= 0 && (off_t) nbytes < total)
+        total = nbytes;
+    amount = total;
+
+    if (range_p) {
+        http_status = lob_range(conn, total, &offset, &amount);
+    } else if (type != NULL) {
+        http_status = 200;
+    }
+
+    /* only whole LOBs streamed to the client are compressed */
+    if (gzip_p) {
+        gzip_p = (http_status == 200 && !spool_p && cache_key == NULL 
+                  && amount > 0
+                  && amount >= (off_t) gzip_min_size && gzip_type_p(type));
+        if (gzip_p) {
+            Ns_ConnSetHeaders(conn, "Vary", "Accept-Encoding");
+            gzip_p = accepts_gzip_p(conn);
+        }
+        if (gzip_p && gzip_sink_init(&sink) == NS_OK) {
+            sink.path = "to connection";
+            sink.conn = conn;
+        } else {
+            gzip_p = NS_FALSE;
+        }
+    }
 
-    if (!dbh || !sql) {
-        error(lexpos(), "invalid args.");
-        return 0;
+    if (http_status == 416) {
+        write_lob_status = STREAM_WRITE_LOB_OK;
+        result = lob_headers(interp, conn, type, http_status, 
+                             offset, amount, total, NS_FALSE);
+        goto write_lob_cleanup;
     }
 
-    ns_status = Ns_OracleExec(dbh, sql);
-    if (ns_status != NS_ROWS) {
-        Ns_OracleFlush(dbh);
-        return 0;
+    if (cache_key != NULL && !cached_p 
+        && loblen <= (off_t) blob_cache_size) {
+        /* on a database error the message is already in interp */
+        write_lob_status = blob_cache_put(interp, dbh, lob, cache_key, 
+                                          &spool_fd);
+        if (write_lob_status != STREAM_WRITE_LOB_OK) {
+            goto write_lob_cleanup;
+        }
+        cached_p = (spool_fd >= 0);
     }
 
-    return Ns_OracleBindRow(dbh);
-}
-/*}}}*/
+    /* the cached copy goes out like a spool file; past here the LOB
+       came from the database, and its offset and amount fit a ub4 */
+    if (cached_p) {
+        lseek(spool_fd, offset - 1, SEEK_SET);
+        spool_length = amount;
+        spooled = 1;
+        write_lob_status = STREAM_WRITE_LOB_OK;
+        result = TCL_OK;
+        goto write_lob_cleanup;
+    }
 
-/*{{{ Ns_OracleDML */
-/*----------------------------------------------------------------------
- * Ns_OracleDML --
- *
- *      Execute a DML statement.
- *
- *      Implements [ns_db dml] 
- *
- *----------------------------------------------------------------------
- */
-static int 
-Ns_OracleDML (Ns_DbHandle *dbh, char *sql) 
-{
-    int ns_status;
+    if (!to_conn_p && !chan_p) {
+        filename = Tcl_GetString(objv[4]);
+    }
 
-    ns_status = Ns_OracleExec(dbh, sql);
-    if (ns_status != NS_DML) {
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+    if (spool_p) {
+        write_lob_status = spool_lob(interp, dbh, lob, (ub4) offset, 
+                                     (ub4) amount, &spool, &spool_fd, 
+                                     &spool_length, &spooled);
+        if (write_lob_status == STREAM_WRITE_LOB_ERROR) {
+            tcl_error_p(lexpos(), interp, dbh, "spool_lob",
+                        query, oci_status);
+            goto write_lob_cleanup;
+        }
     }
 
-    return NS_OK;
-}
-/*}}}*/
+    if (!spooled) {
+        if (http_status != 0 
+            && lob_headers(interp, conn, type, http_status, 
+                           offset, amount, total, gzip_p) != TCL_OK) {
+            write_lob_status = STREAM_WRITE_LOB_OK;
+            goto write_lob_cleanup;
+        }
 
-/*{{{ Ns_OracleExec */
-/*----------------------------------------------------------------------
- * Ns_OracleExec --
- *
- *      Execute a query regardless of type.
- *
- *      Implements [ns_db exec] 
- *
- *----------------------------------------------------------------------
- */
-static int 
-Ns_OracleExec (Ns_DbHandle *dbh, char *sql) 
-{
-    oci_status_t oci_status;
-    ora_connection_t *connection;
-    ub4 iters;
-    ub2 type;
+        /* to stream_write_lob an amount of 0 is the whole lob */
+        if (to_conn_p && amount == 0) {
+            write_lob_status = STREAM_WRITE_LOB_OK;
+        } else if (chan_p || gzip_p) {
+            write_lob_status = stream_lob_to_sink(interp, dbh, lob, 
+                                                  (ub4) offset,
+                                                  (ub4) amount, &sink,
+                                                  connection->svc, 
+                                                  connection->err);
+            if (gzip_p && write_lob_status == STREAM_WRITE_LOB_OK) {
+                errno = 0;
+                if (gzip_sink_write(&sink, NULL, 0, Z_FINISH) < 0) {
+                    write_lob_status = stream_write_failed(interp, sink.path,
+                                                           -1, 0, errno);
+                }
+            }
+        } else {
+            write_lob_status = stream_write_lob(interp, dbh, 0, lob, 
+                                                (ub4) offset, (ub4) amount,
+                                                filename,
+                                                to_conn_p, connection->svc,
+                                                connection->err);
+        }
+        if (write_lob_status == STREAM_WRITE_LOB_ERROR) {
+            tcl_error_p(lexpos(), interp, dbh, "stream_write_lob",
+                        query, oci_status);
+            goto write_lob_cleanup;
+        }
+    }
 
-    ns_ora_log(lexpos(), "generate simple message");
-    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
+    /* if we survived to here, we're golden */
+    result = TCL_OK;
 
-    if (!dbh || !sql) {
-        error(lexpos(), "invalid args.");
-        return NS_ERROR;
-    }
+  write_lob_cleanup:
 
-    connection = dbh->connection;
-    if (connection == 0) {
-        error(lexpos(), "no connection.");
-        return NS_ERROR;
+    if (lob != NULL) {
+        oci_status = OCIDescriptorFree(lob, OCI_DTYPE_LOB);
+        oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0, oci_status);
     }
 
-    /* nuke any previously executing stmt */
     Ns_OracleFlush(dbh);
 
-    /* handle_builtins will flush the handles on a ERROR exit */
+    /* stream_write_lob ends a LOB read it cuts short with
+     * lob_read_abort; only if that didn't work is a new session needed
+     */
+    lob_reopen(dbh);
 
-    switch (handle_builtins(dbh, sql)) {
-    case NS_DML:
-        /* handled */
-        return NS_DML;
+    if (result == TCL_OK && spooled && http_status != 0) {
+        result = lob_headers(interp, conn, type, http_status,
+                             offset, amount, total, NS_FALSE);
+    }
 
-    case NS_ERROR:
-        return NS_ERROR;
+    if (result == TCL_OK && spooled) {
+        result = spool_send(interp, conn, &spool, spool_fd, spool_length);
+    }
 
-    case NS_OK:
-        break;
+    if (spool_fd >= 0)
+        close(spool_fd);
+    Ns_DStringFree(&spool);
 
-    default:
-        error(lexpos(), "internal error");
-        return NS_ERROR;
+    if (sink.zs != NULL)
+        gzip_sink_end(&sink);
+
+    return result;
+}
+/*}}}*/
+
+/*{{{ OracleGetCols
+ *----------------------------------------------------------------------
+ * OracleGetCols --
+ *
+ *      Implements [ns_ora getcols] command.
+ *
+ *      ns_ora getcols dbhandle sql
+ *
+ * Results:
+ *
+ *      Tcl list of columns in select-list.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleGetCols (Tcl_Interp *interp, int objc, 
+               Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection;
+    oci_status_t       oci_status;
+    char              *query;
+    int                i;
+
+    if (objc < 4) {
+        Tcl_AppendResult(interp, "wrong number of args: should be `",
+                         Tcl_GetString(objv[0]), " getcols dbId sql'", NULL);
+        return TCL_ERROR;
     }
 
-    /* allocate a new handle and stuff in connection->stmt */
+    query = Tcl_GetString(objv[3]);
+
+    connection = dbh->connection;
     oci_status = OCIHandleAlloc(connection->env,
                                 (oci_handle_t **) & connection->stmt,
                                 OCI_HTYPE_STMT, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", sql, oci_status)) {
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
         Ns_OracleFlush(dbh);
-        return NS_ERROR;
+        return TCL_ERROR;
     }
 
-    /* purely a local call to "prepare statement for execution" */
     oci_status = OCIStmtPrepare(connection->stmt,
                                 connection->err,
-                                sql, strlen(sql),
+                                query, strlen(query),
                                 OCI_NTV_SYNTAX, OCI_DEFAULT);
-    if (oci_error_p(lexpos(), dbh, "OCIStmtPrepare", sql, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
-    }
-
-    /* check what type of statment it is, this will affect how
-       many times we expect to execute it */
-    oci_status = OCIAttrGet(connection->stmt,
-                            OCI_HTYPE_STMT,
-                            (oci_attribute_t *) & type,
-                            NULL, OCI_ATTR_STMT_TYPE, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", sql, oci_status)) {
-        /* got error asking Oracle for the statement type */
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
         Ns_OracleFlush(dbh);
-        return NS_ERROR;
-    }
-
-    if (type == OCI_STMT_SELECT) {
-        iters = 0;
-        if (prefetch_rows > 0) {
-            /* Set prefetch rows attr for selects. */
-            oci_status = OCIAttrSet(connection->stmt,
-                                    OCI_HTYPE_STMT,
-                                    (dvoid *) &prefetch_rows,
-                                    0,
-                                    OCI_ATTR_PREFETCH_ROWS,
-                                    connection->err);
-            if (oci_error_p(lexpos(), dbh, "OCIAttrSet", sql, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            }
-        }
-        if (prefetch_memory > 0) {
-            /* Set prefetch memory attr for selects. */
-            oci_status = OCIAttrSet(connection->stmt,
-                                    OCI_HTYPE_STMT,
-                                    (dvoid *) &prefetch_memory,
-                                    0,
-                                    OCI_ATTR_PREFETCH_MEMORY,
-                                    connection->err);
-            if (oci_error_p(lexpos(), dbh, "OCIAttrSet", sql, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            }
-        }
-    } else {
-        iters = 1;
+        return TCL_ERROR;
     }
 
-    /* actually go to server and execute statement */
+    /* Execute Query in DESCRIBE_ONLY mode. */
     oci_status = OCIStmtExecute(connection->svc,
                                 connection->stmt,
                                 connection->err,
-                                iters,
-                                0, NULL, NULL,
-                                (connection->mode == autocommit
-                                 ? OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT));
-    if (oci_status == OCI_ERROR) {
-        oci_status_t oci_status1;
-        sb4 errorcode;
+                                1, 0, 0, 0, OCI_DESCRIBE_ONLY);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute",
+                    query, oci_status)) {
+        return TCL_ERROR;
+    }
 
-        oci_status1 = OCIErrorGet(connection->err,
-                                  1,
-                                  NULL, &errorcode, 0, 0, OCI_HTYPE_ERROR);
+    /* Get total number of columns. */
+    oci_status = OCIAttrGet(connection->stmt,
+                            OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & connection->n_columns, 
+                            NULL, OCI_ATTR_PARAM_COUNT,
+                            connection->err);
 
-        if (oci_error_p(lexpos(), dbh, "OCIErrorGet", sql, oci_status1)) {
-            /* the error getter got an error; let's bail */
-            Ns_OracleFlush(dbh);
-            return NS_ERROR;
-        } else if (oci_error_p
-                   (lexpos(), dbh, "OCIStmtExecute", sql, oci_status)) {
-            /* this is where we end up for an ordinary error-producing SQL statement
-               we call oci_error_p above so that crud ends up in the log */
+    for (i = 0; i < connection->n_columns; i++) {
+        OCIParam *param;
+        char name[512];
+        char *name1 = 0;
+        ub2 coltype;
+        sb4 name1_size = 0;
+
+        oci_status = OCIParamGet(connection->stmt,
+                                 OCI_HTYPE_STMT,
+                                 connection->err,
+                                 (oci_param_t *) & param, i + 1);
+        if (oci_error_p(lexpos(), dbh, "OCIParamGet", 0, oci_status)) {
             Ns_OracleFlush(dbh);
-            return NS_ERROR;
+            return TCL_ERROR;
         }
-    } else
-        if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", sql, oci_status))
-    {
-        /* we got some weird error that wasn't OCI_ERROR; we hardly ever get here */
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+
+        oci_status = OCIAttrGet(param,
+                                OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) & name1,
+                                &name1_size,
+                                OCI_ATTR_NAME, connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return TCL_ERROR;
+        }
+
+        oci_status = OCIAttrGet(param,
+                                OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) &coltype,
+                                0,
+                                OCI_ATTR_DATA_TYPE, connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return TCL_ERROR;
+        }
+
+        /* Oracle gives us back a pointer to a string that is not null-terminated
+         * so we copy it into our local var and add a 0 at the end.
+         */
+        memcpy(name, name1, name1_size);
+        name[name1_size] = 0;
+        downcase(name);
+
+        Tcl_ListObjAppendElement(interp, 
+                Tcl_GetObjResult(interp), Tcl_NewIntObj(coltype));
+
+        Tcl_ListObjAppendElement(interp, 
+                Tcl_GetObjResult(interp), Tcl_NewStringObj(name, name1_size));
+
     }
 
-    ns_ora_log(lexpos(), "query type `%d'", type);
+    Ns_OracleFlush(dbh);
 
-    if (type == OCI_STMT_SELECT)
-        return NS_ROWS;
-    else
-        return NS_DML;
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleBindRow */
-/*----------------------------------------------------------------------
- * Ns_OracleBindRow --
+/*{{{ OracleResultRows
+ *----------------------------------------------------------------------
+ * OracleResultRows --
  *
- *      Return a list of column names in an Ns_Set.  This is used 
- *      later to fetch rows into.
+ *      Implements [ns_ora resultrows] command.
  *
- *      Implements [ns_db bindrow] 
+ *      ns_ora resultrows dbhandle sql
+ *
+ * Results:
+ *
+ *      ...
  *
  *----------------------------------------------------------------------
  */
-static Ns_Set *
-Ns_OracleBindRow (Ns_DbHandle *dbh) 
+int
+OracleResultRows (Tcl_Interp *interp, int objc, 
+                  Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
 {
-    oci_status_t oci_status;
-    ora_connection_t *connection;
-    Ns_Set *row = 0;
-    int i;
-
-    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+    ora_connection_t  *connection;
+    oci_status_t       oci_status;
+    ub4                count;
+    char               buf[1024];
 
-    if (!dbh) {
-        error(lexpos(), "invalid args.");
-        return 0;
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbId object");
+        return TCL_ERROR;
     }
 
     connection = dbh->connection;
-    if (connection == 0) {
-        error(lexpos(), "no connection.");
-        return 0;
-    }
-
     if (connection->stmt == 0) {
-        error(lexpos(), "no active query statement executing");
-        return 0;
-    }
-
-    if (connection->fetch_buffers != 0) {
-        error(lexpos(), "query already bound");
-        Ns_OracleFlush(dbh);
-        return 0;
+        Tcl_AppendResult(interp, "no active statement", NULL);
+        return TCL_ERROR;
     }
 
-    row = dbh->row;
-
-    /* get number of columns returned by query; sets connection->n_columns */
     oci_status = OCIAttrGet(connection->stmt,
                             OCI_HTYPE_STMT,
-                            (oci_attribute_t *) & connection->n_columns,
-                            NULL, OCI_ATTR_PARAM_COUNT, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
+                            (oci_attribute_t *) &count,
+                            NULL, OCI_ATTR_ROW_COUNT, connection->err);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIAttrGet", 0, oci_status)) {
         Ns_OracleFlush(dbh);
-        return 0;
+        return TCL_ERROR;
     }
 
-    ns_ora_log(lexpos(), "n_columns: %d", connection->n_columns);
+    snprintf(buf, 1024, "%ld", (long) count);
+    Tcl_AppendResult(interp, buf, NULL);
 
-    /* allocate N fetch buffers, this proc pulls N from connection->n_columns */
-    malloc_fetch_buffers(connection);
+    return TCL_OK;
+}
+/*}}}*/
 
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf;
-        OCIParam *param;
+/*{{{ OracleLoad
+ *----------------------------------------------------------------------
+ * OracleLoad --
+ *
+ *      Implements [ns_ora load] command.
+ *
+ *      ns_ora load dbhandle ?-file path? ?-delimiter char? table columns ?rows?
+ *
+ *      Loads rows into a table with the OCI direct path API, which
+ *      formats data blocks on the client and writes them above the
+ *      high water mark, skipping the SQL layer and the buffer cache.
+ *      The rows are either a list of lists, one element per column,
+ *      or come from a text file with one row per line and the fields
+ *      separated by the delimiter (a tab by default).  Empty fields
+ *      are loaded as NULL.
+ *
+ * Results:
+ *
+ *      A list of load statistics: rows, bytes and elapsed (seconds).
+ *
+ * Side effects:
+ *
+ *      The data is saved when the load finishes, regardless of any
+ *      "begin transaction"; on error the whole load is aborted.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleLoad (Tcl_Interp *interp, int objc, 
+            Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    ora_connection_t   *connection;
+    oci_status_t        oci_status;
+    OCIDirPathCtx      *dpctx = NULL;
+    OCIDirPathColArray *dpca = NULL;
+    OCIDirPathStream   *dpstr = NULL;
+    OCIParam           *collist = NULL;
+    OCIParam           *column = NULL;
+    Tcl_Obj           **columns, **rows = NULL, **values;
+    Tcl_Obj            *stats;
+    Ns_DString          name;
+    Ns_DString         *lines = NULL;
+    Ns_Time             start, end, diff;
+    FILE               *fp = NULL;
+    char               *path = NULL, *table, *dot;
+    char              **fields = NULL;
+    char                delimiter = '\t';
+    char                msg[100];
+    int                 n_columns, n_rows = 0, n_values;
+    int                 argi, i, j, eof_p = 0, line_number = 0;
+    int                 result = TCL_ERROR;
+    ub4                 array_rows = 0, row, rowoff, converted;
+    ub4                 data_size = DML_BUFFER_SIZE;
+    ub2                 ncols, data_type = SQLT_CHR;
+    Tcl_WideInt         total_rows = 0, total_bytes = 0;
 
-        /* 512 is large enough because Oracle sends back table_name.column_name and 
-           neither right now can be larger than 30 chars */
-        char name[512];
-        char *name1 = 0;
-        sb4 name1_size = 0;
+    connection = dbh->connection;
+    Ns_DStringInit(&name);
 
-        /* set current fetch buffer */
-        fetchbuf = &connection->fetch_buffers[i];
+    for (argi = 3; argi < objc; argi += 2) {
+        char *option = Tcl_GetString(objv[argi]);
 
-        oci_status = OCIParamGet(connection->stmt,
-                                 OCI_HTYPE_STMT,
-                                 connection->err,
-                                 (oci_param_t *) & param, i + 1);
-        if (oci_error_p(lexpos(), dbh, "OCIParamGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return 0;
+        if (option[0] != '-') {
+            break;
         }
-
-        oci_status = OCIAttrGet(param,
-                                OCI_DTYPE_PARAM,
-                                (oci_attribute_t *) & name1,
-                                &name1_size, OCI_ATTR_NAME,
-                                connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return 0;
+        if (argi + 1 >= objc) {
+            argi = objc;
+            break;
         }
+        if (!strcmp(option, "-file")) {
+            path = Tcl_GetString(objv[argi + 1]);
+        } else if (!strcmp(option, "-delimiter")) {
+            delimiter = Tcl_GetString(objv[argi + 1])[0];
+        } else {
+            Tcl_AppendResult(interp, "unknown option \"", option, 
+                    "\": should be -file or -delimiter", NULL);
+            return TCL_ERROR;
+        }
+    }
 
-        /* Oracle gives us back a pointer to a string that is not null-terminated
-           so we copy it into our local var and add a 0 at the end */
-        memcpy(name, name1, name1_size);
-        name[name1_size] = 0;
-        /* we downcase the column name for backward-compatibility with philg's
-           AOLserver Tcl scripts written for the case-sensitive Illustra
-           RDBMS.  philg was lucky in that he always used lowercase.  You might want
-           to change this to leave everything all-uppercase if you're a traditional
-           Oracle shop */
-        downcase(name);
+    if (objc - argi != (path == NULL ? 3 : 2)) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                "dbhandle ?-file path? ?-delimiter char? table columns ?rows?");
+        return TCL_ERROR;
+    }
 
-        ns_ora_log(lexpos(), "name %d `%s'", name1_size, name);
-        Ns_SetPut(row, name, 0);
+    if (Tcl_ListObjGetElements(interp, objv[argi + 1], &n_columns, &columns)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (n_columns == 0) {
+        Tcl_AppendResult(interp, "no columns to load", NULL);
+        return TCL_ERROR;
+    }
 
-        /* get the column type */
-        oci_status = OCIAttrGet(param,
-                                OCI_DTYPE_PARAM,
-                                (oci_attribute_t *) & fetchbuf->type,
-                                NULL, OCI_ATTR_DATA_TYPE, connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return 0;
+    if (path == NULL) {
+        if (Tcl_ListObjGetElements(interp, objv[argi + 2], &n_rows, &rows)
+                != TCL_OK) {
+            return TCL_ERROR;
+        }
+    } else {
+        fp = fopen(path, "r");
+        if (fp == NULL) {
+            Tcl_AppendResult(interp, "could not open file `", path,
+                    "' for reading: ", strerror(errno), NULL);
+            return TCL_ERROR;
         }
+    }
 
-        ns_ora_log(lexpos(), "column `%s' type `%d'", name, fetchbuf->type);
+    if (dbh->verbose)
+        Ns_Log(Notice, "ns_ora load: %s", Tcl_GetString(objv[argi]));
 
-        switch (fetchbuf->type) {
-            /* we handle LOBs in the loop below */
-        case OCI_TYPECODE_CLOB:
-        case OCI_TYPECODE_BLOB:
-            break;
+    Ns_GetTime(&start);
 
-            /* RDD is Oracle's happy fun name for ROWID (18 chars long
-               but if you ask Oracle the usual way, it will give you a
-               number that is too small) */
-        case SQLT_RDD:
-            fetchbuf->size = 18;
-            fetchbuf->buf_size = fetchbuf->size + 8;
-            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
-            break;
+    /* 
+     * Describe what we are loading: the table, then each column as
+     * character data which Oracle converts to the column's type.
+     */
+    oci_status = OCIHandleAlloc(connection->env, (oci_handle_t **) &dpctx,
+                                OCI_HTYPE_DIRPATH_CTX, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", 0, oci_status)) {
+        goto load_cleanup;
+    }
+
+    Ns_DStringAppend(&name, Tcl_GetString(objv[argi]));
+    upcase(name.string);
+    table = name.string;
+    if ((dot = strchr(table, '.')) != NULL) {
+        *dot = '\0';
+        oci_status = OCIAttrSet(dpctx, OCI_HTYPE_DIRPATH_CTX, 
+                                table, strlen(table),
+                                OCI_ATTR_SCHEMA_NAME, connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", 0, oci_status)) {
+            goto load_cleanup;
+        }
+        table = dot + 1;
+    }
 
-        case SQLT_NUM:
-            /* OCI reports that all NUMBER values has a size of 22, the size
-               of its internal storage format for numbers. We are fetching
-               all values out as strings, so we need more space. Empirically,
-               it seems to return 41 characters when it does the NUMBER to STRING
-               conversion. */
-            fetchbuf->size = 81;
-            fetchbuf->buf_size = fetchbuf->size + 8;
-            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
-            break;
+    oci_status = OCIAttrSet(dpctx, OCI_HTYPE_DIRPATH_CTX, 
+                            table, strlen(table),
+                            OCI_ATTR_NAME, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", 0, oci_status)) {
+        goto load_cleanup;
+    }
 
-            /* this might work if the rest of our LONG stuff worked */
-        case SQLT_LNG:
-            fetchbuf->buf_size = lob_buffer_size;
-            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
-            break;
+    ncols = n_columns;
+    oci_status = OCIAttrSet(dpctx, OCI_HTYPE_DIRPATH_CTX, &ncols, 0,
+                            OCI_ATTR_NUM_COLS, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", 0, oci_status)) {
+        goto load_cleanup;
+    }
 
-        case SQLT_DAT:
-            /* Wayport mod to allow NLS_DATE_FORMAT = YYYY-MM-DD HH24:MI:SS */
-            fetchbuf->size = 20;
-            fetchbuf->buf_size = fetchbuf->size + 8;
-            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
-            break;
+    oci_status = OCIAttrGet(dpctx, OCI_HTYPE_DIRPATH_CTX, &collist, 0,
+                            OCI_ATTR_LIST_COLUMNS, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, oci_status)) {
+        goto load_cleanup;
+    }
 
-        default:
-            /* get the size */
-            oci_status = OCIAttrGet(param,
-                                    OCI_DTYPE_PARAM,
-                                    (oci_attribute_t *) & fetchbuf->size,
-                                    NULL,
+    for (i = 0; i < n_columns; i++) {
+        oci_status = OCIParamGet(collist, OCI_DTYPE_PARAM, connection->err,
+                                 (dvoid **) &column, i + 1);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIParamGet", 0, oci_status)) {
+            goto load_cleanup;
+        }
+
+        Ns_DStringTrunc(&name, 0);
+        Ns_DStringAppend(&name, Tcl_GetString(columns[i]));
+        upcase(name.string);
+
+        oci_status = OCIAttrSet(column, OCI_DTYPE_PARAM, 
+                                name.string, name.length,
+                                OCI_ATTR_NAME, connection->err);
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIAttrSet(column, OCI_DTYPE_PARAM, &data_type, 0,
+                                    OCI_ATTR_DATA_TYPE, connection->err);
+        }
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIAttrSet(column, OCI_DTYPE_PARAM, &data_size, 0,
                                     OCI_ATTR_DATA_SIZE, connection->err);
-            if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
-            }
+        }
+        OCIDescriptorFree(column, OCI_DTYPE_PARAM);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", 0, oci_status)) {
+            goto load_cleanup;
+        }
+    }
 
-            ns_ora_log(lexpos(), "column `%s' size `%d'", name, fetchbuf->size);
+    oci_status = OCIDirPathPrepare(dpctx, connection->svc, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIDirPathPrepare", 0, 
+                    oci_status)) {
+        goto load_cleanup;
+    }
 
-            /* this is the important part, we allocate buf to be 8 bytes
-               more than Oracle says are necessary (for null
-               termination) */
-            fetchbuf->buf_size = fetchbuf->size + 8;
+    oci_status = OCIHandleAlloc(dpctx, (oci_handle_t **) &dpca,
+                                OCI_HTYPE_DIRPATH_COLUMN_ARRAY, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", 0, oci_status)) {
+        goto load_cleanup;
+    }
 
-            if (fetchbuf->type == SQLT_BIN) {
-                fetchbuf->buf_size = fetchbuf->size * 2 + 8;
+    oci_status = OCIHandleAlloc(dpctx, (oci_handle_t **) &dpstr,
+                                OCI_HTYPE_DIRPATH_STREAM, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", 0, oci_status)) {
+        goto load_cleanup;
+    }
+
+    oci_status = OCIAttrGet(dpca, OCI_HTYPE_DIRPATH_COLUMN_ARRAY, 
+                            &array_rows, 0, 
+                            OCI_ATTR_NUM_ROWS, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, oci_status)) {
+        goto load_cleanup;
+    }
+
+    ns_ora_log(lexpos(), "ns_ora load: %d rows per column array", array_rows);
+
+    if (fp != NULL) {
+        /* The column array points into these until it is converted. */
+        lines = Ns_Malloc(array_rows * sizeof *lines);
+        for (row = 0; row < array_rows; row++) {
+            Ns_DStringInit(&lines[row]);
+        }
+        fields = Ns_Malloc(n_columns * sizeof *fields);
+    }
+
+    for (i = 0; !eof_p; ) {
+
+        /* Fill the column array... */
+        for (row = 0; row < array_rows; row++) {
+
+            if (fp != NULL) {
+                if (read_line(fp, &lines[row]) != NS_OK) {
+                    eof_p = 1;
+                    break;
+                }
+                line_number++;
+                n_values = split_line(lines[row].string, delimiter, 
+                                      fields, n_columns);
             } else {
-                fetchbuf->buf_size = fetchbuf->size + 8;
+                if (i >= n_rows) {
+                    eof_p = 1;
+                    break;
+                }
+                if (Tcl_ListObjGetElements(interp, rows[i], &n_values, &values)
+                        != TCL_OK) {
+                    goto load_abort;
+                }
+                line_number = ++i;
             }
 
-            fetchbuf->buf_size *= char_expansion;
-            fetchbuf->buf = Ns_Malloc (fetchbuf->buf_size);
+            if (n_values != n_columns) {
+                snprintf(msg, sizeof msg, "row %d has %d values, expected %d",
+                         line_number, n_values, n_columns);
+                Tcl_AppendResult(interp, msg, NULL);
+                goto load_abort;
+            }
+
+            for (j = 0; j < n_columns; j++) {
+                char *value;
+                int   length;
+
+                if (fp != NULL) {
+                    value = fields[j];
+                    length = strlen(value);
+                } else {
+                    value = Tcl_GetStringFromObj(values[j], &length);
+                }
+
+                oci_status = OCIDirPathColArrayEntrySet(dpca, connection->err,
+                        row, (ub2) j, (ub1 *) value, (ub4) length,
+                        length == 0 ? OCI_DIRPATH_COL_NULL 
+                                    : OCI_DIRPATH_COL_COMPLETE);
+                if (tcl_error_p(lexpos(), interp, dbh, 
+                                "OCIDirPathColArrayEntrySet", 0, oci_status)) {
+                    goto load_abort;
+                }
+                total_bytes += length;
+            }
+        }
 
+        if (row == 0) {
             break;
         }
+
+        /* ...then convert it into as many streams as it takes. */
+        for (rowoff = 0; ; ) {
+            sword convert_status;
+
+            convert_status = OCIDirPathColArrayToStream(dpca, dpctx, dpstr,
+                    connection->err, row, rowoff);
+            if (convert_status != OCI_SUCCESS 
+                && convert_status != OCI_CONTINUE) {
+                tcl_error_p(lexpos(), interp, dbh, 
+                            "OCIDirPathColArrayToStream", 0, convert_status);
+                goto load_abort;
+            }
+
+            oci_status = OCIDirPathLoadStream(dpctx, dpstr, connection->err);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIDirPathLoadStream", 
+                            0, oci_status)) {
+                goto load_abort;
+            }
+
+            OCIDirPathStreamReset(dpstr, connection->err);
+
+            if (convert_status == OCI_SUCCESS) {
+                break;
+            }
+
+            oci_status = OCIAttrGet(dpca, OCI_HTYPE_DIRPATH_COLUMN_ARRAY,
+                                    &converted, 0, OCI_ATTR_ROW_COUNT,
+                                    connection->err);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, 
+                            oci_status)) {
+                goto load_abort;
+            }
+            rowoff += converted;
+        }
+
+        OCIDirPathColArrayReset(dpca, connection->err);
+        total_rows += row;
     }
 
-    /* loop over the columns again; this could now be in the loop above
-       but we originally did things this way to permit resizing of
-       buffers
+    oci_status = OCIDirPathFinish(dpctx, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIDirPathFinish", 0, 
+                    oci_status)) {
+        goto load_cleanup;
+    }
 
-       Now we're telling Oracle to associate the buffers we just
-       allocated with their respective columns */
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf;
+    Ns_GetTime(&end);
+    Ns_DiffTime(&end, &start, &diff);
 
-        fetchbuf = &connection->fetch_buffers[i];
+    stats = Tcl_NewListObj(0, NULL);
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewStringObj("rows", -1));
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewWideIntObj(total_rows));
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewStringObj("bytes", -1));
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewWideIntObj(total_bytes));
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewStringObj("elapsed", -1));
+    Tcl_ListObjAppendElement(interp, stats, 
+            Tcl_NewDoubleObj(diff.sec + diff.usec / 1000000.0));
+    Tcl_SetObjResult(interp, stats);
 
-        switch (fetchbuf->type) {
-        case OCI_TYPECODE_CLOB:
-        case OCI_TYPECODE_BLOB:
-            /* we allocate descriptors for CLOBs; these are essentially
-               pointers.  We will not allocate any buffers for them
-               until we're actually fetching data from individual
-               rows. */
-            oci_status = OCIDescriptorAlloc(connection->env,
-                                            (oci_descriptor_t *) &
-                                            fetchbuf->lob, OCI_DTYPE_LOB,
-                                            0, 0);
-            if (oci_error_p
-                (lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
+    if (dbh->verbose)
+        Ns_Log(Notice, "ns_ora load: %" TCL_LL_MODIFIER "d rows, %"
+               TCL_LL_MODIFIER "d bytes in %ld.%06ld seconds",
+               total_rows, total_bytes, diff.sec, diff.usec);
+
+    result = TCL_OK;
+    goto load_cleanup;
+
+  load_abort:
+
+    OCIDirPathAbort(dpctx, connection->err);
+
+  load_cleanup:
+
+    if (dpstr != NULL)
+        OCIHandleFree(dpstr, OCI_HTYPE_DIRPATH_STREAM);
+    if (dpca != NULL)
+        OCIHandleFree(dpca, OCI_HTYPE_DIRPATH_COLUMN_ARRAY);
+    if (dpctx != NULL)
+        OCIHandleFree(dpctx, OCI_HTYPE_DIRPATH_CTX);
+
+    if (lines != NULL) {
+        for (row = 0; row < array_rows; row++) {
+            Ns_DStringFree(&lines[row]);
+        }
+        Ns_Free(lines);
+    }
+    Ns_Free(fields);
+    Ns_DStringFree(&name);
+
+    if (fp != NULL)
+        fclose(fp);
+
+    return result;
+}
+/*}}}*/
+
+/*{{{ OracleLoadFile
+ *----------------------------------------------------------------------
+ * OracleLoadFile --
+ *
+ *      Implements [ns_ora load_file] command.
+ *
+ *      ns_ora load_file dbhandle table file ?-format csv|tsv? 
+ *          ?-columns columns? ?-batch n? ?-badfile path?
+ *
+ *      Streams a CSV or TSV file into a table with conventional path
+ *      array inserts.  Fields are parsed in C straight into the array
+ *      bind buffers and each batch is one OCIStmtExecute.  Without
+ *      -columns the first line of the file names the columns.  Lines
+ *      that cannot be loaded (wrong number of fields, a field too long
+ *      for its column, or a row Oracle rejects) are copied to the bad
+ *      file, by default the file name with ".bad" appended.
+ *
+ * Results:
+ *
+ *      A list of load statistics: rows, rejected and elapsed (seconds).
+ *
+ * Side effects:
+ *
+ *      In autocommit mode each batch is committed as it completes.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleLoadFile (Tcl_Interp *interp, int objc, 
+                Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    ora_connection_t   *connection;
+    oci_status_t        oci_status;
+    OCIError           *row_err = NULL;
+    OCIParam           *param;
+    load_column_t      *columns = NULL;
+    Tcl_Obj           **column_names = NULL, *stats;
+    Ns_DString          sql, bad_path, header;
+    Ns_DString         *records = NULL;
+    Ns_Time             start, end, diff;
+    FILE               *fp = NULL, *bad_fp = NULL;
+    char               *table, *path, *format = "csv";
+    char              **fields = NULL;
+    char                delimiter, buf[100];
+    int                 csv_p, n_columns = 0, batch = LOAD_BATCH_SIZE;
+    int                *line_numbers = NULL;
+    int                 i, j, n, n_fields, line_number = 0, eof_p = 0;
+    int                 result = TCL_ERROR;
+    ub4                 n_errors;
+    Tcl_WideInt         total_rows = 0, total_rejected = 0;
+
+    if (objc < 5 || objc % 2 == 0) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle table file "
+                "?-format csv|tsv? ?-columns columns? ?-batch n? "
+                "?-badfile path?");
+        return TCL_ERROR;
+    }
+
+    connection = dbh->connection;
+    table = Tcl_GetString(objv[3]);
+    path = Tcl_GetString(objv[4]);
+
+    Ns_DStringInit(&sql);
+    Ns_DStringInit(&bad_path);
+    Ns_DStringInit(&header);
+    Ns_DStringVarAppend(&bad_path, path, ".bad", NULL);
+
+    for (i = 5; i < objc; i += 2) {
+        char *option = Tcl_GetString(objv[i]);
+
+        if (!strcmp(option, "-format")) {
+            format = Tcl_GetString(objv[i + 1]);
+        } else if (!strcmp(option, "-columns")) {
+            if (Tcl_ListObjGetElements(interp, objv[i + 1], &n_columns,
+                                       &column_names) != TCL_OK) {
+                goto load_file_cleanup;
+            }
+        } else if (!strcmp(option, "-batch")) {
+            if (Tcl_GetIntFromObj(interp, objv[i + 1], &batch) != TCL_OK) {
+                goto load_file_cleanup;
+            }
+            if (batch < 1) {
+                Tcl_AppendResult(interp, "batch size must be positive", NULL);
+                goto load_file_cleanup;
+            }
+        } else if (!strcmp(option, "-badfile")) {
+            Ns_DStringTrunc(&bad_path, 0);
+            Ns_DStringAppend(&bad_path, Tcl_GetString(objv[i + 1]));
+        } else {
+            Tcl_AppendResult(interp, "unknown option \"", option, 
+                    "\": should be -format, -columns, -batch or -badfile",
+                    NULL);
+            goto load_file_cleanup;
+        }
+    }
+
+    if (!strcmp(format, "csv")) {
+        csv_p = 1;
+        delimiter = ',';
+    } else if (!strcmp(format, "tsv")) {
+        csv_p = 0;
+        delimiter = '\t';
+    } else {
+        Tcl_AppendResult(interp, "unknown format \"", format,
+                "\": should be csv or tsv", NULL);
+        goto load_file_cleanup;
+    }
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        Tcl_AppendResult(interp, "could not open file `", path,
+                "' for reading: ", strerror(errno), NULL);
+        goto load_file_cleanup;
+    }
+
+    Ns_GetTime(&start);
+
+    /* Column names come from -columns or the header line. */
+    if (column_names == NULL) {
+        if (read_record(fp, &header, csv_p, &line_number) != NS_OK) {
+            Tcl_AppendResult(interp, "file `", path, "' is empty", NULL);
+            goto load_file_cleanup;
+        }
+        /* an upper bound; a quoted name may hide a delimiter */
+        n_columns = 1;
+        for (i = 0; i < header.length; i++) {
+            n_columns += (header.string[i] == delimiter);
+        }
+    }
+
+    if (n_columns == 0) {
+        Tcl_AppendResult(interp, "no columns to load", NULL);
+        goto load_file_cleanup;
+    }
+
+    columns = Ns_Malloc(n_columns * sizeof *columns);
+    memset(columns, 0, n_columns * sizeof *columns);
+    fields = Ns_Malloc(n_columns * sizeof *fields);
+
+    if (column_names == NULL) {
+        n_columns = split_fields(header.string, delimiter, csv_p, 
+                                 fields, n_columns);
+        for (j = 0; j < n_columns; j++) {
+            columns[j].name = fields[j];
+        }
+    } else {
+        for (j = 0; j < n_columns; j++) {
+            columns[j].name = Tcl_GetString(column_names[j]);
+        }
+    }
+
+    /* the names go into the SQL as they are */
+    for (j = 0; j < n_columns; j++) {
+        if (!sql_identifier_p(columns[j].name)) {
+            Tcl_AppendResult(interp, "invalid column name \"", 
+                    columns[j].name, "\"", NULL);
+            if (column_names == NULL) {
+                Tcl_AppendResult(interp, " in the header of `", path, "'",
+                                 NULL);
+            }
+            goto load_file_cleanup;
+        }
+    }
+
+    /* 
+     * Describe the columns to size the bind buffers: character
+     * columns get their declared width, everything else enough for
+     * its text form.
+     */
+    Ns_DStringAppend(&sql, "select ");
+    for (j = 0; j < n_columns; j++) {
+        Ns_DStringVarAppend(&sql, j ? ", " : "", columns[j].name, NULL);
+    }
+    Ns_DStringVarAppend(&sql, " from ", table, " where 1 = 0", NULL);
+
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) &connection->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", sql.string, 
+                    oci_status)) {
+        goto load_file_cleanup;
+    }
+
+    oci_status = OCIStmtPrepare(connection->stmt, connection->err,
+                                sql.string, sql.length,
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare", sql.string, 
+                    oci_status)) {
+        goto load_file_cleanup;
+    }
+
+    oci_status = OCIStmtExecute(connection->svc, connection->stmt,
+                                connection->err, 0, 0, NULL, NULL,
+                                OCI_DESCRIBE_ONLY);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", sql.string, 
+                    oci_status)) {
+        goto load_file_cleanup;
+    }
+
+    for (j = 0; j < n_columns; j++) {
+        ub2 data_type, data_size;
+
+        oci_status = OCIParamGet(connection->stmt, OCI_HTYPE_STMT,
+                                 connection->err, (dvoid **) &param, j + 1);
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM, &data_type, 
+                                    NULL, OCI_ATTR_DATA_TYPE, 
+                                    connection->err);
+        }
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM, &data_size, 
+                                    NULL, OCI_ATTR_DATA_SIZE, 
+                                    connection->err);
+        }
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", sql.string, 
+                        oci_status)) {
+            goto load_file_cleanup;
+        }
+
+        switch (data_type) {
+            case SQLT_CHR:
+            case SQLT_AFC:
+                columns[j].width = data_size * char_expansion;
+                break;
+
+            case SQLT_CLOB:
+            case SQLT_BLOB:
+            case SQLT_LNG:
+                columns[j].width = DML_BUFFER_SIZE;
+                break;
+
+            default:
+                columns[j].width = LOAD_FIELD_SIZE;
+                break;
+        }
+
+        if (columns[j].width < LOAD_FIELD_SIZE) {
+            columns[j].width = LOAD_FIELD_SIZE;
+        }
+
+        columns[j].values = Ns_Malloc(batch * columns[j].width);
+        columns[j].indicators = Ns_Malloc(batch * sizeof(sb2));
+        columns[j].lengths = Ns_Malloc(batch * sizeof(ub2));
+    }
+
+    /* Now the insert itself, bound to the column arrays. */
+    Ns_DStringTrunc(&sql, 0);
+    Ns_DStringVarAppend(&sql, "insert into ", table, " (", NULL);
+    for (j = 0; j < n_columns; j++) {
+        Ns_DStringVarAppend(&sql, j ? ", " : "", columns[j].name, NULL);
+    }
+    Ns_DStringAppend(&sql, ") values (");
+    for (j = 0; j < n_columns; j++) {
+        snprintf(buf, sizeof buf, "%s:%d", j ? ", " : "", j + 1);
+        Ns_DStringAppend(&sql, buf);
+    }
+    Ns_DStringAppend(&sql, ")");
+
+    if (dbh->verbose)
+        Ns_Log(Notice, "ns_ora load_file: %s", sql.string);
+
+    oci_status = OCIStmtPrepare(connection->stmt, connection->err,
+                                sql.string, sql.length,
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare", sql.string, 
+                    oci_status)) {
+        goto load_file_cleanup;
+    }
+
+    for (j = 0; j < n_columns; j++) {
+        oci_status = OCIBindByPos(connection->stmt, &columns[j].bind,
+                                  connection->err, j + 1,
+                                  columns[j].values, columns[j].width,
+                                  SQLT_CHR, columns[j].indicators,
+                                  columns[j].lengths, NULL,
+                                  0, NULL, OCI_DEFAULT);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByPos", sql.string, 
+                        oci_status)) {
+            goto load_file_cleanup;
+        }
+    }
+
+    oci_status = OCIHandleAlloc(connection->env, (oci_handle_t **) &row_err,
+                                OCI_HTYPE_ERROR, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", sql.string, 
+                    oci_status)) {
+        goto load_file_cleanup;
+    }
+
+    /* The raw records are kept until their batch is done, for the bad file. */
+    records = Ns_Malloc(batch * sizeof *records);
+    line_numbers = Ns_Malloc(batch * sizeof *line_numbers);
+    for (i = 0; i < batch; i++) {
+        Ns_DStringInit(&records[i]);
+    }
+
+    while (!eof_p) {
+        Ns_DString record;
+
+        Ns_DStringInit(&record);
+
+        /* Parse a batch of records straight into the bind arrays. */
+        for (n = 0; n < batch; ) {
+            int start_line = line_number + 1;
+
+            if (read_record(fp, &records[n], csv_p, &line_number) != NS_OK) {
+                eof_p = 1;
+                break;
+            }
+
+            if (records[n].length == 0) {
+                continue;
+            }
+
+            Ns_DStringTrunc(&record, 0);
+            Ns_DStringNAppend(&record, records[n].string, records[n].length);
+            n_fields = split_fields(record.string, delimiter, csv_p, 
+                                    fields, n_columns);
+
+            if (n_fields != n_columns) {
+                ns_ora_log(lexpos(), "line %d: %d fields, expected %d", 
+                           start_line, n_fields, n_columns);
+                if (load_reject(interp, &bad_fp, bad_path.string, 
+                                records[n].string) != TCL_OK) {
+                    Ns_DStringFree(&record);
+                    goto load_file_cleanup;
+                }
+                total_rejected++;
+                continue;
+            }
+
+            for (j = 0; j < n_columns; j++) {
+                int length = strlen(fields[j]);
+
+                if (length > (int) columns[j].width) {
+                    break;
+                }
+                memcpy(columns[j].values + n * columns[j].width, 
+                       fields[j], length);
+                columns[j].lengths[n] = length;
+                columns[j].indicators[n] = length == 0 ? -1 : 0;
             }
 
-            oci_status = OCIDefineByPos(connection->stmt,
-                                        &fetchbuf->def,
-                                        connection->err,
-                                        i + 1,
-                                        &fetchbuf->lob,
-                                        -1,
-                                        fetchbuf->type,
-                                        &fetchbuf->is_null,
-                                        0, 0, OCI_DEFAULT);
-            if (oci_error_p
-                (lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
-            }
-            break;
+            if (j < n_columns) {
+                ns_ora_log(lexpos(), "line %d: field %s too long", 
+                           start_line, columns[j].name);
+                if (load_reject(interp, &bad_fp, bad_path.string, 
+                                records[n].string) != TCL_OK) {
+                    Ns_DStringFree(&record);
+                    goto load_file_cleanup;
+                }
+                total_rejected++;
+                continue;
+            }
+
+            line_numbers[n++] = start_line;
+        }
+
+        Ns_DStringFree(&record);
+
+        if (n == 0) {
+            continue;
+        }
+
+        oci_status = OCIStmtExecute(connection->svc, connection->stmt,
+                                    connection->err, n, 0, NULL, NULL,
+                                    OCI_BATCH_ERRORS);
+        if (oci_status != OCI_SUCCESS_WITH_INFO
+            && tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", 
+                           sql.string, oci_status)) {
+            goto load_file_cleanup;
+        }
+
+        /* Rows Oracle refused go to the bad file; the rest are in. */
+        n_errors = 0;
+        oci_status = OCIAttrGet(connection->stmt, OCI_HTYPE_STMT, &n_errors,
+                                NULL, OCI_ATTR_NUM_DML_ERRORS, 
+                                connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", sql.string, 
+                        oci_status)) {
+            goto load_file_cleanup;
+        }
+
+        for (i = 0; i < (int) n_errors; i++) {
+            ub4  row_offset;
+            sb4  errcode;
+            text errbuf[512];
+
+            oci_status = OCIParamGet(connection->err, OCI_HTYPE_ERROR,
+                                     connection->err, (dvoid **) &row_err, i);
+            if (oci_status == OCI_SUCCESS) {
+                oci_status = OCIAttrGet(row_err, OCI_HTYPE_ERROR, &row_offset,
+                                        NULL, OCI_ATTR_DML_ROW_OFFSET,
+                                        connection->err);
+            }
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", sql.string, 
+                            oci_status)) {
+                goto load_file_cleanup;
+            }
+
+            errbuf[0] = '\0';
+            OCIErrorGet(row_err, 1, NULL, &errcode, errbuf, sizeof errbuf, 
+                        OCI_HTYPE_ERROR);
+            ns_ora_log(lexpos(), "line %d: %s", line_numbers[row_offset], 
+                       errbuf);
+
+            if (load_reject(interp, &bad_fp, bad_path.string, 
+                            records[row_offset].string) != TCL_OK) {
+                goto load_file_cleanup;
+            }
+        }
+
+        total_rows += n - n_errors;
+        total_rejected += n_errors;
+
+        if (connection->mode == autocommit) {
+            oci_status = OCITransCommit(connection->svc,
+                                        connection->err, OCI_DEFAULT);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCITransCommit", 
+                            sql.string, oci_status)) {
+                goto load_file_cleanup;
+            }
+        }
+    }
+
+    Ns_GetTime(&end);
+    Ns_DiffTime(&end, &start, &diff);
+
+    stats = Tcl_NewListObj(0, NULL);
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewStringObj("rows", -1));
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewWideIntObj(total_rows));
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewStringObj("rejected", -1));
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewWideIntObj(total_rejected));
+    Tcl_ListObjAppendElement(interp, stats, Tcl_NewStringObj("elapsed", -1));
+    Tcl_ListObjAppendElement(interp, stats, 
+            Tcl_NewDoubleObj(diff.sec + diff.usec / 1000000.0));
+    Tcl_SetObjResult(interp, stats);
+
+    result = TCL_OK;
+
+  load_file_cleanup:
+
+    if (row_err != NULL)
+        OCIHandleFree(row_err, OCI_HTYPE_ERROR);
+
+    Ns_OracleFlush(dbh);
+
+    if (columns != NULL) {
+        for (j = 0; j < n_columns; j++) {
+            Ns_Free(columns[j].values);
+            Ns_Free(columns[j].indicators);
+            Ns_Free(columns[j].lengths);
+        }
+        Ns_Free(columns);
+    }
+    if (records != NULL) {
+        for (i = 0; i < batch; i++) {
+            Ns_DStringFree(&records[i]);
+        }
+        Ns_Free(records);
+    }
+    Ns_Free(line_numbers);
+    Ns_Free(fields);
+    Ns_DStringFree(&sql);
+    Ns_DStringFree(&bad_path);
+    Ns_DStringFree(&header);
+
+    if (fp != NULL)
+        fclose(fp);
+    if (bad_fp != NULL)
+        fclose(bad_fp);
+
+    return result;
+}
+/*}}}*/
+
+/*{{{ load_reject */
+/*
+ * load_reject appends a record [ns_ora load_file] could not load to
+ * the bad file, opening it on the first reject.
+ */
+static int
+load_reject(Tcl_Interp *interp, FILE **bad_fp, char *bad_path, char *record)
+{
+    if (*bad_fp == NULL) {
+        *bad_fp = fopen(bad_path, "w");
+        if (*bad_fp == NULL) {
+            Tcl_AppendResult(interp, "could not open bad file `", bad_path,
+                    "' for writing: ", strerror(errno), NULL);
+            return TCL_ERROR;
+        }
+    }
+
+    fputs(record, *bad_fp);
+    fputc('\n', *bad_fp);
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleFetch
+ *----------------------------------------------------------------------
+ * OracleFetch --
+ *
+ *      Implements [ns_ora fetch]
+ *
+ *      ns_ora fetch dbhandle cursor ?-max rows? ?-fetchsize rows?
+ *                   ?-format list|dict?
+ *
+ *      Fetches the next rows, all of them by default, of a cursor
+ *      returned by [ns_ora plsql -cursors].  In list format the
+ *      result's first element is the list of column names and each
+ *      further element a row's values; in dict format each element is
+ *      a row as a list of column names and values.
+ *
+ * Results:
+ *
+ *      The rows.  Fewer rows than asked for means the cursor is
+ *      exhausted, and it is closed.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleFetch (Tcl_Interp *interp, int objc, 
+             Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection = dbh->connection;
+    oci_status_t       oci_status;
+    Tcl_Obj           *rows;
+    int                index, argi, done;
+    int                max_rows = 0, fetch_size = array_fetch_size;
+    int                format = 0;
+    static CONST char *formats[] = {"list", "dict", NULL};
+
+    if (objc < 4 || (objc - 4) % 2 != 0) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                "dbhandle cursor ?-max rows? ?-fetchsize rows? "
+                "?-format list|dict?");
+        return TCL_ERROR;
+    }
+
+    if (get_cursor(interp, connection, Tcl_GetString(objv[3]), &index) 
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    for (argi = 4; argi < objc; argi += 2) {
+        char *option = Tcl_GetString(objv[argi]);
+
+        if (!strcmp(option, "-max")) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &max_rows) 
+                    != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else if (!strcmp(option, "-fetchsize")) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &fetch_size) 
+                    != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else if (!strcmp(option, "-format")) {
+            if (Tcl_GetIndexFromObj(interp, objv[argi + 1], formats, 
+                                    "format", 0, &format) != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else {
+            Tcl_AppendResult(interp, "unknown option ", option, 
+                    ": should be -max, -fetchsize or -format", NULL);
+            return TCL_ERROR;
+        }
+    }
+
+    rows = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(rows);
+
+    if (fetch_cursor_rows(interp, dbh, connection->cursors[index], 
+                          fetch_size, max_rows, format, rows, &done) 
+            != TCL_OK) {
+        Tcl_DecrRefCount(rows);
+        return TCL_ERROR;
+    }
+
+    if (done) {
+        oci_status = OCIHandleFree(connection->cursors[index], 
+                                   OCI_HTYPE_STMT);
+        oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+        connection->cursors[index] = NULL;
+    }
+
+    Tcl_SetObjResult(interp, rows);
+    Tcl_DecrRefCount(rows);
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleFetchDbo
+ *----------------------------------------------------------------------
+ * OracleFetchDbo --
+ *
+ *      Implements [ns_ora fetch_dbo]
+ *
+ *      ns_ora fetch_dbo dbhandle ?cursor? ?-fetchsize rows?
+ *
+ *      Reads a cursor returned by [ns_ora plsql -cursors], or the REF
+ *      CURSOR [ns_ora plsql] left on the handle, to the end and
+ *      builds the structure plsql::ref_cursor_hook makes: columns is
+ *      the list of column names, list the row numbers from 1, and
+ *      row:column each value.
+ *
+ * Results:
+ *
+ *      The structure as a list for [array set].
+ *
+ * Side effects:
+ *
+ *      Closes the cursor, or flushes the handle.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleFetchDbo (Tcl_Interp *interp, int objc, 
+                Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection = dbh->connection;
+    oci_status_t       oci_status;
+    OCIStmt           *stmt;
+    Tcl_Obj           *rows;
+    int                index = -1, argi = 3, done, status = TCL_ERROR;
+    int                fetch_size = array_fetch_size;
+
+    if (objc > 3 && *Tcl_GetString(objv[3]) != '-') {
+        if (get_cursor(interp, connection, Tcl_GetString(objv[3]), &index) 
+                != TCL_OK) {
+            return TCL_ERROR;
+        }
+        argi = 4;
+    }
+
+    if (objc == argi + 2 && !strcmp(Tcl_GetString(objv[argi]), "-fetchsize")) {
+        if (Tcl_GetIntFromObj(interp, objv[argi + 1], &fetch_size) 
+                != TCL_OK) {
+            return TCL_ERROR;
+        }
+    } else if (objc != argi) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                "dbhandle ?cursor? ?-fetchsize rows?");
+        return TCL_ERROR;
+    }
+
+    if (index >= 0) {
+        stmt = connection->cursors[index];
+    } else if ((stmt = connection->stmt) == NULL) {
+        Tcl_AppendResult(interp, "no REF CURSOR on handle ", 
+                Tcl_GetString(objv[2]), NULL);
+        return TCL_ERROR;
+    }
+
+    rows = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(rows);
+
+    if (fetch_cursor_rows(interp, dbh, stmt, fetch_size, 0, 0, rows, &done) 
+            != TCL_OK) {
+        goto fetch_dbo_cleanup;
+    }
+
+    Tcl_SetObjResult(interp, cursor_dbo(rows));
+    status = TCL_OK;
+
+  fetch_dbo_cleanup:
+
+    Tcl_DecrRefCount(rows);
+
+    if (index >= 0) {
+        oci_status = OCIHandleFree(connection->cursors[index], 
+                                   OCI_HTYPE_STMT);
+        oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+        connection->cursors[index] = NULL;
+    } else {
+        Ns_OracleFlush(dbh);
+    }
+
+    return status;
+}
+/*}}}*/
+
+/*{{{ cursor_dbo */
+/*
+ * cursor_dbo turns cursor rows fetched in list format into the
+ * structure plsql::ref_cursor_hook makes: columns is the list of column
+ * names, list the row numbers from 1, and row:column each value.
+ */
+static Tcl_Obj *
+cursor_dbo(Tcl_Obj *rows)
+{
+    Tcl_Obj    *dbo, *numbers, **row_objs, **names, **values;
+    Ns_DString  key;
+    int         n_rows, n_names, n_values, i, k;
+    char        number[32];
+
+    Tcl_ListObjGetElements(NULL, rows, &n_rows, &row_objs);
+    Tcl_ListObjGetElements(NULL, row_objs[0], &n_names, &names);
+
+    dbo = Tcl_NewListObj(0, NULL);
+    numbers = Tcl_NewListObj(0, NULL);
+    Tcl_ListObjAppendElement(NULL, dbo, Tcl_NewStringObj("columns", -1));
+    Tcl_ListObjAppendElement(NULL, dbo, row_objs[0]);
+    Tcl_ListObjAppendElement(NULL, dbo, Tcl_NewStringObj("list", -1));
+    Tcl_ListObjAppendElement(NULL, dbo, numbers);
+
+    Ns_DStringInit(&key);
+    for (i = 1; i < n_rows; i++) {
+        sprintf(number, "%d", i);
+        Tcl_ListObjAppendElement(NULL, numbers, Tcl_NewIntObj(i));
+
+        Tcl_ListObjGetElements(NULL, row_objs[i], &n_values, &values);
+        for (k = 0; k < n_values && k < n_names; k++) {
+            Ns_DStringTrunc(&key, 0);
+            Ns_DStringVarAppend(&key, number, ":", Tcl_GetString(names[k]), 
+                                NULL);
+            Tcl_ListObjAppendElement(NULL, dbo, 
+                    Tcl_NewStringObj(key.string, key.length));
+            Tcl_ListObjAppendElement(NULL, dbo, values[k]);
+        }
+    }
+    Ns_DStringFree(&key);
+
+    return dbo;
+}
+/*}}}*/
+
+/*{{{ get_cursor */
+/*
+ * get_cursor finds the open cursor with the given id, as handed out by
+ * [ns_ora plsql -cursors].
+ */
+static int
+get_cursor(Tcl_Interp *interp, ora_connection_t *connection, char *id,
+           int *index)
+{
+    if (sscanf(id, "cursor%d", index) != 1
+        || *index < 0 || *index >= connection->n_cursors
+        || connection->cursors[*index] == NULL) {
+        Tcl_AppendResult(interp, "no such cursor: ", id, NULL);
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ fetch_cursor_rows
+ *----------------------------------------------------------------------
+ * fetch_cursor_rows --
+ *
+ *      Array fetches up to max_rows rows (all of them if max_rows is
+ *      zero) from a cursor, fetch_size rows per round trip, and appends
+ *      them to rows: in list format the column names and then one list
+ *      of values per row, in dict format (dict_p) one list of column
+ *      names and values per row.  Column names are downcased as with
+ *      ns_db getrow, NULLs are empty strings and LOB columns are read
+ *      whole.
+ *
+ * Results:
+ *
+ *      TCL_OK, or TCL_ERROR with a message in the interp.  *done_p is
+ *      set when the cursor has no more rows.
+ *
+ * Side effects:
+ *
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+fetch_cursor_rows(Tcl_Interp *interp, Ns_DbHandle *dbh, OCIStmt *stmt,
+                  int fetch_size, int max_rows, int dict_p, Tcl_Obj *rows,
+                  int *done_p)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    fetch_column_t   *columns = NULL;
+    Tcl_Obj          *names, **name_objs, *row, *value;
+    ub4               n_columns = 0, row_count = 0, new_count, fetched = 0;
+    ub4               n, j, k;
+    int               i, n_names, status = TCL_ERROR;
+
+    *done_p = 0;
+
+    if (fetch_size < 1) {
+        fetch_size = 1;
+    }
+
+    names = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(names);
+
+    oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT, 
+                            (oci_attribute_t *) &n_columns, NULL, 
+                            OCI_ATTR_PARAM_COUNT, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, oci_status)) {
+        goto fetch_cleanup;
+    }
+
+    /* rows fetched by earlier calls */
+    oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT, 
+                            (oci_attribute_t *) &row_count, NULL, 
+                            OCI_ATTR_ROW_COUNT, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, oci_status)) {
+        goto fetch_cleanup;
+    }
+
+    columns = Ns_Malloc(n_columns * sizeof *columns);
+    memset(columns, 0, n_columns * sizeof *columns);
+
+    for (k = 0; k < n_columns; k++) {
+        fetch_column_t *column = &columns[k];
+        OCIParam       *param;
+        char           *name1 = NULL;
+        ub4             name1_size = 0;
+        ub2             size = 0;
+
+        oci_status = OCIParamGet(stmt, OCI_HTYPE_STMT, connection->err,
+                                 (oci_param_t *) &param, k + 1);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIParamGet", 0, 
+                        oci_status)) {
+            goto fetch_cleanup;
+        }
+
+        oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) &name1, &name1_size,
+                                OCI_ATTR_NAME, connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, 
+                        oci_status)) {
+            goto fetch_cleanup;
+        }
+
+        column->name = Ns_Malloc(name1_size + 1);
+        memcpy(column->name, name1, name1_size);
+        column->name[name1_size] = '\0';
+        downcase(column->name);
+        Tcl_ListObjAppendElement(NULL, names, 
+                                 Tcl_NewStringObj(column->name, -1));
+
+        oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) &column->type, NULL,
+                                OCI_ATTR_DATA_TYPE, connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, 
+                        oci_status)) {
+            goto fetch_cleanup;
+        }
+
+        column->indicators = Ns_Malloc(fetch_size * sizeof(sb2));
+
+        switch (column->type) {
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+            column->lobs = Ns_Malloc(fetch_size * sizeof(OCILobLocator *));
+            memset(column->lobs, 0, fetch_size * sizeof(OCILobLocator *));
+            for (i = 0; i < fetch_size; i++) {
+                oci_status = OCIDescriptorAlloc(connection->env,
+                                                (dvoid **) &column->lobs[i],
+                                                OCI_DTYPE_LOB, 0, 0);
+                if (tcl_error_p(lexpos(), interp, dbh, "OCIDescriptorAlloc",
+                                0, oci_status)) {
+                    goto fetch_cleanup;
+                }
+            }
+
+            oci_status = OCIDefineByPos(stmt, &column->def, connection->err,
+                                        k + 1,
+                                        column->lobs,
+                                        (sb4) sizeof(OCILobLocator *),
+                                        column->type,
+                                        column->indicators,
+                                        0, 0, OCI_DEFAULT);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIDefineByPos", 0, 
+                            oci_status)) {
+                goto fetch_cleanup;
+            }
+            continue;
+
+            /* the same widths as Ns_OracleBindRow */
+        case SQLT_RDD:
+            column->width = 18 + 8;
+            break;
+
+        case SQLT_NUM:
+            column->width = 81 + 8;
+            break;
+
+        case SQLT_DAT:
+            column->width = 20 + 8;
+            break;
+
+        case SQLT_LNG:
+            column->width = lob_buffer_size;
+            break;
+
+        default:
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                    (oci_attribute_t *) &size, NULL,
+                                    OCI_ATTR_DATA_SIZE, connection->err);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, 
+                            oci_status)) {
+                goto fetch_cleanup;
+            }
+
+            if (column->type == SQLT_BIN) {
+                column->width = (size * 2 + 8) * char_expansion;
+            } else {
+                column->width = (size + 8) * char_expansion;
+            }
+            break;
+        }
+
+        if (column->width > UB2MAXVAL) {
+            column->width = UB2MAXVAL;
+        }
+
+        column->values = Ns_Malloc(fetch_size * column->width);
+        column->lengths = Ns_Malloc(fetch_size * sizeof(ub2));
+
+        oci_status = OCIDefineByPos(stmt, &column->def, connection->err,
+                                    k + 1,
+                                    column->values,
+                                    column->width,
+                                    SQLT_STR,
+                                    column->indicators,
+                                    column->lengths,
+                                    0, OCI_DEFAULT);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIDefineByPos", 0, 
+                        oci_status)) {
+            goto fetch_cleanup;
+        }
+    }
+
+    Tcl_ListObjGetElements(NULL, names, &n_names, &name_objs);
+
+    if (!dict_p) {
+        Tcl_ListObjAppendElement(NULL, rows, names);
+    }
+
+    while (!*done_p && (max_rows <= 0 || fetched < (ub4) max_rows)) {
+        n = fetch_size;
+        if (max_rows > 0 && (ub4) max_rows - fetched < n) {
+            n = max_rows - fetched;
+        }
+
+        oci_status = OCIStmtFetch(stmt, connection->err, n, 
+                                  OCI_FETCH_NEXT, OCI_DEFAULT);
+        if (oci_status == OCI_NO_DATA) {
+            *done_p = 1;
+        } else if (oci_status != OCI_SUCCESS_WITH_INFO 
+                   && tcl_error_p(lexpos(), interp, dbh, "OCIStmtFetch", 0,
+                                  oci_status)) {
+            goto fetch_cleanup;
+        }
+
+        oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT, 
+                                (oci_attribute_t *) &new_count, NULL, 
+                                OCI_ATTR_ROW_COUNT, connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, 
+                        oci_status)) {
+            goto fetch_cleanup;
+        }
+
+        n = new_count - row_count;
+        row_count = new_count;
+
+        for (j = 0; j < n; j++) {
+            row = Tcl_NewListObj(0, NULL);
+
+            for (k = 0; k < n_columns; k++) {
+                fetch_column_t *column = &columns[k];
+
+                if (column->indicators[j] == -1) {
+                    value = Tcl_NewObj();
+                } else if (column->lobs != NULL) {
+                    value = read_lob_value(interp, dbh, column->lobs[j],
+                                           column->type == OCI_TYPECODE_BLOB);
+                    if (value == NULL) {
+                        Tcl_DecrRefCount(row);
+                        goto fetch_cleanup;
+                    }
+                } else {
+                    value = Tcl_NewStringObj(column->values 
+                                             + j * column->width, -1);
+                }
+
+                if (dict_p) {
+                    Tcl_ListObjAppendElement(NULL, row, name_objs[k]);
+                }
+                Tcl_ListObjAppendElement(NULL, row, value);
+            }
+
+            Tcl_ListObjAppendElement(NULL, rows, row);
+        }
+
+        fetched += n;
+    }
+
+    status = TCL_OK;
+
+  fetch_cleanup:
+
+    if (columns != NULL) {
+        for (k = 0; k < n_columns; k++) {
+            fetch_column_t *column = &columns[k];
+
+            if (column->lobs != NULL) {
+                for (i = 0; i < fetch_size; i++) {
+                    if (column->lobs[i] != NULL) {
+                        OCIDescriptorFree(column->lobs[i], OCI_DTYPE_LOB);
+                    }
+                }
+                Ns_Free(column->lobs);
+            }
+            Ns_Free(column->name);
+            Ns_Free(column->values);
+            Ns_Free(column->indicators);
+            Ns_Free(column->lengths);
+        }
+        Ns_Free(columns);
+    }
+
+    Tcl_DecrRefCount(names);
+
+    return status;
+}
+/*}}}*/
+
+/*{{{ free_cursors */
+/*
+ * free_cursors closes the cursors [ns_ora plsql -cursors] left on the
+ * connection.
+ */
+static void
+free_cursors(ora_connection_t *connection)
+{
+    oci_status_t oci_status;
+    int          i;
+
+    for (i = 0; i < connection->n_cursors; i++) {
+        if (connection->cursors[i] != NULL) {
+            oci_status = OCIHandleFree(connection->cursors[i], 
+                                       OCI_HTYPE_STMT);
+            oci_error_p(lexpos(), connection->dbh, "OCIHandleFree", 0, 
+                        oci_status);
+        }
+    }
+
+    Ns_Free(connection->cursors);
+    connection->cursors = NULL;
+    connection->n_cursors = 0;
+}
+/*}}}*/
+
+/*{{{ OracleDesc
+ *----------------------------------------------------------------------
+ * OracleDesc --
+ *
+ *      Implements [ns_oracle desc] command.  
+ *
+ *      ns_oracle desc dbhandle object_name ?resolve?
+ *
+ *      Always describes the object on dbh; the describe cache is only
+ *      used by [ns_ora desc_cached] and [ns_ora call].
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleDesc (Tcl_Interp *interp, int objc, 
+            Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    int                resolve;
+
+    if (objc < 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle package");
+        return TCL_ERROR;
+    }
+
+    if (objc == 5) {
+        Tcl_GetIntFromObj(interp, objv[4], &resolve);
+    } else {
+        resolve = 1;
+    }
+
+    if (!dbh->connection) {
+        Tcl_SetResult(interp, "error: no connection", NULL);
+        return TCL_ERROR;
+    }
+
+    return describe_object(interp, dbh, Tcl_GetString(objv[3]), resolve);
+}
+/*}}}*/
+
+/*{{{ OracleDescCached
+ *----------------------------------------------------------------------
+ * OracleDescCached --
+ *
+ *      Implements [ns_oracle desc_cached] command.  
+ *
+ *      ns_oracle desc_cached pool object_name ?dbhandle?
+ *
+ *      Returns what [ns_ora desc] would from the describe cache,
+ *      where descriptions are kept per datasource and user: those of
+ *      the pool's.  Without dbhandle only a description that needs
+ *      no checking against the database is returned, so that
+ *      plsql::init can skip taking a handle; with it (a handle from
+ *      the pool) the object is described on a miss.
+ *
+ * Results:
+ *
+ *      The description, or the empty string.
+ *
+ * Side effects:
+ *
+ *      May describe the object on dbhandle.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleDescCached (Tcl_Interp *interp, int objc, 
+                  Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    Tcl_Obj *desc;
+    char    *pool, *path, *datasource, *user;
+
+    if (objc != 4 && objc != 5) {
+        Tcl_WrongNumArgs(interp, 2, objv, "pool package ?dbhandle?");
+        return TCL_ERROR;
+    }
+
+    pool = Tcl_GetString(objv[2]);
+
+    if (objc == 5) {
+        if (Ns_TclDbGetHandle(interp, Tcl_GetString(objv[4]), &dbh) 
+                != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (Ns_DbDriverName(dbh) != ora_driver_name
+            || dbh->poolname == NULL || strcmp(dbh->poolname, pool)) {
+            Tcl_AppendResult(interp, "handle: '", Tcl_GetString(objv[4]),
+                    "' is not an ", ora_driver_name, " handle from pool '",
+                    pool, "'", NULL);
+            return TCL_ERROR;
+        }
+        if (!dbh->connection) {
+            Tcl_SetResult(interp, "error: no connection", NULL);
+            return TCL_ERROR;
+        }
+        datasource = dbh->datasource;
+        user = dbh->user;
+    } else {
+        path = Ns_ConfigGetPath(NULL, NULL, "db", "pool", pool, NULL);
+        if (path == NULL) {
+            Tcl_AppendResult(interp, "no such pool: ", pool, NULL);
+            return TCL_ERROR;
+        }
+        datasource = Ns_ConfigGetValue(path, "datasource");
+        user = Ns_ConfigGetValue(path, "user");
+    }
+
+    desc = describe_cached(interp, dbh, datasource, user, 
+                           Tcl_GetString(objv[3]));
+    if (desc != NULL) {
+        Tcl_SetObjResult(interp, desc);
+    } else if (dbh != NULL) {
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleStats
+ *----------------------------------------------------------------------
+ * OracleStats --
+ *
+ *      Implements [ns_ora stats] command.  
+ *
+ *      ns_ora stats
+ *
+ *      Doesn't take a handle; the counters are for the whole server.
+ *
+ * Results:
+ *
+ *      A list of counter names and values: lob_aborts, the LOB reads
+ *      cut short (a client that went away, say) that left the session
+ *      usable; lob_reopens, the ones that needed a new session; and
+ *      error_reopens, the handles reopened after fatal Oracle errors;
+ *      and cache_hits, cache_misses and cache_evictions for
+ *      write_blob -cache.
+ *
+ * Side effects:
+ *
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleStats (Tcl_Interp *interp, int objc, 
+             Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    struct ora_stats  stats;
+    Tcl_Obj          *result;
+
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, NULL);
+        return TCL_ERROR;
+    }
+
+    Ns_MutexLock(&stats_lock);
+    stats = ora_stats;
+    Ns_MutexUnlock(&stats_lock);
+
+    result = Tcl_NewListObj(0, NULL);
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewStringObj("lob_aborts", -1));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewLongObj(stats.lob_aborts));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewStringObj("lob_reopens", -1));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewLongObj(stats.lob_reopens));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewStringObj("error_reopens", -1));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewLongObj(stats.error_reopens));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewStringObj("cache_hits", -1));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewLongObj(stats.cache_hits));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewStringObj("cache_misses", -1));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewLongObj(stats.cache_misses));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewStringObj("cache_evictions", -1));
+    Tcl_ListObjAppendElement(NULL, result, 
+                             Tcl_NewLongObj(stats.cache_evictions));
+
+    Tcl_SetObjResult(interp, result);
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ stats_incr */
+/* bump one of the ora_stats counters */
+static void
+stats_incr(long *counter)
+{
+    Ns_MutexLock(&stats_lock);
+    (*counter)++;
+    Ns_MutexUnlock(&stats_lock);
+}
+/*}}}*/
+
+/*{{{ describe_object */
+/*
+ * describe_object describes a package, or with resolve the package a
+ * synonym points to, with OCIDescribeAny and appends the description
+ * to the interp's result.
+ */
+static int
+describe_object(Tcl_Interp *interp, Ns_DbHandle *dbh, char *package, 
+                int resolve)
+{
+    ora_connection_t  *connection = dbh->connection;
+    oci_status_t       oci_status;
+    OCIDescribe       *descHandlePtr;
+    OCIParam          *paramHandlePtr;
+    ub1                ptype;
+
+    oci_status = OCIHandleAlloc(connection->env,
+                                (dvoid *)&descHandlePtr,
+                                OCI_HTYPE_DESCRIBE, 0, NULL);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIHandleAlloc", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    oci_status = OCIAttrSet(descHandlePtr,
+                            OCI_HTYPE_DESCRIBE,
+                            (dvoid *) 1, 0,
+                            OCI_ATTR_DESC_PUBLIC,
+                            connection->err);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIAttrSet", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    oci_status = OCIDescribeAny(connection->svc,
+                                connection->err,
+                                package,
+                                (ub4)strlen(package),
+                                OCI_OTYPE_NAME,
+                                (ub1) 0,
+                                OCI_PTYPE_UNK,
+                                descHandlePtr);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIDescribeAny", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    /* Get parameter handle */
+    oci_status = OCIAttrGet(descHandlePtr,
+                            OCI_HTYPE_DESCRIBE, 
+                            &paramHandlePtr, 
+                            (ub4 *)0, 
+                            OCI_ATTR_PARAM,
+                            connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    oci_status = OCIAttrGet(paramHandlePtr,
+                            OCI_DTYPE_PARAM, 
+                            &ptype, 
+                            (ub4 *)0, 
+                            OCI_ATTR_PTYPE,
+                            connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    /* Resolve SYNONYM if necessary */
+    if (ptype == OCI_PTYPE_SYN && resolve) {
+        text *syn_name, *syn_schema;
+        char *syn_points_to, *syn_ptr;
+        ub4   syn_name_len, syn_schema_len;
+
+        oci_status = OCIAttrGet(paramHandlePtr,
+                                OCI_DTYPE_PARAM, 
+                                (dvoid *) &syn_name,
+                                (ub4 *)   &syn_name_len, 
+                                OCI_ATTR_NAME,
+                                connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return TCL_ERROR;
+        }
+
+        oci_status = OCIAttrGet(paramHandlePtr,
+                                OCI_DTYPE_PARAM, 
+                                (dvoid *) &syn_schema, 
+                                (ub4 *)   &syn_schema_len, 
+                                OCI_ATTR_SCHEMA_NAME,
+                                connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return TCL_ERROR;
+        }
+
+        syn_points_to = ns_malloc(syn_schema_len+syn_name_len+4);
+        strncpy(syn_points_to, syn_schema, syn_schema_len);
+        syn_ptr = syn_points_to + syn_schema_len;
+        *syn_ptr++ = '.';
+        strncpy(syn_ptr, syn_name, syn_name_len);
+        syn_ptr += syn_name_len;
+
+        *syn_ptr = '\0';
+
+        oci_status = OCIDescribeAny(connection->svc,
+                                    connection->err,
+                                    (text *) syn_points_to,
+                                    (ub4) (syn_ptr - syn_points_to),
+                                    OCI_OTYPE_NAME,
+                                    (ub1) 0,
+                                    OCI_PTYPE_UNK,
+                                    descHandlePtr);
+        if (tcl_error_p
+            (lexpos(), interp, dbh, "OCIDescribeAny", package, oci_status)) {
+            Ns_OracleFlush(dbh);
+            OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
+            return TCL_ERROR;
+        }
+
+        ns_free(syn_points_to);
+
+        /* Get parameter handle */
+        oci_status = OCIAttrGet(descHandlePtr,
+                                OCI_HTYPE_DESCRIBE, 
+                                &paramHandlePtr, 
+                                (ub4 *)0, 
+                                OCI_ATTR_PARAM,
+                                connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+            Ns_OracleFlush(dbh);
+            OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
+            return TCL_ERROR;
+        }
+    }
+
+    oci_status = OCIAttrGet(paramHandlePtr,
+                            OCI_DTYPE_PARAM, 
+                            &ptype, 
+                            (ub4 *)0, 
+                            OCI_ATTR_PTYPE,
+                            connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
+        return TCL_ERROR;
+    }
+
+    switch (ptype) {
+
+        case OCI_PTYPE_PKG: 
+            OracleDescribePackage(descHandlePtr, 
+                                  paramHandlePtr, 
+                                  connection, dbh, package,
+                                  interp); 
+            break;
+
+        case OCI_PTYPE_SYN: 
+            OracleDescribeSynonym(descHandlePtr, 
+                                  paramHandlePtr, 
+                                  connection, dbh,
+                                  interp); 
+            break;
+
+        default: 
+            Ns_Log(Warning, "No desc handler, unable to describe object. %d", ptype); 
+    }
+
+    OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
+    OCIHandleFree(paramHandlePtr, OCI_DTYPE_PARAM);
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ OracleDescribeSynonym */
+void
+OracleDescribeSynonym ( OCIDescribe *descHandlePtr,
+                        OCIParam    *paramHandlePtr,
+                        ora_connection_t *connection,
+                        Ns_DbHandle *dbh,
+                        Tcl_Interp  *interp ) 
+{
+    oci_status_t       oci_status;
+    text *syn_name, *syn_schema;
+    ub4   syn_name_len, syn_schema_len;
+
+    oci_status = OCIAttrGet(paramHandlePtr,
+                            OCI_DTYPE_PARAM, 
+                            (dvoid *) &syn_name,
+                            (ub4 *)   &syn_name_len, 
+                            OCI_ATTR_NAME,
+                            connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
+        Ns_OracleFlush(dbh);
+        return;
+    }
+
+    oci_status = OCIAttrGet(paramHandlePtr,
+                            OCI_DTYPE_PARAM, 
+                            (dvoid *) &syn_schema, 
+                            (ub4 *)   &syn_schema_len, 
+                            OCI_ATTR_SCHEMA_NAME,
+                            connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
+        Ns_OracleFlush(dbh);
+        return;
+    }
+
+    Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp), Tcl_NewStringObj(syn_schema, syn_schema_len));
+    Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp), Tcl_NewStringObj(syn_name, syn_name_len));
+
+}
+/*}}}*/
+
+/*{{{ OracleDescribePackage */
+void
+OracleDescribePackage ( OCIDescribe      *descHandlePtr,
+                        OCIParam         *paramHandlePtr,
+                        ora_connection_t *connection,
+                        Ns_DbHandle      *dbh,
+                        char             *package,
+                        Tcl_Interp       *interp ) 
+{
+    OCIParam     *procListPtr, *arg, *arg1; 
+    oci_status_t  oci_status;
+    ub2           numProcs;
+    ub4           namelen;
+    text         *name;
+    int           i;
+
+    oci_status = OCIAttrGet (paramHandlePtr, OCI_DTYPE_PARAM, &procListPtr, 0, 
+                             OCI_ATTR_LIST_SUBPROGRAMS, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
+        Ns_OracleFlush(dbh);
+        return;
+    }
+
+    oci_status = OCIAttrGet (procListPtr, OCI_DTYPE_PARAM, &numProcs, 0, OCI_ATTR_NUM_PARAMS, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
+        Ns_OracleFlush(dbh);
+        return;
+    }
+
+    for (i = 0; i < numProcs; i++) {
+        Tcl_Obj *procObj = Tcl_NewObj();
+        
+        OCIParamGet (procListPtr, OCI_DTYPE_PARAM, connection->err, (dvoid *)&arg, (ub4)i);
+        OCIAttrGet (arg, OCI_DTYPE_PARAM, &name, &namelen, OCI_ATTR_NAME, connection->err);
+        OCIAttrGet (arg, OCI_DTYPE_PARAM, &arg1, 0, OCI_ATTR_LIST_ARGUMENTS, connection->err);
+
+        Tcl_ListObjAppendElement(interp, procObj, Tcl_NewStringObj(name, namelen));
+
+        OracleDescribeArguments(descHandlePtr, arg1, connection, dbh, interp, procObj);
+    }
+
+}
+/*}}}*/
+
+/*{{{ OracleDescribeArguments */
+void
+OracleDescribeArguments (OCIDescribe       *descHandlePtr,
+                         OCIParam          *paramHandlePtr,
+                         ora_connection_t  *connection,
+                         Ns_DbHandle       *dbh,
+                         Tcl_Interp        *interp,
+                         Tcl_Obj           *list) 
+{
+    OCIParam         *arg;
+    OCITypeParamMode  mode;
+    OCIParam         *arglst1;
+    OCITypeCode       data_type;
+    ub1               has_default;
+    oci_status_t      oci_status;
+    ub2               numargs;
+    ub4               namelen;
+    text             *name;
+    int               i;
+    Tcl_Obj          *argObj = Tcl_NewObj();
+
+    oci_status = OCIAttrGet (paramHandlePtr, OCI_DTYPE_PARAM, &numargs, 0, OCI_ATTR_NUM_PARAMS, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
+        Ns_OracleFlush(dbh);
+        return;
+    }
+    
+    for (i = 0; i < numargs; i++) {
+        Tcl_Obj *argument = Tcl_NewObj();
+
+        oci_status = OCIParamGet (paramHandlePtr, OCI_DTYPE_PARAM, connection->err, (dvoid *)&arg, i);
+        if (oci_status == OCI_ERROR) {
+            numargs++;
+            continue;
+        }
+
+        OCIAttrGet (arg, OCI_DTYPE_PARAM, &name, &namelen, OCI_ATTR_NAME, connection->err);
+        OCIAttrGet (arg, OCI_DTYPE_PARAM, &arglst1, 0, OCI_ATTR_LIST_ARGUMENTS, connection->err);
+        OCIAttrGet (arg, OCI_DTYPE_PARAM, &mode, 0, OCI_ATTR_IOMODE, connection->err);
+        OCIAttrGet (arg, OCI_DTYPE_PARAM, &data_type, 0, OCI_ATTR_DATA_TYPE, connection->err);
+        OCIAttrGet (arg, OCI_DTYPE_PARAM, &has_default, 0, OCI_ATTR_HAS_DEFAULT, connection->err);
+
+        Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj(name, namelen));
+
+        switch ((int)mode) {
+            case OCI_TYPEPARAM_IN:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("IN", -1));
+                break;
+
+            case OCI_TYPEPARAM_OUT:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("OUT", -1));
+                break;
+
+            case OCI_TYPEPARAM_INOUT:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("INOUT", -1));
+                break;
+
+            default:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("", -1));
+                
+        }
+
+        switch (data_type) {
+            case OCI_TYPECODE_VARCHAR2:
+            case OCI_TYPECODE_VARCHAR:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("VARCHAR2", -1));
+                break;
+
+            case OCI_TYPECODE_CHAR:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("CHAR", -1));
+                break;
+
+            case OCI_TYPECODE_CLOB:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("CLOB", -1));
+                break;
+
+            case OCI_TYPECODE_BLOB:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("BLOB", -1));
+                break;
+
+            case OCI_TYPECODE_NUMBER:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("NUMBER", -1));
+                break;
+
+            case OCI_TYPECODE_DATE:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("DATE", -1));
+                break;
+
+            case OCI_TYPECODE_OBJECT:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("OBJECT", -1));
+                break;
+
+            case SQLT_CUR:
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("REF CURSOR", -1));
+                break;
+
+            default:
+                Ns_Log(Warning, "Unknown Oracle Type: %d", data_type);
+                Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("", -1));
+                
+        }
+
+        Tcl_ListObjAppendElement(interp, argument, Tcl_NewIntObj(has_default));
+        Tcl_ListObjAppendElement(interp, argObj, argument);
+    }
+
+    if (list) {
+        Tcl_ListObjAppendElement(interp, list, argObj);
+        Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp), list);
+    }
+
+}
+/*}}}*/
+
+/*{{{ OracleCall
+ *----------------------------------------------------------------------
+ * OracleCall --
+ *
+ *      Implements [ns_ora call] command.  
+ *
+ *      ns_oracle call dbhandle ?-materialize list|dict? ?-fetchsize rows?
+ *                       ?-named boolean? package.procedure ?arg ...?
+ *
+ *      Calls a packaged procedure or function the way the plsql.tcl
+ *      wrappers do, without their Tcl.  The package is described once
+ *      (see describe_cached), the overload is picked from the
+ *      arguments as plsql::find_signature did, and each argument is
+ *      bound with the type it was described as (see call_bind).
+ *      Arguments are given in order, or by name as -name arg pairs;
+ *      without -named they are taken as named when the first one
+ *      looks like an option.  IN arguments are values, "--" asking
+ *      for the parameter's default; OUT and INOUT arguments name
+ *      variables, which are set after the call.  REF CURSORs are
+ *      fetched into the structure [ns_ora fetch_dbo] builds, as an
+ *      array for OUT arguments and a list for a function's result, or
+ *      with -materialize into a list of rows in that format.
+ *
+ * Results:
+ *
+ *      The function's result, or nothing for a procedure.
+ *
+ * Side effects:
+ *
+ *      Sets OUT and INOUT variables.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleCall (Tcl_Interp *interp, int objc, 
+            Tcl_Obj *CONST objv[], Ns_DbHandle *dbh)
+{
+    ora_connection_t *connection;
+    oci_status_t      oci_status;
+    Tcl_Obj          *desc = NULL, **procs, **parts, **arguments, **field;
+    Tcl_Obj         **args, **values = NULL, **candidate;
+    Tcl_Obj          *value, *dbo, **pairs;
+    Tcl_Obj          *best_arguments = NULL;
+    Ns_DString        package, sql, ds;
+    char             *name, *dot, *mode, *type, *v, bind[32];
+    int               argi, n_args, named_p = -1, format = -1;
+    int               n_procs, n_parts, n_arguments;
+    int               n_fields, n_pairs, has_default, first = 0;
+    int               score, best = 0, status = TCL_ERROR;
+    int               fetch_size = array_fetch_size, i, j, k, p;
+    static CONST char *formats[] = {"list", "dict", NULL};
+
+    for (argi = 3; argi < objc - 1; argi += 2) {
+        char *option = Tcl_GetString(objv[argi]);
+
+        if (!strcmp(option, "-materialize")) {
+            if (Tcl_GetIndexFromObj(interp, objv[argi + 1], formats, 
+                                    "format", 0, &format) != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else if (!strcmp(option, "-fetchsize")) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &fetch_size) 
+                    != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else if (!strcmp(option, "-named")) {
+            if (Tcl_GetBooleanFromObj(interp, objv[argi + 1], &named_p) 
+                    != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else {
+            break;
+        }
+    }
+
+    if (argi >= objc) {
+        Tcl_WrongNumArgs(interp, 2, objv, 
+                "dbhandle ?-materialize list|dict? ?-fetchsize rows? "
+                "?-named boolean? package.procedure ?arg ...?");
+        return TCL_ERROR;
+    }
+
+    name = Tcl_GetString(objv[argi]);
+    if ((dot = strrchr(name, '.')) == NULL || dot == name || !dot[1]) {
+        Tcl_AppendResult(interp, "expected package.procedure but got \"", 
+                name, "\"", NULL);
+        return TCL_ERROR;
+    }
+
+    args = (Tcl_Obj **) objv + argi + 1;
+    n_args = objc - argi - 1;
+    if (named_p < 0) {
+        named_p = n_args > 0 && Tcl_GetString(args[0])[0] == '-' 
+            && isalpha((unsigned char) Tcl_GetString(args[0])[1]);
+    }
+    if (named_p && n_args % 2) {
+        Tcl_AppendResult(interp, "no value given for argument \"", 
+                Tcl_GetString(args[n_args - 1]), "\"", NULL);
+        return TCL_ERROR;
+    }
+
+    Ns_DStringInit(&package);
+    Ns_DStringInit(&sql);
+    Ns_DStringInit(&ds);
+    Ns_DStringNAppend(&package, name, dot - name);
+
+    if ((desc = describe_cached(interp, dbh, dbh->datasource, dbh->user,
+                                package.string)) == NULL) {
+        goto call_cleanup;
+    }
+    Tcl_IncrRefCount(desc);
+    Tcl_ListObjGetElements(NULL, desc, &n_procs, &procs);
+
+    /*
+     * Pick the overload: the arguments given must fill every parameter
+     * without a default, and the best product of call_score wins, the
+     * first one on a tie.
+     */
+    for (i = 0; i < n_procs; i++) {
+        if (Tcl_ListObjGetElements(NULL, procs[i], &n_parts, &parts) 
+                != TCL_OK || n_parts != 2
+            || strcasecmp(Tcl_GetString(parts[0]), dot + 1)
+            || Tcl_ListObjGetElements(NULL, parts[1], &n_arguments, 
+                                      &arguments) != TCL_OK) {
+            continue;
+        }
+
+        k = n_arguments > 0 
+            && Tcl_ListObjGetElements(NULL, arguments[0], &n_fields, 
+                                      &field) == TCL_OK
+            && n_fields > 0 && !*Tcl_GetString(field[0]);
+
+        candidate = Ns_Calloc(n_arguments + 1, sizeof *candidate);
+        score = 1;
+
+        if (named_p) {
+            for (j = 0; j < n_args && score; j += 2) {
+                for (p = k; p < n_arguments; p++) {
+                    Tcl_ListObjIndex(NULL, arguments[p], 0, &value);
+                    if (value != NULL && !strcasecmp(Tcl_GetString(value), 
+                                Tcl_GetString(args[j]) + 1)) {
+                        break;
+                    }
+                }
+                if (p == n_arguments) {
+                    score = 0;
+                } else {
+                    candidate[p] = args[j + 1];
+                }
+            }
+        } else if (n_args > n_arguments - k) {
+            score = 0;
+        } else {
+            for (j = 0; j < n_args; j++) {
+                candidate[k + j] = args[j];
+            }
+        }
+
+        for (j = k; j < n_arguments && score; j++) {
+            if (candidate[j] != NULL) {
+                score *= call_score(interp, arguments[j], candidate[j]);
+            } else if (Tcl_ListObjIndex(NULL, arguments[j], 3, &value) 
+                           != TCL_OK || value == NULL
+                       || Tcl_GetBooleanFromObj(NULL, value, &has_default) 
+                           != TCL_OK || !has_default) {
+                score = 0;
+            }
+        }
+
+        if (score > best) {
+            Ns_Free(values);
+            values = candidate;
+            best = score;
+            best_arguments = parts[1];
+            first = k;
+        } else {
+            Ns_Free(candidate);
+        }
+    }
+
+    if (values == NULL) {
+        /* No overload fits: list them all, as plsql::find_signature did */
+        Tcl_AppendResult(interp, "USAGE:", NULL);
+        for (i = 0, p = 0; i < n_procs; i++) {
+            if (Tcl_ListObjGetElements(NULL, procs[i], &n_parts, &parts) 
+                    != TCL_OK || n_parts != 2
+                || strcasecmp(Tcl_GetString(parts[0]), dot + 1)
+                || Tcl_ListObjGetElements(NULL, parts[1], &n_arguments, 
+                                          &arguments) != TCL_OK) {
+                continue;
+            }
+            Tcl_AppendResult(interp, p++ ? "\n       " : " ", name, NULL);
+            for (j = 0; j < n_arguments; j++) {
+                if (Tcl_ListObjGetElements(NULL, arguments[j], &n_fields, 
+                                           &field) != TCL_OK 
+                    || n_fields < 4 || !*Tcl_GetString(field[0])) {
+                    continue;
+                }
+                Ns_DStringTrunc(&ds, 0);
+                Ns_DStringVarAppend(&ds, Tcl_GetString(field[0]), " ",
+                        Tcl_GetString(field[1]), " ", 
+                        Tcl_GetString(field[2]), NULL);
+                if (Tcl_GetBooleanFromObj(NULL, field[3], &has_default) 
+                        == TCL_OK && has_default) {
+                    Ns_DStringAppend(&ds, " DEFAULT");
+                }
+                downcase(ds.string);
+                Tcl_AppendResult(interp, " {", ds.string, "}", NULL);
+            }
+        }
+        goto call_cleanup;
+    }
+
+    /*
+     * Build the anonymous block with named notation, a :pN bind for
+     * the N'th argument.  values[] ends up holding the value of each IN
+     * argument and the variable name of each OUT or INOUT one, or NULL
+     * for those left to their default.
+     */
+    Tcl_ListObjGetElements(NULL, best_arguments, &n_arguments, &arguments);
+
+    Ns_DStringAppend(&sql, first ? "BEGIN :p0 := " : "BEGIN ");
+    Ns_DStringVarAppend(&sql, name, "(", NULL);
+
+    for (j = first, k = 0; j < n_arguments; j++) {
+        if (values[j] == NULL) {
+            continue;
+        }
+
+        Tcl_ListObjGetElements(NULL, arguments[j], &n_fields, &field);
+        mode = Tcl_GetString(field[1]);
+        Tcl_GetBooleanFromObj(NULL, field[3], &has_default);
+
+        if (!strcmp(mode, "IN")) {
+            v = Tcl_GetString(values[j]);
+        } else if (!strcmp(mode, "INOUT") 
+                   && (value = Tcl_ObjGetVar2(interp, values[j], NULL, 0))
+                          != NULL) {
+            v = Tcl_GetString(value);
+        } else {
+            v = "";
+        }
+
+        if (has_default && strcmp(mode, "OUT") && !strcmp(v, "--")) {
+            /* explicitly DEFAULT */
+            values[j] = NULL;
+            continue;
+        }
+
+        Ns_DStringVarAppend(&sql, k++ ? ", " : "", 
+                Tcl_GetString(field[0]), "=>", NULL);
+
+        if (!strcmp(mode, "IN") && !strcmp(Tcl_GetString(field[2]), "DATE")
+            && (!strcasecmp(v, "SYSDATE") || !strcasecmp(v, "(SYSDATE)"))) {
+            /* the database's clock, not ours */
+            Ns_DStringAppend(&sql, "SYSDATE");
+            values[j] = NULL;
+        } else {
+            sprintf(bind, ":p%d", j);
+            Ns_DStringAppend(&sql, bind);
+        }
+    }
+    Ns_DStringAppend(&sql, "); END;");
+
+    connection = dbh->connection;
+    connection->interp = interp;
+
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIHandleAlloc", sql.string, oci_status)) {
+        Ns_OracleFlush(dbh);
+        goto call_cleanup;
+    }
+
+    oci_status = OCIStmtPrepare(connection->stmt,
+                                connection->err,
+                                sql.string, sql.length,
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCIStmtPrepare", sql.string, oci_status)) {
+        Ns_OracleFlush(dbh);
+        goto call_cleanup;
+    }
+
+    connection->n_columns = n_arguments;
+    malloc_fetch_buffers(connection);
+
+    for (j = 0; j < n_arguments; j++) {
+        if (j == 0 && first) {
+            /* the function's result */
+            Tcl_ListObjIndex(NULL, arguments[0], 2, &value);
+            type = value != NULL ? Tcl_GetString(value) : "";
+            value = NULL;
+            mode = "OUT";
+        } else if (values[j] == NULL) {
+            continue;
+        } else {
+            Tcl_ListObjGetElements(NULL, arguments[j], &n_fields, &field);
+            mode = Tcl_GetString(field[1]);
+            type = Tcl_GetString(field[2]);
+            if (!strcmp(mode, "IN")) {
+                value = values[j];
+            } else if (!strcmp(mode, "INOUT")) {
+                value = Tcl_ObjGetVar2(interp, values[j], NULL, 0);
+            } else {
+                value = NULL;
+            }
+        }
+
+        if (call_bind(interp, dbh, &connection->fetch_buffers[j], j, 
+                      mode, type, value, sql.string) != TCL_OK) {
+            Tcl_AppendResult(interp, " for argument ", j == 0 && first 
+                    ? "RETURN" : Tcl_GetString(field[0]), NULL);
+            Ns_OracleFlush(dbh);
+            free_fetch_buffers(connection);
+            goto call_cleanup;
+        }
+    }
+
+    oci_status = execute_statement(dbh, connection->stmt, 1,
+                                   (connection->mode == autocommit
+                                    ? OCI_COMMIT_ON_SUCCESS :
+                                    OCI_DEFAULT), sql.string);
+
+    if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", sql.string, 
+                    oci_status)) {
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+        /* PLS-00306 and friends come back as ORA-06550: the package
+         * may have changed since it was described. */
+        if (!strcmp(dbh->cExceptionCode, "6550")) {
+            describe_forget(dbh, package.string);
+        }
+        Ns_OracleFlush(dbh);
+        free_fetch_buffers(connection);
+        goto call_cleanup;
+    }
+
+    /*
+     * Hand back the OUT values from their bind buffers, REF CURSORs as
+     * DBOs unless they were asked for in a -materialize format.
+     */
+    for (j = 0; j < n_arguments; j++) {
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[j];
+
+        if (j == 0 && first) {
+            if ((value = call_value(interp, dbh, fetchbuf, fetch_size, 
+                                    format)) == NULL) {
+                Ns_OracleFlush(dbh);
+                free_fetch_buffers(connection);
+                goto call_cleanup;
+            }
+            Tcl_SetObjResult(interp, value);
+            continue;
+        }
+
+        if (values[j] == NULL) {
+            continue;
+        }
+        Tcl_ListObjGetElements(NULL, arguments[j], &n_fields, &field);
+        if (!strcmp(Tcl_GetString(field[1]), "IN")) {
+            continue;
+        }
+
+        if ((value = call_value(interp, dbh, fetchbuf, fetch_size, 
+                                format)) == NULL) {
+            Ns_OracleFlush(dbh);
+            free_fetch_buffers(connection);
+            goto call_cleanup;
+        }
+
+        if (fetchbuf->external_type == SQLT_RSET && format < 0) {
+            /* a DBO is set as an array */
+            dbo = value;
+            Tcl_IncrRefCount(dbo);
+            Tcl_ListObjGetElements(NULL, dbo, &n_pairs, &pairs);
+            for (k = 0; k < n_pairs; k += 2) {
+                if (Tcl_ObjSetVar2(interp, values[j], pairs[k], 
+                            pairs[k + 1], TCL_LEAVE_ERR_MSG) == NULL) {
+                    break;
+                }
+            }
+            Tcl_DecrRefCount(dbo);
+            if (k < n_pairs) {
+                free_fetch_buffers(connection);
+                goto call_cleanup;
+            }
+        } else if (Tcl_ObjSetVar2(interp, values[j], NULL, value, 
+                                  TCL_LEAVE_ERR_MSG) == NULL) {
+            free_fetch_buffers(connection);
+            goto call_cleanup;
+        }
+    }
+
+    free_fetch_buffers(connection);
+    status = TCL_OK;
+
+  call_cleanup:
+
+    Ns_Free(values);
+    if (desc != NULL) {
+        Tcl_DecrRefCount(desc);
+    }
+    Ns_DStringFree(&package);
+    Ns_DStringFree(&sql);
+    Ns_DStringFree(&ds);
+
+    return status;
+}
+/*}}}*/
+
+/*{{{ call_bind
+ *----------------------------------------------------------------------
+ * call_bind --
+ *
+ *      Helper for [ns_ora call]: binds the j'th argument as :pJ with the
+ *      OCI type of what it was described as.  NUMBERs are bound as
+ *      OCINumbers (SQLT_VNU) and DATEs as OCIDates (SQLT_ODT), both
+ *      converted here rather than by TO_NUMBER or TO_DATE, so that
+ *      Oracle sees the type when it resolves the call.  CLOBs and BLOBs
+ *      are temporary LOBs, REF CURSORs statement handles, and anything
+ *      else a string, OUT strings growing as with [ns_ora plsql].  An
+ *      empty value is NULL.
+ *
+ * Results:
+ *
+ *      TCL_OK, or TCL_ERROR with a message in the interp.
+ *
+ * Side effects:
+ *
+ *      Allocates the buffers in fetchbuf, which free_fetch_buffers
+ *      frees.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+call_bind(Tcl_Interp *interp, Ns_DbHandle *dbh, fetch_buffer_t *fetchbuf,
+          int j, char *mode, char *type, Tcl_Obj *value, char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    dvoid            *valuep;
+    sb4               value_size;
+    ub4               bind_mode = OCI_DEFAULT;
+    Ns_DString        ds;
+    char              name[32], *v;
+    int               length = 0, blob_p, ok;
+
+    sprintf(name, "p%d", j);
+    v = value != NULL ? Tcl_GetStringFromObj(value, &length) : "";
+
+    fetchbuf->inout = strcmp(mode, "IN") ? BIND_OUT : BIND_IN;
+    fetchbuf->is_null = 0;
+
+    if (!strcmp(type, "REF CURSOR")) {
+        fetchbuf->external_type = SQLT_RSET;
+
+        oci_status = OCIHandleAlloc(connection->env,
+                                    (oci_handle_t **) &fetchbuf->stmt,
+                                    OCI_HTYPE_STMT, 0, NULL);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", query, 
+                        oci_status)) {
+            return TCL_ERROR;
+        }
+        valuep = &fetchbuf->stmt;
+        value_size = 0;
+
+    } else if (!strcmp(type, "CLOB") || !strcmp(type, "BLOB")) {
+        blob_p = *type == 'B';
+        fetchbuf->external_type = blob_p ? SQLT_BLOB : SQLT_CLOB;
+
+        if (create_temporary_lob(interp, dbh, fetchbuf, blob_p, value, 
+                                 query) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        valuep = &fetchbuf->lob;
+        value_size = -1;
+
+    } else if (!strcmp(type, "NUMBER")) {
+        fetchbuf->external_type = SQLT_VNU;
+        fetchbuf->buf_size = sizeof(OCINumber);
+        fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+
+        if (!*v) {
+            fetchbuf->is_null = -1;
+        } else if (call_number(connection, v, (OCINumber *) fetchbuf->buf)
+                       != OCI_SUCCESS) {
+            Tcl_AppendResult(interp, "invalid number \"", v, "\"", NULL);
+            return TCL_ERROR;
+        }
+        valuep = fetchbuf->buf;
+        value_size = sizeof(OCINumber);
+
+    } else if (!strcmp(type, "DATE")) {
+        fetchbuf->external_type = SQLT_ODT;
+        fetchbuf->buf_size = sizeof(OCIDate);
+        fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+
+        /* (date) is explicitly DATE */
+        Ns_DStringInit(&ds);
+        if (length > 1 && v[0] == '(' && v[length - 1] == ')') {
+            Ns_DStringNAppend(&ds, v + 1, length - 2);
+        } else {
+            Ns_DStringNAppend(&ds, v, length);
+        }
+        fetchbuf->is_null = ds.length == 0 ? -1 : 0;
+        ok = ds.length == 0 || call_date(ds.string, (OCIDate *) fetchbuf->buf);
+        Ns_DStringFree(&ds);
+
+        if (!ok) {
+            Tcl_AppendResult(interp, "invalid date \"", v, "\"", NULL);
+            return TCL_ERROR;
+        }
+        valuep = fetchbuf->buf;
+        value_size = sizeof(OCIDate);
+
+    } else {
+        fetchbuf->external_type = SQLT_STR;
+
+        /* 'string' is explicitly VARCHAR2 */
+        if (!strncmp(type, "VARCHAR", 7) && value != NULL 
+            && length > 1 && v[0] == '\'' && v[length - 1] == '\'') {
+            v++;
+            length -= 2;
+        }
+
+        fetchbuf->buf_size = plsql_buffer_size(length + 1);
+        fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+        memcpy(fetchbuf->buf, v, length);
+        fetchbuf->buf[length] = '\0';
+
+        if (fetchbuf->inout == BIND_IN) {
+            fetchbuf->is_null = length == 0 ? -1 : 0;
+            valuep = fetchbuf->buf;
+            value_size = length + 1;
+        } else {
+            /* DynamicBindIn sends buf, there being no name to look up,
+             * and DynamicBindOut grows it as the value comes back. */
+            valuep = NULL;
+            value_size = max_plsql_buffer_size;
+            bind_mode = OCI_DATA_AT_EXEC;
+        }
+    }
+
+    oci_status = OCIBindByName(connection->stmt,
+                               &fetchbuf->bind,
+                               connection->err,
+                               name,
+                               strlen(name),
+                               valuep,
+                               value_size,
+                               fetchbuf->external_type,
+                               &fetchbuf->is_null,
+                               0, 0, 0, 0, bind_mode);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByName", query, 
+                    oci_status)) {
+        return TCL_ERROR;
+    }
+
+    if (bind_mode == OCI_DATA_AT_EXEC) {
+        oci_status = OCIBindDynamic(fetchbuf->bind, connection->err,
+                                    fetchbuf, DynamicBindIn,
+                                    fetchbuf, DynamicBindOut);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIBindDynamic", query, 
+                        oci_status)) {
+            return TCL_ERROR;
+        }
+    }
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ call_value */
+/*
+ * call_value reads an OUT argument or result of [ns_ora call] back out
+ * of the buffer call_bind bound it to.  A REF CURSOR is fetched whole,
+ * in the -materialize format (0 for list, 1 for dict) or, with none
+ * (format < 0), as a DBO.  NULL is the empty string.  Returns NULL with
+ * a message in the interp on error.
+ */
+static Tcl_Obj *
+call_value(Tcl_Interp *interp, Ns_DbHandle *dbh, fetch_buffer_t *fetchbuf,
+           int fetch_size, int format)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    Tcl_Obj          *rows, *dbo;
+    OraText           text[64];
+    ub4               text_size = sizeof text, rows_attr = prefetch_rows;
+    sb2               year;
+    ub1               month, day, hour, minute, second;
+    int               done;
+    char              date[32];
+
+    if (fetchbuf->external_type == SQLT_RSET) {
+        if (prefetch_rows > 0) {
+            oci_status = OCIAttrSet(fetchbuf->stmt, OCI_HTYPE_STMT,
+                                    (dvoid *) &rows_attr, 0,
+                                    OCI_ATTR_PREFETCH_ROWS, connection->err);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", 0, 
+                            oci_status)) {
+                return NULL;
+            }
+        }
+
+        rows = Tcl_NewListObj(0, NULL);
+        if (fetch_cursor_rows(interp, dbh, fetchbuf->stmt, fetch_size, 0,
+                              format == 1, rows, &done) != TCL_OK) {
+            Tcl_DecrRefCount(rows);
+            return NULL;
+        }
+        if (format >= 0) {
+            return rows;
+        }
+
+        dbo = cursor_dbo(rows);
+        Tcl_DecrRefCount(rows);
+        return dbo;
+    }
+
+    if (fetchbuf->is_null == -1) {
+        return Tcl_NewObj();
+    }
+
+    switch (fetchbuf->external_type) {
+
+        case SQLT_CLOB:
+        case SQLT_BLOB:
+            return read_lob_value(interp, dbh, fetchbuf->lob, 
+                                  fetchbuf->external_type == SQLT_BLOB);
+
+        case SQLT_VNU:
+            oci_status = OCINumberToText(connection->err, 
+                                         (OCINumber *) fetchbuf->buf,
+                                         "TM9", 3, 
+                                         NUMERIC_CHARACTERS, 
+                                         strlen(NUMERIC_CHARACTERS),
+                                         &text_size, text);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCINumberToText", 0, 
+                            oci_status)) {
+                return NULL;
+            }
+            return Tcl_NewStringObj((char *) text, (int) text_size);
+
+        case SQLT_ODT:
+            OCIDateGetDate((OCIDate *) fetchbuf->buf, &year, &month, &day);
+            OCIDateGetTime((OCIDate *) fetchbuf->buf, &hour, &minute, &second);
+            sprintf(date, "%04d-%02d-%02d %02d:%02d:%02d", 
+                    year, month, day, hour, minute, second);
+            return Tcl_NewStringObj(date, -1);
+    }
+
+    return Tcl_NewStringObj(fetchbuf->buf, -1);
+}
+/*}}}*/
+
+/*{{{ call_number */
+/*
+ * call_number converts a NUMBER argument to [ns_ora call] to an
+ * OCINumber.  Plain decimals go through a format model built from
+ * their own digits, so that no precision is lost; anything else Tcl
+ * takes as a number (exponents, hex) goes through a double.
+ */
+static oci_status_t
+call_number(ora_connection_t *connection, char *value, OCINumber *number)
+{
+    char   format[64], *p;
+    double real;
+    int    n = 0, point_p = 0;
+
+    if (*value == '+') {
+        value++;
+    }
+
+    for (p = *value == '-' ? value + 1 : value; *p != '\0'; p++) {
+        if (n >= (int) sizeof format - 1) {
+            break;
+        } else if (isdigit((unsigned char) *p)) {
+            format[n++] = '9';
+        } else if (*p == '.' && !point_p) {
+            format[n++] = 'D';
+            point_p = 1;
+        } else {
+            break;
+        }
+    }
+    format[n] = '\0';
+
+    if (*p == '\0' && n > point_p) {
+        return OCINumberFromText(connection->err, value, strlen(value),
+                                 format, n, NUMERIC_CHARACTERS, 
+                                 strlen(NUMERIC_CHARACTERS), number);
+    }
+
+    if (Tcl_GetDouble(NULL, value, &real) != TCL_OK) {
+        return OCI_ERROR;
+    }
+
+    return OCINumberFromReal(connection->err, &real, sizeof real, number);
+}
+/*}}}*/
+
+/*{{{ call_score */
+/*
+ * call_score rates how well an [ns_ora call] argument fits a parameter
+ * {name mode type has_default}, as plsql::type did: 0 if it can't be
+ * passed there, 10 if it says so ("--" for a default, (date) or
+ * 'string'), otherwise 2 for a NUMBER or DATE and 1 for anything else.
+ */
+static int
+call_score(Tcl_Interp *interp, Tcl_Obj *argument, Tcl_Obj *value)
+{
+    Tcl_Obj    **field;
+    char        *mode, *type, *v;
+    double       number;
+    size_t       length;
+    int          n_fields, has_default = 0;
+
+    if (Tcl_ListObjGetElements(NULL, argument, &n_fields, &field) != TCL_OK
+        || n_fields < 4) {
+        return 0;
+    }
+    mode = Tcl_GetString(field[1]);
+    type = Tcl_GetString(field[2]);
+    Tcl_GetBooleanFromObj(NULL, field[3], &has_default);
+
+    if (!strcmp(mode, "OUT")) {
+        /* the name of a variable, which can't be a number */
+        v = Tcl_GetString(value);
+        return *v && Tcl_GetDouble(NULL, v, &number) == TCL_OK ? 0 : 1;
+    } else if (!strcmp(mode, "INOUT")) {
+        if ((v = Tcl_GetVar(interp, Tcl_GetString(value), 0)) == NULL) {
+            return 0;
+        }
+    } else {
+        v = Tcl_GetString(value);
+    }
+    length = strlen(v);
+
+    if (has_default && !strcmp(v, "--")) {
+        return 10;
+    }
+
+    if (!strcmp(type, "CLOB") || !strcmp(type, "BLOB")) {
+        return 1;
+    } else if (!strcmp(type, "NUMBER")) {
+        return !*v || Tcl_GetDouble(NULL, v, &number) == TCL_OK ? 2 : 0;
+    } else if (!strcmp(type, "DATE")) {
+        if (length > 1 && v[0] == '(' && v[length - 1] == ')') {
+            return 10;
+        }
+        if (!*v || Tcl_GetDouble(NULL, v, &number) == TCL_OK) {
+            return 0;
+        }
+        return !strcasecmp(v, "SYSDATE") || call_date(v, NULL) ? 2 : 0;
+    } else if (!strncmp(type, "VARCHAR", 7)) {
+        return length > 1 && v[0] == '\'' && v[length - 1] == '\'' ? 10 : 1;
+    }
+
+    return 1;
+}
+/*}}}*/
+
+/*{{{ call_date */
+/*
+ * call_date parses a DATE argument to [ns_ora call] into date, if that
+ * isn't NULL: YYYY-MM-DD, MM/DD/YYYY or DD-MON-YYYY, each optionally
+ * followed by a space or T and HH:MI or HH:MI:SS, or an HTTP date,
+ * which is taken in local time.  Returns 0 if the value is not a date.
+ */
+static int
+call_date(char *value, OCIDate *date)
+{
+    static CONST char *months[] = {"JAN", "FEB", "MAR", "APR", "MAY", 
+        "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+    static int         days[] = {31, 28, 31, 30, 31, 30, 
+                                 31, 31, 30, 31, 30, 31};
+    struct tm         *tm;
+    time_t             t;
+    char               month[4];
+    int                y, mo, d, h = 0, mi = 0, sec = 0, n = 0, leap;
+
+    if (sscanf(value, "%4d-%2d-%2d%n", &y, &mo, &d, &n) == 3
+        || (n = 0, sscanf(value, "%2d/%2d/%4d%n", &mo, &d, &y, &n)) == 3) {
+        value += n;
+    } else if ((n = 0, sscanf(value, "%2d-%3[A-Za-z]-%4d%n", 
+                              &d, month, &y, &n)) == 3) {
+        upcase(month);
+        for (mo = 0; mo < 12 && strcmp(month, months[mo]); mo++)
+            ;
+        mo++;
+        value += n;
+    } else if ((t = Ns_ParseHttpTime(value)) > 0 
+               && (tm = ns_localtime(&t)) != NULL) {
+        y = tm->tm_year + 1900;
+        mo = tm->tm_mon + 1;
+        d = tm->tm_mday;
+        h = tm->tm_hour;
+        mi = tm->tm_min;
+        sec = tm->tm_sec;
+        value = "";
+    } else {
+        return 0;
+    }
+
+    if (*value == ' ' || *value == 'T') {
+        n = 0;
+        if (sscanf(value + 1, "%2d:%2d%n", &h, &mi, &n) != 2) {
+            return 0;
+        }
+        value += n + 1;
+        if (*value == ':') {
+            n = 0;
+            if (sscanf(value + 1, "%2d%n", &sec, &n) != 1) {
+                return 0;
+            }
+            value += n + 1;
+        }
+    }
+    if (*value != '\0') {
+        return 0;
+    }
+
+    leap = mo == 2 && y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+    if (y < 1 || y > 9999 || mo < 1 || mo > 12 
+        || d < 1 || d > days[mo - 1] + leap
+        || h < 0 || h > 23 || mi < 0 || mi > 59 || sec < 0 || sec > 59) {
+        return 0;
+    }
+
+    if (date != NULL) {
+        OCIDateSetDate(date, y, mo, d);
+        OCIDateSetTime(date, h, mi, sec);
+    }
+
+    return 1;
+}
+/*}}}*/
+
+/*{{{ describe_cached
+ *----------------------------------------------------------------------
+ * describe_cached --
+ *
+ *      Returns the [ns_ora desc] description of a package, as seen
+ *      by user on datasource: the same name can be a different
+ *      package for another pool.  The package is described the
+ *      first time any interp asks; after that the description is
+ *      shared between interps as a string in desc_cache, and kept
+ *      parsed in each interp's desc_cache_t, until the shared entry
+ *      is forgotten or replaced.  Descriptions loaded
+ *      from DescribeCacheFile are checked against
+ *      ALL_OBJECTS.LAST_DDL_TIME, all those of the datasource and
+ *      user in one query, the first time any of them is asked for.
+ *      With no dbh only descriptions that need no database work are
+ *      returned; otherwise datasource and user must be dbh's.
+ *
+ * Results:
+ *
+ *      The description, owned by the interp's cache, or NULL with a
+ *      message in the interp (or without one, if dbh is NULL).
+ *
+ * Side effects:
+ *
+ *      May describe the package on dbh and append to DescribeCacheFile.
+ *
+ *----------------------------------------------------------------------
+ */
+static Tcl_Obj *
+describe_cached(Tcl_Interp *interp, Ns_DbHandle *dbh, char *datasource,
+                char *user, char *package)
+{
+    desc_cache_t   *cache;
+    desc_entry_t   *entry;
+    desc_copy_t    *copy;
+    Tcl_HashEntry  *hPtr, *sharedPtr;
+    Tcl_HashTable   times;
+    Tcl_Obj        *desc = NULL, **procs;
+    Ns_DString      key, name, line;
+    char           *ddl_time = NULL;
+    int             stamp = 0, found = 0, new, n_procs, n_parts;
+    int             validate = 0;
+
+    cache = Tcl_GetAssocData(interp, "nsoracle:desc", NULL);
+    if (cache == NULL) {
+        cache = Ns_Malloc(sizeof *cache);
+        Tcl_InitHashTable(&cache->packages, TCL_STRING_KEYS);
+        Tcl_SetAssocData(interp, "nsoracle:desc", free_desc_cache, cache);
+    }
+
+    Ns_DStringInit(&key);
+    desc_key(&key, datasource, user, package);
+
+    /* the interp's copy is good as long as the shared entry's stamp
+     * is the one it was made from */
+    hPtr = Tcl_FindHashEntry(&cache->packages, key.string);
+    copy = hPtr != NULL ? Tcl_GetHashValue(hPtr) : NULL;
+
+    Ns_MutexLock(&desc_lock);
+    if ((sharedPtr = Tcl_FindHashEntry(&desc_cache, key.string)) != NULL) {
+        entry = Tcl_GetHashValue(sharedPtr);
+        found = 1;
+        stamp = entry->stamp;
+        if (!entry->validated) {
+            validate = 1;
+        } else if (copy == NULL || copy->stamp != stamp) {
+            desc = Tcl_NewStringObj(entry->desc, -1);
+        }
+    }
+    Ns_MutexUnlock(&desc_lock);
+
+    if (copy != NULL) {
+        if (found && !validate && desc == NULL) {
+            Ns_DStringFree(&key);
+            return copy->desc;
+        }
+        Tcl_DecrRefCount(copy->desc);
+        Ns_Free(copy);
+        Tcl_DeleteHashEntry(hPtr);
+    }
+
+    if (desc == NULL && dbh == NULL) {
+        Ns_DStringFree(&key);
+        return NULL;
+    }
+
+    if (validate) {
+        desc_validate(interp, dbh);
+
+        Ns_MutexLock(&desc_lock);
+        if ((sharedPtr = Tcl_FindHashEntry(&desc_cache, key.string)) 
+                != NULL) {
+            entry = Tcl_GetHashValue(sharedPtr);
+            desc = Tcl_NewStringObj(entry->desc, -1);
+            stamp = entry->stamp;
+        }
+        Ns_MutexUnlock(&desc_lock);
+    }
+
+    if (desc == NULL) {
+        /* Note the DDL time first, so a change made while describing
+         * makes the saved description look stale rather than fresh */
+        Ns_DStringInit(&name);
+        Ns_DStringAppend(&name, package);
+        upcase(name.string);
+        Tcl_InitHashTable(&times, TCL_STRING_KEYS);
+        if (desc_ddl_times(interp, dbh, &name.string, 1, &times) == TCL_OK
+            && (hPtr = Tcl_FindHashEntry(&times, name.string)) != NULL) {
+            ddl_time = Ns_StrDup(Tcl_GetHashValue(hPtr));
+        }
+        desc_free_times(&times);
+
+        Tcl_ResetResult(interp);
+        if (describe_object(interp, dbh, package, 1) != TCL_OK) {
+            Ns_Free(ddl_time);
+            Ns_DStringFree(&name);
+            Ns_DStringFree(&key);
+            return NULL;
+        }
+
+        /* describe_object leaves a message rather than failing when
+         * OCI gives up part way, so check what came back */
+        desc = Tcl_GetObjResult(interp);
+        if (Tcl_ListObjGetElements(NULL, desc, &n_procs, &procs) != TCL_OK
+            || n_procs == 0 
+            || Tcl_ListObjLength(NULL, procs[0], &n_parts) != TCL_OK
+            || n_parts != 2) {
+            desc = Tcl_DuplicateObj(desc);
+            Tcl_ResetResult(interp);
+            Tcl_AppendResult(interp, "unable to describe package ", 
+                    package, *Tcl_GetString(desc) ? ": " : "", 
+                    Tcl_GetString(desc), NULL);
+            Tcl_DecrRefCount(desc);
+            Ns_Free(ddl_time);
+            Ns_DStringFree(&name);
+            Ns_DStringFree(&key);
+            return NULL;
+        }
+
+        Ns_MutexLock(&desc_lock);
+        sharedPtr = Tcl_CreateHashEntry(&desc_cache, key.string, &new);
+        if (!new) {
+            desc_free_entry(Tcl_GetHashValue(sharedPtr));
+        }
+        entry = Ns_Malloc(sizeof *entry);
+        entry->datasource = Ns_StrDup(datasource != NULL ? datasource : "");
+        entry->user = Ns_StrDup(user != NULL ? user : "");
+        entry->package = Ns_StrDup(name.string);
+        entry->desc = Ns_StrDup(Tcl_GetString(desc));
+        entry->ddl_time = ddl_time;
+        entry->validated = 1;
+        entry->stamp = stamp = ++desc_stamp;
+        Tcl_SetHashValue(sharedPtr, entry);
+        Ns_DStringInit(&line);
+        desc_line(&line, entry);
+        Ns_MutexUnlock(&desc_lock);
+        Ns_DStringFree(&name);
+
+        desc_append(line.string);
+        Ns_DStringFree(&line);
+    }
+
+    hPtr = Tcl_CreateHashEntry(&cache->packages, key.string, &new);
+    copy = Ns_Malloc(sizeof *copy);
+    copy->desc = desc;
+    copy->stamp = stamp;
+    Tcl_IncrRefCount(desc);
+    Tcl_SetHashValue(hPtr, copy);
+    Tcl_ResetResult(interp);
+    Ns_DStringFree(&key);
+
+    return desc;
+}
+/*}}}*/
+
+/*{{{ desc_validate */
+/*
+ * desc_validate checks every description of dbh's datasource and user
+ * loaded from DescribeCacheFile and not yet checked against its
+ * package's LAST_DDL_TIME, in one query, and drops those that are out
+ * of date.  If the query fails they are all dropped, to be described
+ * again.  Other users' descriptions wait for a handle of their own, as
+ * unqualified names resolve differently for them.
+ */
+static void
+desc_validate(Tcl_Interp *interp, Ns_DbHandle *dbh)
+{
+    desc_entry_t   *entry;
+    Tcl_HashEntry  *hPtr, *timePtr;
+    Tcl_HashSearch  search;
+    Tcl_HashTable   times;
+    Ns_DString      lines;
+    char          **names, **keys;
+    int             n_names = 0, i, ok, kept = 0, dropped = 0;
+
+    Ns_MutexLock(&desc_lock);
+    names = Ns_Malloc((desc_cache.numEntries + 1) * sizeof *names);
+    keys = Ns_Malloc((desc_cache.numEntries + 1) * sizeof *keys);
+    for (hPtr = Tcl_FirstHashEntry(&desc_cache, &search); hPtr != NULL;
+         hPtr = Tcl_NextHashEntry(&search)) {
+        entry = Tcl_GetHashValue(hPtr);
+        if (!entry->validated
+            && !strcmp(entry->datasource, 
+                       dbh->datasource != NULL ? dbh->datasource : "")
+            && !strcmp(entry->user, dbh->user != NULL ? dbh->user : "")) {
+            names[n_names] = Ns_StrDup(entry->package);
+            keys[n_names++] = Ns_StrDup(Tcl_GetHashKey(&desc_cache, hPtr));
+        }
+    }
+    Ns_MutexUnlock(&desc_lock);
+
+    Tcl_InitHashTable(&times, TCL_STRING_KEYS);
+    ok = desc_ddl_times(interp, dbh, names, n_names, &times) == TCL_OK;
+    if (!ok) {
+        Ns_Log(Warning, "%s: unable to check the describe cache: %s", 
+               ora_driver_name, Tcl_GetStringResult(interp));
+    }
+    Tcl_ResetResult(interp);
+
+    /* a key alone on a line drops the package when the file is read */
+    Ns_DStringInit(&lines);
+
+    Ns_MutexLock(&desc_lock);
+    for (i = 0; i < n_names; i++) {
+        if ((hPtr = Tcl_FindHashEntry(&desc_cache, keys[i])) == NULL) {
+            continue;
+        }
+        entry = Tcl_GetHashValue(hPtr);
+        if (entry->validated) {
+            continue;
+        }
+
+        timePtr = ok ? Tcl_FindHashEntry(&times, names[i]) : NULL;
+        if (timePtr != NULL && entry->ddl_time != NULL
+            && !strcmp(entry->ddl_time, Tcl_GetHashValue(timePtr))) {
+            entry->validated = 1;
+            kept++;
+        } else {
+            desc_free_entry(entry);
+            Tcl_DeleteHashEntry(hPtr);
+            Ns_DStringVarAppend(&lines, keys[i], "\n", NULL);
+            dropped++;
+        }
+    }
+    Ns_MutexUnlock(&desc_lock);
+
+    Ns_Log(Notice, "%s: describe cache: %d packages unchanged, %d changed",
+           ora_driver_name, kept, dropped);
+
+    for (i = 0; i < n_names; i++) {
+        Ns_Free(names[i]);
+        Ns_Free(keys[i]);
+    }
+    Ns_Free(names);
+    Ns_Free(keys);
+    desc_free_times(&times);
+
+    if (dropped) {
+        desc_append(lines.string);
+    }
+    Ns_DStringFree(&lines);
+}
+/*}}}*/
+
+/*{{{ desc_ddl_times */
+/*
+ * desc_ddl_times looks up the LAST_DDL_TIME of the named packages, as
+ * OWNER.PACKAGE or as PACKAGE for one of the session user's own or
+ * one reached through a public synonym, and puts them in times
+ * (name to YYYYMMDDHH24MISS string).  Bare names are looked up in
+ * USER_OBJECTS, so dbh must be the session the names were described
+ * on: describe_cached keys its descriptions by datasource and user for
+ * that reason.  Names go to the server 500 to a query.
+ */
+static int
+desc_ddl_times(Tcl_Interp *interp, Ns_DbHandle *dbh, char **names, 
+               int n_names, Tcl_HashTable *times)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    OCIStmt          *stmt;
+    Tcl_Obj          *rows, **row_objs, **values;
+    Tcl_HashEntry    *hPtr;
+    Ns_DString        sql, in;
+    char             *name, *p;
+    int               start, i, n_rows, n_values, done, new;
+    int               status = TCL_OK;
+
+    Ns_DStringInit(&sql);
+    Ns_DStringInit(&in);
+
+    for (start = 0; start < n_names && status == TCL_OK; start += 500) {
+        Ns_DStringTrunc(&in, 0);
+        for (i = start; i < n_names && i < start + 500; i++) {
+            name = (p = strrchr(names[i], '.')) != NULL ? p + 1 : names[i];
+            Ns_DStringAppend(&in, i > start ? ", '" : "'");
+            for (p = name; *p; p++) {
+                Ns_DStringNAppend(&in, *p == '\'' ? "''" : p, 
+                                  *p == '\'' ? 2 : 1);
+            }
+            Ns_DStringAppend(&in, "'");
+        }
+
+        Ns_DStringTrunc(&sql, 0);
+        Ns_DStringVarAppend(&sql,
+            "SELECT o.owner || '.' || o.object_name, "
+            "TO_CHAR(o.last_ddl_time, 'YYYYMMDDHH24MISS') "
+            "FROM all_objects o "
+            "WHERE o.object_type = 'PACKAGE' AND o.object_name IN (", 
+            in.string, ") "
+            "UNION ALL "
+            "SELECT o.object_name, "
+            "TO_CHAR(o.last_ddl_time, 'YYYYMMDDHH24MISS') "
+            "FROM user_objects o "
+            "WHERE o.object_type = 'PACKAGE' AND o.object_name IN (", 
+            in.string, ") "
+            "UNION ALL "
+            "SELECT s.synonym_name, "
+            "TO_CHAR(o.last_ddl_time, 'YYYYMMDDHH24MISS') "
+            "FROM all_synonyms s, all_objects o "
+            "WHERE s.owner = 'PUBLIC' AND s.synonym_name IN (", 
+            in.string, ") "
+            "AND o.owner = s.table_owner AND o.object_name = s.table_name "
+            "AND o.object_type = 'PACKAGE' "
+            "AND NOT EXISTS (SELECT 1 FROM user_objects u "
+            "WHERE u.object_name = s.synonym_name)", NULL);
+
+        stmt = NULL;
+        oci_status = OCIHandleAlloc(connection->env, (dvoid **) &stmt,
+                                    OCI_HTYPE_STMT, 0, NULL);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", 
+                        sql.string, oci_status)) {
+            status = TCL_ERROR;
+            break;
+        }
+
+        oci_status = OCIStmtPrepare(stmt, connection->err, 
+                                    sql.string, sql.length,
+                                    OCI_NTV_SYNTAX, OCI_DEFAULT);
+        if (!tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare", 
+                         sql.string, oci_status)) {
+            oci_status = OCIStmtExecute(connection->svc, stmt, 
+                                        connection->err, 0, 0, 
+                                        NULL, NULL, OCI_DEFAULT);
+        }
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", 
+                        sql.string, oci_status)) {
+            status = TCL_ERROR;
+        } else {
+            rows = Tcl_NewListObj(0, NULL);
+            Tcl_IncrRefCount(rows);
+            status = fetch_cursor_rows(interp, dbh, stmt, array_fetch_size, 
+                                       0, 0, rows, &done);
+            if (status == TCL_OK) {
+                Tcl_ListObjGetElements(NULL, rows, &n_rows, &row_objs);
+                for (i = 1; i < n_rows; i++) {
+                    Tcl_ListObjGetElements(NULL, row_objs[i], &n_values, 
+                                           &values);
+                    if (n_values != 2) {
+                        continue;
+                    }
+                    hPtr = Tcl_CreateHashEntry(times, 
+                            Tcl_GetString(values[0]), &new);
+                    if (new) {
+                        Tcl_SetHashValue(hPtr, 
+                                Ns_StrDup(Tcl_GetString(values[1])));
+                    }
+                }
+            }
+            Tcl_DecrRefCount(rows);
+        }
+
+        OCIHandleFree(stmt, OCI_HTYPE_STMT);
+    }
+
+    Ns_DStringFree(&sql);
+    Ns_DStringFree(&in);
+
+    return status;
+}
+/*}}}*/
+
+/*{{{ desc_free_times */
+static void
+desc_free_times(Tcl_HashTable *times)
+{
+    Tcl_HashEntry  *hPtr;
+    Tcl_HashSearch  search;
+
+    for (hPtr = Tcl_FirstHashEntry(times, &search); hPtr != NULL;
+         hPtr = Tcl_NextHashEntry(&search)) {
+        Ns_Free(Tcl_GetHashValue(hPtr));
+    }
+    Tcl_DeleteHashTable(times);
+}
+/*}}}*/
+
+/*{{{ desc_free_entry */
+static void
+desc_free_entry(desc_entry_t *entry)
+{
+    Ns_Free(entry->datasource);
+    Ns_Free(entry->user);
+    Ns_Free(entry->package);
+    Ns_Free(entry->desc);
+    Ns_Free(entry->ddl_time);
+    Ns_Free(entry);
+}
+/*}}}*/
+
+/*{{{ desc_load */
+/*
+ * desc_load reads DescribeCacheFile into the describe cache when the
+ * driver is loaded.  Each line is a Tcl list of the datasource and
+ * user it was described as, the package name, its LAST_DDL_TIME and
+ * its description, or of just the first three (see desc_key) for one
+ * dropped since; later lines override earlier ones, and lines written
+ * before the datasource and user were kept are skipped.  Nothing loaded
+ * is used until desc_validate has checked it.
+ */
+static void
+desc_load(void)
+{
+    desc_entry_t   *entry;
+    Tcl_HashEntry  *hPtr;
+    Ns_DString      line;
+    FILE           *fp;
+    Ns_DString      key;
+    CONST char    **fields;
+    int             n_fields, new, n = 0;
+
+    if (describe_cache_file == NULL 
+        || (fp = fopen(describe_cache_file, "r")) == NULL) {
+        return;
+    }
+
+    Ns_DStringInit(&line);
+    Ns_DStringInit(&key);
+    while (read_line(fp, &line) == NS_OK) {
+        if (Tcl_SplitList(NULL, line.string, &n_fields, &fields) != TCL_OK) {
+            continue;
+        }
+        if (n_fields == 3) {
+            Ns_DStringTrunc(&key, 0);
+            desc_key(&key, (char *) fields[0], (char *) fields[1], 
+                     (char *) fields[2]);
+            if ((hPtr = Tcl_FindHashEntry(&desc_cache, key.string)) 
+                    != NULL) {
+                desc_free_entry(Tcl_GetHashValue(hPtr));
+                Tcl_DeleteHashEntry(hPtr);
+                n--;
+            }
+        } else if (n_fields == 5) {
+            Ns_DStringTrunc(&key, 0);
+            desc_key(&key, (char *) fields[0], (char *) fields[1], 
+                     (char *) fields[2]);
+            hPtr = Tcl_CreateHashEntry(&desc_cache, key.string, &new);
+            if (!new) {
+                desc_free_entry(Tcl_GetHashValue(hPtr));
+            } else {
+                n++;
+            }
+            entry = Ns_Malloc(sizeof *entry);
+            entry->datasource = Ns_StrDup(fields[0]);
+            entry->user = Ns_StrDup(fields[1]);
+            entry->package = Ns_StrDup(fields[2]);
+            upcase(entry->package);
+            entry->desc = Ns_StrDup(fields[4]);
+            entry->ddl_time = *fields[3] ? Ns_StrDup(fields[3]) : NULL;
+            entry->validated = 0;
+            entry->stamp = ++desc_stamp;
+            Tcl_SetHashValue(hPtr, entry);
+        }
+        Tcl_Free((char *) fields);
+    }
+    Ns_DStringFree(&line);
+    Ns_DStringFree(&key);
+    fclose(fp);
+
+    Ns_Log(Notice, "%s: loaded %d package descriptions from %s",
+           ora_driver_name, n, describe_cache_file);
+}
+/*}}}*/
+
+/*{{{ desc_save */
+/*
+ * desc_save rewrites DescribeCacheFile from the describe cache, without
+ * the lines desc_append has since made stale, through a temporary file
+ * renamed over it so that a crash never leaves half a cache behind.
+ * It is done once, when the file has been loaded.
+ */
+static void
+desc_save(void)
+{
+    Tcl_HashEntry  *hPtr;
+    Tcl_HashSearch  search;
+    Ns_DString      path, lines;
+    FILE           *fp;
+
+    if (describe_cache_file == NULL) {
+        return;
+    }
+
+    Ns_DStringInit(&path);
+    Ns_DStringInit(&lines);
+    Ns_DStringVarAppend(&path, describe_cache_file, ".tmp", NULL);
+
+    Ns_MutexLock(&desc_lock);
+    for (hPtr = Tcl_FirstHashEntry(&desc_cache, &search); hPtr != NULL;
+         hPtr = Tcl_NextHashEntry(&search)) {
+        desc_line(&lines, Tcl_GetHashValue(hPtr));
+    }
+    Ns_MutexUnlock(&desc_lock);
+
+    Ns_MutexLock(&desc_file_lock);
+    if ((fp = fopen(path.string, "w")) == NULL) {
+        Ns_Log(Warning, "%s: can't write describe cache %s: %s",
+               ora_driver_name, path.string, strerror(errno));
+    } else {
+        fputs(lines.string, fp);
+        if (fclose(fp) != 0 || rename(path.string, describe_cache_file)) {
+            Ns_Log(Warning, "%s: can't write describe cache %s: %s",
+                   ora_driver_name, describe_cache_file, strerror(errno));
+        }
+    }
+    Ns_MutexUnlock(&desc_file_lock);
+
+    Ns_DStringFree(&path);
+    Ns_DStringFree(&lines);
+}
+/*}}}*/
+
+/*{{{ desc_line */
+/* append entry's line of DescribeCacheFile to dsPtr */
+static void
+desc_line(Ns_DString *dsPtr, desc_entry_t *entry)
+{
+    CONST char *fields[5];
+    char       *line;
+
+    fields[0] = entry->datasource;
+    fields[1] = entry->user;
+    fields[2] = entry->package;
+    fields[3] = entry->ddl_time != NULL ? entry->ddl_time : "";
+    fields[4] = entry->desc;
+    line = Tcl_Merge(5, fields);
+    Ns_DStringVarAppend(dsPtr, line, "\n", NULL);
+    Tcl_Free(line);
+}
+/*}}}*/
+
+/*{{{ desc_append */
+/* add lines to the end of DescribeCacheFile, as each description is
+   made or dropped, rather than writing the whole cache every time */
+static void
+desc_append(char *lines)
+{
+    FILE *fp;
+
+    if (describe_cache_file == NULL || *lines == '\0') {
+        return;
+    }
+
+    Ns_MutexLock(&desc_file_lock);
+    if ((fp = fopen(describe_cache_file, "a")) == NULL) {
+        Ns_Log(Warning, "%s: can't write describe cache %s: %s",
+               ora_driver_name, describe_cache_file, strerror(errno));
+    } else {
+        fputs(lines, fp);
+        if (fclose(fp) != 0) {
+            Ns_Log(Warning, "%s: can't write describe cache %s: %s",
+                   ora_driver_name, describe_cache_file, strerror(errno));
+        }
+    }
+    Ns_MutexUnlock(&desc_file_lock);
+}
+/*}}}*/
+
+/*{{{ describe_forget */
+/*
+ * describe_forget drops a package, as dbh sees it, from the describe
+ * cache after a call that may have failed because the package changed.
+ * Interps drop their copies of it the next time they ask; their other
+ * packages are kept.
+ */
+static void
+describe_forget(Ns_DbHandle *dbh, char *package)
+{
+    Tcl_HashEntry *hPtr;
+    Ns_DString     key;
+    int            dropped = 0;
+
+    Ns_DStringInit(&key);
+    desc_key(&key, dbh->datasource, dbh->user, package);
+
+    Ns_MutexLock(&desc_lock);
+    if ((hPtr = Tcl_FindHashEntry(&desc_cache, key.string)) != NULL) {
+        desc_free_entry(Tcl_GetHashValue(hPtr));
+        Tcl_DeleteHashEntry(hPtr);
+        dropped = 1;
+    }
+    Ns_MutexUnlock(&desc_lock);
+
+    if (dropped) {
+        Ns_DStringAppend(&key, "\n");
+        desc_append(key.string);
+    }
+
+    Ns_DStringFree(&key);
+}
+/*}}}*/
+
+/*{{{ desc_key */
+/*
+ * desc_key appends the describe cache key of a package as user sees it
+ * on datasource: a Tcl list of the three, the package upper-cased.
+ */
+static void
+desc_key(Ns_DString *key, char *datasource, char *user, char *package)
+{
+    Ns_DString name;
+
+    Ns_DStringInit(&name);
+    Ns_DStringAppend(&name, package);
+    upcase(name.string);
+
+    Ns_DStringAppendElement(key, datasource != NULL ? datasource : "");
+    Ns_DStringAppendElement(key, user != NULL ? user : "");
+    Ns_DStringAppendElement(key, name.string);
+
+    Ns_DStringFree(&name);
+}
+/*}}}*/
+
+/*{{{ free_desc_cache */
+static void
+free_desc_cache(ClientData clientData, Tcl_Interp *interp)
+{
+    desc_cache_t   *cache = (desc_cache_t *) clientData;
+    Tcl_HashEntry  *hPtr;
+    Tcl_HashSearch  search;
+
+    for (hPtr = Tcl_FirstHashEntry(&cache->packages, &search); 
+         hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+        desc_copy_t *copy = Tcl_GetHashValue(hPtr);
+
+        Tcl_DecrRefCount(copy->desc);
+        Ns_Free(copy);
+    }
+    Tcl_DeleteHashTable(&cache->packages);
+    Ns_Free(cache);
+}
+/*}}}*/
+
+
+/* 
+ * AOLserver [ns_db] implementation. 
+ *
+ */
+
+/*{{{ Ns_DbDriverInit */
+/* Entry point (called by AOLserver when driver loaded) 
+
+   note that this does not leave behind any structures or state outside
+   of reading the configuraton parameters, as well as
+   initializing OCI and registering our functions
+*/
+NS_EXPORT int 
+Ns_DbDriverInit (char *hdriver, char *config_path) 
+{
+    int ns_status;
+
+    /* slurp any nsd.ini configuration parameters first */
+    if (!Ns_ConfigGetBool(config_path, "Debug", &debug_p))
+        debug_p = DEFAULT_DEBUG;
+
+    if (!Ns_ConfigGetInt
+        (config_path, "MaxStringLogLength", &max_string_log_length))
+        max_string_log_length = DEFAULT_MAX_STRING_LOG_LENGTH;
+
+    if (max_string_log_length < 0)
+        max_string_log_length = INT_MAX;
+
+    if (!Ns_ConfigGetInt (config_path, "CharExpansion", &char_expansion))
+         char_expansion = DEFAULT_CHAR_EXPANSION;
+
+    if (!Ns_ConfigGetInt(config_path, "LobBufferSize", &lob_buffer_size))
+        lob_buffer_size = 16384;
+    Ns_Log(Notice, "%s driver LobBufferSize = %d", hdriver, lob_buffer_size);
+
+    if (!Ns_ConfigGetInt(config_path, "LobWriteSize", &lob_write_size))
+        lob_write_size = 262144;
+    Ns_Log(Notice, "%s driver LobWriteSize = %d", hdriver, lob_write_size);
+
+    if (!Ns_ConfigGetInt(config_path, "LobReadThreads", &max_lob_readers))
+        max_lob_readers = 4;
+    Ns_Log(Notice, "%s driver LobReadThreads = %d", hdriver, 
+           max_lob_readers);
+
+    if (!Ns_ConfigGetInt(config_path, "PrefetchRows", &prefetch_rows))
+        prefetch_rows = 0;
+    Ns_Log(Notice, "%s driver PrefetchRows = %d", hdriver, prefetch_rows);
+
+    if (!Ns_ConfigGetInt(config_path, "PrefetchMemory", &prefetch_memory))
+        prefetch_memory = 0;
+    Ns_Log(Notice, "%s driver PrefetchMemory = %d", hdriver,
+           prefetch_memory);
+
+    if (!Ns_ConfigGetInt(config_path, "ArrayDmlChunkSize", 
+                         &array_dml_chunk_size))
+        array_dml_chunk_size = 0;
+    Ns_Log(Notice, "%s driver ArrayDmlChunkSize = %d", hdriver,
+           array_dml_chunk_size);
+
+    if (!Ns_ConfigGetInt(config_path, "ArrayFetchSize", &array_fetch_size))
+        array_fetch_size = ARRAY_FETCH_SIZE;
+    Ns_Log(Notice, "%s driver ArrayFetchSize = %d", hdriver, 
+           array_fetch_size);
+
+    if (!Ns_ConfigGetInt(config_path, "MaxPLSQLBufferSize", 
+                         &max_plsql_buffer_size))
+        max_plsql_buffer_size = MAX_DYNAMIC_BUFFER;
+    Ns_Log(Notice, "%s driver MaxPLSQLBufferSize = %d", hdriver,
+           max_plsql_buffer_size);
+
+    if (!Ns_ConfigGetInt(config_path, "SpoolMemoryLimit", 
+                         &spool_memory_limit))
+        spool_memory_limit = 1048576;
+    Ns_Log(Notice, "%s driver SpoolMemoryLimit = %d", hdriver,
+           spool_memory_limit);
+
+    if (!Ns_ConfigGetInt(config_path, "SpoolFileLimit", &spool_file_limit))
+        spool_file_limit = 104857600;
+    Ns_Log(Notice, "%s driver SpoolFileLimit = %d", hdriver,
+           spool_file_limit);
+
+    if ((spool_dir = Ns_ConfigGetValue(config_path, "SpoolDir")) == NULL)
+        spool_dir = P_tmpdir;
+    Ns_Log(Notice, "%s driver SpoolDir = %s", hdriver, spool_dir);
+
+    if (!Ns_ConfigGetInt(config_path, "GzipMinSize", &gzip_min_size))
+        gzip_min_size = 1024;
+    Ns_Log(Notice, "%s driver GzipMinSize = %d", hdriver, gzip_min_size);
+
+    if ((gzip_types = Ns_ConfigGetValue(config_path, "GzipTypes")) == NULL)
+        gzip_types = "text/* application/json application/javascript "
+            "application/xml *+xml";
+    Ns_Log(Notice, "%s driver GzipTypes = %s", hdriver, gzip_types);
+
+    blob_cache_dir = Ns_ConfigGetValue(config_path, "BlobCacheDir");
+    Ns_Log(Notice, "%s driver BlobCacheDir = %s", hdriver,
+           nilp(blob_cache_dir));
+
+    if (!Ns_ConfigGetInt(config_path, "BlobCacheSize", &blob_cache_size))
+        blob_cache_size = 104857600;
+    Ns_Log(Notice, "%s driver BlobCacheSize = %d", hdriver, 
+           blob_cache_size);
+
+    describe_cache_file = Ns_ConfigGetValue(config_path, "DescribeCacheFile");
+    Ns_Log(Notice, "%s driver DescribeCacheFile = %s", hdriver,
+           nilp(describe_cache_file));
+
+    /* the driver may be loaded under more than one name */
+    if (!desc_cache_initialized) {
+        Tcl_InitHashTable(&desc_cache, TCL_STRING_KEYS);
+        Ns_MutexSetName(&desc_lock, "nsoracle:desc");
+        Ns_MutexSetName(&desc_file_lock, "nsoracle:descfile");
+        Ns_MutexSetName(&stats_lock, "nsoracle:stats");
+        Tcl_InitHashTable(&blob_cache, TCL_STRING_KEYS);
+        Ns_MutexSetName(&blob_cache_lock, "nsoracle:blobcache");
+        Ns_MutexSetName(&lob_reader_lock, "nsoracle:lobread");
+        desc_cache_initialized = 1;
+        desc_load();
+        desc_save();
+        blob_cache_load();
+    }
+
+
+    ns_ora_log(lexpos(), "entry (hdriver %p, config_path %s)", hdriver,
+        nilp(config_path));
+
+    ns_status = Ns_DbRegisterDriver(hdriver, ora_procs);
+    if (ns_status != NS_OK) {
+        error(lexpos(), "Could not register driver `%s'.",
+              nilp(ora_driver_name));
+        return NS_ERROR;
+    }
+
+    Ns_Log(Notice, "Loaded %s, built on %s/%s",
+           ora_driver_version, __TIME__, __DATE__);
+
+#if defined(FOR_CASSANDRACLE)
+    Ns_Log(Notice,
+           "    This Oracle Driver is a reduced-functionality Cassandracle driver");
+#endif
+
+    ns_ora_log(lexpos(), "driver `%s' loaded.", nilp(ora_driver_name));
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleInterpInit */
+static int 
+Ns_OracleInterpInit (Tcl_Interp *interp, void *dummy)
+{
+    Tcl_CreateObjCommand (interp, "ns_ora", OracleObjCmd, 
+            (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+
+    Tcl_CreateObjCommand (interp, "ns_oracle", OracleObjCmd, 
+            (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+
+#if defined(NS_AOLSERVER_3_PLUS)
+    Tcl_CreateCommand(interp, "ns_column", ora_column_command, NULL, NULL);
+    Tcl_CreateCommand(interp, "ns_table", ora_table_command, NULL, NULL);
+#endif
+
+    return NS_OK;
+}          
+/*}}}*/
+
+/*{{{ Ns_OracleServerInit */
+static int 
+Ns_OracleServerInit(char *hserver, char *hmodule, char *hdriver)
+{
+    ns_ora_log(lexpos(), "entry (%s, %s, %s)", nilp(hserver), nilp(hmodule),
+        nilp(hdriver));
+
+    return Ns_TclInitInterps(hserver, Ns_OracleInterpInit, NULL);
+}
+/*}}}*/
+
+/*{{{ Ns_OracleName */
+/*----------------------------------------------------------------------
+ * Ns_OracleName --
+ *
+ *      Return name of database driver.
+ *
+ *----------------------------------------------------------------------
+ */
+static char *
+Ns_OracleName (Ns_DbHandle *dummy) 
+{
+    ns_ora_log(lexpos(), "entry (dummy %p)", dummy);
+
+    return ora_driver_name;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleDbType */
+/*----------------------------------------------------------------------
+ * Ns_OracleDbType --
+ *
+ *      This function returns the string which identifies the database
+ *      type.  
+ *
+ *      Implements [ns_db dbtype] 
+ *
+ *----------------------------------------------------------------------
+ */
+static char *
+Ns_OracleDbType (Ns_DbHandle *dummy) 
+{
+    ns_ora_log(lexpos(), "entry (dummy %p)", dummy);
+
+    return ora_driver_name;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleOpenDb */
+/*----------------------------------------------------------------------
+ * Ns_OracleOpenDb --
+ *
+ *      Opens a database connection.
+ *
+ *      Implements [ns_db open] 
+ *
+ *----------------------------------------------------------------------
+ */
+static int 
+Ns_OracleOpenDb (Ns_DbHandle *dbh) 
+{
+    oci_status_t oci_status;
+    ora_connection_t *connection;
+
+    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+
+    if (!dbh) {
+        error(lexpos(), "invalid args.");
+        return NS_ERROR;
+    }
+
+    if (! dbh->password) {
+        error (lexpos (), 
+                "Missing Password parameter in configuration file for pool %s.", 
+                dbh->poolname );
+        return NS_ERROR;
+    }
+
+    if (! dbh->user) {
+        error (lexpos (), 
+                "Missing User parameter in configuration file for pool %s.", 
+                dbh->poolname);
+        return NS_ERROR;
+    }
+
+    connection = Ns_Malloc(sizeof *connection);
+
+    connection->dbh = dbh;
+    connection->env = NULL;
+    connection->err = NULL;
+    connection->srv = NULL;
+    connection->svc = NULL;
+    connection->auth = NULL;
+    connection->stmt = NULL;
+    connection->mode = autocommit;
+    connection->n_columns = 0;
+    connection->fetch_buffers = NULL;
+    connection->n_cursors = 0;
+    connection->cursors = NULL;
+    connection->needs_reopen = 0;
+
+    /*  AOLserver, in their database handle structure, gives us one field
+     *  to store our connection structure.
+     */
+    dbh->connection = connection;
+
+    oci_status = OCIEnvCreate(&connection->env,
+                              OCI_THREADED|OCI_ENV_NO_MUTEX,
+                              NULL,
+                              Ns_OracleMalloc,
+                              Ns_OracleRealloc,
+                              Ns_OracleFree,
+                              0, 0);
+    if (oci_error_p(lexpos(), NULL, "OCIEnvCreate", 0, oci_status))
+        return NS_ERROR;
+
+
+
+    /* sets connection->err */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->err,
+                                OCI_HTYPE_ERROR, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
+        return NS_ERROR;
+
+    /* sets connection->srv */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->srv,
+                                OCI_HTYPE_SERVER, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
+        return NS_ERROR;
+
+    /* sets connection->svc */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->svc,
+                                OCI_HTYPE_SVCCTX, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
+        return NS_ERROR;
+
+    /* create association between server handle and access path (datasource; 
+       a string from the nsd.ini file) */
+    oci_status = OCIServerAttach(connection->srv, connection->err,
+                                 dbh->datasource,
+                                 strlen(dbh->datasource), OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIServerAttach", 0, oci_status))
+        return NS_ERROR;
+
+    /* tell OCI to associate the server handle with the context handle */
+    oci_status = OCIAttrSet(connection->svc,
+                            OCI_HTYPE_SVCCTX,
+                            connection->srv,
+                            0, OCI_ATTR_SERVER, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+        return NS_ERROR;
+
+    /* allocate connection->auth */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->auth,
+                                OCI_HTYPE_SESSION, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
+        return NS_ERROR;
+
+    /* give OCI the username from the nsd.ini file */
+    oci_status = OCIAttrSet(connection->auth,
+                            OCI_HTYPE_SESSION,
+                            dbh->user,
+                            strlen(dbh->user),
+                            OCI_ATTR_USERNAME, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+        return NS_ERROR;
+
+    /* give OCI the password from the nsd.ini file */
+    oci_status = OCIAttrSet(connection->auth,
+                            OCI_HTYPE_SESSION,
+                            dbh->password,
+                            strlen(dbh->password),
+                            OCI_ATTR_PASSWORD, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+        return NS_ERROR;
+
+    /* the OCI docs say this "creates a user sesion and begins a 
+       user session for a given server */
+    oci_status = OCISessionBegin(connection->svc,
+                                 connection->err,
+                                 connection->auth,
+                                 OCI_CRED_RDBMS, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCISessionBegin", 0, oci_status))
+        return NS_ERROR;
+
+    /* associate the particular authentications with a particular context */
+    oci_status = OCIAttrSet(connection->svc,
+                            OCI_HTYPE_SVCCTX,
+                            connection->auth,
+                            0, OCI_ATTR_SESSION, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+        return NS_ERROR;
+
+    ns_ora_log(lexpos(), "(dbh %p); return NS_OK;", dbh);
+
+    dbh->connected = NS_TRUE;
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleCloseDb */
+/*----------------------------------------------------------------------
+ * Ns_OracleCloseDb --
+ *
+ *      Closes a database connection and clean up handle.
+ *
+ *      Implements [ns_db close] 
+ *
+ *----------------------------------------------------------------------
+ */
+static int 
+Ns_OracleCloseDb (Ns_DbHandle *dbh) 
+{
+    oci_status_t oci_status;
+    ora_connection_t *connection;
+
+    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+
+    if (!dbh) {
+        error(lexpos(), "invalid args.");
+        return NS_ERROR;
+    }
+
+    connection = dbh->connection;
+    if (!connection) {
+        error(lexpos(), "no connection.");
+        return NS_ERROR;
+    }
+
+    free_cursors(connection);
+
+    /* don't return on error; just clean up the best we can */
+    oci_status = OCIServerDetach(connection->srv,
+                                 connection->err, OCI_DEFAULT);
+    oci_error_p(lexpos(), dbh, "OCIServerDetach", 0, oci_status);
+
+    oci_status = OCIHandleFree(connection->svc, OCI_HTYPE_SVCCTX);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->svc = 0;
+
+    oci_status = OCIHandleFree(connection->srv, OCI_HTYPE_SERVER);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->srv = 0;
+
+    oci_status = OCIHandleFree(connection->err, OCI_HTYPE_ERROR);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->err = 0;
+
+    oci_status = OCIHandleFree(connection->auth, OCI_HTYPE_SESSION);
+    oci_error_p (lexpos (), dbh, "OCIHandleFree", 0, oci_status);
+    connection->auth = 0;
+
+    oci_status = OCIHandleFree(connection->env, OCI_HTYPE_ENV);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->env = 0;
+
+    Ns_Free(connection);
+    dbh->connection = NULL;
+    dbh->connected = NS_FALSE;
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleSelect */
+/*----------------------------------------------------------------------
+ * Ns_OracleSelect --
+ *
+ *      Execute a select statement and bindrow it.
+ *
+ *      Implements [ns_db select] 
+ *
+ *----------------------------------------------------------------------
+ */
+static Ns_Set *
+Ns_OracleSelect (Ns_DbHandle *dbh, char *sql)
+{
+    int ns_status;
+
+    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
+
+    if (!dbh || !sql) {
+        error(lexpos(), "invalid args.");
+        return 0;
+    }
+
+    ns_status = Ns_OracleExec(dbh, sql);
+    if (ns_status != NS_ROWS) {
+        Ns_OracleFlush(dbh);
+        return 0;
+    }
+
+    return Ns_OracleBindRow(dbh);
+}
+/*}}}*/
+
+/*{{{ Ns_OracleDML */
+/*----------------------------------------------------------------------
+ * Ns_OracleDML --
+ *
+ *      Execute a DML statement.
+ *
+ *      Implements [ns_db dml] 
+ *
+ *----------------------------------------------------------------------
+ */
+static int 
+Ns_OracleDML (Ns_DbHandle *dbh, char *sql) 
+{
+    int ns_status;
+
+    ns_status = Ns_OracleExec(dbh, sql);
+    if (ns_status != NS_DML) {
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleExec */
+/*----------------------------------------------------------------------
+ * Ns_OracleExec --
+ *
+ *      Execute a query regardless of type.
+ *
+ *      Implements [ns_db exec] 
+ *
+ *----------------------------------------------------------------------
+ */
+static int 
+Ns_OracleExec (Ns_DbHandle *dbh, char *sql) 
+{
+    oci_status_t oci_status;
+    ora_connection_t *connection;
+    ub4 iters;
+    ub2 type;
+
+    ns_ora_log(lexpos(), "generate simple message");
+    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
+
+    if (!dbh || !sql) {
+        error(lexpos(), "invalid args.");
+        return NS_ERROR;
+    }
+
+    connection = dbh->connection;
+    if (connection == 0) {
+        error(lexpos(), "no connection.");
+        return NS_ERROR;
+    }
+
+    /* nuke any previously executing stmt */
+    Ns_OracleFlush(dbh);
+
+    /* handle_builtins will flush the handles on a ERROR exit */
+
+    switch (handle_builtins(dbh, sql)) {
+    case NS_DML:
+        /* handled */
+        return NS_DML;
+
+    case NS_ERROR:
+        return NS_ERROR;
+
+    case NS_OK:
+        break;
+
+    default:
+        error(lexpos(), "internal error");
+        return NS_ERROR;
+    }
+
+    /* allocate a new handle and stuff in connection->stmt */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", sql, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    /* purely a local call to "prepare statement for execution" */
+    oci_status = OCIStmtPrepare(connection->stmt,
+                                connection->err,
+                                sql, strlen(sql),
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIStmtPrepare", sql, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    /* check what type of statment it is, this will affect how
+       many times we expect to execute it */
+    oci_status = OCIAttrGet(connection->stmt,
+                            OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & type,
+                            NULL, OCI_ATTR_STMT_TYPE, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", sql, oci_status)) {
+        /* got error asking Oracle for the statement type */
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    if (type == OCI_STMT_SELECT) {
+        iters = 0;
+        if (prefetch_rows > 0) {
+            /* Set prefetch rows attr for selects. */
+            oci_status = OCIAttrSet(connection->stmt,
+                                    OCI_HTYPE_STMT,
+                                    (dvoid *) &prefetch_rows,
+                                    0,
+                                    OCI_ATTR_PREFETCH_ROWS,
+                                    connection->err);
+            if (oci_error_p(lexpos(), dbh, "OCIAttrSet", sql, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            }
+        }
+        if (prefetch_memory > 0) {
+            /* Set prefetch memory attr for selects. */
+            oci_status = OCIAttrSet(connection->stmt,
+                                    OCI_HTYPE_STMT,
+                                    (dvoid *) &prefetch_memory,
+                                    0,
+                                    OCI_ATTR_PREFETCH_MEMORY,
+                                    connection->err);
+            if (oci_error_p(lexpos(), dbh, "OCIAttrSet", sql, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            }
+        }
+    } else {
+        iters = 1;
+    }
+
+    /* actually go to server and execute statement */
+    oci_status = execute_statement(dbh, connection->stmt, iters,
+                                   (connection->mode == autocommit
+                                    ? OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT),
+                                   sql);
+    if (oci_status == OCI_ERROR) {
+        oci_status_t oci_status1;
+        sb4 errorcode;
+
+        oci_status1 = OCIErrorGet(connection->err,
+                                  1,
+                                  NULL, &errorcode, 0, 0, OCI_HTYPE_ERROR);
+
+        if (oci_error_p(lexpos(), dbh, "OCIErrorGet", sql, oci_status1)) {
+            /* the error getter got an error; let's bail */
+            Ns_OracleFlush(dbh);
+            return NS_ERROR;
+        } else if (oci_error_p
+                   (lexpos(), dbh, "OCIStmtExecute", sql, oci_status)) {
+            /* this is where we end up for an ordinary error-producing SQL statement
+               we call oci_error_p above so that crud ends up in the log */
+            Ns_OracleFlush(dbh);
+            return NS_ERROR;
+        }
+    } else
+        if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", sql, oci_status))
+    {
+        /* we got some weird error that wasn't OCI_ERROR; we hardly ever get here */
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    ns_ora_log(lexpos(), "query type `%d'", type);
+
+    if (type == OCI_STMT_SELECT)
+        return NS_ROWS;
+    else
+        return NS_DML;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleBindRow */
+/*----------------------------------------------------------------------
+ * Ns_OracleBindRow --
+ *
+ *      Return a list of column names in an Ns_Set.  This is used 
+ *      later to fetch rows into.
+ *
+ *      Implements [ns_db bindrow] 
+ *
+ *----------------------------------------------------------------------
+ */
+static Ns_Set *
+Ns_OracleBindRow (Ns_DbHandle *dbh) 
+{
+    oci_status_t oci_status;
+    ora_connection_t *connection;
+    Ns_Set *row = 0;
+    int i;
+
+    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+
+    if (!dbh) {
+        error(lexpos(), "invalid args.");
+        return 0;
+    }
+
+    connection = dbh->connection;
+    if (connection == 0) {
+        error(lexpos(), "no connection.");
+        return 0;
+    }
+
+    if (connection->stmt == 0) {
+        error(lexpos(), "no active query statement executing");
+        return 0;
+    }
+
+    if (connection->fetch_buffers != 0) {
+        error(lexpos(), "query already bound");
+        Ns_OracleFlush(dbh);
+        return 0;
+    }
+
+    row = dbh->row;
+
+    /* get number of columns returned by query; sets connection->n_columns */
+    oci_status = OCIAttrGet(connection->stmt,
+                            OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & connection->n_columns,
+                            NULL, OCI_ATTR_PARAM_COUNT, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return 0;
+    }
+
+    ns_ora_log(lexpos(), "n_columns: %d", connection->n_columns);
+
+    /* allocate N fetch buffers, this proc pulls N from connection->n_columns */
+    malloc_fetch_buffers(connection);
+
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf;
+        OCIParam *param;
+
+        /* 512 is large enough because Oracle sends back table_name.column_name and 
+           neither right now can be larger than 30 chars */
+        char name[512];
+        char *name1 = 0;
+        sb4 name1_size = 0;
+
+        /* set current fetch buffer */
+        fetchbuf = &connection->fetch_buffers[i];
+
+        oci_status = OCIParamGet(connection->stmt,
+                                 OCI_HTYPE_STMT,
+                                 connection->err,
+                                 (oci_param_t *) & param, i + 1);
+        if (oci_error_p(lexpos(), dbh, "OCIParamGet", 0, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return 0;
+        }
+
+        oci_status = OCIAttrGet(param,
+                                OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) & name1,
+                                &name1_size, OCI_ATTR_NAME,
+                                connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return 0;
+        }
+
+        /* Oracle gives us back a pointer to a string that is not null-terminated
+           so we copy it into our local var and add a 0 at the end */
+        memcpy(name, name1, name1_size);
+        name[name1_size] = 0;
+        /* we downcase the column name for backward-compatibility with philg's
+           AOLserver Tcl scripts written for the case-sensitive Illustra
+           RDBMS.  philg was lucky in that he always used lowercase.  You might want
+           to change this to leave everything all-uppercase if you're a traditional
+           Oracle shop */
+        downcase(name);
+
+        ns_ora_log(lexpos(), "name %d `%s'", name1_size, name);
+        Ns_SetPut(row, name, 0);
+
+        /* get the column type */
+        oci_status = OCIAttrGet(param,
+                                OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) & fetchbuf->type,
+                                NULL, OCI_ATTR_DATA_TYPE, connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return 0;
+        }
+
+        ns_ora_log(lexpos(), "column `%s' type `%d'", name, fetchbuf->type);
+
+        switch (fetchbuf->type) {
+            /* we handle LOBs in the loop below */
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+            break;
+
+            /* RDD is Oracle's happy fun name for ROWID (18 chars long
+               but if you ask Oracle the usual way, it will give you a
+               number that is too small) */
+        case SQLT_RDD:
+            fetchbuf->size = 18;
+            fetchbuf->buf_size = fetchbuf->size + 8;
+            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+            break;
+
+        case SQLT_NUM:
+            /* OCI reports that all NUMBER values has a size of 22, the size
+               of its internal storage format for numbers. We are fetching
+               all values out as strings, so we need more space. Empirically,
+               it seems to return 41 characters when it does the NUMBER to STRING
+               conversion. */
+            fetchbuf->size = 81;
+            fetchbuf->buf_size = fetchbuf->size + 8;
+            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+            break;
+
+            /* this might work if the rest of our LONG stuff worked */
+        case SQLT_LNG:
+            fetchbuf->buf_size = lob_buffer_size;
+            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+            break;
+
+        case SQLT_DAT:
+            /* Wayport mod to allow NLS_DATE_FORMAT = YYYY-MM-DD HH24:MI:SS */
+            fetchbuf->size = 20;
+            fetchbuf->buf_size = fetchbuf->size + 8;
+            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+            break;
+
+        default:
+            /* get the size */
+            oci_status = OCIAttrGet(param,
+                                    OCI_DTYPE_PARAM,
+                                    (oci_attribute_t *) & fetchbuf->size,
+                                    NULL,
+                                    OCI_ATTR_DATA_SIZE, connection->err);
+            if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+
+            ns_ora_log(lexpos(), "column `%s' size `%d'", name, fetchbuf->size);
+
+            /* this is the important part, we allocate buf to be 8 bytes
+               more than Oracle says are necessary (for null
+               termination) */
+            fetchbuf->buf_size = fetchbuf->size + 8;
+
+            if (fetchbuf->type == SQLT_BIN) {
+                fetchbuf->buf_size = fetchbuf->size * 2 + 8;
+            } else {
+                fetchbuf->buf_size = fetchbuf->size + 8;
+            }
+
+            fetchbuf->buf_size *= char_expansion;
+            fetchbuf->buf = Ns_Malloc (fetchbuf->buf_size);
+
+            break;
+        }
+    }
+
+    /* loop over the columns again; this could now be in the loop above
+       but we originally did things this way to permit resizing of
+       buffers
+
+       Now we're telling Oracle to associate the buffers we just
+       allocated with their respective columns */
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf;
+
+        fetchbuf = &connection->fetch_buffers[i];
+
+        switch (fetchbuf->type) {
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+            /* we allocate descriptors for CLOBs; these are essentially
+               pointers.  We will not allocate any buffers for them
+               until we're actually fetching data from individual
+               rows. */
+            oci_status = OCIDescriptorAlloc(connection->env,
+                                            (oci_descriptor_t *) &
+                                            fetchbuf->lob, OCI_DTYPE_LOB,
+                                            0, 0);
+            if (oci_error_p
+                (lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+
+            oci_status = OCIDefineByPos(connection->stmt,
+                                        &fetchbuf->def,
+                                        connection->err,
+                                        i + 1,
+                                        &fetchbuf->lob,
+                                        -1,
+                                        fetchbuf->type,
+                                        &fetchbuf->is_null,
+                                        0, 0, OCI_DEFAULT);
+            if (oci_error_p
+                (lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+            break;
+
+        case SQLT_LNG:
+            oci_status = OCIDefineByPos(connection->stmt,
+                                        &fetchbuf->def,
+                                        connection->err,
+                                        i + 1,
+                                        0,
+                                        (sb4) SB4MAXVAL,
+                                        fetchbuf->type,
+                                        &fetchbuf->is_null,
+                                        &fetchbuf->fetch_length,
+                                        0, OCI_DYNAMIC_FETCH);
+
+            if (oci_error_p
+                (lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+
+            ns_ora_log(lexpos(), "`OCIDefineDynamic ()' success");
+            break;
+
+        default:
+            oci_status = OCIDefineByPos(connection->stmt,
+                                        &fetchbuf->def,
+                                        connection->err,
+                                        i + 1,
+                                        fetchbuf->buf,
+                                        fetchbuf->buf_size,
+                                        SQLT_STR,
+                                        &fetchbuf->is_null,
+                                        &fetchbuf->fetch_length,
+                                        NULL, OCI_DEFAULT);
+
+            if (oci_error_p
+                (lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+            break;
+        }
+    }
+
+    return row;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleGetRow */
+/*----------------------------------------------------------------------
+ * Ns_OracleGetRow --
+ *
+ *      Fetch the next row of the result set into the row Ns_Set.
+ *
+ *      Implements [ns_db getrow] 
+ * 
+ *----------------------------------------------------------------------
+ */
+static int 
+Ns_OracleGetRow (Ns_DbHandle *dbh, Ns_Set *row)
+{
+    oci_status_t oci_status;
+    ora_connection_t *connection;
+    int i;
+    ub4 ret_len = 0;
+
+    ns_ora_log(lexpos(), "entry (dbh %p, row %p)", dbh, row);
+
+    if (!dbh || !row) {
+        error(lexpos(), "invalid args.");
+        return NS_ERROR;
+    }
+
+    connection = dbh->connection;
+    if (connection == 0) {
+        error(lexpos(), "no connection.");
+        return NS_ERROR;
+    }
+
+    if (row == 0) {
+        error(lexpos(), "invalid argument, `NULL' row");
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    if (connection->stmt == 0) {
+        error(lexpos(), "no active select");
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    /* fetch */
+    oci_status = OCIStmtFetch(connection->stmt,
+                              connection->err,
+                              1, OCI_FETCH_NEXT, OCI_DEFAULT);
+
+    if (oci_status == OCI_NEED_DATA) {
+        ;
+    } else if (oci_status == OCI_NO_DATA) {
+        /*  We've reached beyond the last row of the select, so flush the
+         *  statement and tell AOLserver that it isn't going to get
+         *  anything more out of us. 
+         */
+        ns_ora_log(lexpos(), "return NS_END_DATA;");
+
+        if (Ns_OracleFlush(dbh) != NS_OK)
+            return NS_ERROR;
+        else
+            return NS_END_DATA;
+    } else if (oci_error_p(lexpos(), dbh, "OCIStmtFetch", 0, oci_status)) {
+        /* We got some other kind of error */
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    /* Fetched succeeded; copy fetch buffers (one/column) into the ns_set */
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+
+        switch (fetchbuf->type) {
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+
+            if (fetchbuf->is_null == -1) {
+                Ns_SetPutValue(row, i, "");
+            } else if (fetchbuf->is_null != 0) {
+                error(lexpos(), "invalid fetch buffer is_null");
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            } else {
+                /* CLOB is not null, let's grab it. We use an Ns_DString
+                   to do this, because when dealing with variable width
+                   character sets, a single character can be many bytes long
+                   (in UTF8, up to six). */
+                ub4 lob_length = 0;
+                Ns_DString retval;
+                ub1 *bufp;
+
+                /* Get length of LOB, in characters for CLOBs and bytes
+                   for BLOBs. */
+                oci_status = OCILobGetLength(connection->svc,
+                                             connection->err,
+                                             fetchbuf->lob, &lob_length);
+                if (oci_error_p(lexpos(), dbh, "OCILobGetLength",
+                                0, oci_status)) {
+                    Ns_OracleFlush(dbh);
+                    return NS_ERROR;
+                }
+
+                /* Initialize the buffer we're going to use for the value. */
+                bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
+                Ns_DStringInit(&retval);
+
+                /* Do the read. */
+                oci_status = OCILobRead(connection->svc,
+                                        connection->err,
+                                        fetchbuf->lob,
+                                        &lob_length,
+                                        (ub4) 1,
+                                        bufp,
+                                        lob_buffer_size,
+                                        &retval, (OCICallbackLobRead)
+                                        ora_append_buf_to_dstring, (ub2) 0,
+                                        (ub1) SQLCS_IMPLICIT);
+
+                if (oci_error_p
+                    (lexpos(), dbh, "OCILobRead", 0, oci_status)) {
+                    Ns_OracleFlush(dbh);
+                    Ns_DStringFree(&retval);
+                    Ns_Free(bufp);
+                    return NS_ERROR;
+                }
+
+                Ns_SetPutValue(row, i, Ns_DStringValue(&retval));
+                Ns_DStringFree(&retval);
+                Ns_Free(bufp);
+            }
+            break;
+
+        case SQLT_LNG:
+            /* this is broken for multi-part LONGs.  LONGs are being deprecated
+             * by Oracle anyway, so no big loss
+             *
+             * Maybe fixed by davis@arsdigita.com
+             */
+            if (fetchbuf->is_null == -1)
+                fetchbuf->buf[0] = 0;
+            else if (fetchbuf->is_null != 0) {
+                error(lexpos(), "invalid fetch buffer is_null");
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            } else {
+                fetchbuf->buf[0] = 0;
+                fetchbuf->fetch_length = 0;
+                ret_len = 0;
+
+                ns_ora_log(lexpos(), "LONG start: buf_size=%d fetched=%d\n",
+                    fetchbuf->buf_size, fetchbuf->fetch_length);
+
+                do {
+                    //dvoid *def;
+                    ub1 inoutp;
+                    ub1 piece;
+                    ub4 type;
+                    ub4 iterp;
+                    ub4 idxp;
+
+                    fetchbuf->fetch_length += ret_len;
+                    if (fetchbuf->fetch_length > fetchbuf->buf_size / 2) {
+                        fetchbuf->buf_size *= 2;
+                        fetchbuf->buf =
+                            ns_realloc(fetchbuf->buf, fetchbuf->buf_size);
+                    }
+                    ret_len = fetchbuf->buf_size - fetchbuf->fetch_length;
+
+                    oci_status = OCIStmtGetPieceInfo(connection->stmt,
+                                                     connection->err,
+                                                     (dvoid **) &
+                                                     fetchbuf->def, &type,
+                                                     &inoutp, &iterp,
+                                                     &idxp, &piece);
+
+                    if (oci_error_p
+                        (lexpos(), dbh, "OCIStmtGetPieceInfo", 0,
+                         oci_status)) {
+                        Ns_OracleFlush(dbh);
+                        return NS_ERROR;
+                    }
+
+                    oci_status = OCIStmtSetPieceInfo(fetchbuf->def,
+                                                     OCI_HTYPE_DEFINE,
+                                                     connection->err,
+                                                     (void *) (fetchbuf->
+                                                               buf +
+                                                               fetchbuf->
+                                                               fetch_length),
+                                                     &ret_len, piece, 
+                                                     &fetchbuf->is_null,
+                                                     NULL);
+
+                    if (oci_error_p
+                        (lexpos(), dbh, "OCIStmtGetPieceInfo", 0,
+                         oci_status)) {
+                        Ns_OracleFlush(dbh);
+                        return NS_ERROR;
+                    }
+
+                    oci_status = OCIStmtFetch(connection->stmt,
+                                              connection->err,
+                                              1,
+                                              OCI_FETCH_NEXT, OCI_DEFAULT);
+
+                    ns_ora_log(lexpos(),
+                        "LONG: status=%d ret_len=%d buf_size=%d fetched=%d\n",
+                        oci_status, ret_len, fetchbuf->buf_size,
+                        fetchbuf->fetch_length);
+
+                    if (oci_status != OCI_NEED_DATA
+                        && oci_error_p(lexpos(), dbh, "OCIStmtFetch", 0,
+                                       oci_status)) {
+                        Ns_OracleFlush(dbh);
+                        return NS_ERROR;
+                    }
+
+                    if (oci_status == OCI_NO_DATA)
+                        break;
+
+                } while (oci_status == OCI_SUCCESS_WITH_INFO ||
+                         oci_status == OCI_NEED_DATA);
+
+            }
+
+            fetchbuf->buf[fetchbuf->fetch_length] = 0;
+            ns_ora_log(lexpos(), "LONG done: status=%d buf_size=%d fetched=%d\n",
+                oci_status, fetchbuf->buf_size, fetchbuf->fetch_length);
+
+            Ns_SetPutValue(row, i, fetchbuf->buf);
+
+            break;
+
+        default:
+            /* add null termination and then do an ns_set put */
+            if (fetchbuf->is_null == -1)
+                fetchbuf->buf[0] = 0;
+            else if (fetchbuf->is_null != 0) {
+                error(lexpos(), "invalid fetch buffer is_null");
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            } else
+                fetchbuf->buf[fetchbuf->fetch_length] = 0;
+
+            Ns_SetPutValue(row, i, fetchbuf->buf);
+
+            break;
+        }
+    }
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleFlush */
+/*----------------------------------------------------------------------
+ * Ns_OracleFlush --
+ *
+ *      Used to clean up after an error or after we've reached the
+ *      end of a result set.  Frees fetch buffers.
+ *
+ *      Implements [ns_db flush] 
+ *
+ *----------------------------------------------------------------------
+ */
+static int 
+Ns_OracleFlush (Ns_DbHandle *dbh)
+{
+    ora_connection_t *connection;
+    oci_status_t      oci_status;
+    int i;
+
+    ns_ora_log(lexpos(), "entry (dbh %p, row %p)", dbh, 0);
+
+    if (dbh == 0) {
+        error(lexpos(), "invalid args, `NULL' database handle");
+        return NS_ERROR;
+    }
+
+    connection = dbh->connection;
+
+    if (connection == 0) {
+        /* Connection is closed.  That's as good as flushed to me */
+        return NS_OK;
+    }
+    
+    if (connection->stmt != 0) {
+        oci_status = OCIHandleFree(connection->stmt, OCI_HTYPE_STMT);
+        if (oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status))
+            return NS_ERROR;
+        connection->stmt = 0;
+    } 
+
+    connection->interp = NULL;
+
+    if (connection->fetch_buffers != 0) {
+        for (i = 0; i < connection->n_columns; i++) {
+            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+
+            ns_ora_log(lexpos(), "fetchbuf %d, %p, %d, %p, %p, %p", i, fetchbuf,
+                fetchbuf->type, fetchbuf->lob, fetchbuf->buf,
+                fetchbuf->lobs);
+
+            free_temporary_lob(connection, fetchbuf);
+
+            if (fetchbuf->stmt != NULL) {
+                oci_status = OCIHandleFree(fetchbuf->stmt, OCI_HTYPE_STMT);
+                oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+                fetchbuf->stmt = NULL;
+            }
+
+            if (fetchbuf->lob != 0) {
+                oci_status =
+                    OCIDescriptorFree(fetchbuf->lob, OCI_DTYPE_LOB);
+                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
+                            oci_status);
+                fetchbuf->lob = 0;
+            }
+
+            Ns_Free(fetchbuf->buf);
+            fetchbuf->buf = NULL;
+            free_array_values(fetchbuf);
+            free_returned_values(fetchbuf);
+            Ns_Free(fetchbuf->indicators);
+            fetchbuf->indicators = NULL;
+            Ns_Free(fetchbuf->lengths);
+            fetchbuf->lengths = NULL;
+            Ns_Free(fetchbuf->rcodes);
+            fetchbuf->rcodes = NULL;
+
+            if (fetchbuf->lobs != 0) {
+                int k;
+                for (k = 0; k < (int) fetchbuf->n_rows; k++) {
+                    oci_status = OCIDescriptorFree(fetchbuf->lobs[k],
+                                                   OCI_DTYPE_LOB);
+                    oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
+                                oci_status);
+                }
+                Ns_Free(fetchbuf->lobs);
+                fetchbuf->lobs = NULL;
+                fetchbuf->n_rows = 0;
+            }
+        }
+
+        Ns_Free(connection->fetch_buffers);
+        connection->fetch_buffers = 0;
+    }
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleResetHandle */
+/*----------------------------------------------------------------------
+ * Ns_OracleResetHandle --
+ *
+ *      Called by AOLserver when a handle is returned to the
+ *      database pool.
+ *
+ *----------------------------------------------------------------------
+ */
+static int 
+Ns_OracleResetHandle (Ns_DbHandle *dbh)
+{
+    oci_status_t oci_status;
+    ora_connection_t *connection;
+
+    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+
+    if (!dbh) {
+        error(lexpos(), "invalid args.");
+        return 0;
+    }
+
+    connection = dbh->connection;
+    if (!connection) {
+        error(lexpos(), "no connection.");
+        return 0;
+    }
+
+    if (connection->mode == transaction) {
+        oci_status = OCITransRollback(connection->svc,
+                                      connection->err, OCI_DEFAULT);
+        if (oci_error_p(lexpos(), dbh, "OCITransRollback", 0, oci_status))
+            return NS_ERROR;
+
+        connection->mode = autocommit;
+    }
+
+    free_cursors(connection);
+
+    return NS_OK;
+}
+/*}}}*/
+
+/* 
+ * Utility functions for dealing with string lists.
+ *
+ */
+
+/*{{{ snprintf (WIN32) */
+#ifdef WIN32
+/*
+ * This is a GNU extension that isn't present on Windows.
+ */
+static int snprintf(char *buf, int len, const char *fmt, ...)
+{
+    va_list ap;
+    int cc;
+
+    va_start(ap, fmt);
+    cc = vsprintf(buf, fmt, ap);
+    va_end(ap);
+    return cc;
+}
+#endif
+/*}}}*/
+
+/*{{{ string_list_elt_t */
+static string_list_elt_t *
+string_list_elt_new(char *string)
+{
+    string_list_elt_t *elt =
+        (string_list_elt_t *) Ns_Malloc(sizeof(string_list_elt_t));
+    elt->string = string;
+    elt->next = 0;
+
+    return elt;
+}
+/*}}}*/
+
+/*{{{ string_list_len */
+static int 
+string_list_len(string_list_elt_t * head)
+{
+    int i = 0;
+
+    while (head != NULL) {
+        i++;
+        head = head->next;
+    }
+
+    return i;
+}
+/*}}}*/
+
+/*{{{ string_list_free_list */
+static void 
+string_list_free_list(string_list_elt_t * head)
+{
+    string_list_elt_t *elt;
+
+    while (head) {
+        Ns_Free(head->string);
+        elt = head->next;
+        Ns_Free(head);
+        head = elt;
+    }
+
+}
+/*}}}*/
+
+/*{{{ parse_bind_variables  */
+static string_list_elt_t *
+parse_bind_variables(char *input)
+{
+    char *p, lastchar;
+    enum { base, instr, bind } state;
+    char bindbuf[1024], *bp = bindbuf;
+    string_list_elt_t *elt, *head = 0, *tail = 0;
+    int current_string_length = 0;
+
+    for (p = input, state = base, lastchar = '\0'; *p != '\0';
+         lastchar = *p, p++) {
+
+        switch (state) {
+        case base:
+            if (*p == '\'') {
+                state = instr;
+                current_string_length = 0;
+            } else if (*p == ':') {
+                bp = bindbuf;
+                state = bind;
+            }
+            break;
+
+        case instr:
+            if (*p == '\''
+                && (lastchar != '\'' || current_string_length == 0)) {
+                state = base;
+            }
+            current_string_length++;
+            break;
+
+        case bind:
+            if (*p == '=') {
+                state = base;
+                bp = bindbuf;
+            } else if (!
+                       (*p == '_' || *p == '$' || *p == '#'
+                        || isalnum((int) *p))) {
+                *bp = '\0';
+                elt = string_list_elt_new(Ns_StrDup(bindbuf));
+                if (tail == 0) {
+                    head = tail = elt;
+                } else {
+                    tail->next = elt;
+                    tail = elt;
+                }
+                state = base;
+                p--;
+            } else {
+                *bp++ = *p;
+            }
+            break;
+        }
+    }
+
+    if (state == bind) {
+        *bp = '\0';
+        elt = string_list_elt_new(Ns_StrDup(bindbuf));
+        if (tail == 0) {
+            head = tail = elt;
+        } else {
+            tail->next = elt;
+            tail = elt;
+        }
+    }
+
+    return head;
+}
+/*}}}*/
+
+/*{{{ returning_into_clause */
+/*
+ * returning_into_clause finds the INTO part of a DML statement's
+ * RETURNING ... INTO clause, skipping over anything in string literals.
+ * Returns a pointer just past the INTO keyword, or NULL if the
+ * statement has no such clause.  Every bind variable after that point
+ * is an output bind.  *exprsPtr is set to just past RETURNING, where
+ * the returned expressions start.
+ */
+static char *
+returning_into_clause(char *input, char **exprsPtr)
+{
+    char *p;
+
+    if ((p = find_keyword(input, "returning")) == NULL) {
+        return NULL;
+    }
+    *exprsPtr = p + 9;
+
+    if ((p = find_keyword(p + 9, "into")) == NULL) {
+        return NULL;
+    }
+
+    return p + 4;
+}
+/*}}}*/
+
+/*{{{ find_keyword */
+/* the first occurrence of keyword in input, as a word of its own and
+   outside string literals, or NULL */
+static char *
+find_keyword(char *input, char *keyword)
+{
+    char *p, lastchar;
+    int instr_p = 0;
+    int current_string_length = 0;
+    int length = strlen(keyword);
+
+    for (p = input, lastchar = '\0'; *p != '\0'; lastchar = *p, p++) {
+
+        if (instr_p) {
+            if (*p == '\''
+                && (lastchar != '\'' || current_string_length == 0)) {
+                instr_p = 0;
+            }
+            current_string_length++;
+            continue;
+        }
+
+        if (*p == '\'') {
+            instr_p = 1;
+            current_string_length = 0;
+            continue;
+        }
+
+        /* only look at the start of a word */
+        if (lastchar == '_' || lastchar == '$' || lastchar == '#'
+            || lastchar == ':' || isalnum((int) lastchar)) {
+            continue;
+        }
+
+        if (!strncasecmp(p, keyword, length)
+            && !(p[length] == '_' || p[length] == '$' || p[length] == '#'
+                 || isalnum((int) p[length]))) {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+/*}}}*/
+
+/*{{{ dml_table */
+/* append the table (and alias) an INSERT, UPDATE or DELETE statement
+   changes to dsPtr; 0 if it can't be made out */
+static int
+dml_table(char *query, Ns_DString *dsPtr)
+{
+    char *start = query, *end = NULL, *p;
+
+    while (isspace((unsigned char) *start))
+        start++;
+
+    if ((p = find_keyword(start, "insert")) == start) {
+        if ((start = find_keyword(start, "into")) == NULL)
+            return 0;
+        start += 4;
+        end = find_keyword(start, "values");
+        if ((p = find_keyword(start, "select")) != NULL 
+            && (end == NULL || p < end))
+            end = p;
+        if ((p = strchr(start, '(')) != NULL && (end == NULL || p < end))
+            end = p;
+    } else if ((p = find_keyword(start, "update")) == start) {
+        start += 6;
+        end = find_keyword(start, "set");
+    } else if ((p = find_keyword(start, "delete")) == start) {
+        start += 6;
+        while (isspace((unsigned char) *start))
+            start++;
+        if (find_keyword(start, "from") == start)
+            start += 4;
+        end = find_keyword(start, "where");
+        if (end == NULL)
+            end = find_keyword(start, "returning");
+    }
+
+    if (end == NULL || end <= start)
+        return 0;
+
+    Ns_DStringNAppend(dsPtr, start, end - start);
+
+    return 1;
+}
+/*}}}*/
+
+/*{{{ returning_widths */
+/*
+ * returning_widths finds how wide each of the n expressions a DML
+ * statement returns (those between exprs and into) can be as text, by
+ * describing them as a SELECT from the statement's table, and sets
+ * widths accordingly: as Ns_OracleBindRow would size their columns.
+ * When they can't be described (an expression only valid in the DML,
+ * say) they get DML_BUFFER_SIZE bytes, as before.
+ */
+static void
+returning_widths(Ns_DbHandle *dbh, char *query, char *exprs, char *into,
+                 int n, ub4 *widths)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status = OCI_ERROR;
+    OCIStmt          *stmt = NULL;
+    OCIParam         *param;
+    Ns_DString        sql;
+    ub2               type, size;
+    int               j;
+
+    for (j = 0; j < n; j++) {
+        widths[j] = DML_BUFFER_SIZE;
+    }
+
+    Ns_DStringInit(&sql);
+    Ns_DStringAppend(&sql, "select ");
+    Ns_DStringNAppend(&sql, exprs, into - exprs);
+    Ns_DStringAppend(&sql, " from ");
+
+    if (dml_table(query, &sql)) {
+        Ns_DStringAppend(&sql, " where 1 = 0");
+
+        oci_status = OCIHandleAlloc(connection->env, 
+                                    (oci_handle_t **) &stmt,
+                                    OCI_HTYPE_STMT, 0, NULL);
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIStmtPrepare(stmt, connection->err,
+                                        sql.string, sql.length,
+                                        OCI_NTV_SYNTAX, OCI_DEFAULT);
+        }
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIStmtExecute(connection->svc, stmt,
+                                        connection->err, 0, 0, NULL, NULL,
+                                        OCI_DESCRIBE_ONLY);
+        }
+    }
+
+    for (j = 0; j < n && oci_status == OCI_SUCCESS; j++) {
+        oci_status = OCIParamGet(stmt, OCI_HTYPE_STMT, connection->err,
+                                 (dvoid **) &param, j + 1);
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM, &type, NULL,
+                                    OCI_ATTR_DATA_TYPE, connection->err);
+        }
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM, &size, NULL,
+                                    OCI_ATTR_DATA_SIZE, connection->err);
+        }
+        if (oci_status != OCI_SUCCESS) {
+            break;
+        }
+
+        /* the same widths as Ns_OracleBindRow */
+        switch (type) {
+            case SQLT_RDD:
+                widths[j] = 18 + 8;
+                break;
+
+            case SQLT_NUM:
+                widths[j] = 81 + 8;
+                break;
+
+            case SQLT_DAT:
+                widths[j] = 20 + 8;
+                break;
+
+            case SQLT_BIN:
+                widths[j] = (size * 2 + 8) * char_expansion;
+                break;
+
+            case SQLT_CHR:
+            case SQLT_AFC:
+                widths[j] = (size + 8) * char_expansion;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (oci_status != OCI_SUCCESS) {
+        ns_ora_log(lexpos(), "can't describe %s; RETURNING INTO values "
+                   "get %d bytes", sql.string, DML_BUFFER_SIZE);
+        for (j = 0; j < n; j++) {
+            widths[j] = DML_BUFFER_SIZE;
+        }
+    }
+
+    if (stmt != NULL) {
+        OCIHandleFree(stmt, OCI_HTYPE_STMT);
+    }
+    Ns_DStringFree(&sql);
+}
+/*}}}*/
+
+/*{{{ downcase */
+static void 
+downcase(char *s)
+{
+    for (; *s; s++)
+        *s = tolower(*s);
+} 
+/*}}}*/
+
+/*{{{ upcase */
+static void 
+upcase(char *s)
+{
+    for (; *s; s++)
+        *s = toupper(*s);
+} 
+/*}}}*/
+
+/*{{{ read_line */
+/*
+ * read_line reads the next line of a text file into ds, without the
+ * line terminator.  Returns NS_ERROR at end of file.
+ */
+static int
+read_line(FILE *fp, Ns_DString *ds)
+{
+    char buf[STACK_BUFFER_SIZE];
+    int  length;
+
+    Ns_DStringTrunc(ds, 0);
+
+    while (fgets(buf, sizeof buf, fp) != NULL) {
+        Ns_DStringAppend(ds, buf);
+        if (ds->length > 0 && ds->string[ds->length - 1] == '\n') {
+            break;
+        }
+    }
+
+    if (ds->length == 0) {
+        return NS_ERROR;
+    }
+
+    length = ds->length;
+    while (length > 0 && (ds->string[length - 1] == '\n' 
+                          || ds->string[length - 1] == '\r')) {
+        length--;
+    }
+    Ns_DStringTrunc(ds, length);
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ read_record */
+/*
+ * read_record reads the next record of a CSV or TSV file into ds.  A
+ * CSV record continues onto the next line while a quoted field is
+ * open.  *line_number is advanced by the number of lines read.
+ * Returns NS_ERROR at end of file.
+ */
+static int
+read_record(FILE *fp, Ns_DString *ds, int csv_p, int *line_number)
+{
+    Ns_DString line;
+    int        quotes = 0;
+    char      *p;
+
+    if (read_line(fp, ds) != NS_OK) {
+        return NS_ERROR;
+    }
+    (*line_number)++;
+
+    if (!csv_p) {
+        return NS_OK;
+    }
+
+    Ns_DStringInit(&line);
+    for (p = ds->string; *p != '\0'; p++) {
+        quotes += (*p == '"');
+    }
+    while (quotes % 2 != 0 && read_line(fp, &line) == NS_OK) {
+        (*line_number)++;
+        Ns_DStringNAppend(ds, "\n", 1);
+        Ns_DStringNAppend(ds, line.string, line.length);
+        for (p = line.string; *p != '\0'; p++) {
+            quotes += (*p == '"');
+        }
+    }
+    Ns_DStringFree(&line);
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ split_fields */
+/*
+ * split_fields splits a record in place.  TSV fields are split at
+ * each delimiter.  CSV fields may be quoted, with "" standing for a
+ * quote, in which case the quotes are removed.  Up to max_fields
+ * pointers are stored in fields; the number of fields found is
+ * returned.
+ */
+static int
+split_fields(char *record, char delimiter, int csv_p, char **fields, 
+             int max_fields)
+{
+    char *p, *out, *start, c;
+    int   n = 0;
+
+    if (!csv_p) {
+        return split_line(record, delimiter, fields, max_fields);
+    }
+
+    for (p = record; ; p++) {
+        start = out = p;
+
+        if (*p == '"') {
+            for (p++; *p != '\0'; p++) {
+                if (*p == '"') {
+                    if (p[1] != '"') {
+                        p++;
+                        break;
+                    }
+                    p++;
+                }
+                *out++ = *p;
+            }
+            /* anything between the closing quote and the delimiter */
+            while (*p != '\0' && *p != delimiter) {
+                *out++ = *p++;
+            }
+        } else {
+            while (*p != '\0' && *p != delimiter) {
+                p++;
+            }
+            out = p;
+        }
+
+        c = *p;
+        *out = '\0';
+
+        if (n < max_fields) {
+            fields[n] = start;
+        }
+        n++;
+
+        if (c == '\0') {
+            break;
+        }
+    }
+
+    return n;
+}
+/*}}}*/
+
+/*{{{ sql_identifier_p */
+/*
+ * sql_identifier_p says whether name is an Oracle identifier that can
+ * go into SQL as it is: letters, digits, _, $ and # starting with a
+ * letter, or anything but a double quote between double quotes.
+ */
+static int
+sql_identifier_p(char *name)
+{
+    char *p;
+
+    if (*name == '"') {
+        p = name + 1 + strcspn(name + 1, "\"");
+        return p > name + 1 && p[0] == '"' && p[1] == '\0';
+    }
+
+    if (!isalpha((unsigned char) *name)) {
+        return NS_FALSE;
+    }
+    for (p = name + 1; *p != '\0'; p++) {
+        if (!isalnum((unsigned char) *p) 
+            && *p != '_' && *p != '$' && *p != '#') {
+            return NS_FALSE;
+        }
+    }
+
+    return NS_TRUE;
+}
+/*}}}*/
+
+/*{{{ split_line */
+/*
+ * split_line splits a line in place at each delimiter, storing up to
+ * max_fields pointers in fields.  Returns the number of fields found,
+ * which may be more than max_fields.
+ */
+static int
+split_line(char *line, char delimiter, char **fields, int max_fields)
+{
+    int n = 0;
+
+    for (;;) {
+        char *end = strchr(line, delimiter);
+
+        if (n < max_fields) {
+            fields[n] = line;
+        }
+        n++;
+
+        if (end == NULL) {
+            break;
+        }
+        *end = '\0';
+        line = end + 1;
+    }
+
+    return n;
+}
+/*}}}*/
+
+/*{{{ nilp */
+/* nilp is misnamed to some extent; handle empty or overly long strings 
+ *  before printing them out to logs 
+ */
+static char *
+nilp(char *s)
+{
+    if (s == 0)
+        return "[nil]";
+
+    if ((int) strlen(s) > max_string_log_length)
+        return "[too long]";
+
+    return s;
+}
+/*}}}*/
+
+/*
+ * Several helper funtions that get used everywhere.
+ */
+
+#ifdef FOR_CASSANDRACLE
+/*{{{ allow_sql_p*/
+
+/* 
+ * Because Cassandracle (http://www.arsdigita.com/free-tools/cassandracle.html)
+ * runs with DBA priviliges, we need to prevent anything
+ * Bad from happening, whether through malicious intent or just plain
+ * human sloppiness.  Selects are pretty safe, so only those are allowed
+ * if FOR_CASSANDRACLE is defined, disallow any sql that does not
+ * begin with "select".
+ *
+ */
+
+static int allow_sql_p(Ns_DbHandle * dbh, char *sql, int display_sql_p)
+{
+    char *trimmedSql = sql;
+
+    /* trim off leading white space. (the int cast is necessary for the HP) */
+    while (*trimmedSql && isspace((int) *trimmedSql)) {
+        trimmedSql++;
+    }
+
+
+    /* (damned if you do, damned if you don't.  doing a
+     * strlen("select") each time here is wasteful of CPU which
+     * would offend the sensibilities of half the world.  hard-coding
+     * the "6" offends the other half)
+     */
+    if (strncasecmp(trimmedSql, "select", 6) != 0) {
+        int bufsize = strlen(sql) + 4096;
+
+        /* don't put a 20,000 byte buffer on the stack here, since this case
+         * should be very rare.  allocate enough space for the sql
+         * plus some to handle the other text.  (4K should be enough to
+         * handle the lexpos() call)
+         */
+        char *buf = Ns_Malloc(bufsize);
+
+        /* means someone is trying to do something other than a select.
+         * Bad!  Very Bad!
+         */
+        if (display_sql_p) {
+            snprintf(buf, bufsize, "%s:%d:%s: Sql Rejected: %s",
+                     lexpos(), trimmedSql);
+        } else {
+            snprintf(buf, bufsize, "%s:%d:%s: Sql Rejected", lexpos());
+        }
+
+        Ns_Log(Error, "%s", buf);
+
+        Ns_DbSetException(dbh, "ORA", buf);
+
+        Ns_Free(buf);
+
+        return NS_FALSE;
+    }
+
+    return NS_TRUE;
+
+}                               /* allow_sql_p */
+/*}}}*/
+#endif
+
+/*{{{ oci_error_p */
+/* we call this after every OCI call, i.e., a couple of times during
+   each fetch of a row 
+*/
+static int
+oci_error_p(const char *file, int line, const char *fn,
+            Ns_DbHandle * dbh, char *ocifn, char *query,
+            oci_status_t oci_status)
+{
+    ora_connection_t *connection = 0;
+    ub2               offset = 0;
+    sb4               errorcode = 0;
+
+    char             *msgbuf;
+    char             *buf;
+    char              exceptbuf[EXCEPTION_CODE_SIZE + 1];
+
+    if (dbh) {
+        connection = dbh->connection;
+    }
+
+    if (oci_status == OCI_SUCCESS)
+        return 0;
+
+    /* Until we get the logging situation worked out, return
+     * OCI_SUCCESS_WITH_INFO as a pure success.
+     */
+    if (oci_status == OCI_SUCCESS_WITH_INFO)
+        return 0;
+
+    /* If the query is long, nilp will return "[too long]"; 
+     * if null (we're not doing a query yet, e.g., could 
+     * be opening db), then "[nil]"  
+     */
+    query = nilp(query);
+
+    msgbuf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    *msgbuf = 0;
+
+    switch (oci_status) {
+
+        case OCI_NEED_DATA:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_NEED_DATA");
+            break;
+        case OCI_NO_DATA:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_NO_DATA");
+            break;
+        case OCI_ERROR:
+
+            if (connection == 0)
+                snprintf(msgbuf, STACK_BUFFER_SIZE, "NULL connection");
+            else {
+                oci_status_t oci_status1;
+                char         errorbuf[1024];
+
+                oci_status1 = OCIErrorGet(connection->err,
+                                          1,
+                                          NULL,
+                                          &errorcode,
+                                          errorbuf,
+                                          sizeof errorbuf, OCI_HTYPE_ERROR);
+                if (oci_status1) {
+                    snprintf(msgbuf, STACK_BUFFER_SIZE,
+                             "`OCIErrorGet ()' error");
+                } else {
+                    snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", errorbuf);
+                }
+
+                oci_status1 = OCIAttrGet(connection->stmt,
+                                         OCI_HTYPE_STMT,
+                                         &offset,
+                                         NULL,
+                                         OCI_ATTR_PARSE_ERROR_OFFSET,
+                                         connection->err);
+
+                if (errorcode == 1041 || 
+                    errorcode == 3113 || 
+                    errorcode == 12571 ||
+                    errorcode == 28 ||
+                    errorcode == 1012 ||
+                    errorcode == 24324) {
+
+                    /* 3113 is 'end-of-file on communications channel', which
+                     *      happens if the oracle process dies
+                     * 12571 is TNS:packet writer failure, which also happens if
+                     *      the oracle process dies
+                     * 1041 is the dreaded "hostdef extension doesn't exist error,
+                     *      which means the db handle is screwed and can't be used
+                     *      for anything else.
+                     *
+                     * In either case, close and re-open the handle to clear the
+                     * error condition
+                     */
+                    Ns_OracleFlush(dbh);
+                    Ns_OracleCloseDb(dbh);
+                }
+
+                if (errorcode == 20 || errorcode == 1034) {
+                    /* ora-00020 means 'maximum number of processes exceeded.
+                     * ora-01034 means 'oracle not available'.
+                     *           we want to make sure the oracleSID process
+                     *           goes away so we don't make the problem worse
+                     */
+                    Ns_OracleCloseDb(dbh);
+                }
+            }
+            break;
+        case OCI_INVALID_HANDLE:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_INVALID_HANDLE");
+            break;
+        case OCI_STILL_EXECUTING:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_STILL_EXECUTING");
+            break;
+        case OCI_CONTINUE:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_CONTINUE");
+            break;
+    }
+
+    if (((errorcode == 900) || (offset > 0)) && (strlen(query) >= offset)) {
+        /* ora-00900 is invalid sql statment
+         *           it seems to be the msg most likely to be a parse
+         *           error that sets offset to 0
+         */
+        int len;
+        len = snprintf(buf, STACK_BUFFER_SIZE,
+                       "%s:%d:%s: error in `%s ()': %s\nSQL: ",
+                       file, line, fn, ocifn, msgbuf);
+        if (offset > 0)
+            len +=
+                snprintf(buf + len, STACK_BUFFER_SIZE - len, "%.*s",
+                         offset - 1, query);
+
+        snprintf(buf + len, STACK_BUFFER_SIZE - len, " !>>>!%s",
+                 query + offset);
+    } else {
+        snprintf(buf, STACK_BUFFER_SIZE,
+                 "%s:%d:%s: error in `%s ()': %s\nSQL: %s",
+                 file, line, fn, ocifn, msgbuf, query);
+    }
+
+    Ns_Log(Error, "%s", buf);
+
+    /* We need to call this so that AOLserver will print out the relevant
+     * error on pages served to browsers where ClientDebug is set.
+     */
+    snprintf(exceptbuf, EXCEPTION_CODE_SIZE, "%d", (int) errorcode);
+    Ns_DbSetException(dbh, exceptbuf, buf);
+
+    Ns_Free(msgbuf);
+    Ns_Free(buf);
+
+    return 1;
+}
+/*}}}*/
+
+/*{{{ tcl_error_p */
+/* tcl_error_p is only used for ns_ora and potentialy other new Tcl commands
+   does not log the error and does not Ns_DbSetException but instead just
+   tells the Tcl interpreter about it
+ */
+static int
+tcl_error_p(const char *file, int line, const char *fn,
+            Tcl_Interp * interp,
+            Ns_DbHandle * dbh, char *ocifn, char *query,
+            oci_status_t oci_status)
+{
+    char *msgbuf;
+    char *buf;
+    ora_connection_t *connection = 0;
+    ub2 offset = 0;
+    sb4 errorcode = 0;
+
+    if (dbh)
+        connection = dbh->connection;
+
+    /* success */
+    if (oci_status == OCI_SUCCESS)
+        return 0;
+
+    query = nilp(query);
+    msgbuf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    *msgbuf = 0;
 
-        case SQLT_LNG:
-            oci_status = OCIDefineByPos(connection->stmt,
-                                        &fetchbuf->def,
-                                        connection->err,
-                                        i + 1,
-                                        0,
-                                        (sb4) SB4MAXVAL,
-                                        fetchbuf->type,
-                                        &fetchbuf->is_null,
-                                        &fetchbuf->fetch_length,
-                                        0, OCI_DYNAMIC_FETCH);
+    switch (oci_status) {
+    case OCI_SUCCESS_WITH_INFO:
+        snprintf(msgbuf, STACK_BUFFER_SIZE,
+                 "Error - OCI_SUCCESS_WITH_INFO");
+        break;
+    case OCI_NEED_DATA:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_NEED_DATA");
+        break;
+    case OCI_NO_DATA:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_NO_DATA");
+        break;
+    case OCI_ERROR:
+        if (connection == 0)
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "NULL connection");
+        else {
+            char errorbuf[512];
+            oci_status_t oci_status1;
 
-            if (oci_error_p
-                (lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
-            }
+            oci_status1 = OCIErrorGet(connection->err,
+                                      1,
+                                      NULL,
+                                      &errorcode,
+                                      errorbuf,
+                                      sizeof errorbuf, OCI_HTYPE_ERROR);
 
-            ns_ora_log(lexpos(), "`OCIDefineDynamic ()' success");
-            break;
+            if (oci_status1) {
+                snprintf(msgbuf, STACK_BUFFER_SIZE, "`OCIErrorGet ()' error");
+            } else {
+                snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", errorbuf);
+            }
 
-        default:
-            oci_status = OCIDefineByPos(connection->stmt,
-                                        &fetchbuf->def,
-                                        connection->err,
-                                        i + 1,
-                                        fetchbuf->buf,
-                                        fetchbuf->buf_size,
-                                        SQLT_STR,
-                                        &fetchbuf->is_null,
-                                        &fetchbuf->fetch_length,
-                                        NULL, OCI_DEFAULT);
+            oci_status1 = OCIAttrGet(connection->stmt,
+                                     OCI_HTYPE_STMT,
+                                     &offset,
+                                     NULL,
+                                     OCI_ATTR_PARSE_ERROR_OFFSET,
+                                     connection->err);
 
-            if (oci_error_p
-                (lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
+            if (errorcode == 1041 || errorcode == 3113
+                || errorcode == 12571 || errorcode == 1012 
+                || errorcode == 28) {
+                /* 3113 is 'end-of-file on communications channel', which
+                 *      happens if the oracle process dies
+                 * 12571 is TNS:packet writer failure, which also happens if
+                 *      the oracle process dies
+                 * 1041 is the dreaded "hostdef extension doesn't exist error,
+                 *      which means the db handle is screwed and can't be used
+                 *      for anything else.
+                 * 1012 (not logged on) and 28 (session killed) mean the
+                 *      session is gone, though the server isn't.
+                 * In either case, close and re-open the handle to clear the
+                 * error condition
+                 */
                 Ns_OracleFlush(dbh);
-                return 0;
+                Ns_OracleCloseDb(dbh);
+                Ns_OracleOpenDb(dbh);
+                stats_incr(&ora_stats.error_reopens);
             }
-            break;
         }
+        break;
+    case OCI_INVALID_HANDLE:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_INVALID_HANDLE");
+        break;
+    case OCI_STILL_EXECUTING:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_STILL_EXECUTING");
+        break;
+    case OCI_CONTINUE:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_CONTINUE");
+        break;
     }
 
-    return row;
+    snprintf(buf, STACK_BUFFER_SIZE,
+             "%s:%d:%s: error in `%s ()': %s\nSQL: %s", file, line, fn,
+             ocifn, msgbuf, query);
+
+    Ns_Log(Error, "SQL(): %s", buf);
+
+    Tcl_AppendResult(interp, buf, NULL);
+
+    /* error */
+    Ns_Free(msgbuf);
+    Ns_Free(buf);
+
+    return 1;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleGetRow */
-/*----------------------------------------------------------------------
- * Ns_OracleGetRow --
- *
- *      Fetch the next row of the result set into the row Ns_Set.
- *
- *      Implements [ns_db getrow] 
- * 
- *----------------------------------------------------------------------
+/*{{{ execute_statement */
+/*
+ * execute_statement runs OCIStmtExecute.  If Oracle has discarded the
+ * session's package state (ORA-04068, 04061 or 04065, after a package
+ * the session used was recompiled), a plain SQL statement, or a block
+ * that makes nothing but a single call (see plsql_single_call_p), has
+ * not run any of itself yet, so it is run once more, which
+ * instantiates the new package.  Any other PL/SQL block may have done
+ * part of its work before the error, so it isn't run again: the
+ * session's packages are reset instead (see reset_packages), and the
+ * error is left for the caller to report, as is a second failure.
  */
-static int 
-Ns_OracleGetRow (Ns_DbHandle *dbh, Ns_Set *row)
+static oci_status_t
+execute_statement(Ns_DbHandle *dbh, OCIStmt *stmt, ub4 iters, ub4 mode,
+                  char *query)
 {
-    oci_status_t oci_status;
-    ora_connection_t *connection;
-    int i;
-    ub4 ret_len = 0;
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    sb4               errorcode = 0;
+    char              errorbuf[512];
+    ub2               type = 0;
+    OCIError         *err = NULL;
 
-    ns_ora_log(lexpos(), "entry (dbh %p, row %p)", dbh, row);
+    oci_status = OCIStmtExecute(connection->svc, stmt, connection->err,
+                                iters, 0, NULL, NULL, mode);
 
-    if (!dbh || !row) {
-        error(lexpos(), "invalid args.");
-        return NS_ERROR;
+    if (oci_status != OCI_ERROR
+        || OCIErrorGet(connection->err, 1, NULL, &errorcode, errorbuf,
+                       sizeof errorbuf, OCI_HTYPE_ERROR) != OCI_SUCCESS
+        || (errorcode != 4068 && errorcode != 4061 && errorcode != 4065)) {
+        return oci_status;
     }
 
-    connection = dbh->connection;
-    if (connection == 0) {
-        error(lexpos(), "no connection.");
-        return NS_ERROR;
+    /* connection->err keeps the error for the caller */
+    if (OCIHandleAlloc(connection->env, (oci_handle_t **) &err,
+                       OCI_HTYPE_ERROR, 0, NULL) != OCI_SUCCESS) {
+        return oci_status;
     }
 
-    if (row == 0) {
-        error(lexpos(), "invalid argument, `NULL' row");
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
-    }
+    OCIAttrGet(stmt, OCI_HTYPE_STMT, (oci_attribute_t *) &type, NULL,
+               OCI_ATTR_STMT_TYPE, err);
 
-    if (connection->stmt == 0) {
-        error(lexpos(), "no active select");
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+    if ((type != OCI_STMT_BEGIN && type != OCI_STMT_DECLARE)
+        || plsql_single_call_p(query)) {
+        Ns_Log(Notice, "%s: ORA-%05d, package state discarded; "
+               "running the statement again: %s", 
+               ora_driver_name, (int) errorcode, nilp(query));
+        oci_status = OCIStmtExecute(connection->svc, stmt, connection->err,
+                                    iters, 0, NULL, NULL, mode);
+    } else {
+        Ns_Log(Notice, "%s: ORA-%05d, package state discarded; "
+               "resetting the session's packages after: %s", 
+               ora_driver_name, (int) errorcode, nilp(query));
+        reset_packages(dbh, err);
     }
 
-    /* fetch */
-    oci_status = OCIStmtFetch(connection->stmt,
-                              connection->err,
-                              1, OCI_FETCH_NEXT, OCI_DEFAULT);
+    OCIHandleFree(err, OCI_HTYPE_ERROR);
 
-    if (oci_status == OCI_NEED_DATA) {
-        ;
-    } else if (oci_status == OCI_NO_DATA) {
-        /*  We've reached beyond the last row of the select, so flush the
-         *  statement and tell AOLserver that it isn't going to get
-         *  anything more out of us. 
-         */
-        ns_ora_log(lexpos(), "return NS_END_DATA;");
+    return oci_status;
+}
+/*}}}*/
 
-        if (Ns_OracleFlush(dbh) != NS_OK)
-            return NS_ERROR;
-        else
-            return NS_END_DATA;
-    } else if (oci_error_p(lexpos(), dbh, "OCIStmtFetch", 0, oci_status)) {
-        /* We got some other kind of error */
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
-    }
+/*{{{ plsql_single_call_p */
+/* whether query is an anonymous block that does nothing but call one
+   procedure or function, with only binds and literals for arguments:
 
-    /* Fetched succeeded; copy fetch buffers (one/column) into the ns_set */
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+       BEGIN [:result :=] name[(arguments)]; END;
 
-        switch (fetchbuf->type) {
-        case OCI_TYPECODE_CLOB:
-        case OCI_TYPECODE_BLOB:
+   ns_ora call's blocks are of this kind.  Nothing in such a block has
+   run when the call fails with ORA-04068, so it is safe to run again. */
+static int
+plsql_single_call_p(char *query)
+{
+    char *p = query;
+    char *word;
+    int   length;
+    int   depth;
 
-            if (fetchbuf->is_null == -1) {
-                Ns_SetPutValue(row, i, "");
-            } else if (fetchbuf->is_null != 0) {
-                error(lexpos(), "invalid fetch buffer is_null");
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            } else {
-                /* CLOB is not null, let's grab it. We use an Ns_DString
-                   to do this, because when dealing with variable width
-                   character sets, a single character can be many bytes long
-                   (in UTF8, up to six). */
-                ub4 lob_length = 0;
-                Ns_DString retval;
-                ub1 *bufp;
+    if (p == NULL)
+        return 0;
 
-                /* Get length of LOB, in characters for CLOBs and bytes
-                   for BLOBs. */
-                oci_status = OCILobGetLength(connection->svc,
-                                             connection->err,
-                                             fetchbuf->lob, &lob_length);
-                if (oci_error_p(lexpos(), dbh, "OCILobGetLength",
-                                0, oci_status)) {
-                    Ns_OracleFlush(dbh);
-                    return NS_ERROR;
+#define SKIP_SPACE(p)  while (isspace((unsigned char) *(p))) (p)++
+#define WORD_CHAR(c)   (isalnum((unsigned char) (c)) || (c) == '_' \
+                        || (c) == '$' || (c) == '#')
+
+    SKIP_SPACE(p);
+    if (strncasecmp(p, "begin", 5) || WORD_CHAR(p[5]))
+        return 0;
+    p += 5;
+    SKIP_SPACE(p);
+
+    if (*p == ':') {
+        for (p++; WORD_CHAR(*p); p++)
+            ;
+        SKIP_SPACE(p);
+        if (p[0] != ':' || p[1] != '=')
+            return 0;
+        p += 2;
+        SKIP_SPACE(p);
+    }
+
+    if (!WORD_CHAR(*p) && *p != '"')
+        return 0;
+    while (WORD_CHAR(*p) || *p == '.' || *p == '"')
+        p++;
+    SKIP_SPACE(p);
+
+    if (*p == '(') {
+        /* anything but binds, literals and parameter names might be
+           a call, or a subquery, that ran before the error */
+        for (p++, depth = 1; depth > 0; ) {
+            SKIP_SPACE(p);
+            if (*p == '\'') {
+                for (p++; *p != '\'' || p[1] == '\''; p++) {
+                    if (*p == '\0')
+                        return 0;
+                    if (*p == '\'')
+                        p++;
+                }
+                p++;
+            } else if (*p == ':') {
+                for (p++; WORD_CHAR(*p); p++)
+                    ;
+            } else if (WORD_CHAR(*p) || *p == '"') {
+                word = p;
+                while (WORD_CHAR(*p) || *p == '.' || *p == '"')
+                    p++;
+                length = p - word;
+                SKIP_SPACE(p);
+                if (p[0] == '=' && p[1] == '>') {
+                    p += 2;
+                } else if (!isdigit((unsigned char) *word)
+                           && !(length == 7 && !strncasecmp(word, "sysdate", 7))
+                           && !(length == 4 && !strncasecmp(word, "null", 4))
+                           && !(length == 4 && !strncasecmp(word, "true", 4))
+                           && !(length == 5 && !strncasecmp(word, "false", 5))) {
+                    return 0;
                 }
+            } else if (*p == '(') {
+                depth++;
+                p++;
+            } else if (*p == ')') {
+                depth--;
+                p++;
+            } else if (*p == ',' || *p == '-' || *p == '+') {
+                p++;
+            } else {
+                return 0;
+            }
+        }
+        SKIP_SPACE(p);
+    }
 
-                /* Initialize the buffer we're going to use for the value. */
-                bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
-                Ns_DStringInit(&retval);
+    if (*p != ';')
+        return 0;
+    p++;
+    SKIP_SPACE(p);
+    if (strncasecmp(p, "end", 3) || WORD_CHAR(p[3]))
+        return 0;
+    p += 3;
+    SKIP_SPACE(p);
+    if (*p == ';') {
+        p++;
+        SKIP_SPACE(p);
+    }
 
-                /* Do the read. */
-                oci_status = OCILobRead(connection->svc,
-                                        connection->err,
-                                        fetchbuf->lob,
-                                        &lob_length,
-                                        (ub4) 1,
-                                        bufp,
-                                        lob_buffer_size,
-                                        &retval, (OCICallbackLobRead)
-                                        ora_append_buf_to_dstring, (ub2) 0,
-                                        (ub1) SQLCS_IMPLICIT);
+#undef SKIP_SPACE
+#undef WORD_CHAR
 
-                if (oci_error_p
-                    (lexpos(), dbh, "OCILobRead", 0, oci_status)) {
-                    Ns_OracleFlush(dbh);
-                    Ns_DStringFree(&retval);
-                    Ns_Free(bufp);
-                    return NS_ERROR;
-                }
+    return *p == '\0';
+}
+/*}}}*/
+
+/*{{{ reset_packages */
+/* run DBMS_SESSION.RESET_PACKAGE on the session, with err as the error
+   handle so the caller's error stays where it is; a failure is only
+   logged, as the next call hits the discarded state again anyway. */
+static void
+reset_packages(Ns_DbHandle *dbh, OCIError *err)
+{
+    ora_connection_t *connection = dbh->connection;
+    OCIStmt          *stmt = NULL;
+    oci_status_t      oci_status;
+    static char       sql[] = "BEGIN DBMS_SESSION.RESET_PACKAGE; END;";
 
-                Ns_SetPutValue(row, i, Ns_DStringValue(&retval));
-                Ns_DStringFree(&retval);
-                Ns_Free(bufp);
-            }
-            break;
+    oci_status = OCIHandleAlloc(connection->env, (oci_handle_t **) &stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (oci_status == OCI_SUCCESS) {
+        oci_status = OCIStmtPrepare(stmt, err, (text *) sql, strlen(sql),
+                                    OCI_NTV_SYNTAX, OCI_DEFAULT);
+    }
+    if (oci_status == OCI_SUCCESS) {
+        oci_status = OCIStmtExecute(connection->svc, stmt, err, 1, 0,
+                                    NULL, NULL, OCI_DEFAULT);
+    }
+    if (oci_status != OCI_SUCCESS) {
+        Ns_Log(Warning, "%s: DBMS_SESSION.RESET_PACKAGE failed (%d)",
+               ora_driver_name, (int) oci_status);
+    }
 
-        case SQLT_LNG:
-            /* this is broken for multi-part LONGs.  LONGs are being deprecated
-             * by Oracle anyway, so no big loss
-             *
-             * Maybe fixed by davis@arsdigita.com
-             */
-            if (fetchbuf->is_null == -1)
-                fetchbuf->buf[0] = 0;
-            else if (fetchbuf->is_null != 0) {
-                error(lexpos(), "invalid fetch buffer is_null");
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            } else {
-                fetchbuf->buf[0] = 0;
-                fetchbuf->fetch_length = 0;
-                ret_len = 0;
+    if (stmt != NULL)
+        OCIHandleFree(stmt, OCI_HTYPE_STMT);
+}
+/*}}}*/
 
-                ns_ora_log(lexpos(), "LONG start: buf_size=%d fetched=%d\n",
-                    fetchbuf->buf_size, fetchbuf->fetch_length);
+/*{{{ error */
+/* For logging errors that come from C code rather than 
+ * Oracle unhappiness.
+ */
+static void 
+error(const char *file, int line, const char *fn, char *fmt, ...)
+{
+    char *buf1;
+    char *buf;
+    va_list ap;
 
-                do {
-                    //dvoid *def;
-                    ub1 inoutp;
-                    ub1 piece;
-                    ub4 type;
-                    ub4 iterp;
-                    ub4 idxp;
+    buf1 = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
 
-                    fetchbuf->fetch_length += ret_len;
-                    if (fetchbuf->fetch_length > fetchbuf->buf_size / 2) {
-                        fetchbuf->buf_size *= 2;
-                        fetchbuf->buf =
-                            ns_realloc(fetchbuf->buf, fetchbuf->buf_size);
-                    }
-                    ret_len = fetchbuf->buf_size - fetchbuf->fetch_length;
+    va_start(ap, fmt);
+    vsprintf(buf1, fmt, ap);
+    va_end(ap);
 
-                    oci_status = OCIStmtGetPieceInfo(connection->stmt,
-                                                     connection->err,
-                                                     (dvoid **) &
-                                                     fetchbuf->def, &type,
-                                                     &inoutp, &iterp,
-                                                     &idxp, &piece);
+    snprintf(buf, STACK_BUFFER_SIZE, "%s:%d:%s: %s", file, line, fn, buf1);
 
-                    if (oci_error_p
-                        (lexpos(), dbh, "OCIStmtGetPieceInfo", 0,
-                         oci_status)) {
-                        Ns_OracleFlush(dbh);
-                        return NS_ERROR;
-                    }
+    Ns_Log(Error, "%s", buf);
 
-                    oci_status = OCIStmtSetPieceInfo(fetchbuf->def,
-                                                     OCI_HTYPE_DEFINE,
-                                                     connection->err,
-                                                     (void *) (fetchbuf->
-                                                               buf +
-                                                               fetchbuf->
-                                                               fetch_length),
-                                                     &ret_len, piece, 
-                                                     &fetchbuf->is_null,
-                                                     NULL);
+    Ns_Free(buf1);
+    Ns_Free(buf);
+} 
+/*}}}*/
 
-                    if (oci_error_p
-                        (lexpos(), dbh, "OCIStmtGetPieceInfo", 0,
-                         oci_status)) {
-                        Ns_OracleFlush(dbh);
-                        return NS_ERROR;
-                    }
+/*{{{ log */
+/*  For optional logging of all kinds of random stuff, turn on 
+ *  debug in the [ns/db/driver/drivername] section of your nsd.ini
+ */
+static void 
+ns_ora_log(const char *file, int line, const char *fn, char *fmt, ...)
+{
+    char *buf1;
+    char *buf;
+    va_list ap;
 
-                    oci_status = OCIStmtFetch(connection->stmt,
-                                              connection->err,
-                                              1,
-                                              OCI_FETCH_NEXT, OCI_DEFAULT);
+    if (!debug_p) {
+        return;
+    }
 
-                    ns_ora_log(lexpos(),
-                        "LONG: status=%d ret_len=%d buf_size=%d fetched=%d\n",
-                        oci_status, ret_len, fetchbuf->buf_size,
-                        fetchbuf->fetch_length);
+    buf1 = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
 
-                    if (oci_status != OCI_NEED_DATA
-                        && oci_error_p(lexpos(), dbh, "OCIStmtFetch", 0,
-                                       oci_status)) {
-                        Ns_OracleFlush(dbh);
-                        return NS_ERROR;
-                    }
+    va_start(ap, fmt);
+    vsprintf(buf1, fmt, ap);
+    va_end(ap);
 
-                    if (oci_status == OCI_NO_DATA)
-                        break;
+    snprintf(buf, STACK_BUFFER_SIZE, "%s:%d:%s: %s", file, line, fn, buf1);
 
-                } while (oci_status == OCI_SUCCESS_WITH_INFO ||
-                         oci_status == OCI_NEED_DATA);
+    Ns_Log(Notice, "%s", buf);
 
-            }
+    Ns_Free(buf1);
+    Ns_Free(buf);
+} 
+/*}}}*/
 
-            fetchbuf->buf[fetchbuf->fetch_length] = 0;
-            ns_ora_log(lexpos(), "LONG done: status=%d buf_size=%d fetched=%d\n",
-                oci_status, fetchbuf->buf_size, fetchbuf->fetch_length);
+/*{{{ malloc_fetch_buffers*/
+/*
+ * malloc_fetch_buffers allocates the fetch_buffers array in the
+ * specified connection.  connection->n_columns must be set to the
+ * correct number before calling this function.
+ */
+static void 
+malloc_fetch_buffers(ora_connection_t * connection)
+{
+    int i;
 
-            Ns_SetPutValue(row, i, fetchbuf->buf);
+    connection->fetch_buffers
+        =
+        Ns_Malloc(connection->n_columns *
+                  sizeof *connection->fetch_buffers);
 
-            break;
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
 
-        default:
-            /* add null termination and then do an ns_set put */
-            if (fetchbuf->is_null == -1)
-                fetchbuf->buf[0] = 0;
-            else if (fetchbuf->is_null != 0) {
-                error(lexpos(), "invalid fetch buffer is_null");
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            } else
-                fetchbuf->buf[fetchbuf->fetch_length] = 0;
+        fetchbuf->connection = connection;
 
-            Ns_SetPutValue(row, i, fetchbuf->buf);
+        fetchbuf->type = 0;
+        fetchbuf->lob = NULL;
+        fetchbuf->bind = NULL;
+        fetchbuf->def = NULL;
+        fetchbuf->size = 0;
+        fetchbuf->buf_size = 0;
+        fetchbuf->buf = NULL;
+        fetchbuf->stmt = NULL;
+        fetchbuf->array_list = NULL;
+        fetchbuf->array_rows = NULL;
+        fetchbuf->array_sets_p = 0;
+        fetchbuf->array_count = 0;
+        fetchbuf->array_values = NULL;
+        fetchbuf->returning_width = 0;
+        fetchbuf->returning_iters = 0;
+        fetchbuf->returning_rows = 0;
+        fetchbuf->returned = NULL;
+        fetchbuf->returned_dummy = NULL;
+        fetchbuf->returned_list = NULL;
+        fetchbuf->max_elements = 0;
+        fetchbuf->n_elements = 0;
+        fetchbuf->indicators = NULL;
+        fetchbuf->lengths = NULL;
+        fetchbuf->rcodes = NULL;
+        fetchbuf->is_null = 0;
+        fetchbuf->fetch_length = 0;
+        fetchbuf->piecewise_fetch_length = 0;
+        fetchbuf->out_length = 0;
+        fetchbuf->inout = 0;
+        fetchbuf->name = NULL;
 
-            break;
-        }
+        fetchbuf->lobs = NULL;
+        fetchbuf->is_lob = 0;
+        fetchbuf->is_temporary = 0;
+        fetchbuf->lob_path = NULL;
+        fetchbuf->n_rows = 0;
     }
 
-    return NS_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleFlush */
-/*----------------------------------------------------------------------
- * Ns_OracleFlush --
- *
- *      Used to clean up after an error or after we've reached the
- *      end of a result set.  Frees fetch buffers.
- *
- *      Implements [ns_db flush] 
- *
- *----------------------------------------------------------------------
+/*{{{ free_fetch_buffers*/
+/*
+ * free_fetch_buffers frees the fetch_buffers array in the specified
+ * connection.  connection->n_columns must have the same value as it
+ * did when malloc_fetch_buffers was called.  The non-NULL
+ * dynamically-allocated components of each fetchbuf will also be freed.
  */
-static int 
-Ns_OracleFlush (Ns_DbHandle *dbh)
+static void 
+free_fetch_buffers(ora_connection_t * connection)
 {
-    ora_connection_t *connection;
-    oci_status_t      oci_status;
-    int i;
+    if (connection != NULL && connection->fetch_buffers != NULL) {
+        Ns_DbHandle *dbh = connection->dbh;
+        int i;
+        int j;
+        oci_status_t oci_status;
 
-    ns_ora_log(lexpos(), "entry (dbh %p, row %p)", dbh, 0);
+        for (i = 0; i < connection->n_columns; i++) {
+            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
 
-    if (dbh == 0) {
-        error(lexpos(), "invalid args, `NULL' database handle");
-        return NS_ERROR;
-    }
+            free_temporary_lob(connection, fetchbuf);
 
-    connection = dbh->connection;
+            if (fetchbuf->stmt != NULL) {
+                oci_status = OCIHandleFree(fetchbuf->stmt, OCI_HTYPE_STMT);
+                oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+                fetchbuf->stmt = NULL;
+            }
 
-    if (connection == 0) {
-        /* Connection is closed.  That's as good as flushed to me */
-        return NS_OK;
-    }
-    
-    if (connection->stmt != 0) {
-        oci_status = OCIHandleFree(connection->stmt, OCI_HTYPE_STMT);
-        if (oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status))
-            return NS_ERROR;
-        connection->stmt = 0;
-    } 
+            if (fetchbuf->lob != NULL) {
+                oci_status =
+                    OCIDescriptorFree(fetchbuf->lob, OCI_DTYPE_LOB);
+                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
+                            oci_status);
+                fetchbuf->lob = NULL;
+            }
 
-    connection->interp = NULL;
+            /*
+             * fetchbuf->bind is automatically deallocated when its
+             * statement is deallocated.
+             *
+             * Same for fetchbuf->def, I believe, though the manual
+             * doesn't say.
+             */
+
+            if (fetchbuf->buf != NULL) {
+                Ns_Free(fetchbuf->buf);
+                fetchbuf->buf = NULL;
+                fetchbuf->buf_size = 0;
+            }
 
-    if (connection->fetch_buffers != 0) {
-        for (i = 0; i < connection->n_columns; i++) {
-            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+            free_array_values(fetchbuf);
 
-            ns_ora_log(lexpos(), "fetchbuf %d, %p, %d, %p, %p, %p", i, fetchbuf,
-                fetchbuf->type, fetchbuf->lob, fetchbuf->buf,
-                fetchbuf->lobs);
+            free_returned_values(fetchbuf);
 
-            if (fetchbuf->lob != 0) {
-                oci_status =
-                    OCIDescriptorFree(fetchbuf->lob, OCI_DTYPE_LOB);
-                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
-                            oci_status);
-                fetchbuf->lob = 0;
+            if (fetchbuf->indicators != NULL) {
+                Ns_Free(fetchbuf->indicators);
+                Ns_Free(fetchbuf->lengths);
+                Ns_Free(fetchbuf->rcodes);
+                fetchbuf->indicators = NULL;
+                fetchbuf->lengths = NULL;
+                fetchbuf->rcodes = NULL;
             }
 
-            Ns_Free(fetchbuf->buf);
-            fetchbuf->buf = NULL;
-            Ns_Free(fetchbuf->array_values);
-            fetchbuf->array_values = NULL;
-
             if (fetchbuf->lobs != 0) {
-                int k;
-                for (k = 0; k < (int) fetchbuf->n_rows; k++) {
-                    oci_status = OCIDescriptorFree(fetchbuf->lobs[k],
+                for (j = 0; j < fetchbuf->n_rows; j++) {
+                    oci_status = OCIDescriptorFree(fetchbuf->lobs[j],
                                                    OCI_DTYPE_LOB);
                     oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
                                 oci_status);
@@ -3908,1353 +10062,1959 @@ Ns_OracleFlush (Ns_DbHandle *dbh)
         }
 
         Ns_Free(connection->fetch_buffers);
-        connection->fetch_buffers = 0;
+        connection->fetch_buffers = NULL;
     }
-
-    return NS_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleResetHandle */
-/*----------------------------------------------------------------------
- * Ns_OracleResetHandle --
- *
- *      Called by AOLserver when a handle is returned to the
- *      database pool.
- *
- *----------------------------------------------------------------------
- */
+/*{{{ handle_builtins*/
+
+/* this gets called on every query or dml.  Usually it will 
+   return NS_OK ("I did nothing").  If the SQL is one of our special 
+   cases, e.g., "begin transaction", that aren't supposed to go through
+   to Oracle, we handle it and return NS_DML ("I handled it and nobody 
+   else has do anything").
+
+   return NS_ERROR on error
+*/
 static int 
-Ns_OracleResetHandle (Ns_DbHandle *dbh)
+handle_builtins(Ns_DbHandle * dbh, char *sql)
 {
     oci_status_t oci_status;
     ora_connection_t *connection;
 
-    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
-
-    if (!dbh) {
-        error(lexpos(), "invalid args.");
-        return 0;
-    }
+    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
 
+    /* args should be correct */
     connection = dbh->connection;
-    if (!connection) {
-        error(lexpos(), "no connection.");
-        return 0;
-    }
-
-    if (connection->mode == transaction) {
-        oci_status = OCITransRollback(connection->svc,
-                                      connection->err, OCI_DEFAULT);
-        if (oci_error_p(lexpos(), dbh, "OCITransRollback", 0, oci_status))
-            return NS_ERROR;
-
-        connection->mode = autocommit;
-    }
-
-    return NS_OK;
-}
-/*}}}*/
-
-/* 
- * Utility functions for dealing with string lists.
- *
- */
-
-/*{{{ snprintf (WIN32) */
-#ifdef WIN32
-/*
- * This is a GNU extension that isn't present on Windows.
- */
-static int snprintf(char *buf, int len, const char *fmt, ...)
-{
-    va_list ap;
-    int cc;
-
-    va_start(ap, fmt);
-    cc = vsprintf(buf, fmt, ap);
-    va_end(ap);
-    return cc;
-}
-#endif
-/*}}}*/
-
-/*{{{ string_list_elt_t */
-static string_list_elt_t *
-string_list_elt_new(char *string)
-{
-    string_list_elt_t *elt =
-        (string_list_elt_t *) Ns_Malloc(sizeof(string_list_elt_t));
-    elt->string = string;
-    elt->next = 0;
-
-    return elt;
-}
-/*}}}*/
-
-/*{{{ string_list_len */
-static int 
-string_list_len(string_list_elt_t * head)
-{
-    int i = 0;
-
-    while (head != NULL) {
-        i++;
-        head = head->next;
-    }
-
-    return i;
-}
-/*}}}*/
-
-/*{{{ string_list_free_list */
-static void 
-string_list_free_list(string_list_elt_t * head)
-{
-    string_list_elt_t *elt;
-
-    while (head) {
-        Ns_Free(head->string);
-        elt = head->next;
-        Ns_Free(head);
-        head = elt;
-    }
 
-}
-/*}}}*/
+    if (!strcasecmp(sql, "begin transaction")) {
+        ns_ora_log(lexpos(), "builtin `begin transaction`");
 
-/*{{{ parse_bind_variables  */
-static string_list_elt_t *
-parse_bind_variables(char *input)
-{
-    char *p, lastchar;
-    enum { base, instr, bind } state;
-    char bindbuf[1024], *bp = bindbuf;
-    string_list_elt_t *elt, *head = 0, *tail = 0;
-    int current_string_length = 0;
+        connection->mode = transaction;
 
-    for (p = input, state = base, lastchar = '\0'; *p != '\0';
-         lastchar = *p, p++) {
+        return NS_DML;
+    } else if (!strcasecmp(sql, "end transaction")) {
+        ns_ora_log(lexpos(), "builtin `end transaction`");
 
-        switch (state) {
-        case base:
-            if (*p == '\'') {
-                state = instr;
-                current_string_length = 0;
-            } else if (*p == ':') {
-                bp = bindbuf;
-                state = bind;
-            }
-            break;
+        oci_status = OCITransCommit(connection->svc,
+                                    connection->err, OCI_DEFAULT);
+        if (oci_error_p(lexpos(), dbh, "OCITransCommit", sql, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return NS_ERROR;
+        }
 
-        case instr:
-            if (*p == '\''
-                && (lastchar != '\'' || current_string_length == 0)) {
-                state = base;
-            }
-            current_string_length++;
-            break;
+        connection->mode = autocommit;
+        return NS_DML;
+    } else if (!strcasecmp(sql, "abort transaction")) {
+        ns_ora_log(lexpos(), "builtin `abort transaction`");
 
-        case bind:
-            if (*p == '=') {
-                state = base;
-                bp = bindbuf;
-            } else if (!
-                       (*p == '_' || *p == '$' || *p == '#'
-                        || isalnum((int) *p))) {
-                *bp = '\0';
-                elt = string_list_elt_new(Ns_StrDup(bindbuf));
-                if (tail == 0) {
-                    head = tail = elt;
-                } else {
-                    tail->next = elt;
-                    tail = elt;
-                }
-                state = base;
-                p--;
-            } else {
-                *bp++ = *p;
-            }
-            break;
+        oci_status = OCITransRollback(connection->svc,
+                                      connection->err, OCI_DEFAULT);
+        if (oci_error_p
+            (lexpos(), dbh, "OCITransRollback", sql, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return NS_ERROR;
         }
+
+        connection->mode = autocommit;
+        return NS_DML;
     }
 
-    if (state == bind) {
-        *bp = '\0';
-        elt = string_list_elt_new(Ns_StrDup(bindbuf));
-        if (tail == 0) {
-            head = tail = elt;
-        } else {
-            tail->next = elt;
-            tail = elt;
-        }
+    if (!allow_sql_p(dbh, sql, NS_FALSE)) {
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
     }
 
-    return head;
+    /* not handled */
+    return NS_OK;
 }
 /*}}}*/
 
-/*{{{ downcase */
-static void 
-downcase(char *s)
-{
-    for (; *s; s++)
-        *s = tolower(*s);
-} 
-/*}}}*/
-
-/*{{{ nilp */
-/* nilp is misnamed to some extent; handle empty or overly long strings 
- *  before printing them out to logs 
- */
-static char *
-nilp(char *s)
+/*{{{ ora_append_buf_to_dstring*/
+/* Callback function for LOB case in ora_get_row. */
+static sb4
+ora_append_buf_to_dstring(dvoid * ctxp, CONST dvoid * bufp, ub4 len,
+                          ub1 piece)
 {
-    if (s == 0)
-        return "[nil]";
-
-    if ((int) strlen(s) > max_string_log_length)
-        return "[too long]";
+    Ns_DString *retval = (Ns_DString *) ctxp;
 
-    return s;
+    switch (piece) {
+        case OCI_LAST_PIECE:
+        case OCI_FIRST_PIECE:
+        case OCI_NEXT_PIECE:
+            Ns_DStringNAppend(retval, (char *) bufp, len);
+            return OCI_CONTINUE;
+
+        default:
+            return OCI_ERROR;
+    }
 }
 /*}}}*/
 
-/*
- * Several helper funtions that get used everywhere.
- */
-
-#ifdef FOR_CASSANDRACLE
-/*{{{ allow_sql_p*/
+/*{{{ no_data*/
 
-/* 
- * Because Cassandracle (http://www.arsdigita.com/free-tools/cassandracle.html)
- * runs with DBA priviliges, we need to prevent anything
- * Bad from happening, whether through malicious intent or just plain
- * human sloppiness.  Selects are pretty safe, so only those are allowed
- * if FOR_CASSANDRACLE is defined, disallow any sql that does not
- * begin with "select".
- *
+/*  This is a function that we register as a callback with Oracle for
+ *  DML statements that do RETURNING FOOBAR INTO ... (this was
+ *  necessitated by the clob_dml statement which was necessitated by
+ *  Oracle's stupid SQL parser that can't handle string literals longer
+ *  than 4000 chars) 
  */
 
-static int allow_sql_p(Ns_DbHandle * dbh, char *sql, int display_sql_p)
+static sb4
+no_data(dvoid * ctxp, OCIBind * bindp,
+        ub4 iter, ub4 index, dvoid ** bufpp, ub4 * alenpp, ub1 * piecep,
+        dvoid ** indpp)
 {
-    char *trimmedSql = sql;
-
-    /* trim off leading white space. (the int cast is necessary for the HP) */
-    while (*trimmedSql && isspace((int) *trimmedSql)) {
-        trimmedSql++;
-    }
-
-
-    /* (damned if you do, damned if you don't.  doing a
-     * strlen("select") each time here is wasteful of CPU which
-     * would offend the sensibilities of half the world.  hard-coding
-     * the "6" offends the other half)
-     */
-    if (strncasecmp(trimmedSql, "select", 6) != 0) {
-        int bufsize = strlen(sql) + 4096;
-
-        /* don't put a 20,000 byte buffer on the stack here, since this case
-         * should be very rare.  allocate enough space for the sql
-         * plus some to handle the other text.  (4K should be enough to
-         * handle the lexpos() call)
-         */
-        char *buf = Ns_Malloc(bufsize);
+    ns_ora_log(lexpos(), "entry");
 
-        /* means someone is trying to do something other than a select.
-         * Bad!  Very Bad!
-         */
-        if (display_sql_p) {
-            snprintf(buf, bufsize, "%s:%d:%s: Sql Rejected: %s",
-                     lexpos(), trimmedSql);
-        } else {
-            snprintf(buf, bufsize, "%s:%d:%s: Sql Rejected", lexpos());
-        }
+    *bufpp = (dvoid *) 0;
+    *alenpp = 0;
+    null_ind = -1;
+    *indpp = (dvoid *) & null_ind;
+    *piecep = OCI_ONE_PIECE;
 
-        Ns_Log(Error, "%s", buf);
+    return OCI_CONTINUE;
+}
+/*}}}*/
 
-        Ns_DbSetException(dbh, "ORA", buf);
+/*{{{ list_element_put_data*/
+/* For use by OCIBindDynamic: returns the iter'th element (0-relative)
+   of the context pointer taken as an array of strings (char**).  A NULL
+   element is bound as a NULL. */
+static sb4
+list_element_put_data(dvoid * ictxp,
+                      OCIBind * bindp,
+                      ub4 iter,
+                      ub4 index,
+                      dvoid ** bufpp,
+                      ub4 * alenp, ub1 * piecep, dvoid ** indpp)
+{
+    fetch_buffer_t *fetchbuf = ictxp;
+    char **elements = fetchbuf->array_values;
 
-        Ns_Free(buf);
+    *piecep = OCI_ONE_PIECE;
 
-        return NS_FALSE;
+    if (elements[iter] == NULL) {
+        /* row-major array DML: the row did not have this column */
+        *bufpp = NULL;
+        *alenp = 0;
+        null_ind = -1;
+        *indpp = (dvoid *) & null_ind;
+        return OCI_CONTINUE;
     }
 
-    return NS_TRUE;
+    *bufpp = elements[iter];
+    *alenp = strlen(elements[iter]);
+    *indpp = NULL;
 
-}                               /* allow_sql_p */
+    return OCI_CONTINUE;
+}
 /*}}}*/
-#endif
 
-/*{{{ oci_error_p */
-/* we call this after every OCI call, i.e., a couple of times during
-   each fetch of a row 
-*/
-static int
-oci_error_p(const char *file, int line, const char *fn,
-            Ns_DbHandle * dbh, char *ocifn, char *query,
-            oci_status_t oci_status)
+/*{{{ get_data*/
+/* another callback to register with Oracle */
+static sb4
+get_data(dvoid * ctxp, OCIBind * bindp,
+         ub4 iter, ub4 index, dvoid ** bufpp, ub4 ** alenp, ub1 * piecep,
+         dvoid ** indpp, ub2 ** rcodepp)
 {
-    ora_connection_t *connection = 0;
-    ub2               offset = 0;
-    sb4               errorcode = 0;
+    Ns_DbHandle      *dbh;
+    ora_connection_t *connection;
+    fetch_buffer_t   *buf;
+    oci_status_t      oci_status;
+    int               i;
 
-    char             *msgbuf;
-    char             *buf;
-    char              exceptbuf[EXCEPTION_CODE_SIZE + 1];
+    ns_ora_log(lexpos(), "entry (dbh %p; iter %d, index %d)", ctxp, iter, index);
 
-    if (dbh) {
-        connection = dbh->connection;
+    if (iter != 0) {
+        error(lexpos(), "iter != 0");
+        return NS_ERROR;
     }
 
-    if (oci_status == OCI_SUCCESS)
-        return 0;
+    buf = ctxp;
+    connection = buf->connection;
+    dbh = connection->dbh;
 
-    /* Until we get the logging situation worked out, return
-     * OCI_SUCCESS_WITH_INFO as a pure success.
-     */
-    if (oci_status == OCI_SUCCESS_WITH_INFO)
-        return 0;
+    if (buf->lobs == 0) {
+        oci_status = OCIAttrGet(bindp,
+                                OCI_HTYPE_BIND,
+                                (oci_attribute_t *) & buf->n_rows,
+                                NULL,
+                                OCI_ATTR_ROWS_RETURNED, connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status))
+            return NS_ERROR;
 
-    /* If the query is long, nilp will return "[too long]"; 
-     * if null (we're not doing a query yet, e.g., could 
-     * be opening db), then "[nil]"  
-     */
-    query = nilp(query);
+        ns_ora_log(lexpos(), "n_rows %d", buf->n_rows);
 
-    msgbuf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    *msgbuf = 0;
+        buf->lobs = Ns_Malloc(buf->n_rows * sizeof *buf->lobs);
 
-    switch (oci_status) {
+        for (i = 0; i < (int) buf->n_rows; i++)
+            buf->lobs[i] = 0;
 
-        case OCI_NEED_DATA:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_NEED_DATA");
-            break;
-        case OCI_NO_DATA:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_NO_DATA");
-            break;
-        case OCI_ERROR:
+        for (i = 0; i < (int) buf->n_rows; i++) {
+            oci_status = OCIDescriptorAlloc(connection->env,
+                                            (oci_descriptor_t *) & buf->
+                                            lobs[i], OCI_DTYPE_LOB, 0, 0);
+            if (oci_error_p
+                (lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status))
+                return NS_ERROR;
+        }
+    }
 
-            if (connection == 0)
-                snprintf(msgbuf, STACK_BUFFER_SIZE, "NULL connection");
-            else {
-                oci_status_t oci_status1;
-                char         errorbuf[1024];
+    *bufpp = (dvoid *) buf->lobs[index];
 
-                oci_status1 = OCIErrorGet(connection->err,
-                                          1,
-                                          NULL,
-                                          &errorcode,
-                                          errorbuf,
-                                          sizeof errorbuf, OCI_HTYPE_ERROR);
-                if (oci_status1) {
-                    snprintf(msgbuf, STACK_BUFFER_SIZE,
-                             "`OCIErrorGet ()' error");
-                } else {
-                    snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", errorbuf);
-                }
+    *alenp = &rl;
+    null_ind = -1;
+    *indpp = (dvoid *) & null_ind;
+    *piecep = OCI_ONE_PIECE;
+    *rcodepp = &rc;
 
-                oci_status1 = OCIAttrGet(connection->stmt,
-                                         OCI_HTYPE_STMT,
-                                         &offset,
-                                         NULL,
-                                         OCI_ATTR_PARSE_ERROR_OFFSET,
-                                         connection->err);
+    return OCI_CONTINUE;
+}
+/*}}}*/
 
-                if (errorcode == 1041 || 
-                    errorcode == 3113 || 
-                    errorcode == 12571 ||
-                    errorcode == 28 ||
-                    errorcode == 1012 ||
-                    errorcode == 24324) {
+/*{{{ returning_get_data*/
+/* OCIBindDynamic out callback for RETURNING INTO binds in array DML.
+ * Oracle calls this once for every row returned by every iteration;
+ * each row gets a slot in the chunk's blocks, which are turned into
+ * list elements once the chunk has been executed (see
+ * returned_values_append).
+ */
+static sb4
+returning_get_data(dvoid * ctxp, OCIBind * bindp,
+                   ub4 iter, ub4 index, dvoid ** bufpp, ub4 ** alenp,
+                   ub1 * piecep, dvoid ** indpp, ub2 ** rcodepp)
+{
+    fetch_buffer_t   *fetchbuf = ctxp;
+    ora_connection_t *connection = fetchbuf->connection;
+    returned_block_t *block;
+    oci_status_t      oci_status;
+    ub4               size;
 
-                    /* 3113 is 'end-of-file on communications channel', which
-                     *      happens if the oracle process dies
-                     * 12571 is TNS:packet writer failure, which also happens if
-                     *      the oracle process dies
-                     * 1041 is the dreaded "hostdef extension doesn't exist error,
-                     *      which means the db handle is screwed and can't be used
-                     *      for anything else.
-                     *
-                     * In either case, close and re-open the handle to clear the
-                     * error condition
-                     */
-                    Ns_OracleFlush(dbh);
-                    Ns_OracleCloseDb(dbh);
-                }
+    ns_ora_log(lexpos(), "entry (fetchbuf %p; iter %d, index %d)", ctxp,
+               iter, index);
 
-                if (errorcode == 20 || errorcode == 1034) {
-                    /* ora-00020 means 'maximum number of processes exceeded.
-                     * ora-01034 means 'oracle not available'.
-                     *           we want to make sure the oracleSID process
-                     *           goes away so we don't make the problem worse
-                     */
-                    Ns_OracleCloseDb(dbh);
-                }
-            }
-            break;
-        case OCI_INVALID_HANDLE:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_INVALID_HANDLE");
-            break;
-        case OCI_STILL_EXECUTING:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_STILL_EXECUTING");
-            break;
-        case OCI_CONTINUE:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_CONTINUE");
-            break;
+    if (index == 0) {
+        oci_status = OCIAttrGet(bindp,
+                                OCI_HTYPE_BIND,
+                                (oci_attribute_t *) & fetchbuf->returning_rows,
+                                NULL,
+                                OCI_ATTR_ROWS_RETURNED, connection->err);
+        if (oci_error_p(lexpos(), connection->dbh, "OCIAttrGet", 0,
+                        oci_status))
+            return OCI_ERROR;
+
+        ns_ora_log(lexpos(), "iter %d returned %d rows", iter,
+                   fetchbuf->returning_rows);
+
+        /* room for this iteration's rows, and likely the rest's */
+        block = fetchbuf->returned;
+        if (fetchbuf->returning_rows > 0
+            && (block == NULL 
+                || block->size - block->used < fetchbuf->returning_rows)) {
+            size = fetchbuf->returning_iters - iter;
+            if (size < fetchbuf->returning_rows) {
+                size = fetchbuf->returning_rows;
+            }
+            block = returned_block_new(size, fetchbuf->returning_width);
+            block->next = fetchbuf->returned;
+            fetchbuf->returned = block;
+        }
     }
 
-    if (((errorcode == 900) || (offset > 0)) && (strlen(query) >= offset)) {
-        /* ora-00900 is invalid sql statment
-         *           it seems to be the msg most likely to be a parse
-         *           error that sets offset to 0
+    if (index < fetchbuf->returning_rows) {
+        block = fetchbuf->returned;
+    } else {
+        /*
+         * Iterations that did not touch any rows still get called
+         * once; give Oracle somewhere to write that we will ignore.
          */
-        int len;
-        len = snprintf(buf, STACK_BUFFER_SIZE,
-                       "%s:%d:%s: error in `%s ()': %s\nSQL: ",
-                       file, line, fn, ocifn, msgbuf);
-        if (offset > 0)
-            len +=
-                snprintf(buf + len, STACK_BUFFER_SIZE - len, "%.*s",
-                         offset - 1, query);
+        if (fetchbuf->returned_dummy == NULL) {
+            fetchbuf->returned_dummy = 
+                returned_block_new(1, fetchbuf->returning_width);
+        }
+        block = fetchbuf->returned_dummy;
+        block->used = 0;
+    }
 
-        snprintf(buf + len, STACK_BUFFER_SIZE - len, " !>>>!%s",
-                 query + offset);
-    } else {
-        snprintf(buf, STACK_BUFFER_SIZE,
-                 "%s:%d:%s: error in `%s ()': %s\nSQL: %s",
-                 file, line, fn, ocifn, msgbuf, query);
+    block->lengths[block->used] = fetchbuf->returning_width;
+    block->indicators[block->used] = 0;
+    block->rcodes[block->used] = 0;
+
+    *bufpp = block->values + block->used * fetchbuf->returning_width;
+    *alenp = &block->lengths[block->used];
+    *indpp = &block->indicators[block->used];
+    *rcodepp = &block->rcodes[block->used];
+    *piecep = OCI_ONE_PIECE;
+
+    block->used++;
+
+    return OCI_CONTINUE;
+}
+/*}}}*/
+
+/*{{{ returned_block_new */
+/* a block of size slots, each width bytes wide, for returning_get_data */
+static returned_block_t *
+returned_block_new(ub4 size, ub4 width)
+{
+    returned_block_t *block;
+
+    block = Ns_Malloc(sizeof *block 
+                      + size * (sizeof *block->lengths 
+                                + sizeof *block->rcodes
+                                + sizeof *block->indicators + width));
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    block->lengths = (ub4 *) (block + 1);
+    block->rcodes = (ub2 *) (block->lengths + size);
+    block->indicators = (sb2 *) (block->rcodes + size);
+    block->values = (char *) (block->indicators + size);
+
+    return block;
+}
+/*}}}*/
+
+/*{{{ returned_values_append */
+/* add the values a chunk returned to fetchbuf->returned_list, in the
+   order the rows were processed, and free the chunk's blocks */
+static void
+returned_values_append(fetch_buffer_t * fetchbuf)
+{
+    returned_block_t *block, *order = NULL, *next;
+    Tcl_Obj          *value;
+    ub4               j;
+
+    if (fetchbuf->returned == NULL) {
+        return;
     }
 
-    Ns_Log(Error, "%s", buf);
+    if (fetchbuf->returned_list == NULL) {
+        fetchbuf->returned_list = Tcl_NewListObj(0, NULL);
+        Tcl_IncrRefCount(fetchbuf->returned_list);
+    }
 
-    /* We need to call this so that AOLserver will print out the relevant
-     * error on pages served to browsers where ClientDebug is set.
-     */
-    snprintf(exceptbuf, EXCEPTION_CODE_SIZE, "%d", (int) errorcode);
-    Ns_DbSetException(dbh, exceptbuf, buf);
+    /* the blocks were chained newest first */
+    for (block = fetchbuf->returned; block != NULL; block = next) {
+        next = block->next;
+        block->next = order;
+        order = block;
+    }
 
-    Ns_Free(msgbuf);
-    Ns_Free(buf);
+    for (block = order; block != NULL; block = next) {
+        next = block->next;
+        for (j = 0; j < block->used; j++) {
+            if (block->indicators[j] == -1) {
+                value = Tcl_NewObj();
+            } else {
+                value = Tcl_NewStringObj(block->values 
+                                         + j * fetchbuf->returning_width,
+                                         block->lengths[j]);
+            }
+            Tcl_ListObjAppendElement(NULL, fetchbuf->returned_list, value);
+        }
+        Ns_Free(block);
+    }
 
-    return 1;
+    fetchbuf->returned = NULL;
 }
 /*}}}*/
 
-/*{{{ tcl_error_p */
-/* tcl_error_p is only used for ns_ora and potentialy other new Tcl commands
-   does not log the error and does not Ns_DbSetException but instead just
-   tells the Tcl interpreter about it
+/*{{{ free_returned_values*/
+static void
+free_returned_values(fetch_buffer_t * fetchbuf)
+{
+    returned_block_t *block, *next;
+
+    for (block = fetchbuf->returned; block != NULL; block = next) {
+        next = block->next;
+        Ns_Free(block);
+    }
+    Ns_Free(fetchbuf->returned_dummy);
+    if (fetchbuf->returned_list != NULL) {
+        Tcl_DecrRefCount(fetchbuf->returned_list);
+    }
+
+    fetchbuf->returned = NULL;
+    fetchbuf->returned_dummy = NULL;
+    fetchbuf->returned_list = NULL;
+    fetchbuf->returning_rows = 0;
+}
+/*}}}*/
+
+/*{{{ write_lob_buffer*/
+/* write length bytes from memory into the lob, lob_buffer_size bytes
+   at a time.  An empty value leaves the lob empty.
  */
 static int
-tcl_error_p(const char *file, int line, const char *fn,
-            Tcl_Interp * interp,
-            Ns_DbHandle * dbh, char *ocifn, char *query,
-            oci_status_t oci_status)
+write_lob_buffer(Tcl_Interp * interp, Ns_DbHandle * dbh, 
+                 OCILobLocator * lobl, char *data, ub4 length)
 {
-    char *msgbuf;
-    char *buf;
-    ora_connection_t *connection = 0;
-    ub2 offset = 0;
-    sb4 errorcode = 0;
+    return write_lob_pieces(interp, dbh, lobl, data, -1, NULL, length,
+                            lob_buffer_size);
+}
+/*}}}*/
 
-    if (dbh)
-        connection = dbh->connection;
+/*{{{ write_lob_pieces*/
+/* write length bytes into the lob, piece_size bytes per OCI call,
+   taking them from data, or if that is NULL reading them from fd
+   (path is for messages).  An empty value leaves the lob empty.
+ */
+static int
+write_lob_pieces(Tcl_Interp * interp, Ns_DbHandle * dbh, 
+                 OCILobLocator * lobl, char *data, int fd, char *path,
+                 lob_length_t length, ub4 piece_size)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t oci_status;
+    lob_length_t amtp = length;
+    lob_length_t offset = 0;
+    ub4 nbytes, got;
+    ub1 piece;
+    char *bufp = NULL;
+    int readlen = 0;
+    int status = NS_ERROR;
 
-    /* success */
-    if (oci_status == OCI_SUCCESS)
-        return 0;
+    if (length == 0)
+        return NS_OK;
 
-    query = nilp(query);
-    msgbuf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    *msgbuf = 0;
+    if (data == NULL)
+        bufp = Ns_Malloc(piece_size);
 
-    switch (oci_status) {
-    case OCI_SUCCESS_WITH_INFO:
-        snprintf(msgbuf, STACK_BUFFER_SIZE,
-                 "Error - OCI_SUCCESS_WITH_INFO");
-        break;
-    case OCI_NEED_DATA:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_NEED_DATA");
-        break;
-    case OCI_NO_DATA:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_NO_DATA");
-        break;
-    case OCI_ERROR:
-        if (connection == 0)
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "NULL connection");
-        else {
-            char errorbuf[512];
-            oci_status_t oci_status1;
+    piece = (length > piece_size) ? OCI_FIRST_PIECE : OCI_ONE_PIECE;
 
-            oci_status1 = OCIErrorGet(connection->err,
-                                      1,
-                                      NULL,
-                                      &errorcode,
-                                      errorbuf,
-                                      sizeof errorbuf, OCI_HTYPE_ERROR);
+    do {
+        if (length - offset > piece_size) {
+            nbytes = piece_size;
+        } else {
+            nbytes = (ub4) (length - offset);
+            if (piece != OCI_ONE_PIECE)
+                piece = OCI_LAST_PIECE;
+        }
 
-            if (oci_status1) {
-                snprintf(msgbuf, STACK_BUFFER_SIZE, "`OCIErrorGet ()' error");
-            } else {
-                snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", errorbuf);
+        if (data == NULL) {
+            for (got = 0; got < nbytes; got += readlen) {
+                readlen = read(fd, bufp + got, nbytes - got);
+                if (readlen <= 0)
+                    break;
             }
 
-            oci_status1 = OCIAttrGet(connection->stmt,
-                                     OCI_HTYPE_STMT,
-                                     &offset,
-                                     NULL,
-                                     OCI_ATTR_PARSE_ERROR_OFFSET,
-                                     connection->err);
-
-            if (errorcode == 1041 || errorcode == 3113
-                || errorcode == 12571) {
-                /* 3113 is 'end-of-file on communications channel', which
-                 *      happens if the oracle process dies
-                 * 12571 is TNS:packet writer failure, which also happens if
-                 *      the oracle process dies
-                 * 1041 is the dreaded "hostdef extension doesn't exist error,
-                 *      which means the db handle is screwed and can't be used
-                 *      for anything else.
-                 * In either case, close and re-open the handle to clear the
-                 * error condition
-                 */
-                Ns_OracleFlush(dbh);
-                Ns_OracleCloseDb(dbh);
-                Ns_OracleOpenDb(dbh);
+            if (got < nbytes) {
+                Ns_Log(Error, "%s:%d:%s Error reading file %s: %d(%s)",
+                       lexpos(), path, errno, 
+                       readlen < 0 ? strerror(errno) : "short file");
+                Tcl_AppendResult(interp, "can't read ", path,
+                                 " received error ", 
+                                 readlen < 0 ? strerror(errno) 
+                                 : "file is shorter than expected", NULL);
+
+                /* finish the stream, so the handle stays usable */
+                if (piece != OCI_ONE_PIECE && piece != OCI_FIRST_PIECE)
+                    lob_write_piece(connection, lobl, &amtp, bufp, 0, 
+                                    OCI_LAST_PIECE);
+                goto bailout;
             }
         }
-        break;
-    case OCI_INVALID_HANDLE:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_INVALID_HANDLE");
-        break;
-    case OCI_STILL_EXECUTING:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_STILL_EXECUTING");
-        break;
-    case OCI_CONTINUE:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "Error - OCI_CONTINUE");
-        break;
+
+        oci_status = lob_write_piece(connection, lobl, &amtp, 
+                                     data ? data + offset : bufp,
+                                     nbytes, piece);
+        if (oci_status != OCI_NEED_DATA
+            && tcl_error_p(lexpos(), interp, dbh, "OCILobWrite", 0,
+                           oci_status)) {
+            goto bailout;
+        }
+
+        offset += nbytes;
+        piece = OCI_NEXT_PIECE;
+
+    } while (oci_status == OCI_NEED_DATA && offset < length);
+
+    status = NS_OK;
+
+  bailout:
+    if (bufp)
+        Ns_Free(bufp);
+
+    return status;
+}
+/*}}}*/
+
+/*{{{ write_lob_content*/
+/* write length bytes from memory into the lob, piece_size bytes
+   (lob_write_size if 0), rounded to the lob's chunks, per OCI call. */
+static int
+write_lob_content(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                  OCILobLocator * lobl, char *data, ub4 length, 
+                  int piece_size)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t oci_status;
+    ub4 chunk_size = 0;
+
+    oci_status = OCILobGetChunkSize(connection->svc, connection->err, 
+                                    lobl, &chunk_size);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCILobGetChunkSize", 0, oci_status))
+        return NS_ERROR;
+
+    if (piece_size <= 0)
+        piece_size = lob_write_size;
+
+    return write_lob_pieces(interp, dbh, lobl, data, -1, NULL, length,
+                            lob_piece_size(piece_size, chunk_size));
+}
+/*}}}*/
+
+/*{{{ memfind*/
+/* the first needle in the length bytes at haystack, or NULL. */
+static char *
+memfind(char *haystack, int length, char *needle, int needle_length)
+{
+    char *p, *end = haystack + length - needle_length;
+
+    for (p = haystack; p <= end; p++) {
+        if ((p = memchr(p, *needle, end - p + 1)) == NULL)
+            return NULL;
+        if (!memcmp(p, needle, needle_length))
+            return p;
     }
 
-    snprintf(buf, STACK_BUFFER_SIZE,
-             "%s:%d:%s: error in `%s ()': %s\nSQL: %s", file, line, fn,
-             ocifn, msgbuf, query);
+    return NULL;
+}
+/*}}}*/
 
-    Ns_Log(Error, "SQL(): %s", buf);
+/*{{{ multipart_part*/
+/* find the part called name in a multipart/form-data request body,
+   as content_type (the request's Content-Type header) describes it.
+   Returns NS_OK with *partPtr and *lengthPtr set to the part's
+   content, or NS_ERROR if there is no such part. */
+static int
+multipart_part(char *content, int length, char *content_type, char *name,
+               char **partPtr, int *lengthPtr)
+{
+    Ns_DString  boundary, disposition;
+    char       *p, *end, *headers, *body, *next, *n;
+    int         status = NS_ERROR;
 
-    Tcl_AppendResult(interp, buf, NULL);
+    if (content == NULL || content_type == NULL
+        || strncasecmp(content_type, "multipart/form-data", 19)
+        || (p = strstr(content_type, "boundary=")) == NULL)
+        return NS_ERROR;
 
-    /* error */
-    Ns_Free(msgbuf);
-    Ns_Free(buf);
+    p += 9;
+    Ns_DStringInit(&boundary);
+    Ns_DStringInit(&disposition);
+    Ns_DStringAppend(&boundary, "--");
+    if (*p == '"') {
+        p++;
+        Ns_DStringNAppend(&boundary, p, strcspn(p, "\""));
+    } else {
+        Ns_DStringNAppend(&boundary, p, strcspn(p, "; \t"));
+    }
+    Ns_DStringVarAppend(&disposition, "name=\"", name, "\"", NULL);
 
-    return 1;
+    end = content + length;
+    p = memfind(content, length, boundary.string, boundary.length);
+
+    while (p != NULL) {
+        p += boundary.length;
+
+        /* the closing delimiter */
+        if (end - p >= 2 && p[0] == '-' && p[1] == '-')
+            break;
+
+        if ((headers = memfind(p, end - p, "\r\n", 2)) == NULL
+            || (body = memfind(headers, end - headers, "\r\n\r\n", 4)) 
+               == NULL)
+            break;
+        headers += 2;
+        body += 4;
+
+        if ((next = memfind(body, end - body, boundary.string, 
+                            boundary.length)) == NULL)
+            break;
+
+        /* name="..." but not filename="..." */
+        for (n = headers; 
+             (n = memfind(n, body - n, disposition.string, 
+                          disposition.length)) != NULL; 
+             n++) {
+            if (n == headers || !isalnum((unsigned char) n[-1]))
+                break;
+        }
+
+        if (n != NULL) {
+            *partPtr = body;
+            /* the CRLF before the delimiter belongs to it */
+            *lengthPtr = (next - body) - 2;
+            if (*lengthPtr < 0)
+                *lengthPtr = 0;
+            status = NS_OK;
+            break;
+        }
+
+        p = next;
+    }
+
+    Ns_DStringFree(&boundary);
+    Ns_DStringFree(&disposition);
+
+    return status;
 }
 /*}}}*/
 
-/*{{{ error */
-/* For logging errors that come from C code rather than 
- * Oracle unhappiness.
- */
-static void 
-error(const char *file, int line, const char *fn, char *fmt, ...)
+/*{{{ lob_write_piece*/
+/* one OCILobWrite of a piecewise write; *amtp is the total length.
+   OCILobWrite2 where there is one, so the total can pass 4 GB. */
+static oci_status_t
+lob_write_piece(ora_connection_t * connection, OCILobLocator * lobl,
+                lob_length_t * amtp, void *bufp, ub4 nbytes, ub1 piece)
 {
-    char *buf1;
-    char *buf;
-    va_list ap;
+#ifdef HAVE_OCI_LOB2
+    oraub8 char_amt = 0;
 
-    buf1 = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    return OCILobWrite2(connection->svc, connection->err, lobl,
+                        amtp, &char_amt, 1, bufp, nbytes, piece,
+                        NULL, NULL, 0, SQLCS_IMPLICIT);
+#else
+    return OCILobWrite(connection->svc, connection->err, lobl,
+                       amtp, 1, bufp, nbytes, piece, 0, 0, 0, 
+                       SQLCS_IMPLICIT);
+#endif
+}
+/*}}}*/
 
-    va_start(ap, fmt);
-    vsprintf(buf1, fmt, ap);
-    va_end(ap);
+/*{{{ lob_piece_size*/
+/* round size down to a whole number of the lob's chunks, but to no
+   less than one chunk. */
+static ub4
+lob_piece_size(ub4 size, ub4 chunk_size)
+{
+    if (chunk_size == 0)
+        return size;
+    if (size <= chunk_size)
+        return chunk_size;
+    return size - size % chunk_size;
+}
+/*}}}*/
+
+/*{{{ read_lob_dstring*/
+/* append lob_length units of the lob, starting at offset (counting
+   from 1), to ds, with the error in the interp on failure. */
+static int
+read_lob_dstring(Tcl_Interp * interp, Ns_DbHandle * dbh, 
+                 OCILobLocator * lobl, ub4 offset, ub4 lob_length, 
+                 Ns_DString * ds)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t oci_status;
+    ub1 *bufp;
 
-    snprintf(buf, STACK_BUFFER_SIZE, "%s:%d:%s: %s", file, line, fn, buf1);
+    if (lob_length == 0)
+        return TCL_OK;
 
-    Ns_Log(Error, "%s", buf);
+    bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
 
-    Ns_Free(buf1);
-    Ns_Free(buf);
-} 
+    oci_status = OCILobRead(connection->svc,
+                            connection->err,
+                            lobl,
+                            &lob_length,
+                            offset,
+                            bufp,
+                            lob_buffer_size,
+                            ds, (OCICallbackLobRead)
+                            ora_append_buf_to_dstring, (ub2) 0,
+                            (ub1) SQLCS_IMPLICIT);
+    Ns_Free(bufp);
+
+    if (tcl_error_p(lexpos(), interp, dbh, "OCILobRead", 0, oci_status))
+        return TCL_ERROR;
+
+    return TCL_OK;
+}
 /*}}}*/
 
-/*{{{ log */
-/*  For optional logging of all kinds of random stuff, turn on 
- *  debug in the [ns/db/driver/drivername] section of your nsd.ini
+/*{{{ read_lob_value*/
+/* read the whole lob into a new Tcl object: a byte array for BLOBs,
+   a string for CLOBs.  Returns NULL, with the error in the interp,
+   on failure.
  */
-static void 
-ns_ora_log(const char *file, int line, const char *fn, char *fmt, ...)
+static Tcl_Obj *
+read_lob_value(Tcl_Interp * interp, Ns_DbHandle * dbh, 
+               OCILobLocator * lobl, int blob_p)
 {
-    char *buf1;
-    char *buf;
-    va_list ap;
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t oci_status;
+    ub4 lob_length = 0;
+    Ns_DString retval;
+    Tcl_Obj *value = NULL;
 
-    if (!debug_p) {
-        return;
+    oci_status = OCILobGetLength(connection->svc, connection->err,
+                                 lobl, &lob_length);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCILobGetLength", 0, 
+                    oci_status)) {
+        return NULL;
     }
 
-    buf1 = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-
-    va_start(ap, fmt);
-    vsprintf(buf1, fmt, ap);
-    va_end(ap);
+    Ns_DStringInit(&retval);
 
-    snprintf(buf, STACK_BUFFER_SIZE, "%s:%d:%s: %s", file, line, fn, buf1);
+    if (read_lob_dstring(interp, dbh, lobl, 1, lob_length, &retval) 
+        != TCL_OK) {
+        Ns_DStringFree(&retval);
+        return NULL;
+    }
 
-    Ns_Log(Notice, "%s", buf);
+    if (blob_p) {
+        value = Tcl_NewByteArrayObj((unsigned char *) retval.string, 
+                                    retval.length);
+    } else {
+        value = Tcl_NewStringObj(retval.string, retval.length);
+    }
+    Ns_DStringFree(&retval);
 
-    Ns_Free(buf1);
-    Ns_Free(buf);
-} 
+    return value;
+}
 /*}}}*/
 
-/*{{{ malloc_fetch_buffers*/
-/*
- * malloc_fetch_buffers allocates the fetch_buffers array in the
- * specified connection.  connection->n_columns must be set to the
- * correct number before calling this function.
+/*{{{ free_temporary_lob*/
+/* free the temporary lob a PL/SQL lob bind created, or the one the
+   call handed back in its place.  Called before the locator itself
+   is freed.
  */
-static void 
-malloc_fetch_buffers(ora_connection_t * connection)
+static void
+free_temporary_lob(ora_connection_t * connection, fetch_buffer_t * fetchbuf)
 {
-    int i;
-
-    connection->fetch_buffers
-        =
-        Ns_Malloc(connection->n_columns *
-                  sizeof *connection->fetch_buffers);
-
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+    oci_status_t oci_status;
+    boolean is_temporary = FALSE;
 
-        fetchbuf->connection = connection;
+    if (!fetchbuf->is_temporary || fetchbuf->lob == NULL)
+        return;
 
-        fetchbuf->type = 0;
-        fetchbuf->lob = NULL;
-        fetchbuf->bind = NULL;
-        fetchbuf->def = NULL;
-        fetchbuf->size = 0;
-        fetchbuf->buf_size = 0;
-        fetchbuf->buf = NULL;
-        fetchbuf->stmt = NULL;
-        fetchbuf->array_count = 0;
-        fetchbuf->array_values = NULL;
-        fetchbuf->is_null = 0;
-        fetchbuf->fetch_length = 0;
-        fetchbuf->piecewise_fetch_length = 0;
-        fetchbuf->inout = 0;
-        fetchbuf->name = NULL;
+    fetchbuf->is_temporary = 0;
 
-        fetchbuf->lobs = NULL;
-        fetchbuf->is_lob = 0;
-        fetchbuf->n_rows = 0;
-    }
+    oci_status = OCILobIsTemporary(connection->env, connection->err,
+                                   fetchbuf->lob, &is_temporary);
+    if (oci_error_p(lexpos(), connection->dbh, "OCILobIsTemporary", 0,
+                    oci_status) || !is_temporary)
+        return;
 
+    oci_status = OCILobFreeTemporary(connection->svc, connection->err,
+                                     fetchbuf->lob);
+    oci_error_p(lexpos(), connection->dbh, "OCILobFreeTemporary", 0,
+                oci_status);
 }
 /*}}}*/
 
-/*{{{ free_fetch_buffers*/
-/*
- * free_fetch_buffers frees the fetch_buffers array in the specified
- * connection.  connection->n_columns must have the same value as it
- * did when malloc_fetch_buffers was called.  The non-NULL
- * dynamically-allocated components of each fetchbuf will also be freed.
+/*{{{ stream_read_lob*/
+/* read a file from the operating system and then stuff it into the
+   lob, piece_size bytes (lob_write_size if 0, rounded to the lob's
+   chunks either way) per OCI call.  With mmap_p the file is mapped
+   rather than read, saving a copy; otherwise the kernel is told it
+   will be read sequentially.
  */
-static void 
-free_fetch_buffers(ora_connection_t * connection)
+static int
+stream_read_lob(Tcl_Interp * interp, Ns_DbHandle * dbh, int rowind,
+                OCILobLocator * lobl, char *path,
+                ora_connection_t * connection, int piece_size, int mmap_p)
 {
-    if (connection != NULL && connection->fetch_buffers != NULL) {
-        Ns_DbHandle *dbh = connection->dbh;
-        int i;
-        int j;
-        oci_status_t oci_status;
+    lob_length_t filelen = 0;
+    ub4 chunk_size = 0;
+    char *map = NULL;
+    int status = NS_ERROR;
+    oci_status_t oci_status = OCI_SUCCESS;
+    struct stat statbuf;
 
-        for (i = 0; i < connection->n_columns; i++) {
-            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+    int fd = -1;
 
-            if (fetchbuf->lob != NULL) {
-                oci_status =
-                    OCIDescriptorFree(fetchbuf->lob, OCI_DTYPE_LOB);
-                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
-                            oci_status);
-                fetchbuf->lob = NULL;
-            }
+    fd = open(path, O_RDONLY | EXTRA_OPEN_FLAGS);
 
-            /*
-             * fetchbuf->bind is automatically deallocated when its
-             * statement is deallocated.
-             *
-             * Same for fetchbuf->def, I believe, though the manual
-             * doesn't say.
-             */
+    if (fd == -1) {
+        Ns_Log(Error, "%s:%d:%s Error opening file %s: %d(%s)",
+               lexpos(), path, errno, strerror(errno));
+        Tcl_AppendResult(interp, "can't open file ", path,
+                         " for reading. ", "received error ",
+                         strerror(errno), NULL);
+        goto bailout;
+    }
 
-            if (fetchbuf->buf != NULL) {
-                Ns_Free(fetchbuf->buf);
-                fetchbuf->buf = NULL;
-                fetchbuf->buf_size = 0;
-            }
+    if (fstat(fd, &statbuf) == -1) {
+        Ns_Log(Error, "%s:%d:%s Error statting %s: %d(%s)",
+               lexpos(), path, errno, strerror(errno));
+        Tcl_AppendResult(interp, "can't stat ", path, ". ",
+                         "received error ", strerror(errno), NULL);
+        goto bailout;
+    }
+    filelen = statbuf.st_size;
 
-            if (fetchbuf->array_values != NULL) {
-                /* allocated from Tcl_SplitList so Tcl_Free it */
-                Tcl_Free((char *) fetchbuf->array_values);
-                fetchbuf->array_values = NULL;
-                fetchbuf->array_count = 0;
-            }
+    if ((off_t) filelen != statbuf.st_size) {
+        Tcl_AppendResult(interp, path, " is too big for a lob written "
+                         "with this Oracle client", NULL);
+        goto bailout;
+    }
 
-            if (fetchbuf->lobs != 0) {
-                for (j = 0; j < fetchbuf->n_rows; j++) {
-                    oci_status = OCIDescriptorFree(fetchbuf->lobs[j],
-                                                   OCI_DTYPE_LOB);
-                    oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
-                                oci_status);
-                }
-                Ns_Free(fetchbuf->lobs);
-                fetchbuf->lobs = NULL;
-                fetchbuf->n_rows = 0;
-            }
+    oci_status = OCILobGetChunkSize(connection->svc, connection->err, 
+                                    lobl, &chunk_size);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCILobGetChunkSize", 0, oci_status))
+        goto bailout;
+
+    if (piece_size <= 0)
+        piece_size = lob_write_size;
+    piece_size = lob_piece_size(piece_size, chunk_size);
+
+    ns_ora_log(lexpos(), "to do streamed write lob, amount = %lu, "
+               "piece size %d", (unsigned long) filelen, piece_size);
+
+#ifndef WIN32
+    if (mmap_p && filelen > 0 
+        && (lob_length_t) (size_t) filelen == filelen) {
+        map = mmap(NULL, (size_t) filelen, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            Ns_Log(Notice, "%s:%d:%s can't map %s, reading it: %s",
+                   lexpos(), path, strerror(errno));
+            map = NULL;
+        }
+#ifdef MADV_SEQUENTIAL
+        else {
+            madvise(map, (size_t) filelen, MADV_SEQUENTIAL);
         }
+#endif
+    }
 
-        Ns_Free(connection->fetch_buffers);
-        connection->fetch_buffers = NULL;
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (map == NULL)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+
+    status = write_lob_pieces(interp, dbh, lobl, map, fd, path, filelen,
+                              piece_size);
+
+  bailout:
+
+#ifndef WIN32
+    if (map != NULL)
+        munmap(map, (size_t) filelen);
+#endif
+    if (fd >= 0)
+        close(fd);
+
+    if (status != NS_OK && connection->mode == transaction) {
+        ns_ora_log(lexpos(), "error writing lob.  rolling back transaction");
+
+        oci_status = OCITransRollback(connection->svc,
+                                      connection->err, OCI_DEFAULT);
+        tcl_error_p(lexpos(), interp, dbh, "OCITransRollback", 0,
+                    oci_status);
     }
+
+    return status;
 }
 /*}}}*/
 
-/*{{{ handle_builtins*/
+/*{{{ stream_actually_write*/
+static int
+stream_actually_write(lob_sink_t *sink, void *bufp, int length)
+{
+    int bytes_written = 0;
 
-/* this gets called on every query or dml.  Usually it will 
-   return NS_OK ("I did nothing").  If the SQL is one of our special 
-   cases, e.g., "begin transaction", that aren't supposed to go through
-   to Oracle, we handle it and return NS_DML ("I handled it and nobody 
-   else has do anything").
+    ns_ora_log(lexpos(), "entry (%s, %d)", sink->path, length);
 
-   return NS_ERROR on error
-*/
-static int 
-handle_builtins(Ns_DbHandle * dbh, char *sql)
-{
-    oci_status_t oci_status;
-    ora_connection_t *connection;
+    if (sink->zs != NULL) {
+        bytes_written = gzip_sink_write(sink, bufp, length, Z_NO_FLUSH);
+    } else if (sink->chan != NULL) {
+        bytes_written = Tcl_Write(sink->chan, bufp, length);
+        if (bytes_written < 0) {
+            errno = Tcl_GetErrno();
+        }
+    } else if (sink->conn != NULL) {
+        if (Ns_WriteConn(sink->conn, bufp, length) == NS_OK) {
+            bytes_written = length;
+        } else {
+            bytes_written = 0;
+        }
+    } else {
+        bytes_written = write(sink->fd, bufp, length);
+    }
 
-    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
+    ns_ora_log(lexpos(), "exit (%d, %s, %d)", bytes_written, sink->path,
+        length);
 
-    /* args should be correct */
-    connection = dbh->connection;
+    return bytes_written;
+}
+/*}}}*/
 
-    if (!strcasecmp(sql, "begin transaction")) {
-        ns_ora_log(lexpos(), "builtin `begin transaction`");
+/*{{{ stream_write_failed */
+/* log and report a write stream_write_lob couldn't finish.  err is
+   the errno of the failed write.  Returns the status for
+   stream_write_lob to return. */
+static int
+stream_write_failed(Tcl_Interp *interp, char *path, int bytes_written,
+                    int bytes_to_write, int err)
+{
+    if (err == EPIPE) {
+        /* broken pipe means the user hit the stop button.
+         * if that's the case, lie and say we've completed
+         * successfully so we don't cause false-positive errors
+         * in the server.log
+         * photo.net ticket # 5901
+         */
+        return STREAM_WRITE_LOB_PIPE;
+    }
 
-        connection->mode = transaction;
+    if (bytes_written < 0) {
+        Ns_Log(Error, "%s:%d:%s error writing %s.  error %d(%s)",
+               lexpos(), path, err, strerror(err));
+    } else {
+        Ns_Log(Error,
+               "%s:%d:%s error writing %s.  incomplete write of %d out of %d",
+               lexpos(), path, bytes_written, bytes_to_write);
+    }
+    Tcl_AppendResult(interp, "can't write ", path,
+                     " received error ", strerror(err), NULL);
 
-        return NS_DML;
-    } else if (!strcasecmp(sql, "end transaction")) {
-        ns_ora_log(lexpos(), "builtin `end transaction`");
+    return STREAM_WRITE_LOB_ERROR;
+}
+/*}}}*/
 
-        oci_status = OCITransCommit(connection->svc,
-                                    connection->err, OCI_DEFAULT);
-        if (oci_error_p(lexpos(), dbh, "OCITransCommit", sql, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return NS_ERROR;
-        }
+/*{{{ lob_reader_thread */
+/* one of the lob reader threads: runs the reads lob_read_start queues,
+   one at a time, for as long as the server runs. */
+static void
+lob_reader_thread(void *arg)
+{
+    lob_read_t *rd;
 
-        connection->mode = autocommit;
-        return NS_DML;
-    } else if (!strcasecmp(sql, "abort transaction")) {
-        ns_ora_log(lexpos(), "builtin `abort transaction`");
+    Ns_ThreadSetName("-nsoracle:lob-");
 
-        oci_status = OCITransRollback(connection->svc,
-                                      connection->err, OCI_DEFAULT);
-        if (oci_error_p
-            (lexpos(), dbh, "OCITransRollback", sql, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return NS_ERROR;
-        }
+    Ns_MutexLock(&lob_reader_lock);
+    for (;;) {
+        while (lob_read_queue == NULL)
+            Ns_CondWait(&lob_reader_cond, &lob_reader_lock);
 
-        connection->mode = autocommit;
-        return NS_DML;
+        rd = lob_read_queue;
+        lob_read_queue = rd->next;
+        Ns_MutexUnlock(&lob_reader_lock);
+
+        rd->status = lob_read_piece(rd);
+
+        Ns_MutexLock(&lob_reader_lock);
+        rd->done = 1;
+        lob_readers_idle++;
+        Ns_CondBroadcast(&lob_reader_cond);
     }
+}
+/*}}}*/
 
-    if (!allow_sql_p(dbh, sql, NS_FALSE)) {
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+/*{{{ lob_read_start */
+/* hand rd to a lob reader thread, starting one if none is free and
+   there are fewer than max_lob_readers.  Returns 0 if rd wasn't
+   queued, in which case the caller reads the piece itself. */
+static int
+lob_read_start(lob_read_t *rd)
+{
+    int queued = 1;
+
+    Ns_MutexLock(&lob_reader_lock);
+    if (lob_readers_idle > 0) {
+        lob_readers_idle--;
+    } else if (lob_readers < max_lob_readers) {
+        lob_readers++;
+        Ns_ThreadCreate(lob_reader_thread, NULL, 0, NULL);
+    } else {
+        queued = 0;
+    }
+
+    if (queued) {
+        rd->done = 0;
+        rd->next = lob_read_queue;
+        lob_read_queue = rd;
+        Ns_CondBroadcast(&lob_reader_cond);
     }
+    Ns_MutexUnlock(&lob_reader_lock);
 
-    /* not handled */
-    return NS_OK;
+    return queued;
 }
 /*}}}*/
 
-/*{{{ ora_append_buf_to_dstring*/
-/* Callback function for LOB case in ora_get_row. */
-static sb4
-ora_append_buf_to_dstring(dvoid * ctxp, CONST dvoid * bufp, ub4 len,
-                          ub1 piece)
+/*{{{ lob_read_wait */
+/* wait for a read lob_read_start queued, and return its status */
+static oci_status_t
+lob_read_wait(lob_read_t *rd)
 {
-    Ns_DString *retval = (Ns_DString *) ctxp;
-
-    switch (piece) {
-        case OCI_LAST_PIECE:
-        case OCI_FIRST_PIECE:
-        case OCI_NEXT_PIECE:
-            Ns_DStringNAppend(retval, (char *) bufp, len);
-            return OCI_CONTINUE;
+    Ns_MutexLock(&lob_reader_lock);
+    while (!rd->done)
+        Ns_CondWait(&lob_reader_cond, &lob_reader_lock);
+    Ns_MutexUnlock(&lob_reader_lock);
 
-        default:
-            return OCI_ERROR;
-    }
+    return rd->status;
 }
 /*}}}*/
 
-/*{{{ no_data*/
+/*{{{ lob_read_piece */
+/* read the next piece of a polling OCILobRead into rd->buf.  The
+   environment is OCI_THREADED, and the handle is only ever used by
+   one thread at a time, so this can run on a lob reader thread. */
+static oci_status_t
+lob_read_piece(lob_read_t *rd)
+{
+    ub4 amtp = 0;
 
-/*  This is a function that we register as a callback with Oracle for
- *  DML statements that do RETURNING FOOBAR INTO ... (this was
- *  necessitated by the clob_dml statement which was necessitated by
- *  Oracle's stupid SQL parser that can't handle string literals longer
- *  than 4000 chars) 
- */
+    return OCILobRead(rd->svchp, rd->errhp, rd->lobl, &amtp, rd->offset,
+                      rd->buf, rd->buf_size, 0, 0, 0, SQLCS_IMPLICIT);
+}
+/*}}}*/
 
-static sb4
-no_data(dvoid * ctxp, OCIBind * bindp,
-        ub4 iter, ub4 index, dvoid ** bufpp, ub4 * alenpp, ub1 * piecep,
-        dvoid ** indpp)
+/*{{{ lob_read_abort */
+/* end a polling OCILobRead that still has pieces to come, so the
+   session can be used again without logging on afresh.  Returns
+   NS_OK if it survived. */
+static int
+lob_read_abort(Ns_DbHandle *dbh, OCISvcCtx *svchp, OCIError *errhp)
 {
-    ns_ora_log(lexpos(), "entry");
+    oci_status_t oci_status;
 
-    *bufpp = (dvoid *) 0;
-    *alenpp = 0;
-    null_ind = -1;
-    *indpp = (dvoid *) & null_ind;
-    *piecep = OCI_ONE_PIECE;
+    oci_status = OCIBreak(svchp, errhp);
+    if (oci_error_p(lexpos(), dbh, "OCIBreak", 0, oci_status))
+        return NS_ERROR;
 
-    return OCI_CONTINUE;
+    oci_status = OCIReset(svchp, errhp);
+    if (oci_error_p(lexpos(), dbh, "OCIReset", 0, oci_status))
+        return NS_ERROR;
+
+#ifdef HAVE_OCI_PING
+    oci_status = OCIPing(svchp, errhp, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIPing", 0, oci_status))
+        return NS_ERROR;
+#endif
+
+    stats_incr(&ora_stats.lob_aborts);
+    ns_ora_log(lexpos(), "lob read aborted");
+
+    return NS_OK;
 }
 /*}}}*/
 
-/*{{{ list_element_put_data*/
-/* For use by OCIBindDynamic: returns the iter'th element (0-relative)
-   of the context pointer taken as an array of strings (char**). */
-static sb4
-list_element_put_data(dvoid * ictxp,
-                      OCIBind * bindp,
-                      ub4 iter,
-                      ub4 index,
-                      dvoid ** bufpp,
-                      ub4 * alenp, ub1 * piecep, dvoid ** indpp)
+/*{{{ lob_reopen */
+/* log dbh on afresh if a LOB read was cut short and lob_read_abort
+   couldn't end it.  Every caller of stream_write_lob and
+   stream_lob_to_sink calls this once it has freed what it had on the
+   handle, and before the handle can be used again. */
+static void
+lob_reopen(Ns_DbHandle *dbh)
 {
-    fetch_buffer_t *fetchbuf = ictxp;
-    char **elements = fetchbuf->array_values;
-
-    *bufpp = elements[iter];
-    *alenp = strlen(elements[iter]);
-    *piecep = OCI_ONE_PIECE;
-    *indpp = NULL;
+    ora_connection_t *connection = dbh->connection;
 
-    return OCI_CONTINUE;
+    if (connection != NULL && connection->needs_reopen) {
+        stats_incr(&ora_stats.lob_reopens);
+        Ns_OracleCloseDb(dbh);
+        Ns_OracleOpenDb(dbh);
+    }
 }
 /*}}}*/
 
-/*{{{ get_data*/
-/* another callback to register with Oracle */
-static sb4
-get_data(dvoid * ctxp, OCIBind * bindp,
-         ub4 iter, ub4 index, dvoid ** bufpp, ub4 ** alenp, ub1 * piecep,
-         dvoid ** indpp, ub2 ** rcodepp)
+/*{{{ stream_write_lob*/
+/* snarf lobs using stream mode from Oracle into local buffers, then
+   write them to the given file (replacing the file if it exists) or
+   out to the connection.
+   This was cargo-culted from an example in the OCI programmer's
+   guide.
+
+   Only amount bytes from offset (counting from 1) on are written;
+   an amount of 0 means the rest of the lob.
+*/
+static int
+stream_write_lob(Tcl_Interp * interp, Ns_DbHandle * dbh, int rowind,
+                 OCILobLocator * lobl, ub4 offset, ub4 amount, 
+                 char *path, int to_conn_p,
+                 OCISvcCtx * svchp, OCIError * errhp)
 {
-    Ns_DbHandle      *dbh;
-    ora_connection_t *connection;
-    fetch_buffer_t   *buf;
-    oci_status_t      oci_status;
-    int               i;
+    int status = STREAM_WRITE_LOB_ERROR;
+    lob_sink_t sink;
 
-    ns_ora_log(lexpos(), "entry (dbh %p; iter %d, index %d)", ctxp, iter, index);
+    memset(&sink, 0, sizeof sink);
+    sink.fd = -1;
 
-    if (iter != 0) {
-        error(lexpos(), "iter != 0");
-        return NS_ERROR;
+    if (path == NULL) {
+        path = "to connection";
     }
+    sink.path = path;
 
-    buf = ctxp;
-    connection = buf->connection;
-    dbh = connection->dbh;
-
-    if (buf->lobs == 0) {
-        oci_status = OCIAttrGet(bindp,
-                                OCI_HTYPE_BIND,
-                                (oci_attribute_t *) & buf->n_rows,
-                                NULL,
-                                OCI_ATTR_ROWS_RETURNED, connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status))
-            return NS_ERROR;
-
-        ns_ora_log(lexpos(), "n_rows %d", buf->n_rows);
+    ns_ora_log(lexpos(), "entry (path %s)", path);
 
-        buf->lobs = Ns_Malloc(buf->n_rows * sizeof *buf->lobs);
+    if (to_conn_p) {
+        sink.conn = Ns_TclGetConn(interp);
 
-        for (i = 0; i < (int) buf->n_rows; i++)
-            buf->lobs[i] = 0;
+        /* this Shouldn't Happen, but spew an error just in case */
+        if (sink.conn == NULL) {
+            Ns_Log(Error, "%s:%d:%s: No AOLserver conn available",
+                   lexpos());
+            Tcl_AppendResult(interp, "No AOLserver conn available", NULL);
+            return status;
+        }
+    } else {
+        sink.fd = open(path, O_CREAT | O_TRUNC | O_WRONLY | EXTRA_OPEN_FLAGS,
+                       0600);
 
-        for (i = 0; i < (int) buf->n_rows; i++) {
-            oci_status = OCIDescriptorAlloc(connection->env,
-                                            (oci_descriptor_t *) & buf->
-                                            lobs[i], OCI_DTYPE_LOB, 0, 0);
-            if (oci_error_p
-                (lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status))
-                return NS_ERROR;
+        if (sink.fd < 0) {
+            Ns_Log(Error,
+                   "%s:%d:%s: can't open %s for writing. error %d(%s)",
+                   lexpos(), path, errno, strerror(errno));
+            Tcl_AppendResult(interp, "can't open file ", path,
+                             " for writing. ", "received error ",
+                             strerror(errno), NULL);
+            return status;
         }
     }
 
-    *bufpp = (dvoid *) buf->lobs[index];
+    status = stream_lob_to_sink(interp, dbh, lobl, offset, amount, &sink,
+                                svchp, errhp);
 
-    *alenp = &rl;
-    null_ind = -1;
-    *indpp = (dvoid *) & null_ind;
-    *piecep = OCI_ONE_PIECE;
-    *rcodepp = &rc;
+    if (sink.fd >= 0) {
+        close(sink.fd);
+    }
 
-    return OCI_CONTINUE;
+    return status;
 }
 /*}}}*/
 
-/*{{{ stream_read_lob*/
-/* read a file from the operating system and then stuff it into the lob
-   This was cargo-culted from an example in the OCI programmer's
-   guide.
- */
+/*{{{ stream_lob_to_sink */
+/* the guts of stream_write_lob, for any lob_sink.
+
+   Pieces are a whole number of the LOB's chunks, about
+   sink->piece_size (or lob_buffer_size) bytes.  When there is more
+   than one, a lob reader thread reads the next piece into the other
+   buffer while this thread writes the last one out, so a big LOB goes
+   out as fast as the slower of Oracle and the client, rather than at
+   the sum of both.  The sink, and so the conn, is only ever written
+   from this thread.
+*/
 static int
-stream_read_lob(Tcl_Interp * interp, Ns_DbHandle * dbh, int rowind,
-                OCILobLocator * lobl, char *path,
-                ora_connection_t * connection)
+stream_lob_to_sink(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                   OCILobLocator *lobl, ub4 offset, ub4 amount,
+                   lob_sink_t *sink, OCISvcCtx *svchp, OCIError *errhp)
 {
-    ub4 offset = 1;
     ub4 loblen = 0;
-    ub1 *bufp = NULL;
-    ub4 amtp;
-    ub1 piece;
-    ub4 nbytes;
-    ub4 remainder;
-    ub4 filelen = 0;
-#ifdef WIN32
-    int readlen;
-#else
-    ssize_t readlen;
-#endif
-    int status = NS_ERROR;
-    oci_status_t oci_status = OCI_SUCCESS;
-    struct stat statbuf;
+    ub4 chunk_size = 0;
+    ub4 piece_size;
+    ub4 amtp = 0;
+    ub4 piece = 0;
+    ub4 remainder;              /* bytes of the lob not yet written */
+    ub4 bytes_to_write;
+    ub1 *buf[2] = {NULL, NULL};
+    int i, bytes_written, err;
+    int more_p, queued_p;
+    int status = STREAM_WRITE_LOB_ERROR;
+    char *path = sink->path;
+    oci_status_t oci_status;
+    lob_read_t rd;
 
-    int fd = -1;
+    oci_status = OCILobGetLength(svchp, errhp, lobl, &loblen);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCILobGetLength", path, oci_status))
+        goto bailout;
 
-    fd = open(path, O_RDONLY | EXTRA_OPEN_FLAGS);
+    oci_status = OCILobGetChunkSize(svchp, errhp, lobl, &chunk_size);
+    if (tcl_error_p
+        (lexpos(), interp, dbh, "OCILobGetChunkSize", path, oci_status))
+        goto bailout;
 
-    if (fd == -1) {
-        Ns_Log(Error, "%s:%d:%s Error opening file %s: %d(%s)",
-               lexpos(), path, errno, strerror(errno));
-        Tcl_AppendResult(interp, "can't open file ", path,
-                         " for reading. ", "received error ",
-                         strerror(errno), NULL);
+    piece_size = lob_piece_size(sink->piece_size > 0 
+                                ? sink->piece_size : lob_buffer_size,
+                                chunk_size);
+
+    if (offset > loblen) {
+        amount = 0;
+    } else if (amount == 0 || amount > loblen - offset + 1) {
+        amount = loblen - offset + 1;
+    }
+
+    ns_ora_log(lexpos(), "loblen %d, offset %d, amount %d, "
+               "chunk size %d, piece size %d", 
+               loblen, offset, amount, chunk_size, piece_size);
+
+    if (amount == 0) {
+        status = STREAM_WRITE_LOB_OK;
         goto bailout;
     }
 
-    if (stat(path, &statbuf) == -1) {
-        Ns_Log(Error, "%s:%d:%s Error statting %s: %d(%s)",
-               lexpos(), path, errno, strerror(errno));
-        Tcl_AppendResult(interp, "can't stat ", path, ". ",
-                         "received error ", strerror(errno), NULL);
+    amtp = amount;
+
+    buf[0] = (ub1 *) Ns_Malloc(piece_size);
+
+    oci_status = OCILobRead(svchp,
+                            errhp,
+                            lobl,
+                            &amtp,
+                            offset,
+                            buf[0],
+                            (amount < piece_size ? amount : piece_size),
+                            0, 0, 0, SQLCS_IMPLICIT);
+
+    switch (oci_status) {
+    case OCI_SUCCESS:          /* only one piece */
+        ns_ora_log(lexpos(), "stream read %d'th piece\n", (int) (++piece));
+
+        errno = 0;
+        bytes_written = stream_actually_write(sink, buf[0], amount);
+        err = errno;
+
+        if (bytes_written != (int) amount) {
+            sink->failed = 1;
+            status = stream_write_failed(interp, path, bytes_written,
+                                         amount, err);
+            goto bailout;
+        }
+        break;
+
+    case OCI_NEED_DATA:        /* there are 2 or more pieces */
+
+        buf[1] = (ub1 *) Ns_Malloc(piece_size);
+
+        rd.svchp = svchp;
+        rd.errhp = errhp;
+        rd.lobl = lobl;
+        rd.offset = offset;
+        rd.buf_size = piece_size;
+
+        remainder = amount;
+        bytes_to_write = piece_size;    /* the first piece is full */
+        i = 0;
+
+        for (;;) {
+            ns_ora_log(lexpos(), "stream read %d'th piece, %d bytes",
+                       (int) (++piece), (int) bytes_to_write);
+
+            /* start reading the next piece into the other buffer,
+               then write this one out */
+            more_p = (oci_status == OCI_NEED_DATA);
+            queued_p = 0;
+            if (more_p) {
+                rd.buf = buf[i ^ 1];
+                queued_p = lob_read_start(&rd);
+            }
+
+            errno = 0;
+            bytes_written = stream_actually_write(sink, buf[i],
+                                                  bytes_to_write);
+            err = errno;
+            remainder -= bytes_to_write;
+
+            if (queued_p) {
+                oci_status = lob_read_wait(&rd);
+            }
+
+            if (bytes_written != (int) bytes_to_write) {
+                sink->failed = 1;
+                break;
+            }
+
+            if (!more_p)
+                break;
+
+            if (!queued_p) {
+                oci_status = lob_read_piece(&rd);
+            }
+
+            if (oci_status != OCI_NEED_DATA
+                && tcl_error_p(lexpos(), interp, dbh, "OCILobRead", 0,
+                               oci_status)) {
+                goto bailout;
+            }
+
+            /* the amount read returned is undefined for FIRST, NEXT
+               pieces, so go by what is left */
+            bytes_to_write = (remainder < piece_size) 
+                ? remainder : piece_size;
+            i ^= 1;
+        }
+
+        if (sink->failed) {
+            if (oci_status == OCI_NEED_DATA
+                && lob_read_abort(dbh, svchp, errhp) != NS_OK) {
+                ((ora_connection_t *) dbh->connection)->needs_reopen = 1;
+            }
+            status = stream_write_failed(interp, path, bytes_written,
+                                         bytes_to_write, err);
+            goto bailout;
+        }
+        break;
+
+    case OCI_ERROR:
+        tcl_error_p(lexpos(), interp, dbh, "OCILobRead", path, oci_status);
+        goto bailout;
+        break;
+
+    default:
+        Ns_Log(Error, "%s:%d:%s: Unexpected error from OCILobRead (%d)",
+               lexpos(), oci_status);
         goto bailout;
+        break;
+    }
+
+    status = STREAM_WRITE_LOB_OK;
+
+  bailout:
+    if (buf[0])
+        Ns_Free(buf[0]);
+    if (buf[1])
+        Ns_Free(buf[1]);
+
+    return status;
+}
+/*}}}*/
+
+/*{{{ lob_range */
+/* work out which part of a LOB of total bytes the request's Range
+   header asks for.  Only a single range is honored; several ranges,
+   or an If-Range that doesn't match the ETag or Last-Modified already
+   in the output headers, get the whole LOB.  Returns the HTTP status
+   to answer with: 200, with *offsetPtr and *amountPtr left alone, 206
+   with them set to the range (the offset counting from 1, as OCI
+   does), or 416 if the range is past the end.
+*/
+static int
+lob_range(Ns_Conn *conn, off_t total, off_t *offsetPtr, off_t *amountPtr)
+{
+    char          *range, *if_range, *validator, *end;
+    Tcl_WideUInt   first, last, size = (Tcl_WideUInt) total;
+
+    range = Ns_SetIGet(Ns_ConnHeaders(conn), "Range");
+    if (range == NULL)
+        return 200;
+
+    if_range = Ns_SetIGet(Ns_ConnHeaders(conn), "If-Range");
+    if (if_range != NULL) {
+        /* weak validators never match */
+        if (!strncmp(if_range, "W/", 2))
+            return 200;
+        validator = Ns_SetIGet(Ns_ConnOutputHeaders(conn),
+                               *if_range == '"' ? "ETag" : "Last-Modified");
+        if (validator == NULL || strcmp(validator, if_range))
+            return 200;
+    }
+
+    while (isspace((unsigned char) *range))
+        range++;
+    if (strncasecmp(range, "bytes=", 6) || strchr(range, ',') != NULL)
+        return 200;
+    range += 6;
+
+    if (*range == '-') {
+        /* the last so many bytes */
+        last = strtoull(range + 1, &end, 10);
+        if (end == range + 1)
+            return 200;
+        if (last == 0 || size == 0)
+            return 416;
+        if (last > size)
+            last = size;
+        first = size - last;
+        last = size - 1;
+    } else {
+        first = strtoull(range, &end, 10);
+        if (end == range || *end != '-')
+            return 200;
+        range = end + 1;
+        last = strtoull(range, &end, 10);
+        if (end == range) {
+            last = size - 1;
+        } else if (last < first) {
+            return 200;
+        }
+        if (first >= size)
+            return 416;
+        if (last >= size)
+            last = size - 1;
     }
-    filelen = statbuf.st_size;
 
-    remainder = amtp = filelen;
+    *offsetPtr = (off_t) first + 1;
+    *amountPtr = (off_t) (last - first + 1);
 
-    ns_ora_log(lexpos(), "to do streamed write lob, amount = %d", (int) filelen);
-
-    oci_status =
-        OCILobGetLength(connection->svc, connection->err, lobl, &loblen);
+    return 206;
+}
+/*}}}*/
 
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCILobGetLength", 0, oci_status))
-        goto bailout;
+/*{{{ lob_headers */
+/* send the headers for amount bytes of a LOB of total bytes, from
+   offset (counting from 1) on, gzipped if gzip_p.  A 416 is the
+   whole response. */
+static int
+lob_headers(Tcl_Interp *interp, Ns_Conn *conn, char *type, int status,
+            off_t offset, off_t amount, off_t total, int gzip_p)
+{
+    char buf[100];
+
+    Ns_ConnSetHeaders(conn, "Accept-Ranges", "bytes");
+
+    if (status == 416) {
+        snprintf(buf, sizeof buf, "bytes */%" TCL_LL_MODIFIER "d", 
+                 (Tcl_WideInt) total);
+        Ns_ConnSetHeaders(conn, "Content-Range", buf);
+        Ns_ConnReturnStatus(conn, status);
+        return TCL_OK;
+    }
+
+    if (status == 206) {
+        snprintf(buf, sizeof buf, "bytes %" TCL_LL_MODIFIER "d-%" 
+                 TCL_LL_MODIFIER "d/%" TCL_LL_MODIFIER "d", 
+                 (Tcl_WideInt) offset - 1, 
+                 (Tcl_WideInt) offset - 1 + amount - 1,
+                 (Tcl_WideInt) total);
+        Ns_ConnSetHeaders(conn, "Content-Range", buf);
+    }
+
+    if (gzip_p) {
+        /* the compressed length isn't known until it's all sent */
+        Ns_ConnSetHeaders(conn, "Content-Encoding", "gzip");
+        Ns_ConnSetRequiredHeaders(conn, type, -1);
+    } else if (amount > INT_MAX) {
+        /* too big for Ns_ConnSetRequiredHeaders to count */
+        Ns_ConnSetRequiredHeaders(conn, type, -1);
+        snprintf(buf, sizeof buf, "%" TCL_LL_MODIFIER "d", 
+                 (Tcl_WideInt) amount);
+        Ns_ConnSetHeaders(conn, "Content-Length", buf);
+    } else {
+        Ns_ConnSetRequiredHeaders(conn, type, (int) amount);
+    }
 
+    if (Ns_ConnFlushHeaders(conn, status) != NS_OK) {
+        Tcl_AppendResult(interp, "can't write headers to connection", NULL);
+        return TCL_ERROR;
+    }
 
-    ns_ora_log(lexpos(), "before stream write, lob length is %d", (int) loblen);
+    return TCL_OK;
+}
+/*}}}*/
 
-    if (filelen > lob_buffer_size)
-        nbytes = lob_buffer_size;
-    else
-        nbytes = filelen;
+/*{{{ accepts_gzip_p */
+/* does the request's Accept-Encoding take gzip?  A q of 0 refuses
+   it. */
+static int
+accepts_gzip_p(Ns_Conn *conn)
+{
+    char *value, *p, *next, *param;
+    int   len;
 
-    bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
-    readlen = read(fd, bufp, nbytes);
+    value = Ns_SetIGet(Ns_ConnHeaders(conn), "Accept-Encoding");
+    if (value == NULL)
+        return NS_FALSE;
 
-    if (readlen < 0) {
-        Ns_Log(Error, "%s:%d:%s Error reading file %s: %d(%s)",
-               lexpos(), path, errno, strerror(errno));
-        Tcl_AppendResult(interp, "can't read ", path,
-                         " received error ", strerror(errno), NULL);
-        goto bailout;
+    for (p = value; *p != '\0'; p = next) {
+        while (*p == ',' || isspace((unsigned char) *p))
+            p++;
+        len = strcspn(p, ",; \t");
+        next = p + strcspn(p, ",");
+
+        if ((len == 4 && !strncasecmp(p, "gzip", 4))
+            || (len == 6 && !strncasecmp(p, "x-gzip", 6))) {
+            for (param = p + len; param < next; param++) {
+                if ((*param == 'q' || *param == 'Q') && param[1] == '=')
+                    return strtod(param + 2, NULL) > 0;
+            }
+            return NS_TRUE;
+        }
     }
 
-    remainder -= readlen;
+    return NS_FALSE;
+}
+/*}}}*/
 
-    if (remainder == 0) {       /* exactly one piece in the file */
-        if (readlen > 0) {      /* if no bytes, bypass the LobWrite to insert a NULL */
-            ns_ora_log(lexpos(), "only one piece, no need for stream write");
-            oci_status = OCILobWrite(connection->svc,
-                                     connection->err,
-                                     lobl,
-                                     &amtp,
-                                     offset,
-                                     bufp,
-                                     readlen,
-                                     OCI_ONE_PIECE, 0, 0, 0,
-                                     SQLCS_IMPLICIT);
-            if (tcl_error_p
-                (lexpos(), interp, dbh, "OCILobWrite", 0, oci_status)) {
-                goto bailout;
-            }
+/*{{{ gzip_type_p */
+/* is type one of the gzip_types?  Parameters such as charset are
+   ignored. */
+static int
+gzip_type_p(char *type)
+{
+    Ns_DString  ds;
+    char      **patterns;
+    int         npatterns, i;
+    int         match = NS_FALSE;
+
+    Ns_DStringInit(&ds);
+    Ns_DStringNAppend(&ds, type, strcspn(type, "; \t"));
+    Ns_StrToLower(ds.string);
+
+    if (Tcl_SplitList(NULL, gzip_types, &npatterns, &patterns) == TCL_OK) {
+        for (i = 0; i < npatterns && !match; i++) {
+            match = Tcl_StringMatch(ds.string, patterns[i]);
         }
-    } else {                    /* more than one piece */
+        Tcl_Free((char *) patterns);
+    }
 
-        oci_status = OCILobWrite(connection->svc,
-                                 connection->err,
-                                 lobl,
-                                 &amtp,
-                                 offset,
-                                 bufp,
-                                 lob_buffer_size,
-                                 OCI_FIRST_PIECE, 0, 0, 0, SQLCS_IMPLICIT);
+    Ns_DStringFree(&ds);
 
-        if (oci_status != OCI_NEED_DATA
-            && tcl_error_p(lexpos(), interp, dbh, "OCILobWrite", 0,
-                           oci_status)) {
-            goto bailout;
-        }
+    return match;
+}
+/*}}}*/
 
+/*{{{ gzip_sink_init */
+/* have stream_lob_to_sink gzip what it writes to sink->conn */
+static int
+gzip_sink_init(lob_sink_t *sink)
+{
+    sink->zs = (z_stream *) Ns_Calloc(1, sizeof(z_stream));
+
+    /* 16 more window bits asks for a gzip header and trailer */
+    if (deflateInit2(sink->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 
+                     15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        Ns_Log(Error, "%s:%d:%s: deflateInit2 failed: %s",
+               lexpos(), nilp(sink->zs->msg));
+        Ns_Free(sink->zs);
+        sink->zs = NULL;
+        return NS_ERROR;
+    }
 
-        piece = OCI_NEXT_PIECE;
+    sink->zbuf = (Bytef *) Ns_Malloc(GZIP_BUFFER_SIZE);
 
-        do {
-            if (remainder > lob_buffer_size)
-                nbytes = lob_buffer_size;
-            else {
-                nbytes = remainder;
-                piece = OCI_LAST_PIECE;
-            }
+    return NS_OK;
+}
+/*}}}*/
 
-            readlen = read(fd, bufp, nbytes);
+/*{{{ gzip_sink_write */
+/* compress length bytes from bufp, writing whatever comes out to the
+   connection.  flush is Z_FINISH, with no bytes, once the whole LOB
+   has gone in.  Returns length, or -1 if the connection couldn't be
+   written. */
+static int
+gzip_sink_write(lob_sink_t *sink, void *bufp, int length, int flush)
+{
+    z_stream *zs = sink->zs;
+    int       out;
 
-            if (readlen < 0) {
-                Ns_Log(Error, "%s:%d:%s Error reading file %s: %d(%s)",
-                       lexpos(), path, errno, strerror(errno));
-                Tcl_AppendResult(interp, "can't read ", path,
-                                 " received error ", strerror(errno),
-                                 NULL);
-                piece = OCI_LAST_PIECE;
-            }
+    zs->next_in = (Bytef *) bufp;
+    zs->avail_in = length;
 
-            oci_status = OCILobWrite(connection->svc,
-                                     connection->err,
-                                     lobl,
-                                     &amtp,
-                                     offset,
-                                     bufp,
-                                     readlen,
-                                     piece, 0, 0, 0, SQLCS_IMPLICIT);
-            if (oci_status != OCI_NEED_DATA
-                && tcl_error_p(lexpos(), interp, dbh, "OCILobWrite", 0,
-                               oci_status)) {
-                goto bailout;
-            }
-            remainder -= readlen;
+    do {
+        zs->next_out = sink->zbuf;
+        zs->avail_out = GZIP_BUFFER_SIZE;
 
-        } while (oci_status == OCI_NEED_DATA && remainder > 0);
-    }
+        if (deflate(zs, flush) == Z_STREAM_ERROR) {
+            Ns_Log(Error, "%s:%d:%s: deflate failed", lexpos());
+            return -1;
+        }
 
-    if (tcl_error_p(lexpos(), interp, dbh, "OCILobWrite", 0, oci_status)) {
-        goto bailout;
-    }
+        out = GZIP_BUFFER_SIZE - zs->avail_out;
+        if (out > 0 
+            && Ns_WriteConn(sink->conn, (char *) sink->zbuf, out) != NS_OK)
+            return -1;
+    } while (zs->avail_out == 0);
 
-    status = NS_OK;
+    return length;
+}
+/*}}}*/
 
-  bailout:
+/*{{{ gzip_sink_end */
+static void
+gzip_sink_end(lob_sink_t *sink)
+{
+    deflateEnd(sink->zs);
+    Ns_Free(sink->zs);
+    Ns_Free(sink->zbuf);
+    sink->zs = NULL;
+    sink->zbuf = NULL;
+}
+/*}}}*/
 
-    if (bufp)
-        Ns_Free(bufp);
+/*{{{ spool_lob */
+/* read amount bytes of the lob, from offset on, at database speed,
+   so the handle can go back to the pool before a slow client has all
+   of it.  Up to spool_memory_limit bytes end up in ds, more in a
+   temporary file in spool_dir, already unlinked, whose descriptor is
+   left in *fdPtr and length in *lengthPtr.  More than
+   spool_file_limit isn't spooled at all; *spooledPtr is left 0 and
+   the caller streams it.  Returns a STREAM_WRITE_LOB_ status.
+*/
+static int
+spool_lob(Tcl_Interp *interp, Ns_DbHandle *dbh, OCILobLocator *lobl,
+          ub4 offset, ub4 amount, Ns_DString *ds, int *fdPtr, 
+          off_t *lengthPtr, int *spooledPtr)
+{
+    ora_connection_t *connection = dbh->connection;
+    Ns_DString        path;
+    int               fd;
+    int               status;
+
+    if (spool_file_limit > 0 && amount > (ub4) spool_file_limit) {
+        ns_ora_log(lexpos(), "lob of %d bytes is too big to spool", 
+                   (int) amount);
+        return STREAM_WRITE_LOB_OK;
+    }
+
+    if (amount <= (ub4) spool_memory_limit) {
+        if (read_lob_dstring(interp, dbh, lobl, offset, amount, ds) 
+            != TCL_OK)
+            return STREAM_WRITE_LOB_ERROR;
+        *lengthPtr = ds->length;
+        *spooledPtr = 1;
+        return STREAM_WRITE_LOB_OK;
+    }
+
+    Ns_DStringInit(&path);
+    Ns_DStringVarAppend(&path, spool_dir, "/nsoracle.XXXXXX", NULL);
+
+    fd = mkstemp(path.string);
+    if (fd < 0) {
+        Ns_Log(Error, "%s:%d:%s: can't create spool file %s. error %d(%s)",
+               lexpos(), path.string, errno, strerror(errno));
+        Tcl_AppendResult(interp, "can't create spool file ", path.string,
+                         ". received error ", strerror(errno), NULL);
+        Ns_DStringFree(&path);
+        return STREAM_WRITE_LOB_ERROR;
+    }
     close(fd);
 
-    if (status != NS_OK && connection->mode == transaction) {
-        ns_ora_log(lexpos(), "error writing lob.  rolling back transaction");
+    status = stream_write_lob(interp, dbh, 0, lobl, offset, amount, 
+                              path.string, 0, 
+                              connection->svc, connection->err);
 
-        oci_status = OCITransRollback(connection->svc,
-                                      connection->err, OCI_DEFAULT);
-        tcl_error_p(lexpos(), interp, dbh, "OCITransRollback", 0,
-                    oci_status);
+    if (status == STREAM_WRITE_LOB_OK) {
+        fd = open(path.string, O_RDONLY | EXTRA_OPEN_FLAGS);
+        if (fd < 0) {
+            Tcl_AppendResult(interp, "can't open spool file ", path.string,
+                             ". received error ", strerror(errno), NULL);
+            status = STREAM_WRITE_LOB_ERROR;
+        } else {
+            *fdPtr = fd;
+            *lengthPtr = lseek(fd, 0, SEEK_END);
+            lseek(fd, 0, SEEK_SET);
+            *spooledPtr = 1;
+        }
     }
 
+    unlink(path.string);
+    Ns_DStringFree(&path);
+
     return status;
 }
 /*}}}*/
 
-/*{{{ stream_actually_write*/
+/*{{{ spool_send */
+/* send what spool_lob read to the connection: length bytes from the
+   spool file if fd is open, ds otherwise.  Ns_ConnSendFd counts in
+   ints, so a file past 2 GB goes in several sends.  A client that
+   went away isn't an error; see stream_write_failed. */
 static int
-stream_actually_write(int fd, Ns_Conn * conn, void *bufp, int length,
-                      int to_conn_p)
+spool_send(Tcl_Interp *interp, Ns_Conn *conn, Ns_DString *ds, int fd, 
+           off_t length)
 {
-    int bytes_written = 0;
-
-    ns_ora_log(lexpos(), "entry (%d, %d, %d)", fd, length, to_conn_p);
-
-    if (to_conn_p) {
-        if (Ns_WriteConn(conn, bufp, length) == NS_OK) {
-            bytes_written = length;
-        } else {
-            bytes_written = 0;
+    int status = NS_OK;
+    int piece = ds->length;
+
+    errno = 0;
+    if (fd >= 0) {
+        while (status == NS_OK && length > 0) {
+            piece = (length > INT_MAX) ? INT_MAX : (int) length;
+            status = Ns_ConnSendFd(conn, fd, piece);
+            length -= piece;
         }
     } else {
-        bytes_written = write(fd, bufp, length);
+        status = Ns_WriteConn(conn, ds->string, ds->length);
     }
 
-    ns_ora_log(lexpos(), "exit (%d, %d, %d)", bytes_written, fd, length,
-        to_conn_p);
+    if (status != NS_OK
+        && stream_write_failed(interp, "to connection", -1, piece, errno)
+           == STREAM_WRITE_LOB_ERROR) {
+        return TCL_ERROR;
+    }
 
-    return bytes_written;
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ stream_write_lob*/
-/* snarf lobs using stream mode from Oracle into local buffers, then
-   write them to the given file (replacing the file if it exists) or
-   out to the connection.
-   This was cargo-culted from an example in the OCI programmer's
-   guide.
-*/
-static int
-stream_write_lob(Tcl_Interp * interp, Ns_DbHandle * dbh, int rowind,
-                 OCILobLocator * lobl, char *path, int to_conn_p,
-                 OCISvcCtx * svchp, OCIError * errhp)
+/*{{{ blob_cache_load */
+/* index the LOBs an earlier run left in blob_cache_dir, in no
+   particular order of use, and drop its unfinished ones. */
+static void
+blob_cache_load(void)
 {
-    ub4 offset = 1;
-    ub4 loblen = 0;
-    ub1 *bufp = NULL;
-    ub4 amtp = 0;
-    ub4 piece = 0;
-    ub4 remainder;              /* the number of bytes for the last piece */
-    int fd = 0;
-    int bytes_to_write, bytes_written;
-    int status = STREAM_WRITE_LOB_ERROR;
-    oci_status_t oci_status;
-    Ns_Conn *conn = NULL;
+    DIR                *dir;
+    struct dirent      *ent;
+    struct stat         st;
+    Ns_DString          path, key;
+    Tcl_HashEntry      *hPtr;
+    blob_cache_entry_t *entry;
+    char               *p, c;
+    int                 new, hex;
+
+    if (blob_cache_dir == NULL)
+        return;
 
-    if (path == NULL) {
-        path = "to connection";
+    dir = opendir(blob_cache_dir);
+    if (dir == NULL) {
+        Ns_Log(Warning, "%s:%d:%s: can't read BlobCacheDir %s: %s",
+               lexpos(), blob_cache_dir, strerror(errno));
+        return;
     }
 
-    ns_ora_log(lexpos(), "entry (path %s)", path);
+    Ns_DStringInit(&path);
+    Ns_DStringInit(&key);
 
-    if (to_conn_p) {
-        conn = Ns_TclGetConn(interp);
+    while ((ent = readdir(dir)) != NULL) {
+        Ns_DStringTrunc(&path, 0);
+        Ns_DStringVarAppend(&path, blob_cache_dir, "/", ent->d_name, NULL);
 
-        /* this Shouldn't Happen, but spew an error just in case */
-        if (conn == NULL) {
-            Ns_Log(Error, "%s:%d:%s: No AOLserver conn available",
-                   lexpos());
-            Tcl_AppendResult(interp, "No AOLserver conn available", NULL);
-            goto bailout;
+        if (!strncmp(ent->d_name, "tmp.", 4)) {
+            unlink(path.string);
+            continue;
         }
-    } else {
-        fd = open(path, O_CREAT | O_TRUNC | O_WRONLY | EXTRA_OPEN_FLAGS,
-                  0600);
 
-        if (fd < 0) {
-            Ns_Log(Error,
-                   "%s:%d:%s: can't open %s for writing. error %d(%s)",
-                   lexpos(), path, errno, strerror(errno));
-            Tcl_AppendResult(interp, "can't open file ", path,
-                             " for writing. ", "received error ",
-                             strerror(errno), NULL);
-            goto bailout;
-        }
-    }
+        if (strncmp(ent->d_name, "blob.", 5) 
+            || stat(path.string, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
 
-    oci_status = OCILobGetLength(svchp, errhp, lobl, &loblen);
-    if (tcl_error_p
-        (lexpos(), interp, dbh, "OCILobGetLength", path, oci_status))
-        goto bailout;
+        /* undo blob_cache_path */
+        Ns_DStringTrunc(&key, 0);
+        for (p = ent->d_name + 5; *p != '\0'; p++) {
+            if (*p == '%' && sscanf(p + 1, "%2x", &hex) == 1) {
+                c = (char) hex;
+                p += 2;
+            } else {
+                c = *p;
+            }
+            Ns_DStringNAppend(&key, &c, 1);
+        }
 
-    amtp = loblen;
+        hPtr = Tcl_CreateHashEntry(&blob_cache, key.string, &new);
+        if (!new)
+            continue;
 
-    ns_ora_log(lexpos(), "loblen %d", loblen);
+        entry = (blob_cache_entry_t *) Ns_Calloc(1, sizeof *entry);
+        entry->hPtr = hPtr;
+        entry->size = st.st_size;
+        Tcl_SetHashValue(hPtr, entry);
+        blob_cache_link(entry);
+        blob_cache_used += entry->size;
+    }
 
-    bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
-    memset((void *) bufp, (int) '\0', (size_t) lob_buffer_size);
+    closedir(dir);
+    Ns_DStringFree(&path);
+    Ns_DStringFree(&key);
 
-    oci_status = OCILobRead(svchp,
-                            errhp,
-                            lobl,
-                            &amtp,
-                            offset,
-                            bufp,
-                            (loblen <
-                             lob_buffer_size ? loblen : lob_buffer_size),
-                            0, 0, 0, SQLCS_IMPLICIT);
+    blob_cache_evict(NULL);
 
-    switch (oci_status) {
-    case OCI_SUCCESS:          /* only one piece */
-        ns_ora_log(lexpos(), "stream read %d'th piece\n", (int) (++piece));
+    Ns_Log(Notice, "nsoracle: %ld bytes of cached LOBs in %s",
+           (long) blob_cache_used, blob_cache_dir);
+}
+/*}}}*/
 
-        bytes_written =
-            stream_actually_write(fd, conn, bufp, loblen, to_conn_p);
+/*{{{ blob_cache_path */
+/* the file in blob_cache_dir that holds key's LOB.  Anything but
+   letters, digits, - and _ is escaped as %XX. */
+static void
+blob_cache_path(Ns_DString *ds, char *key)
+{
+    char buf[4];
 
-        if (bytes_written != (int) loblen) {
-            if (errno == EPIPE) {
-                status = STREAM_WRITE_LOB_PIPE;
-                goto bailout;
-            }
-            if (bytes_written < 0) {
-                Ns_Log(Error, "%s:%d:%s error writing %s.  error %d(%s)",
-                       lexpos(), path, errno, strerror(errno));
-                Tcl_AppendResult(interp, "can't write ", path,
-                                 " received error ", strerror(errno),
-                                 NULL);
-                goto bailout;
-            } else {
-                Ns_Log(Error,
-                       "%s:%d:%s error writing %s.  incomplete write of %d out of %d",
-                       lexpos(), path, bytes_written, loblen);
-                Tcl_AppendResult(interp, "can't write ", path,
-                                 " received error ", strerror(errno),
-                                 NULL);
-                goto bailout;
-            }
+    Ns_DStringVarAppend(ds, blob_cache_dir, "/blob.", NULL);
+    for (; *key != '\0'; key++) {
+        if (isalnum((unsigned char) *key) || *key == '-' || *key == '_') {
+            Ns_DStringNAppend(ds, key, 1);
+        } else {
+            snprintf(buf, sizeof buf, "%%%02X", (unsigned char) *key);
+            Ns_DStringAppend(ds, buf);
         }
-        break;
+    }
+}
+/*}}}*/
 
-    case OCI_ERROR:
-        break;
+/*{{{ blob_cache_link */
+/* make entry the most recently used.  Called with blob_cache_lock
+   held, as are the rest of the blob_cache_ functions but load, get
+   and put. */
+static void
+blob_cache_link(blob_cache_entry_t *entry)
+{
+    entry->prev = NULL;
+    entry->next = blob_cache_head;
+    if (blob_cache_head != NULL)
+        blob_cache_head->prev = entry;
+    blob_cache_head = entry;
+    if (blob_cache_tail == NULL)
+        blob_cache_tail = entry;
+}
+/*}}}*/
 
-    case OCI_NEED_DATA:        /* there are 2 or more pieces */
+/*{{{ blob_cache_unlink */
+static void
+blob_cache_unlink(blob_cache_entry_t *entry)
+{
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        blob_cache_head = entry->next;
 
-        remainder = loblen;
-        /* a full buffer to write */
-        bytes_written =
-            stream_actually_write(fd, conn, bufp, lob_buffer_size,
-                                  to_conn_p);
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        blob_cache_tail = entry->prev;
 
-        if (bytes_written != lob_buffer_size) {
-            if (errno == EPIPE) {
-                status = STREAM_WRITE_LOB_PIPE;
-                goto bailout;
-            }
-            if (bytes_written < 0) {
-                Ns_Log(Error, "%s:%d:%s error writing %s.  error %d(%s)",
-                       lexpos(), path, errno, strerror(errno));
-                Tcl_AppendResult(interp, "can't write ", path,
-                                 " received error ", strerror(errno),
-                                 NULL);
-                goto bailout;
-            } else {
-                Ns_Log(Error,
-                       "%s:%d:%s error writing %s.  incomplete write of %d out of %d",
-                       lexpos(), path, bytes_written, lob_buffer_size);
-                Tcl_AppendResult(interp, "can't write ", path,
-                                 " received error ", strerror(errno),
-                                 NULL);
-                goto bailout;
-            }
-        }
+    entry->prev = entry->next = NULL;
+}
+/*}}}*/
 
-        do {
-            memset(bufp, '\0', lob_buffer_size);
-            amtp = 0;
+/*{{{ blob_cache_remove */
+/* forget entry and remove its file.  Anyone sending it already has
+   it open. */
+static void
+blob_cache_remove(blob_cache_entry_t *entry)
+{
+    Ns_DString path;
 
-            remainder -= lob_buffer_size;
+    Ns_DStringInit(&path);
+    blob_cache_path(&path, Tcl_GetHashKey(&blob_cache, entry->hPtr));
+    unlink(path.string);
+    Ns_DStringFree(&path);
 
-            oci_status = OCILobRead(svchp,
-                                    errhp,
-                                    lobl,
-                                    &amtp,
-                                    offset,
-                                    bufp,
-                                    lob_buffer_size,
-                                    0, 0, 0, SQLCS_IMPLICIT);
-            if (oci_status != OCI_NEED_DATA
-                && tcl_error_p(lexpos(), interp, dbh, "OCILobRead", 0,
-                               oci_status)) {
-                goto bailout;
-            }
+    blob_cache_unlink(entry);
+    blob_cache_used -= entry->size;
+    Tcl_DeleteHashEntry(entry->hPtr);
+    Ns_Free(entry);
+}
+/*}}}*/
 
+/*{{{ blob_cache_evict */
+/* remove the least recently used LOBs, but not keep, until the cache
+   fits in blob_cache_size. */
+static void
+blob_cache_evict(blob_cache_entry_t *keep)
+{
+    while (blob_cache_used > blob_cache_size
+           && blob_cache_tail != NULL && blob_cache_tail != keep) {
+        ns_ora_log(lexpos(), "evicting %s",
+                   Tcl_GetHashKey(&blob_cache, blob_cache_tail->hPtr));
+        blob_cache_remove(blob_cache_tail);
+        stats_incr(&ora_stats.cache_evictions);
+    }
+}
+/*}}}*/
 
-            /* the amount read returned is undefined for FIRST, NEXT pieces */
-            ns_ora_log(lexpos(), "stream read %d'th piece, atmp = %d",
-                (int) (++piece), (int) amtp);
+/*{{{ blob_cache_get */
+/* open the cached copy of key's LOB, if there is one, leaving its
+   descriptor in *fdPtr and size in *sizePtr, and make it the most
+   recently used.  Returns NS_ERROR on a miss. */
+static int
+blob_cache_get(char *key, int *fdPtr, off_t *sizePtr)
+{
+    Tcl_HashEntry      *hPtr;
+    blob_cache_entry_t *entry;
+    Ns_DString          path;
+    int                 fd = -1;
+
+    Ns_DStringInit(&path);
+    blob_cache_path(&path, key);
+
+    Ns_MutexLock(&blob_cache_lock);
+    hPtr = Tcl_FindHashEntry(&blob_cache, key);
+    if (hPtr != NULL) {
+        entry = (blob_cache_entry_t *) Tcl_GetHashValue(hPtr);
+        fd = open(path.string, O_RDONLY | EXTRA_OPEN_FLAGS);
+        if (fd < 0) {
+            /* someone cleaned up the directory */
+            blob_cache_remove(entry);
+        } else {
+            blob_cache_unlink(entry);
+            blob_cache_link(entry);
+            *sizePtr = entry->size;
+        }
+    }
+    Ns_MutexUnlock(&blob_cache_lock);
 
-            if (remainder < lob_buffer_size) {  /* last piece not a full buffer piece */
-                bytes_to_write = remainder;
-            } else {
-                bytes_to_write = lob_buffer_size;
-            }
+    Ns_DStringFree(&path);
 
-            bytes_written =
-                stream_actually_write(fd, conn, bufp, bytes_to_write,
-                                      to_conn_p);
+    stats_incr(fd >= 0 ? &ora_stats.cache_hits : &ora_stats.cache_misses);
 
-            if (bytes_written != bytes_to_write) {
-                if (errno == EPIPE) {
-                    /* broken pipe means the user hit the stop button.
-                     * if that's the case, lie and say we've completed
-                     * successfully so we don't cause false-positive errors
-                     * in the server.log
-                     * photo.net ticket # 5901
-                     */
-                    status = STREAM_WRITE_LOB_PIPE;
-                } else {
-                    if (bytes_written < 0) {
-                        Ns_Log(Error,
-                               "%s:%d:%s error writing %s.  error %d(%s)",
-                               lexpos(), path, errno, strerror(errno));
-                        Tcl_AppendResult(interp, "can't write ", path,
-                                         " for writing. ",
-                                         " received error ",
-                                         strerror(errno), NULL);
-                    } else {
-                        Ns_Log(Error,
-                               "%s:%d:%s error writing %s.  incomplete write of %d out of %d",
-                               lexpos(), path, bytes_written,
-                               bytes_to_write);
-                        Tcl_AppendResult(interp, "can't write ", path,
-                                         " for writing. ",
-                                         " received error ",
-                                         strerror(errno), NULL);
-                    }
-                }
-                goto bailout;
-            }
-        } while (oci_status == OCI_NEED_DATA);
-        break;
+    *fdPtr = fd;
+    return (fd >= 0) ? NS_OK : NS_ERROR;
+}
+/*}}}*/
 
-    default:
-        Ns_Log(Error, "%s:%d:%s: Unexpected error from OCILobRead (%d)",
-               lexpos(), oci_status);
-        goto bailout;
-        break;
+/*{{{ blob_cache_put */
+/* read the whole lob into a new file in blob_cache_dir and make it
+   the cached copy of key's LOB, evicting others as needed.  The file
+   is left open, at its start, in *fdPtr.  Returns a STREAM_WRITE_LOB_
+   status; when only the file can't be written that is logged and
+   STREAM_WRITE_LOB_OK returned with *fdPtr -1, as a cache that can't
+   be written is no reason to fail the download. */
+static int
+blob_cache_put(Tcl_Interp *interp, Ns_DbHandle *dbh, OCILobLocator *lobl,
+               char *key, int *fdPtr)
+{
+    ora_connection_t   *connection = dbh->connection;
+    Ns_DString          tmp, path;
+    Tcl_HashEntry      *hPtr;
+    blob_cache_entry_t *entry;
+    lob_sink_t          sink;
+    off_t               size;
+    int                 new;
+    int                 status = STREAM_WRITE_LOB_ERROR;
+
+    Ns_DStringInit(&tmp);
+    Ns_DStringInit(&path);
+    Ns_DStringVarAppend(&tmp, blob_cache_dir, "/tmp.XXXXXX", NULL);
+    blob_cache_path(&path, key);
+
+    memset(&sink, 0, sizeof sink);
+    sink.path = tmp.string;
+    sink.fd = mkstemp(tmp.string);
+    if (sink.fd < 0) {
+        Ns_Log(Warning, "%s:%d:%s: can't create cache file %s. error %d(%s)",
+               lexpos(), tmp.string, errno, strerror(errno));
+        *fdPtr = -1;
+        status = STREAM_WRITE_LOB_OK;
+        goto done;
+    }
+
+    status = stream_lob_to_sink(interp, dbh, lobl, 1, 0, &sink,
+                                connection->svc, connection->err);
+    if (status != STREAM_WRITE_LOB_OK) {
+        close(sink.fd);
+        unlink(tmp.string);
+        if (sink.failed && !connection->needs_reopen) {
+            Ns_Log(Warning, "%s:%d:%s: not caching %s: %s",
+                   lexpos(), key, Tcl_GetStringResult(interp));
+            Tcl_ResetResult(interp);
+            *fdPtr = -1;
+            status = STREAM_WRITE_LOB_OK;
+        }
+        goto done;
     }
 
-    status = STREAM_WRITE_LOB_OK;
+    size = lseek(sink.fd, 0, SEEK_END);
+    lseek(sink.fd, 0, SEEK_SET);
+    *fdPtr = sink.fd;
 
-  bailout:
-    if (bufp)
-        Ns_Free(bufp);
+    Ns_MutexLock(&blob_cache_lock);
 
-    if (!to_conn_p) {
-        close(fd);
+    /* another thread may have missed on the same key */
+    hPtr = Tcl_FindHashEntry(&blob_cache, key);
+    if (hPtr != NULL)
+        blob_cache_remove((blob_cache_entry_t *) Tcl_GetHashValue(hPtr));
+
+    if (rename(tmp.string, path.string) != 0) {
+        Ns_Log(Error, "%s:%d:%s: can't rename %s to %s. error %d(%s)",
+               lexpos(), tmp.string, path.string, errno, strerror(errno));
+        unlink(tmp.string);
+    } else {
+        hPtr = Tcl_CreateHashEntry(&blob_cache, key, &new);
+        entry = (blob_cache_entry_t *) Ns_Calloc(1, sizeof *entry);
+        entry->hPtr = hPtr;
+        entry->size = size;
+        Tcl_SetHashValue(hPtr, entry);
+        blob_cache_link(entry);
+        blob_cache_used += size;
+        blob_cache_evict(entry);
     }
 
+    Ns_MutexUnlock(&blob_cache_lock);
+
+  done:
+    Ns_DStringFree(&tmp);
+    Ns_DStringFree(&path);
+
     return status;
 }
 /*}}}*/
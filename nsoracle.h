@@ -5,7 +5,14 @@
 #define STACK_BUFFER_SIZE      20000
 #define EXEC_PLSQL_BUFFER_SIZE 4096
 #define DML_BUFFER_SIZE        4000
-#define MAX_DYNAMIC_BUFFER     5000000 /* FIXME: should be config param? */
+#define LOAD_BATCH_SIZE        1000
+#define LOAD_FIELD_SIZE        128
+#define PLSQL_TABLE_SIZE       1000
+#define PLSQL_TABLE_ELEMENT_SIZE 256
+#define ARRAY_FETCH_SIZE       100
+#define MAX_DYNAMIC_BUFFER     5000000 /* default MaxPLSQLBufferSize */
+#define GZIP_BUFFER_SIZE       16384
+#define NUMERIC_CHARACTERS     "NLS_NUMERIC_CHARACTERS='.,'"
 #define EXCEPTION_CODE_SIZE    5
 
 #define BIND_OUT               1
@@ -23,6 +30,11 @@
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <dirent.h>
+#endif
+#include <zlib.h>
 #include <ns.h>
 
 #ifndef NS_DML
@@ -53,6 +65,24 @@ typedef dvoid oci_attribute_t;
 typedef dvoid oci_param_t;
 typedef dvoid oci_descriptor_t;
 
+/* 
+ * OCI 10 and later (ociver.h defines OCI_MAJOR_VERSION) have the
+ * OCILob*2 calls, whose 64 bit amounts let LOBs past 4 GB be written.
+ */
+#if defined(OCI_MAJOR_VERSION) && OCI_MAJOR_VERSION >= 10
+#define HAVE_OCI_LOB2 1
+typedef oraub8 lob_length_t;
+#else
+typedef ub4 lob_length_t;
+#endif
+
+/* OCIPing came with 10.2 */
+#if defined(OCI_MAJOR_VERSION) \
+    && (OCI_MAJOR_VERSION > 10 \
+        || (OCI_MAJOR_VERSION == 10 && OCI_MINOR_VERSION >= 2))
+#define HAVE_OCI_PING 1
+#endif
+
 typedef int (OracleCmdProc) (Tcl_Interp *interp, int objc, 
         struct Tcl_Obj * CONST * objv, Ns_DbHandle *dbh);
 
@@ -68,7 +98,14 @@ OracleCmdProc
     OracleLobDML,
     OracleLobDMLBind,
     OracleDesc,
-    OracleGetCols;
+    OracleGetCols,
+    OracleLoad,
+    OracleLoadFile,
+    OracleFetch,
+    OracleFetchDbo,
+    OracleCall,
+    OracleDescCached,
+    OracleStats;
 
 /* When we start a query, we allocate one fetch buffer for each 
  * column that we're querying, i.e., if you say "select foo,bar from yow"
@@ -105,10 +142,32 @@ struct fetch_buffer {
     /* Used for dynamic binds. */
     int   inout; 
 
-    /* support for array DML: the array of values for this bind variable. */
+    /* support for array DML: where this bind variable's values come
+       from, and the values of the chunk being executed. */
+    Tcl_Obj *array_list;    /* the list of values, one per row */
+    Tcl_Obj **array_rows;   /* or a dict or ns_set per row */
+    int array_sets_p;
     int array_count;
     char **array_values;
 
+    /* support for RETURNING INTO with array DML: the values Oracle
+       handed back during the chunk being executed, each
+       returning_width bytes, and the list of those of earlier chunks. */
+    ub4 returning_width;
+    ub4 returning_iters;
+    ub4 returning_rows;
+    struct returned_block *returned;
+    struct returned_block *returned_dummy;
+    Tcl_Obj *returned_list;
+
+    /* support for PL/SQL index-by tables: per-element indicators,
+       lengths and return codes, and the element count (curelep). */
+    ub4 max_elements;
+    ub4 n_elements;
+    sb2 *indicators;
+    ub2 *lengths;
+    ub2 *rcodes;
+
     /* 2-byte signed integer indicating null-ness; if null, value will be -1 */
     sb2 is_null;
 
@@ -117,6 +176,7 @@ struct fetch_buffer {
 
     /* these are only used for LONGs; the length of one piece */
     ub4 piecewise_fetch_length;
+    ub4 out_length;    /* bytes of a dynamic OUT bind received so far */
 
     /* in order to implement the clob_dml API call, we need 1 LOB 
        for every row/column intersection inserted.  I.e., if we do an 
@@ -130,10 +190,127 @@ struct fetch_buffer {
 
     /* Whether we determined that this column is a LOB during processing. */
     int is_lob;
+
+    /* PL/SQL LOB binds: whether lob is a temporary LOB we created, and
+       the file an OUT LOB is written to instead of its variable. */
+    int is_temporary;
+    char *lob_path;
 };
 
 typedef struct fetch_buffer fetch_buffer_t;
 
+/* Values returned by a RETURNING INTO bind in array DML, one slot of
+ * the bind's width per returned row.  Oracle hangs on to the pointers
+ * we give it until the execute has finished, so a full block is never
+ * grown; another one is chained on instead.  The slots follow the
+ * struct in the same allocation.
+ */
+struct returned_block {
+    struct returned_block *next;
+    ub4   size;
+    ub4   used;
+    ub4  *lengths;
+    ub2  *rcodes;
+    sb2  *indicators;
+    char *values;
+};
+
+typedef struct returned_block returned_block_t;
+
+/* One column of an [ns_ora load_file] batch: an array bind of
+ * fixed-width slots that the file parser fills in directly.
+ */
+struct load_column {
+    char    *name;
+    ub4      width;
+    char    *values;
+    sb2     *indicators;
+    ub2     *lengths;
+    OCIBind *bind;
+};
+
+typedef struct load_column load_column_t;
+
+/* One column of an array fetch from a cursor: fetch_size slots of
+ * width bytes each, or LOB locators for LOB columns.
+ */
+struct fetch_column {
+    char           *name;
+    OCITypeCode     type;
+    ub4             width;
+    char           *values;
+    sb2            *indicators;
+    ub2            *lengths;
+    OCILobLocator **lobs;
+    OCIDefine      *def;
+};
+
+typedef struct fetch_column fetch_column_t;
+
+/* Each interp's parsed copies of the package descriptions [ns_ora call]
+ * uses, each dropped once its shared entry's stamp moves on.
+ */
+struct desc_cache {
+    Tcl_HashTable packages;     /* of desc_copy_t */
+};
+
+typedef struct desc_cache desc_cache_t;
+
+struct desc_copy {
+    Tcl_Obj *desc;
+    int      stamp;
+};
+
+typedef struct desc_copy desc_copy_t;
+
+/* A package description in the shared describe cache */
+struct desc_entry {
+    char *datasource;   /* where and as whom it was described */
+    char *user;
+    char *package;      /* upper-cased, as asked for */
+    char *desc;         /* as [ns_ora desc] returns it */
+    char *ddl_time;     /* LAST_DDL_TIME when described, or NULL */
+    int   validated;    /* 0 if loaded from DescribeCacheFile and not
+                           yet checked against LAST_DDL_TIME */
+    int   stamp;        /* new for every entry, to tell copies apart */
+};
+
+typedef struct desc_entry desc_entry_t;
+
+/* Where stream_lob_to_sink puts the LOB pieces it reads: a file, the
+ * connection, or a Tcl channel, whichever is set.
+ */
+struct lob_sink {
+    char        *path;        /* names the sink in messages */
+    int          fd;          /* a file, if >= 0 */
+    Ns_Conn     *conn;        /* else the connection, if set */
+    Tcl_Channel  chan;        /* else a Tcl channel */
+    int          piece_size;  /* bytes per read, 0 for LOBBufferSize */
+    z_stream    *zs;          /* gzip what goes to conn, if set */
+    Bytef       *zbuf;        /* and the compressed output */
+    int          failed;      /* set when a write to it fails */
+};
+
+typedef struct lob_sink lob_sink_t;
+
+/* One OCILobRead of the next piece of a LOB, handed to a lob reader
+ * thread so that it runs while the last piece is written out.  The
+ * reader only reads; the sink is written by the thread that owns it.
+ */
+struct lob_read {
+    OCISvcCtx        *svchp;
+    OCIError         *errhp;
+    OCILobLocator    *lobl;
+    ub4               offset;
+    ub1              *buf;
+    ub4               buf_size;
+    oci_status_t      status;   /* what OCILobRead returned */
+    int               done;
+    struct lob_read  *next;     /* in lob_read_queue */
+};
+
+typedef struct lob_read lob_read_t;
+
 /* this is our own data structure for keeping track 
    of an Oracle connection 
 */
@@ -161,9 +338,40 @@ struct ora_connection {
     /* Fetch buffers; these change per query */
     sb4 n_columns;
     fetch_buffer_t *fetch_buffers;
+
+    /* Cursors returned by [ns_ora plsql -cursors], for [ns_ora fetch];
+       closed by the next plsql call.  Exhausted ones are NULL. */
+    int n_cursors;
+    OCIStmt **cursors;
+
+    /* Set when a LOB read was cut short and couldn't be ended
+       cleanly; only a new session fixes that. */
+    int needs_reopen;
 };
 typedef struct ora_connection ora_connection_t;
 
+/* Counters for [ns_ora stats], under stats_lock */
+struct ora_stats {
+    long lob_aborts;        /* LOB reads cut short, session kept */
+    long lob_reopens;       /* ones that needed a new session */
+    long error_reopens;     /* handles reopened after fatal errors */
+    long cache_hits;        /* write_blob -cache served from disk */
+    long cache_misses;      /* and read from Oracle */
+    long cache_evictions;   /* cached LOBs removed to make room */
+};
+
+/* A LOB kept in blob_cache_dir by write_blob -cache, hashed by its
+ * key in blob_cache and linked from most to least recently used.
+ */
+struct blob_cache_entry {
+    Tcl_HashEntry           *hPtr;
+    struct blob_cache_entry *prev;
+    struct blob_cache_entry *next;
+    off_t                    size;
+};
+
+typedef struct blob_cache_entry blob_cache_entry_t;
+
 /* A linked list to use when parsing SQL. */
 typedef struct _string_list_elt {
     char *string;
@@ -240,20 +448,162 @@ static void error(const char *file, int line, const char *fn, char *fmt, ...);
 static int oci_error_p(const char *file, int line, const char *fn,
                        Ns_DbHandle * dbh, char *ocifn, char *query,
                        oci_status_t oci_status);
+static oci_status_t execute_statement(Ns_DbHandle *dbh, OCIStmt *stmt, 
+        ub4 iters, ub4 mode, char *query);
+static int plsql_single_call_p(char *query);
+static void reset_packages(Ns_DbHandle *dbh, OCIError *err);
 static int tcl_error_p(const char *file, int line, const char *fn, Tcl_Interp * interp,
         Ns_DbHandle * dbh, char *ocifn, char *query,
         oci_status_t oci_status);
 static void downcase(char *s);
+static void upcase(char *s);
+static int read_line(FILE *fp, Ns_DString *ds);
+static int split_line(char *line, char delimiter, char **fields, 
+                      int max_fields);
+static int read_record(FILE *fp, Ns_DString *ds, int csv_p, 
+                       int *line_number);
+static int split_fields(char *record, char delimiter, int csv_p, 
+                        char **fields, int max_fields);
+static int sql_identifier_p(char *name);
+static unsigned plsql_buffer_size(unsigned wanted);
+static int plsql_implicit_results(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                                  Tcl_Obj *varName, int prefetch,
+                                  int fetch_size, int materialize);
+static int plsql_cursor_result(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                               fetch_buffer_t *fetchbuf, int prefetch,
+                               int fetch_size, int materialize);
+static int fetch_cursor_rows(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                             OCIStmt *stmt, int fetch_size, int max_rows,
+                             int dict_p, Tcl_Obj *rows, int *done_p);
+static void free_cursors(ora_connection_t *connection);
+static int get_cursor(Tcl_Interp *interp, ora_connection_t *connection,
+                      char *id, int *index);
+static Tcl_Obj *bind_spec(Tcl_Obj **specs, int n_specs, char *name);
+static int bind_plsql_lob(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                          fetch_buffer_t *fetchbuf, Tcl_Obj *spec, 
+                          int blob_p, char *query);
+static int create_temporary_lob(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                                fetch_buffer_t *fetchbuf, int blob_p,
+                                Tcl_Obj *value, char *query);
+static int plsql_lob_result(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                            fetch_buffer_t *fetchbuf);
+static int write_lob_buffer(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                            OCILobLocator *lobl, char *data, ub4 length);
+static int write_lob_pieces(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                            OCILobLocator *lobl, char *data, int fd,
+                            char *path, lob_length_t length, 
+                            ub4 piece_size);
+static oci_status_t lob_write_piece(ora_connection_t *connection, 
+                                    OCILobLocator *lobl, 
+                                    lob_length_t *amtp, void *bufp, 
+                                    ub4 nbytes, ub1 piece);
+static ub4 lob_piece_size(ub4 size, ub4 chunk_size);
+static int write_lob_content(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                             OCILobLocator *lobl, char *data, ub4 length,
+                             int piece_size);
+static char *memfind(char *haystack, int length, char *needle, 
+                     int needle_length);
+static int multipart_part(char *content, int length, char *content_type,
+                          char *name, char **partPtr, int *lengthPtr);
+static Tcl_Obj *read_lob_value(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                               OCILobLocator *lobl, int blob_p);
+static void free_temporary_lob(ora_connection_t *connection,
+                               fetch_buffer_t *fetchbuf);
+static int bind_plsql_table(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                            fetch_buffer_t *fetchbuf, Tcl_Obj *spec, 
+                            char *query);
+static Tcl_Obj *plsql_table_list(fetch_buffer_t *fetchbuf);
+static Tcl_Obj *cursor_dbo(Tcl_Obj *rows);
+static int describe_object(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+        char *package, int resolve);
+static Tcl_Obj *describe_cached(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+        char *datasource, char *user, char *package);
+static void describe_forget(Ns_DbHandle *dbh, char *package);
+static void desc_key(Ns_DString *key, char *datasource, char *user, 
+        char *package);
+static void desc_validate(Tcl_Interp *interp, Ns_DbHandle *dbh);
+static int desc_ddl_times(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+        char **names, int n_names, Tcl_HashTable *times);
+static void desc_free_times(Tcl_HashTable *times);
+static void desc_free_entry(desc_entry_t *entry);
+static void desc_load(void);
+static void desc_save(void);
+static void desc_line(Ns_DString *dsPtr, desc_entry_t *entry);
+static void desc_append(char *lines);
+static void free_desc_cache(ClientData clientData, Tcl_Interp *interp);
+static int call_score(Tcl_Interp *interp, Tcl_Obj *argument, 
+        Tcl_Obj *value);
+static int call_date(char *value, OCIDate *date);
+static int call_bind(Tcl_Interp *interp, Ns_DbHandle *dbh, 
+        fetch_buffer_t *fetchbuf, int j, char *mode, char *type, 
+        Tcl_Obj *value, char *query);
+static Tcl_Obj *call_value(Tcl_Interp *interp, Ns_DbHandle *dbh,
+        fetch_buffer_t *fetchbuf, int fetch_size, int format);
+static oci_status_t call_number(ora_connection_t *connection, char *value,
+        OCINumber *number);
+static int load_reject(Tcl_Interp *interp, FILE **bad_fp, char *bad_path,
+                       char *record);
 static char *nilp(char *s);
 static int stream_write_lob(Tcl_Interp * interp, Ns_DbHandle * dbh,
-                            int rowind, OCILobLocator * lobl, char *path,
+                            int rowind, OCILobLocator * lobl, 
+                            ub4 offset, ub4 amount, char *path,
                             int to_conn_p, OCISvcCtx * svchp,
                             OCIError * errhp);
+static int stream_lob_to_sink(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                              OCILobLocator *lobl, ub4 offset, ub4 amount,
+                              lob_sink_t *sink, OCISvcCtx *svchp,
+                              OCIError *errhp);
+static int spool_lob(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                     OCILobLocator *lobl, ub4 offset, ub4 amount,
+                     Ns_DString *ds, int *fdPtr, off_t *lengthPtr, 
+                     int *spooledPtr);
+static int spool_send(Tcl_Interp *interp, Ns_Conn *conn, Ns_DString *ds,
+                      int fd, off_t length);
+static int read_lob_dstring(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                            OCILobLocator *lobl, ub4 offset, 
+                            ub4 lob_length, Ns_DString *ds);
+static int lob_range(Ns_Conn *conn, off_t total, off_t *offsetPtr, 
+                     off_t *amountPtr);
+static int lob_headers(Tcl_Interp *interp, Ns_Conn *conn, char *type,
+                       int status, off_t offset, off_t amount, off_t total,
+                       int gzip_p);
+static int accepts_gzip_p(Ns_Conn *conn);
+static int gzip_type_p(char *type);
+static int gzip_sink_init(lob_sink_t *sink);
+static int gzip_sink_write(lob_sink_t *sink, void *bufp, int length, 
+                           int flush);
+static void gzip_sink_end(lob_sink_t *sink);
+static void blob_cache_load(void);
+static void blob_cache_path(Ns_DString *ds, char *key);
+static void blob_cache_link(blob_cache_entry_t *entry);
+static void blob_cache_unlink(blob_cache_entry_t *entry);
+static void blob_cache_remove(blob_cache_entry_t *entry);
+static void blob_cache_evict(blob_cache_entry_t *keep);
+static int blob_cache_get(char *key, int *fdPtr, off_t *sizePtr);
+static int blob_cache_put(Tcl_Interp *interp, Ns_DbHandle *dbh,
+                          OCILobLocator *lobl, char *key, int *fdPtr);
+static void lob_reader_thread(void *arg);
+static int lob_read_start(lob_read_t *rd);
+static oci_status_t lob_read_wait(lob_read_t *rd);
+static oci_status_t lob_read_piece(lob_read_t *rd);
+static int lob_read_abort(Ns_DbHandle *dbh, OCISvcCtx *svchp, 
+                          OCIError *errhp);
+static void lob_reopen(Ns_DbHandle *dbh);
+static void stats_incr(long *counter);
+static int stream_write_failed(Tcl_Interp *interp, char *path,
+                               int bytes_written, int bytes_to_write,
+                               int err);
 static int stream_read_lob(Tcl_Interp * interp, Ns_DbHandle * dbh,
                            int rowind, OCILobLocator * lobl, char *path,
-                           ora_connection_t * connection);
+                           ora_connection_t * connection, 
+                           int piece_size, int mmap_p);
 
 static string_list_elt_t * parse_bind_variables(char *input);
+static char *returning_into_clause(char *input, char **exprsPtr);
+static char *find_keyword(char *input, char *keyword);
+static int dml_table(char *query, Ns_DString *dsPtr);
+static void returning_widths(Ns_DbHandle *dbh, char *query, char *exprs,
+        char *into, int n, ub4 *widths);
 static void string_list_free_list(string_list_elt_t * head);
 static int string_list_len(string_list_elt_t * head);
 static string_list_elt_t * string_list_elt_new(char *string);
@@ -269,6 +619,12 @@ static sb4 list_element_put_data(dvoid * ictxp,
                       ub4 index,
                       dvoid ** bufpp,
                       ub4 * alenp, ub1 * piecep, dvoid ** indpp);
+static int row_bind_values(Tcl_Interp *interp, fetch_buffer_t *fetchbuf,
+        char *name, Tcl_Obj **rows, int n_rows, int sets_p, int *max_length);
+static int row_bind_value(Tcl_Interp *interp, Tcl_Obj *row, char *name,
+        int sets_p, char **valuePtr);
+static void array_fill_chunk(fetch_buffer_t *fetchbuf, ub4 offset, ub4 n);
+static void free_array_values(fetch_buffer_t *fetchbuf);
 static sb4 no_data(dvoid * ctxp, OCIBind * bindp,
         ub4 iter, ub4 index, dvoid ** bufpp, ub4 * alenpp, ub1 * piecep,
         dvoid ** indpp);
@@ -277,6 +633,13 @@ static sb4 get_data(dvoid * ctxp, OCIBind * bindp,
          ub4 iter, ub4 index, dvoid ** bufpp, ub4 ** alenp, ub1 * piecep,
          dvoid ** indpp, ub2 ** rcodepp);
 
+static sb4 returning_get_data(dvoid * ctxp, OCIBind * bindp,
+         ub4 iter, ub4 index, dvoid ** bufpp, ub4 ** alenp, ub1 * piecep,
+         dvoid ** indpp, ub2 ** rcodepp);
+static void free_returned_values(fetch_buffer_t * fetchbuf);
+static returned_block_t *returned_block_new(ub4 size, ub4 width);
+static void returned_values_append(fetch_buffer_t * fetchbuf);
+
 #ifdef FOR_CASSANDRACLE
 static int allow_sql_p(Ns_DbHandle * dbh, char *sql, int display_sql_p);
 #else
@@ -304,12 +667,73 @@ void OracleDescribeArguments (OCIDescribe *descHandlePtr,
 static int debug_p = NS_FALSE;  
 static int max_string_log_length = 0;
 static int lob_buffer_size = 16384;
+
+/* Bytes per OCI call when a file is written into a LOB, rounded to
+ * the LOB's chunk size */
+static int lob_write_size = 262144;
 static int char_expansion;
 
+/* Threads that read the next piece of a LOB while the last one is
+ * written out, started as needed up to max_lob_readers and kept; a
+ * read that finds none free is done by the writing thread itself */
+static int         max_lob_readers = 4;
+static int         lob_readers = 0;
+static int         lob_readers_idle = 0;
+static lob_read_t *lob_read_queue = NULL;
+static Ns_Mutex    lob_reader_lock;
+static Ns_Cond     lob_reader_cond;
+
 /* Prefetch parameters, if zero leave defaults */
 static ub4 prefetch_rows = 0;
 static ub4 prefetch_memory = 0;
 
+/* Execute array DML this many rows at a time; zero means all at once */
+static int array_dml_chunk_size = 0;
+
+/* Rows per round trip when fetching from PL/SQL cursors */
+static int array_fetch_size = ARRAY_FETCH_SIZE;
+
+/* Largest value a dynamically bound PL/SQL OUT variable can return */
+static int max_plsql_buffer_size = MAX_DYNAMIC_BUFFER;
+
+/* Package descriptions for [ns_ora call] and plsql::init, shared by
+ * all interps as desc_entry_t and keyed by datasource, user and
+ * package (see desc_key); desc_file_lock serializes writes to
+ * DescribeCacheFile, which are made without desc_lock held */
+static Tcl_HashTable desc_cache;
+static Ns_Mutex      desc_lock;
+static Ns_Mutex      desc_file_lock;
+static int           desc_stamp = 0;
+static int           desc_cache_initialized = 0;
+
+/* Where the describe cache is kept across restarts, if anywhere */
+static char *describe_cache_file = NULL;
+
+static struct ora_stats ora_stats;
+static Ns_Mutex         stats_lock;
+
+/* ns_ora write_blob -spool keeps LOBs up to spool_memory_limit bytes
+ * in memory, and up to spool_file_limit (0 for no limit) in a
+ * temporary file in spool_dir; bigger ones are streamed as usual */
+static int   spool_memory_limit = 1048576;
+static int   spool_file_limit = 104857600;
+static char *spool_dir = NULL;
+
+/* ns_ora write_blob -gzip compresses LOBs of at least gzip_min_size
+ * bytes whose type matches one of the glob patterns in gzip_types */
+static int   gzip_min_size = 1024;
+static char *gzip_types = NULL;
+
+/* ns_ora write_blob -cache keeps LOBs in blob_cache_dir, if set, up
+ * to blob_cache_size bytes in all */
+static char               *blob_cache_dir = NULL;
+static int                 blob_cache_size = 104857600;
+static Tcl_HashTable       blob_cache;
+static blob_cache_entry_t *blob_cache_head = NULL;
+static blob_cache_entry_t *blob_cache_tail = NULL;
+static off_t               blob_cache_used = 0;
+static Ns_Mutex            blob_cache_lock;
+
 static Ns_DbProc ora_procs[] = {
     {DbFn_Name,         (void *) Ns_OracleName},
     {DbFn_DbType,       (void *) Ns_OracleDbType},
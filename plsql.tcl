@@ -111,14 +111,19 @@ proc isfalse { varname } {
 
 #{{{ plsql::init
 #
+# With -lazy nothing is described or generated here: the first call to
+# a ::package::procedure that matches makes its wrapper (see
+# plsql::lazy_procedure).
+#
 proc plsql::init { args } {
 
   # handle regexp or glob matching
   parse_args args -regexp
+  parse_args args -lazy
   parse_args args -pool pool
   set package [lindex $args 0]
   set matches [lrange $args 1 end]
-  if { ![llength $package] } { error "Wrong # of args.  Should be [lindex [info level 1] 0] package ?-pool pool? ?-regexp? ?match? ?match? ?match?" }
+  if { ![llength $package] } { error "Wrong # of args.  Should be [lindex [info level 1] 0] package ?-pool pool? ?-regexp? ?-lazy? ?match? ?match? ?match?" }
   if { ![llength $matches] } {
     if { [is_arg_set -regexp] } {
       set matches [list .*]
@@ -127,17 +132,75 @@ proc plsql::init { args } {
     }
   }
 
-  # get the description of the package.
-  if { [llength $pool] } {
-    set dbh [ns_db gethandle $pool]
-  } else {
-    set dbh [ns_db gethandle]
+  if { [is_arg_set -lazy] } {
+    ns_log notice Deferring PL/SQL package $package until first call . . .
+    namespace eval ::${package} {}
+    nsv_set plsql_lazy $package [list $pool [is_arg_set -regexp] $matches]
+    ::plsql::install_unknown
+    return {}
   }
 
   ns_log notice Loading PL/SQL package $package . . .
 
-  set objects [ns_ora desc $dbh $package]
-  ns_db releasehandle $dbh
+  set objects [::plsql::describe $pool $package]
+  array set signatures [::plsql::signatures $objects]
+
+  foreach {object_name sigs} [array get signatures] {
+    if { [::plsql::matches [is_arg_set -regexp] $matches $object_name] } {
+      # set up the procedure in the package namespace
+      make_procedure $pool $package [string tolower $object_name] $sigs
+    }
+  }
+
+
+  if { [llength $objects] } {
+    return [info procs ::${package}::*]
+  } else {
+    error "Invalid Package"
+  }
+
+}
+#}}}
+
+#{{{ plsql::describe
+# the ns_ora desc description of a package, from the pool's describe
+# cache if it can be had without a handle.  Otherwise it is described
+# through the cache with dbh if given, or the connection's handle (see
+# plsql::conn_handle), and only failing both with a handle of its own: a
+# page that holds a handle from the pool can't get another.
+proc plsql::describe { pool package {dbh {}} } {
+
+  set objects [list]
+  set pool [::plsql::pool_name $pool]
+  if { [llength $pool] } {
+    set objects [ns_ora desc_cached $pool $package]
+    if { [llength $objects] } {
+      return $objects
+    }
+  }
+
+  set release 0
+  if { ![llength $dbh] && ![llength [set dbh [::plsql::conn_handle $pool]]] } {
+    set release 1
+    if { [llength $pool] } {
+      set dbh [ns_db gethandle $pool]
+    } else {
+      set dbh [ns_db gethandle]
+    }
+  }
+  catch { set objects [ns_ora desc_cached [ns_db poolname $dbh] $package $dbh] }
+  if { $release } {
+    ns_db releasehandle $dbh
+  }
+
+  return $objects
+}
+#}}}
+
+#{{{ plsql::signatures
+# turns a package description into object_name signatures pairs, the
+# signatures in the form make_procedure takes.
+proc plsql::signatures { objects } {
 
   # for each object (procedure or function)
   foreach object $objects {
@@ -159,23 +222,81 @@ proc plsql::init { args } {
     lappend signatures($object_name) [concat $object_type $args]
   }
 
-  foreach {object_name sigs} [array get signatures] {
-    foreach match $matches {
-      if { ([is_arg_set -regexp] && [regexp $match [string tolower $object_name]]) || (![is_arg_set -regexp] && [string match $match [string tolower $object_name]]) } {
-        # set up the procedure in the package namespace
-        make_procedure $pool $package [string tolower $object_name] $sigs
-        break
-      }
+  return [array get signatures]
+}
+#}}}
+
+#{{{ plsql::matches
+# 1 if object_name is one of the ones plsql::init was asked for.
+proc plsql::matches { regexp_p matches object_name } {
+
+  set object_name [string tolower $object_name]
+  foreach match $matches {
+    if { ($regexp_p && [regexp $match $object_name]) || (!$regexp_p && [string match $match $object_name]) } {
+      return 1
     }
   }
 
+  return 0
+}
+#}}}
 
-  if { [llength $objects] } {
-    return [info procs ::${package}::*]
-  } else {
-    error "Invalid Package"
+#{{{ plsql::install_unknown
+# puts plsql::lazy_procedure in front of ::unknown, once.  A namespace
+# unknown handler would only see calls made from inside the package's
+# namespace, so ::unknown is chained instead.
+proc plsql::install_unknown { } {
+
+  if { [llength [info procs ::plsql::chained_unknown]] } {
+    return
   }
 
+  rename ::unknown ::plsql::chained_unknown
+  proc ::unknown args {
+    if { [::plsql::lazy_procedure [lindex $args 0] [lrange $args 1 end]] } {
+      return [uplevel 1 $args]
+    }
+    uplevel 1 [list ::plsql::chained_unknown] $args
+  }
+}
+#}}}
+
+#{{{ plsql::lazy_procedure
+# makes the wrapper for package::procedure if its package was set up
+# with plsql::init -lazy and it is one of the ones asked for.  Only the
+# procedure called is generated; the description comes from the
+# driver's describe cache, so only the first call into a package
+# describes it, with the -handle in arguments if the call has one.
+# Returns 1 if the wrapper now exists.
+proc plsql::lazy_procedure { name {arguments {}} } {
+
+  if { ![regexp {^(?:::)?([^:]+)::([^:]+)$} $name -> package procedure] } {
+    return 0
+  }
+  if { ![nsv_exists plsql_lazy $package] } {
+    return 0
+  }
+  foreach { pool regexp_p matches } [nsv_get plsql_lazy $package] break;
+
+  if { ![::plsql::matches $regexp_p $matches $procedure] } {
+    return 0
+  }
+
+  set dbh {}
+  if { [set i [lsearch -exact $arguments -handle]] != -1 } {
+    set dbh [lindex $arguments [expr {$i + 1}]]
+  }
+
+  array set signatures [::plsql::signatures [::plsql::describe $pool $package $dbh]]
+  set object_name [string toupper $procedure]
+  if { ![info exists signatures($object_name)] } {
+    return 0
+  }
+
+  namespace eval ::${package} {}
+  make_procedure $pool $package [string tolower $procedure] $signatures($object_name)
+
+  return [llength [info procs ::${package}::[string tolower $procedure]]]
 }
 #}}}
 
@@ -201,18 +322,88 @@ proc plsql::make_procedure { pool package procedure signatures } {
   # initialize the namespace
   namespace eval ::${package} {}
 
+  # plsql::execute is only needed for -select, -debug or a ref_cursor_hook
+  # of your own, everything else is done in C by ns_ora call.
   if { [llength $pool] } {
+    set pool_arg [list $pool]
     proc ::${package}::${procedure} args [subst -nocommands {
+      if { [::plsql::native_p \$args] } {
+        return [::plsql::call \"$package\" \"$procedure\" \$args -pool $pool_arg]
+      }
       eval ::plsql::execute \"$package\" \"$procedure\" \"\{$signatures\}\" \"\{\$args\}\" -pool \"\{$pool\}\"
     }]
   } else {
     proc ::${package}::${procedure} args [subst -nocommands {
+      if { [::plsql::native_p \$args] } {
+        return [::plsql::call \"$package\" \"$procedure\" \$args]
+      }
       eval ::plsql::execute \"$package\" \"$procedure\" \"\{$signatures\}\" \"\{\$args\}\"
     }]
   }
 }
 #}}}
 
+#{{{ plsql::native_p
+# 1 if a wrapper can hand its arguments to plsql::call.
+proc plsql::native_p { arguments } {
+  expr { [lsearch -exact $arguments -select] == -1
+         && [lsearch -exact $arguments -debug] == -1
+         && [::plsql::get_ref_cursor_hook] == "::plsql::ref_cursor_hook" }
+}
+#}}}
+
+#{{{ plsql::call
+#
+# Calls package.procedure with ns_ora call, which picks the overload
+# and binds the arguments in C.  OUT and INOUT arguments name variables
+# in the wrapper's caller.  Takes -handle and -pool as plsql::execute does,
+# and like it uses the connection's handle (see plsql::conn_handle) when
+# not given one.
+#
+proc plsql::call { package procedure arguments args } {
+
+  set dbh {}
+  set pool {}
+  foreach option {-handle -pool} var {dbh pool} {
+    if { [set i [lsearch -exact $arguments $option]] != -1 } {
+      set $var [lindex $arguments [expr {$i + 1}]]
+      set arguments [lreplace $arguments $i [expr {$i + 1}]]
+    }
+  }
+  if { [set i [lsearch -exact $args -pool]] != -1 && ![llength $pool] } {
+    set pool [lindex $args [expr {$i + 1}]]
+  }
+
+  if { [llength $dbh] && ![llength $pool] } {
+    set release 0
+  } elseif { [llength [set dbh [::plsql::conn_handle $pool]]] } {
+    set release 0
+  } else {
+    set release 1
+    if { [llength $pool] } {
+      set dbh [ns_db gethandle $pool]
+    } else {
+      set dbh [ns_db gethandle]
+    }
+  }
+
+  set caught [catch {
+    uplevel 2 [concat [list ns_ora call $dbh -named 0 ${package}.${procedure}] $arguments]
+  } result]
+  set errorinfo $::errorInfo
+  set errorcode $::errorCode
+
+  if { $release } {
+    ns_db releasehandle $dbh
+  }
+  if { $caught } {
+    return -code error -errorinfo $errorinfo -errorcode $errorcode $result
+  }
+
+  return $result
+}
+#}}}
+
 #{{{ plsql::execute
 #
 proc plsql::execute { args } {
@@ -252,8 +443,11 @@ proc plsql::execute { args } {
       # -- means default, '--' means literal --
       if { $_default && [set $_varname] == "--" } { continue }
       # if it's a value, use the appropriate TO_type business
-      if { $_mode == "IN" } {
-        switch -glob -- [string map {CLOB VARCHAR2} $_type] {
+      if { $_type == "CLOB" || $_type == "BLOB" } {
+        # LOBs are passed as temporary LOBs, see ns_ora plsql -clob/-blob
+        lappend _lobs(-[string tolower $_type]) [list $_varname [string tolower $_mode]]
+      } elseif { $_mode == "IN" } {
+        switch -glob -- $_type {
           NUMBER      {
             set _bind TO_NUMBER($_bind)
           }
@@ -287,16 +481,19 @@ proc plsql::execute { args } {
     lappend _procedure_arguments "${_name}=>$_arg"
   }
 
-  # get a db handle
-  if { [llength $_pool] } {
-    set _dbh [ns_db gethandle $_pool]
-  } elseif { ![llength $_dbh] } {
-    set _dbh [ns_db gethandle]
-  }
-
-  if { [is_arg_set -handle] } {
+  # get a db handle, the connection's own unless told otherwise
+  set _conn 0
+  if { [is_arg_set -handle] && ![llength $_pool] } {
     set _release 0
+  } elseif { [llength [set _dbh [::plsql::conn_handle $_pool]]] } {
+    set _conn 1
+    set _release 1
   } else {
+    if { [llength $_pool] } {
+      set _dbh [ns_db gethandle $_pool]
+    } else {
+      set _dbh [ns_db gethandle]
+    }
     set _release 1
   }
 
@@ -324,18 +521,20 @@ proc plsql::execute { args } {
           # not -select.  use plsql and bind multiple out variables
           # this result_bind_variable___ stuff is just to make sure we're not stomping out another bind variable.  
           set result_bind_variable___ {}
+          if { $_return_type == "CLOB" || $_return_type == "BLOB" } {
+            lappend _lobs(-[string tolower $_return_type]) [list result_bind_variable___ out]
+          }
           set _call "BEGIN :result_bind_variable___ := ${_package}.${_procedure}([join $_procedure_arguments {, }]); END;"
           # the ns_oracle plsql call
           if { $_return_type == "REF CURSOR" } {
             # this function returns a ref cursor
-            ns_oracle_plsql _dbh $_call result_bind_variable___
+            ns_oracle_plsql _dbh $_call result_bind_variable___ 1 [array get _lobs]
+            # create and return a DBO.
             if { [catch {
-              set _setid [ns_db bindrow $_dbh]
+              set _release [::plsql::fetch_ref_cursor $_dbh _result 0]
             }] } {
               continue
             }
-            # create and return a DBO.
-            set _release [[::plsql::get_ref_cursor_hook] $_dbh $_setid _result 0]
           } else {
             # find the ref cursor argument, if any.
             foreach _parg $_signature {
@@ -347,12 +546,11 @@ proc plsql::execute { args } {
             }
             if { [info exists _ref] } {
               # $_ref is the ref cursor argument.
-              ns_oracle_plsql _dbh $_call $_ref
-              set _setid [ns_db bindrow $_dbh]
-              set _release [[::plsql::get_ref_cursor_hook] $_dbh $_setid $_ref 1]
+              ns_oracle_plsql _dbh $_call $_ref 1 [array get _lobs]
+              set _release [::plsql::fetch_ref_cursor $_dbh $_ref 1]
             } else {
               # no ref cursor argument
-              ns_oracle_plsql _dbh $_call
+              ns_oracle_plsql _dbh $_call {} 1 [array get _lobs]
             }
             set _result $result_bind_variable___
           }
@@ -371,27 +569,22 @@ proc plsql::execute { args } {
         }
         if { [info exists _ref] } {
           # $_ref is the ref cursor argument.
-          ns_oracle_plsql _dbh $_call $_ref
-          set _setid [ns_db bindrow $_dbh]
-          set _release [[::plsql::get_ref_cursor_hook] $_dbh $_setid $_ref 1]
+          ns_oracle_plsql _dbh $_call $_ref 1 [array get _lobs]
+          set _release [::plsql::fetch_ref_cursor $_dbh $_ref 1]
         } else {
           # no ref cursor argument
-          ns_oracle_plsql _dbh $_call
+          ns_oracle_plsql _dbh $_call {} 1 [array get _lobs]
         }
         set _result ""
       }
     }
   } _err]} {
     # if there was an error, drop the db handle anyway.
-    if { $_release } {
-      ns_db releasehandle $_dbh
-    }
+    ::plsql::done_with_handle $_dbh $_conn $_release
     error $_err
   } else {
     # no error, just drop the db handle if necessary.
-    if { $_release } {
-      ns_db releasehandle $_dbh
-    }
+    ::plsql::done_with_handle $_dbh $_conn $_release
   }
 
   # debugging
@@ -406,9 +599,115 @@ proc plsql::execute { args } {
 }
 #}}}
 
+#{{{ plsql::conn_handle
+#
+# Returns a handle from pool (the default pool if empty) that is kept for
+# the rest of the connection and released by ns_atclose when it closes,
+# so that the wrappers called while serving a page share one handle
+# instead of going back to the pool for each call.  Returns {} outside a
+# connection, or when turned off with plsql::use_conn_handle 0.
+#
+# While it is held the connection has a handle from that pool, and nsdb
+# won't give a thread a second one: code that does its own ns_db
+# gethandle on the same pool must call this instead.
+#
+proc plsql::conn_handle { {pool {}} } {
+  variable conn_id
+  variable conn_handles
+
+  if { ![::plsql::use_conn_handle] || [catch { ns_conn id } id] } {
+    return {}
+  }
+
+  # handles of an earlier connection were released when it closed
+  if { ![info exists conn_id] || $conn_id != $id } {
+    array unset conn_handles
+    set conn_id $id
+  }
+
+  # -pool main and the default pool may well be the same pool
+  set poolname [::plsql::pool_name $pool]
+  if { [info exists conn_handles($poolname)] } {
+    return $conn_handles($poolname)
+  }
+
+  if { [llength $pool] } {
+    set dbh [ns_db gethandle $pool]
+  } else {
+    set dbh [ns_db gethandle]
+  }
+  if { ![array size conn_handles] } {
+    ns_atclose ::plsql::release_conn_handles
+  }
+  set conn_handles([ns_db poolname $dbh]) $dbh
+
+  return $dbh
+}
+#}}}
+
+#{{{ plsql::pool_name
+# the pool ns_db gethandle takes a handle from, given pool or, if it is
+# empty, the server's default pool.
+proc plsql::pool_name { pool } {
+  if { [llength $pool] } {
+    return $pool
+  }
+  return [ns_config ns/server/[ns_info server]/db defaultpool]
+}
+#}}}
+
+#{{{ plsql::release_conn_handles
+# the ns_atclose callback for plsql::conn_handle.
+proc plsql::release_conn_handles { } {
+  variable conn_handles
+
+  foreach { pool dbh } [array get conn_handles] {
+    catch { ns_db releasehandle $dbh }
+  }
+  array unset conn_handles
+}
+#}}}
+
+#{{{ plsql::done_with_handle
+# gives back a handle plsql::execute got: a connection handle is kept,
+# unless a ref_cursor_hook said (by returning 0) that it released it.
+proc plsql::done_with_handle { dbh conn release } {
+  variable conn_handles
+
+  if { $conn } {
+    if { !$release } {
+      foreach { pool handle } [array get conn_handles] {
+        if { $handle == $dbh } {
+          unset conn_handles($pool)
+        }
+      }
+    }
+  } elseif { $release } {
+    ns_db releasehandle $dbh
+  }
+}
+#}}}
+
+#{{{ plsql::use_conn_handle
+# turns the connection handle on (1, the default) or off (0) for the whole
+# server; returns whether it is on.
+proc plsql::use_conn_handle { {use {}} } {
+  if { [llength $use] } {
+    nsv_set plsql use_conn_handle [string is true $use]
+  }
+  if { [nsv_exists plsql use_conn_handle] } {
+    return [nsv_get plsql use_conn_handle]
+  }
+  return 1
+}
+#}}}
+
 #{{{ plsql::ns_oracle_plsql
 #
-proc plsql::ns_oracle_plsql { dbh_var call {bind_variable {}} {loopsafe 1} } {
+# options are passed on to ns_ora plsql (-clob and -blob).  loopsafe 0
+# turns off the retry after a lost session.
+#
+proc plsql::ns_oracle_plsql { dbh_var call {bind_variable {}} {loopsafe 1} {options {}} } {
 
   # upvar the bind_variable
   if { [llength $bind_variable] } {
@@ -416,29 +715,58 @@ proc plsql::ns_oracle_plsql { dbh_var call {bind_variable {}} {loopsafe 1} } {
   }
   upvar $dbh_var handle
 
-  set caught [catch { uplevel "ns_ora plsql $handle \"$call\" $bind_variable" } oerr]
+  # ORA-04068 and friends (package state discarded after a recompile)
+  # are retried by the driver on this handle when the block is a single
+  # call, and otherwise returned with the packages reset, so there is no
+  # need to bounce the pool here.
+  set caught [catch {
+    uplevel [concat [list ns_ora plsql $handle] $options [list $call] $bind_variable]
+  } oerr]
+
+  # ORA-01012 and ORA-00028 (session not logged on, or killed) make the
+  # driver log this one handle on again, so the call, which never ran,
+  # is tried once more on it.  Other errors, including ones without an
+  # ORA code, are no longer retried: the statement may have done its work.
+  if { $caught && $loopsafe && [regexp {ORA-0(1012|0028):} $oerr] } {
+    ns_log warning "Retrying last query on a new session . . ."
+    set caught [catch {
+      uplevel [concat [list ns_ora plsql $handle] $options [list $call] $bind_variable]
+    } oerr]
+  }
 
-  # The following errors are non-fatal and the query *should* work if
-  # we just give it another try after bouncing the pool.
+  if { $caught } {
+    return -code error -errorinfo $::errorInfo -errorcode $::errorCode $oerr
+  }
 
-  if { $caught && $loopsafe && [lsearch -exact [list 04061 04068 1012 00028 04065 ""] [ns_dberrorcode $handle]] != -1  } {
-    # Don't recurse, try once, then give up.
-    if { [lindex [info level -1] 0] != "ns_oracle_plsql"} {
-      ns_log warning "Retrying last query . . ."
-      ns_db bouncepool [ns_db poolname $handle]
-      ns_db releasehandle $handle
-      set handle [ns_db gethandle]
-      uplevel "ns_oracle_plsql $dbh_var \"$call\" \"$bind_variable\" 0"
+}
+#}}}
+
+#{{{ plsql::fetch_ref_cursor
+# hands the REF CURSOR left on dbh to the ref_cursor_hook.  The default
+# hook's DBO is built in C by ns_ora fetch_dbo, without the row by row
+# ns_db getrow loop.  Returns what the hook returns.
+proc plsql::fetch_ref_cursor { dbh variable_name array_allowed } {
+
+  upvar $variable_name mydbo
+
+  set hook [::plsql::get_ref_cursor_hook]
+  if { $hook == "::plsql::ref_cursor_hook" } {
+    if { $array_allowed } {
+      array set mydbo [ns_ora fetch_dbo $dbh]
+    } else {
+      set mydbo [ns_ora fetch_dbo $dbh]
     }
-  } elseif { $caught } {
-    error $oerr
+    return 1
   }
 
+  set setid [ns_db bindrow $dbh]
+  return [$hook $dbh $setid mydbo $array_allowed]
 }
 #}}}
 
 #{{{ plsql::ref_cursor_hook
-# the default ref_cursor_hook (see set_ref_cursor_hook).
+# the default ref_cursor_hook (see set_ref_cursor_hook).  plsql::execute
+# uses ns_ora fetch_dbo instead, which builds the same DBO.
 proc plsql::ref_cursor_hook { dbh setid variable_name array_allowed } {
   
   upvar $variable_name mydbo
@@ -508,7 +836,12 @@ proc plsql::type { var parg } {
     return 10
   }
 
-  switch -glob -- [string map {CLOB VARCHAR2} $type] {
+  switch -glob -- $type {
+    CLOB       -
+    BLOB       {
+      # any value will do
+      return 1
+    }
     NUMBER     {
       if { [string is double $myvar] } {
         # it's a number
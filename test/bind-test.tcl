@@ -773,6 +773,183 @@ select an_int, chunks, a_varchar
 
 
 
+# array dml tests
+
+ns_write "<p><li> array dml, inline syntax, returning into. "
+
+set an_ints [list 10 11 12]
+set a_varchars [list "varchar value 10" "varchar value 11" "varchar value 12"]
+set returned_varchars ""
+
+ns_ora array_dml $db "
+insert into markd_bind_test (an_int, a_varchar)
+values (:an_ints, :a_varchars)
+returning a_varchar into :returned_varchars
+"
+
+if { $returned_varchars != $a_varchars } {
+    ns_write "<b><font color=red>didn't get expected values</font></b>"
+} else {
+    ns_write "got expected values"
+}
+
+
+ns_write "<li> array dml update, returning several rows per iteration. "
+
+set low_ints [list 10 12]
+set returned_ints ""
+
+ns_ora array_dml $db "
+update markd_bind_test set chunks = 'updated'
+ where an_int >= :low_ints
+returning an_int into :returned_ints
+"
+
+if { [lsort -integer $returned_ints] != [list 10 11 12 12] } {
+    ns_write "<b><font color=red>didn't get expected values</font></b>"
+} else {
+    ns_write "got expected values"
+}
+
+
+ns_write "<li> array dml, -rows with a missing key. "
+
+set rows [list \
+    [list an_int 20 a_varchar "varchar value 20"] \
+    [list an_int 21]]
+
+ns_ora array_dml $db -rows $rows "
+insert into markd_bind_test (an_int, a_varchar)
+values (:an_int, :a_varchar)
+"
+
+set n_null [ns_set value [ns_db 1row $db "
+select count(*) from markd_bind_test
+ where an_int in (20, 21) and a_varchar is null
+"] 0]
+if { $n_null != 1 } {
+    ns_write "<b><font color=red>didn't get expected values</font></b>"
+} else {
+    ns_write "got expected values"
+}
+
+
+ns_write "<li> array dml, -rows with a duplicate key. "
+
+set rows [list [list an_int 24 a_varchar first a_varchar last]]
+
+ns_ora array_dml $db -rows $rows "
+insert into markd_bind_test (an_int, a_varchar)
+values (:an_int, :a_varchar)
+"
+
+set a_varchar [ns_set value [ns_db 1row $db "
+select a_varchar from markd_bind_test where an_int = 24
+"] 0]
+if { $a_varchar != "last" } {
+    ns_write "<b><font color=red>didn't get expected values</font></b>"
+} else {
+    ns_write "got expected values"
+}
+
+
+ns_write "<li> array dml, -sets. "
+
+set sets [list]
+foreach i {22 23} {
+    set row [ns_set create]
+    ns_set put $row an_int $i
+    ns_set put $row a_varchar "varchar value $i"
+    lappend sets $row
+}
+
+ns_ora array_dml $db -sets $sets "
+insert into markd_bind_test (an_int, a_varchar)
+values (:an_int, :a_varchar)
+"
+
+set a_varchar [ns_set value [ns_db 1row $db "
+select a_varchar from markd_bind_test where an_int = 23
+"] 0]
+if { $a_varchar != "varchar value 23" } {
+    ns_write "<b><font color=red>didn't get expected values</font></b>"
+} else {
+    ns_write "got expected values"
+}
+
+
+# -chunk feeds Oracle a few rows per execute; every row should still
+# go in once, in order, however the rows fall across the chunks
+
+foreach { n_rows chunk_size } { 7 3  6 3  2 5  1 1 } {
+    ns_write "<li> array dml, $n_rows rows in chunks of $chunk_size, returning into. "
+
+    set an_ints [list]
+    set a_varchars [list]
+    for { set i 0 } { $i < $n_rows } { incr i } {
+        lappend an_ints [expr {100 + $i}]
+        lappend a_varchars "chunked value $i"
+    }
+    set returned_ints ""
+
+    ns_db dml $db "delete from markd_bind_test where an_int >= 100"
+
+    ns_ora array_dml $db -chunk $chunk_size "
+    insert into markd_bind_test (an_int, a_varchar)
+    values (:an_ints, :a_varchars)
+    returning an_int into :returned_ints
+    "
+
+    set selection [ns_db select $db "
+    select an_int, a_varchar from markd_bind_test
+     where an_int >= 100 order by an_int
+    "]
+    set back_ints [list]
+    set back_varchars [list]
+    while { [ns_db getrow $db $selection] } {
+        lappend back_ints [ns_set get $selection an_int]
+        lappend back_varchars [ns_set get $selection a_varchar]
+    }
+
+    if { $back_ints != $an_ints || $back_varchars != $a_varchars
+         || $returned_ints != $an_ints } {
+        ns_write "<b><font color=red>didn't get expected values</font></b>"
+    } else {
+        ns_write "got expected values"
+    }
+}
+
+
+ns_write "<li> array dml update in chunks, several rows per iteration. "
+
+ns_db dml $db "delete from markd_bind_test where an_int >= 100"
+
+set an_ints [list 100 101 102 103 104]
+
+ns_ora array_dml $db "
+insert into markd_bind_test (an_int) values (:an_ints)
+"
+
+set low_ints [list 100 102 104]
+set returned_ints ""
+
+ns_ora array_dml $db -chunk 2 "
+update markd_bind_test set chunks = 'chunked'
+ where an_int >= :low_ints
+returning an_int into :returned_ints
+"
+
+# 5 rows for 100, 3 for 102 and 1 for 104, the last in a chunk of its own
+if { [lsort -integer $returned_ints] 
+     != [list 100 101 102 102 103 103 104 104 104] } {
+    ns_write "<b><font color=red>didn't get expected values</font></b>"
+} else {
+    ns_write "got expected values"
+}
+
+
+
+
 # wrap it up
 
 ns_write "<p><li> cleaning up test table"
@@ -0,0 +1,253 @@
+# call-test.tcl -- exercise ns_ora call and the ORA-04068 retry
+# $Id$
+
+# The retry tests recompile the package on a second handle, so the
+# default pool needs at least two.
+
+
+# checks a value against what was expected
+proc call_test_check { value expected } {
+    if { [string compare $value $expected] == 0 } {
+        ns_write "they match"
+    } else {
+        ns_write "<font color=red>they don't match: got [ns_quotehtml $value]</font>"
+    }
+}
+
+
+# (re)creates the test package's body, its counter starting at start
+proc call_test_body { db start } {
+    ns_db dml $db "
+create or replace package body markd_call_test as
+  g_count number := $start;
+
+  function echo (p_value number) return varchar2 is
+  begin
+    return 'number ' || p_value;
+  end;
+
+  function echo (p_value varchar2) return varchar2 is
+  begin
+    return 'varchar2 ' || p_value;
+  end;
+
+  function echo (p_value date) return varchar2 is
+  begin
+    return 'date ' || to_char(p_value, 'YYYY-MM-DD');
+  end;
+
+  function add (p_a number, p_b number default 1) return number is
+  begin
+    return p_a + p_b;
+  end;
+
+  procedure swap (p_in in number, p_out out varchar2,
+                  p_inout in out number) is
+  begin
+    p_out := 'got ' || p_in;
+    p_inout := p_inout * 2;
+  end;
+
+  function bump return number is
+  begin
+    g_count := g_count + 1;
+    return g_count;
+  end;
+end markd_call_test;"
+}
+
+
+ReturnHeaders
+
+ns_write "
+<html>
+<head>
+    <title>Oracle Driver Call Tests</title>
+</head>
+
+<body bgcolor=white>
+<h2>Oracle Driver Call Tests</h2>
+<hr>
+
+<blockquote>
+
+This outputs what it will be doing before it actually does it.
+If an error happens, look for the prior &lt;li&gt;
+
+<ul>
+"
+
+
+
+ns_write "<li> getting two db handles"
+
+set handles [ns_db gethandle [ns_config ns/server/[ns_info server]/db defaultpool] 2]
+set db [lindex $handles 0]
+set db2 [lindex $handles 1]
+
+
+
+ns_write "<li> setting up test package"
+
+ns_db dml $db "
+create or replace package markd_call_test as
+  function echo (p_value number) return varchar2;
+  function echo (p_value varchar2) return varchar2;
+  function echo (p_value date) return varchar2;
+  function add (p_a number, p_b number default 1) return number;
+  procedure swap (p_in in number, p_out out varchar2,
+                  p_inout in out number);
+  function bump return number;
+end markd_call_test;"
+
+call_test_body $db 0
+
+
+
+ns_write "<p><li> <b>Starting overload tests</b>"
+
+ns_write "<li> a number picks the NUMBER overload. "
+
+call_test_check [ns_ora call $db markd_call_test.echo 42] "number 42"
+
+
+ns_write "<li> text picks the VARCHAR2 overload. "
+
+call_test_check [ns_ora call $db markd_call_test.echo abc] "varchar2 abc"
+
+
+ns_write "<li> a date picks the DATE overload. "
+
+call_test_check [ns_ora call $db markd_call_test.echo 2024-06-30] "date 2024-06-30"
+
+
+ns_write "<li> a DD-MON-YYYY date picks the DATE overload. "
+
+call_test_check [ns_ora call $db markd_call_test.echo 30-JUN-2024] "date 2024-06-30"
+
+
+ns_write "<li> a number keeps digits a double would lose. "
+
+call_test_check [ns_ora call $db markd_call_test.echo 12345678901234567890.125] \
+    "number 12345678901234567890.125"
+
+
+ns_write "<li> a quoted number picks the VARCHAR2 overload. "
+
+call_test_check [ns_ora call $db markd_call_test.echo '42'] "varchar2 42"
+
+
+ns_write "<li> a named argument. "
+
+call_test_check [ns_ora call $db markd_call_test.echo -p_value 42] "number 42"
+
+
+
+ns_write "<p><li> <b>Starting argument and result tests</b>"
+
+ns_write "<li> a function result, every argument given. "
+
+call_test_check [ns_ora call $db markd_call_test.add 2 5] 7
+
+
+ns_write "<li> a function result, a default left out. "
+
+call_test_check [ns_ora call $db markd_call_test.add 2] 3
+
+
+ns_write "<li> a function result, a default asked for with --. "
+
+call_test_check [ns_ora call $db markd_call_test.add -p_b -- -p_a 2] 3
+
+
+ns_write "<li> OUT and INOUT arguments, positional. "
+
+set out ""
+set inout 21
+ns_ora call $db markd_call_test.swap 5 out inout
+
+call_test_check [list $out $inout] {{got 5} 42}
+
+
+ns_write "<li> OUT and INOUT arguments, named. "
+
+set out ""
+set inout 4
+ns_ora call $db markd_call_test.swap -p_inout inout -p_out out -p_in 6
+
+call_test_check [list $out $inout] {{got 6} 8}
+
+
+
+ns_write "<p><li> <b>Starting ORA-04068 retry tests</b>"
+
+ns_write "<li> the package keeps its state between calls. "
+
+set first [ns_ora call $db markd_call_test.bump]
+set second [ns_ora call $db markd_call_test.bump]
+
+call_test_check [list $first $second] {1 2}
+
+
+ns_write "<li> ns_ora call after the package is recompiled elsewhere. "
+
+call_test_body $db2 100
+
+if { [catch { ns_ora call $db markd_call_test.bump } result] } {
+    ns_write "<font color=red>it failed: [ns_quotehtml $result]</font>"
+} else {
+    call_test_check $result 101
+}
+
+
+ns_write "<li> ns_ora exec_plsql after the package is recompiled elsewhere. "
+
+call_test_body $db2 200
+
+if { [catch { ns_ora exec_plsql $db "begin :1 := markd_call_test.bump; end;" } result] } {
+    ns_write "<font color=red>it failed: [ns_quotehtml $result]</font>"
+} else {
+    call_test_check $result 201
+}
+
+
+
+ns_write "<li> a block doing more than one call isn't run again. "
+
+call_test_body $db2 300
+
+if { [catch { ns_ora exec_plsql $db "begin :1 := markd_call_test.bump + markd_call_test.bump; end;" } result]
+     && [string match "*ORA-0406*" $result] } {
+    ns_write "it isn't"
+} else {
+    ns_write "<font color=red>it was: [ns_quotehtml $result]</font>"
+}
+
+
+ns_write "<li> the next call gets the new package. "
+
+call_test_check [ns_ora call $db markd_call_test.bump] 301
+
+
+
+# wrap it up
+
+ns_write "<p><li> cleaning up test package"
+
+ns_db dml $db "drop package markd_call_test"
+
+
+ns_write "<li> explicitly releasing handles"
+
+ns_db releasehandle $db
+ns_db releasehandle $db2
+
+
+ns_write "
+</ul>
+</blockquote>
+<hr>
+<address><a href=\"mailto:markd@ardigita.com\">markd@arsdigita.com</a></address>
+</body>
+</html>
+"
@@ -8,6 +8,8 @@ set small_file_name "/tmp/markd-small.txt"
 set medium_file_name "/tmp/markd-medium.txt"
 set large_file_name "/tmp/markd-large.txt"
 set large_binary_file_name "/tmp/markd-large.bin"
+set piece_file_name "/tmp/markd-piece.bin"
+set piece_text_file_name "/tmp/markd-piece.txt"
 
 
 # must be bigger than 48K so that it exercises the piece-wise sections of code
@@ -852,6 +854,210 @@ catch { exec rm -f ${large_binary_file_name}-back }
 
 
 
+ns_write "<p><li> <b>Starting -piecesize and -mmap tests</b>"
+
+ns_write "<p><li> setting up test files"
+
+# every byte value, and not a whole number of pieces or chunks
+set f [open $piece_file_name w]
+fconfigure $f -translation binary
+for { set i 0 } { $i < 1000 } { incr i } {
+    for { set j 0 } { $j < 256 } { incr j } {
+        puts -nonewline $f [binary format c [expr {($i + $j) % 256}]]
+    }
+}
+puts -nonewline $f "tail"
+close $f
+
+set f [open $piece_text_file_name w]
+for { set i 0 } { $i < 5000 } { incr i } {
+    puts $f "line $i of the piece test file"
+}
+close $f
+
+set f [open $empty_file_name w]
+close $f
+
+
+# checks a file against the one it was loaded from
+proc clob_test_compare { path } {
+    if [catch { exec cmp $path ${path}-back } ] {
+        ns_write "<font color=red>they don't match</font>"
+    } else {
+        ns_write "they match"
+    }
+    catch { exec rm -f ${path}-back }
+}
+
+
+ns_write "<p> <li> inserting a binary file as blob, -piecesize 1000"
+
+ns_ora blob_dml_file $db -piecesize 1000 "
+insert into markd_lob_test (lob_id, blunks)
+values (700, empty_blob())
+returning blunks into :1" $piece_file_name
+
+ns_write "<li> making sure we get an equivalent file back. "
+
+ns_ora blob_get_file $db "select blunks from markd_lob_test where lob_id = 700" ${piece_file_name}-back
+clob_test_compare $piece_file_name
+
+
+ns_write "<p> <li> inserting a binary file as blob, -mmap"
+
+ns_ora blob_dml_file $db -mmap "
+insert into markd_lob_test (lob_id, blunks)
+values (701, empty_blob())
+returning blunks into :1" $piece_file_name
+
+ns_write "<li> making sure we get an equivalent file back. "
+
+ns_ora blob_get_file $db "select blunks from markd_lob_test where lob_id = 701" ${piece_file_name}-back
+clob_test_compare $piece_file_name
+
+
+ns_write "<p> <li> inserting a text file as clob, -mmap -piecesize 65536"
+
+ns_ora clob_dml_file $db -mmap -piecesize 65536 "
+insert into markd_lob_test (lob_id, chunks)
+values (702, empty_clob())
+returning chunks into :1" $piece_text_file_name
+
+ns_write "<li> making sure we get an equivalent file back. "
+
+ns_ora clob_get_file $db "select chunks from markd_lob_test where lob_id = 702" ${piece_text_file_name}-back
+clob_test_compare $piece_text_file_name
+
+
+ns_write "<p> <li> inserting an empty file as blob, -mmap"
+
+ns_ora blob_dml_file $db -mmap "
+insert into markd_lob_test (lob_id, blunks)
+values (703, empty_blob())
+returning blunks into :1" $empty_file_name
+
+ns_write "<li> making sure we get an empty file back. "
+
+ns_ora blob_get_file $db "select blunks from markd_lob_test where lob_id = 703" ${empty_file_name}-back
+clob_test_compare $empty_file_name
+
+
+ns_write "<p> <li> making sure a -piecesize that isn't a number is refused. "
+
+if { [catch { ns_ora blob_dml_file $db -piecesize lots "
+insert into markd_lob_test (lob_id, blunks)
+values (704, empty_blob())
+returning blunks into :1" $piece_file_name }] } {
+    ns_write "it is"
+} else {
+    ns_write "<font color=red>it isn't</font>"
+}
+
+
+
+
+ns_write "<p><li> <b>Starting *_get_channel tests</b>"
+
+# reads a file back
+proc clob_test_read { path } {
+    set f [open $path r]
+    fconfigure $f -translation binary
+    set contents [read $f]
+    close $f
+    return $contents
+}
+
+
+ns_write "<p> <li> writing a blob to a channel"
+
+set f [open ${piece_file_name}-back w]
+fconfigure $f -translation binary
+ns_ora blob_get_channel $db "select blunks from markd_lob_test where lob_id = 700" $f
+close $f
+
+ns_write "<li> making sure we get an equivalent file. "
+
+clob_test_compare $piece_file_name
+
+
+ns_write "<p> <li> writing a blob to a channel, -piecesize 100"
+
+set f [open ${piece_file_name}-back w]
+fconfigure $f -translation binary
+ns_ora blob_get_channel $db -piecesize 100 "select blunks from markd_lob_test where lob_id = 700" $f
+close $f
+
+ns_write "<li> making sure we get an equivalent file. "
+
+clob_test_compare $piece_file_name
+
+
+ns_write "<p> <li> writing a clob to a channel"
+
+set f [open ${piece_text_file_name}-back w]
+ns_ora clob_get_channel $db "select chunks from markd_lob_test where lob_id = 702" $f
+close $f
+
+ns_write "<li> making sure we get an equivalent file. "
+
+clob_test_compare $piece_text_file_name
+
+
+ns_write "<p> <li> making sure the channel is left open. "
+
+set f [open ${piece_file_name}-back w]
+fconfigure $f -translation binary
+ns_ora blob_get_channel $db "select blunks from markd_lob_test where lob_id = 700" $f
+if { [catch { puts -nonewline $f "end"; close $f }] } {
+    ns_write "<font color=red>it isn't</font>"
+} elseif { [clob_test_read ${piece_file_name}-back] 
+           != "[clob_test_read $piece_file_name]end" } {
+    ns_write "<font color=red>it is, but the file doesn't match</font>"
+} else {
+    ns_write "it is"
+}
+catch { exec rm -f ${piece_file_name}-back }
+
+
+if { [llength [info commands zlib]] } {
+    ns_write "<p> <li> writing a blob to a channel with gzip stacked on it"
+
+    set f [open ${piece_file_name}-back w]
+    fconfigure $f -translation binary
+    zlib push gzip $f
+    ns_ora blob_get_channel $db "select blunks from markd_lob_test where lob_id = 700" $f
+    close $f
+
+    ns_write "<li> making sure it unzips to an equivalent file. "
+
+    if { [zlib gunzip [clob_test_read ${piece_file_name}-back]] 
+         == [clob_test_read $piece_file_name] } {
+        ns_write "they match"
+    } else {
+        ns_write "<font color=red>they don't match</font>"
+    }
+    catch { exec rm -f ${piece_file_name}-back }
+}
+
+
+ns_write "<p> <li> making sure a channel that isn't open for writing is refused. "
+
+set f [open $piece_file_name r]
+if { [catch { ns_ora blob_get_channel $db "select blunks from markd_lob_test where lob_id = 700" $f }] } {
+    ns_write "it is"
+} else {
+    ns_write "<font color=red>it isn't</font>"
+}
+close $f
+
+
+ns_write "<p><li> cleaning up files"
+catch { exec rm -f $empty_file_name }
+catch { exec rm -f $piece_text_file_name }
+catch { exec rm -f $piece_file_name }
+
+
+
 
 # now for write* tests
 
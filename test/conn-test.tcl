@@ -0,0 +1,619 @@
+# conn-test.tcl -- exercise the calls that read or write the connection
+# $Id$
+
+# The page requests itself over a socket, the query saying what to
+# serve, so the server needs at least two connection threads, and a
+# handle the served request can get while this one waits.
+
+
+# the BLOB the served requests send, 26 bytes so ranges are easy to check
+set range_lob "abcdefghijklmnopqrstuvwxyz"
+set range_file_name "/tmp/markd-range.bin"
+
+# a BLOB too big for SpoolMemoryLimit (1 MB by default), so -spool
+# puts it in a file
+set big_lob [string repeat "0123456789abcdef" 524288]
+set big_file_name "/tmp/markd-big.bin"
+
+
+# the served requests; the query is parsed here rather than with
+# ns_queryget so that a malformed multipart body can't get in the way
+
+set query [ns_parsequery [ns_conn query]]
+
+switch -- [ns_set get $query serve] {
+    range {
+        set db [ns_db gethandle]
+        if { [ns_set get $query etag] != "" } {
+            ns_set put [ns_conn outputheaders] ETag [ns_set get $query etag]
+        }
+        ns_ora write_blob $db -range "select blunks from markd_conn_test where lob_id = 1"
+        ns_db releasehandle $db
+        return
+    }
+    release {
+        # the handle is still ours after -release: it runs a query,
+        # and releasing it once more is an error, not a second release
+        set db [ns_db gethandle]
+        ns_ora write_blob $db -release -type text/plain "select blunks from markd_conn_test where lob_id = 1"
+        set count [database_to_tcl_string $db "select count(*) from markd_conn_test where lob_id = 1"]
+        ns_db releasehandle $db
+        set second [catch { ns_db releasehandle $db }]
+        nsv_set markd_conn_test release [list $count $second]
+        return
+    }
+    spool {
+        set db [ns_db gethandle]
+        ns_ora write_blob $db -spool -range "select blunks from markd_conn_test where lob_id = 3"
+        ns_db releasehandle $db
+        return
+    }
+    gzip {
+        set db [ns_db gethandle]
+        set type [ns_set get $query type]
+        if { $type == "" } {
+            set type text/plain
+        }
+        ns_ora write_blob $db -gzip -range -type $type "select blunks from markd_conn_test where lob_id = [ns_set get $query lob_id]"
+        ns_db releasehandle $db
+        return
+    }
+    cache {
+        set db [ns_db gethandle]
+        ns_ora write_blob $db -range -cache [ns_set get $query key] "select blunks from markd_conn_test where lob_id = [ns_set get $query lob_id]"
+        ns_db releasehandle $db
+        return
+    }
+    abort {
+        # the client goes away part way through; the session should
+        # be the same one afterwards
+        set db [ns_db gethandle]
+        set sid "select sys_context('userenv', 'sessionid') from dual"
+        set before [database_to_tcl_string $db $sid]
+        catch { ns_ora write_blob $db "select blunks from markd_conn_test where lob_id = 3" }
+        set after [database_to_tcl_string $db $sid]
+        ns_db releasehandle $db
+        nsv_set markd_conn_test abort [expr {$before == $after}]
+        return
+    }
+    part {
+        # the part goes into a new row, and back as the reply
+        set db [ns_db gethandle]
+        set lob_id [ns_set get $query lob_id]
+        if { [catch { ns_ora blob_dml_conn $db -part [ns_set get $query name] "
+insert into markd_conn_test (lob_id, blunks)
+values ($lob_id, empty_blob())
+returning blunks into :1" } errmsg] } {
+            set reply "error: $errmsg"
+        } else {
+            set reply [database_to_tcl_string $db "select blunks from markd_conn_test where lob_id = $lob_id"]
+        }
+        ns_db releasehandle $db
+        ns_return 200 text/plain $reply
+        return
+    }
+}
+
+
+# sends a request to this page with the given query, headers and body,
+# and returns the status, the Content-Range and the body of the reply
+proc conn_test_request { method query headers {body ""} } {
+    regexp {^[a-z]+://([^:/]+)(:([0-9]+))?} [ns_conn location] \
+        match host colon port
+    if { $port == "" } {
+        set port 80
+    }
+
+    foreach { rfd wfd } [ns_sockopen $host $port] break
+    fconfigure $rfd -translation binary
+    fconfigure $wfd -translation binary
+
+    puts -nonewline $wfd "$method [ns_conn url]?$query HTTP/1.0\r\n"
+    foreach { name value } $headers {
+        puts -nonewline $wfd "$name: $value\r\n"
+    }
+    if { $method == "POST" } {
+        puts -nonewline $wfd "Content-Length: [string length $body]\r\n"
+    }
+    puts -nonewline $wfd "\r\n$body"
+    flush $wfd
+
+    set reply [read $rfd]
+    close $rfd
+    close $wfd
+
+    set end [string first "\r\n\r\n" $reply]
+    set status [lindex [string range $reply 0 [string first "\r\n" $reply]] 1]
+    set range ""
+    foreach line [split [string range $reply 0 [expr {$end - 1}]] "\n"] {
+        regexp -nocase {^content-range: *([^\r]*)} $line match range
+    }
+
+    return [list $status $range [string range $reply [expr {$end + 4}] end]]
+}
+
+
+# asks for this page with the given query, but goes away after
+# reading the first few bytes of the reply
+proc conn_test_abort { query } {
+    regexp {^[a-z]+://([^:/]+)(:([0-9]+))?} [ns_conn location] \
+        match host colon port
+    if { $port == "" } {
+        set port 80
+    }
+
+    foreach { rfd wfd } [ns_sockopen $host $port] break
+    fconfigure $rfd -translation binary
+    puts -nonewline $wfd "GET [ns_conn url]?$query HTTP/1.0\r\n\r\n"
+    flush $wfd
+    read $rfd 100
+    close $rfd
+    close $wfd
+}
+
+
+# asks for this page with the given query and headers
+proc conn_test_get { query args } {
+    return [conn_test_request GET $query $args]
+}
+
+
+# posts a multipart/form-data body to this page, as boundary (quoted
+# in the Content-Type if quote_p) separates the given parts, each a
+# Content-Disposition and a value; returns the body of the reply
+proc conn_test_post { query boundary quote_p parts {close_p 1} } {
+    set body ""
+    foreach { disposition value } $parts {
+        append body "--$boundary\r\n" \
+            "Content-Disposition: form-data; $disposition\r\n" \
+            "\r\n" $value "\r\n"
+    }
+    if { $close_p } {
+        append body "--$boundary--\r\n"
+    }
+
+    if { $quote_p } {
+        set type "multipart/form-data; boundary=\"$boundary\""
+    } else {
+        set type "multipart/form-data; boundary=$boundary"
+    }
+
+    return [lindex [conn_test_request POST $query \
+                        [list Content-Type $type] $body] 2]
+}
+
+
+# checks a reply against what was expected
+proc conn_test_check { reply expected } {
+    if { [string compare $reply $expected] == 0 } {
+        ns_write "they match"
+    } else {
+        ns_write "<font color=red>they don't match: got [ns_quotehtml $reply]</font>"
+    }
+}
+
+
+ReturnHeaders
+
+ns_write "
+<html>
+<head>
+    <title>Oracle Driver Connection Tests</title>
+</head>
+
+<body bgcolor=white>
+<h2>Oracle Driver Connection Tests</h2>
+<hr>
+
+<blockquote>
+
+This outputs what it will be doing before it actually does it.
+If an error happens, look for the prior &lt;li&gt;
+
+<ul>
+"
+
+
+
+ns_write "<li> getting db handle"
+
+set db [ns_db gethandle]
+set driver_section ns/db/driver/[ns_db driver $db]
+
+
+
+ns_write "<li> setting up test table"
+
+catch { ns_db dml $db "drop table markd_conn_test" }
+ns_db dml $db "create table markd_conn_test (lob_id integer, chunks clob, blunks blob)"
+
+set f [open $range_file_name w]
+fconfigure $f -translation binary
+puts -nonewline $f $range_lob
+close $f
+
+ns_ora blob_dml_file $db "
+insert into markd_conn_test (lob_id, blunks)
+values (1, empty_blob())
+returning blunks into :1" $range_file_name
+
+ns_ora clob_dml $db "
+insert into markd_conn_test (lob_id, chunks)
+values (2, empty_clob())
+returning chunks into :1" $range_lob
+
+set f [open $big_file_name w]
+fconfigure $f -translation binary
+puts -nonewline $f $big_lob
+close $f
+
+ns_ora blob_dml_file $db "
+insert into markd_conn_test (lob_id, blunks)
+values (3, empty_blob())
+returning blunks into :1" $big_file_name
+
+
+
+ns_write "<p><li> <b>Starting write_blob -range tests</b>"
+
+ns_write "<li> making sure write_clob won't take -range. "
+
+if { [catch { ns_ora write_clob $db -range "select chunks from markd_conn_test where lob_id = 2" } errmsg]
+     && [string match "*only write_blob takes -range*" $errmsg] } {
+    ns_write "it won't"
+} else {
+    ns_write "<font color=red>it did</font>"
+}
+
+# the served requests need a handle of their own
+ns_db releasehandle $db
+
+
+ns_write "<li> a plain range. "
+
+conn_test_check [conn_test_get serve=range Range bytes=0-4] \
+    [list 206 "bytes 0-4/26" abcde]
+
+
+ns_write "<li> a range running past the end. "
+
+conn_test_check [conn_test_get serve=range Range bytes=20-99] \
+    [list 206 "bytes 20-25/26" uvwxyz]
+
+
+ns_write "<li> an open-ended range. "
+
+conn_test_check [conn_test_get serve=range Range bytes=20-] \
+    [list 206 "bytes 20-25/26" uvwxyz]
+
+
+ns_write "<li> a suffix range. "
+
+conn_test_check [conn_test_get serve=range Range bytes=-3] \
+    [list 206 "bytes 23-25/26" xyz]
+
+
+ns_write "<li> a suffix range longer than the BLOB. "
+
+conn_test_check [conn_test_get serve=range Range bytes=-100] \
+    [list 206 "bytes 0-25/26" $range_lob]
+
+
+ns_write "<li> a range starting at the end. "
+
+conn_test_check [conn_test_get serve=range Range bytes=26-30] \
+    [list 416 "bytes */26" ""]
+
+
+ns_write "<li> a range starting past the end. "
+
+conn_test_check [conn_test_get serve=range Range bytes=100-] \
+    [list 416 "bytes */26" ""]
+
+
+ns_write "<li> several ranges get the whole BLOB. "
+
+conn_test_check [conn_test_get serve=range Range bytes=0-1,4-5] \
+    [list 200 "" $range_lob]
+
+
+ns_write "<li> an If-Range that matches the ETag. "
+
+conn_test_check [conn_test_get serve=range&etag=%22v1%22 \
+                     Range bytes=0-4 If-Range {"v1"}] \
+    [list 206 "bytes 0-4/26" abcde]
+
+
+ns_write "<li> an If-Range that doesn't match gets the whole BLOB. "
+
+conn_test_check [conn_test_get serve=range&etag=%22v1%22 \
+                     Range bytes=0-4 If-Range {"v2"}] \
+    [list 200 "" $range_lob]
+
+
+ns_write "<li> a weak If-Range gets the whole BLOB. "
+
+conn_test_check [conn_test_get serve=range&etag=%22v1%22 \
+                     Range bytes=0-4 If-Range {W/"v1"}] \
+    [list 200 "" $range_lob]
+
+
+
+ns_write "<p><li> <b>Starting write_blob -release tests</b>"
+
+ns_write "<li> the BLOB is sent. "
+
+nsv_set markd_conn_test release ""
+
+conn_test_check [conn_test_get serve=release] [list 200 "" $range_lob]
+
+
+ns_write "<li> the handle still works afterwards, and is released only once. "
+
+conn_test_check [nsv_get markd_conn_test release] {1 1}
+
+
+ns_write "<li> a BLOB spooled to a file is sent whole. "
+
+conn_test_check [string equal [conn_test_get serve=spool] [list 200 "" $big_lob]] 1
+
+
+ns_write "<li> a range of a BLOB spooled to a file. "
+
+conn_test_check [conn_test_get serve=spool Range bytes=5000000-5000009] \
+    [list 206 "bytes 5000000-5000009/8388608" [string range $big_lob 5000000 5000009]]
+
+
+
+ns_write "<p><li> <b>Starting write_blob -gzip tests</b>"
+
+# a reply's body, unzipped if it looks gzipped and zlib is there to
+# do it; "gzipped" if it does but zlib isn't
+proc conn_test_gunzip { reply } {
+    set body [lindex $reply 2]
+    if { [string range $body 0 1] != "\x1f\x8b" } {
+        return [list [lindex $reply 0] plain $body]
+    }
+    if { [llength [info commands zlib]] } {
+        return [list [lindex $reply 0] gzip [zlib gunzip $body]]
+    }
+    return [list [lindex $reply 0] gzip gzipped]
+}
+
+if { [llength [info commands zlib]] } {
+    set gzipped_lob $big_lob
+} else {
+    set gzipped_lob gzipped
+}
+
+
+ns_write "<li> a client that takes gzip gets it. "
+
+conn_test_check [string equal \
+                     [conn_test_gunzip [conn_test_get serve=gzip&lob_id=3 Accept-Encoding gzip]] \
+                     [list 200 gzip $gzipped_lob]] 1
+
+
+ns_write "<li> a client that doesn't gets the BLOB as it is. "
+
+conn_test_check [string equal \
+                     [conn_test_gunzip [conn_test_get serve=gzip&lob_id=3]] \
+                     [list 200 plain $big_lob]] 1
+
+
+ns_write "<li> gzip with q=0 is refused. "
+
+conn_test_check [string equal \
+                     [conn_test_gunzip [conn_test_get serve=gzip&lob_id=3 Accept-Encoding "gzip;q=0, identity"]] \
+                     [list 200 plain $big_lob]] 1
+
+
+ns_write "<li> a BLOB smaller than GzipMinSize isn't compressed. "
+
+conn_test_check [conn_test_gunzip [conn_test_get serve=gzip&lob_id=1 Accept-Encoding gzip]] \
+    [list 200 plain $range_lob]
+
+
+ns_write "<li> a type not in GzipTypes isn't compressed. "
+
+conn_test_check [string equal \
+                     [conn_test_gunzip [conn_test_get serve=gzip&lob_id=3&type=image/png Accept-Encoding gzip]] \
+                     [list 200 plain $big_lob]] 1
+
+
+ns_write "<li> a range isn't compressed. "
+
+conn_test_check [conn_test_gunzip [conn_test_get serve=gzip&lob_id=3 Accept-Encoding gzip Range bytes=0-4]] \
+    [list 206 plain 01234]
+
+
+
+ns_write "<p><li> <b>Starting write_blob -cache tests</b>"
+
+# what one request did to the cache counters, and what it got
+proc conn_test_cached { query args } {
+    array set before [ns_ora stats]
+    set reply [eval [list conn_test_get $query] $args]
+    array set after [ns_ora stats]
+    set counts [list]
+    foreach counter {cache_hits cache_misses cache_evictions} {
+        lappend counts [expr {$after($counter) - $before($counter)}]
+    }
+    return [list $counts $reply]
+}
+
+# keys outlive the rows, so each run uses new ones
+set key markd-[clock seconds]
+
+if { [ns_config $driver_section BlobCacheDir] == "" } {
+    ns_write "<li> skipped, BlobCacheDir isn't set"
+} else {
+    ns_write "<li> the first request misses. "
+
+    conn_test_check [conn_test_cached serve=cache&lob_id=1&key=$key-1] \
+        [list {0 1 0} [list 200 "" $range_lob]]
+
+
+    ns_write "<li> the next one hits. "
+
+    conn_test_check [conn_test_cached serve=cache&lob_id=1&key=$key-1] \
+        [list {1 0 0} [list 200 "" $range_lob]]
+
+
+    ns_write "<li> a hit doesn't run the query. "
+
+    conn_test_check [conn_test_cached serve=cache&lob_id=99&key=$key-1] \
+        [list {1 0 0} [list 200 "" $range_lob]]
+
+
+    ns_write "<li> a range of a cached BLOB. "
+
+    conn_test_check [conn_test_cached serve=cache&lob_id=1&key=$key-1 Range bytes=20-] \
+        [list {1 0 0} [list 206 "bytes 20-25/26" uvwxyz]]
+
+
+    ns_write "<li> a new key misses. "
+
+    conn_test_check [conn_test_cached serve=cache&lob_id=1&key=$key-2] \
+        [list {0 1 0} [list 200 "" $range_lob]]
+
+
+    set cache_size [ns_config $driver_section BlobCacheSize 104857600]
+    set big_length [string length $big_lob]
+
+    ns_write "<li> a BLOB bigger than BlobCacheSize isn't cached. "
+
+    if { $cache_size >= $big_length } {
+        ns_write "skipped, BlobCacheSize is $cache_size"
+    } else {
+        conn_test_get serve=cache&lob_id=3&key=$key-3
+        conn_test_check [lindex [conn_test_cached serve=cache&lob_id=3&key=$key-3] 0] \
+            {0 1 0}
+    }
+
+
+    ns_write "<li> the least recently used BLOB makes room. "
+
+    if { $cache_size < $big_length || $cache_size >= 2 * $big_length } {
+        ns_write "skipped, BlobCacheSize is $cache_size"
+    } else {
+        # whatever else is cached goes first, so count at least one
+        conn_test_get serve=cache&lob_id=3&key=$key-3
+        set evicted [lindex [conn_test_cached serve=cache&lob_id=3&key=$key-4] 0]
+        set again [lindex [conn_test_cached serve=cache&lob_id=3&key=$key-3] 0]
+        conn_test_check [list [lrange $evicted 0 1] [expr {[lindex $evicted 2] > 0}] \
+                             [lrange $again 0 1]] \
+            {{0 1} 1 {0 1}}
+    }
+}
+
+
+
+ns_write "<p><li> <b>Starting aborted write_blob tests</b>"
+
+ns_write "<li> a client that goes away part way through. "
+
+array set before [ns_ora stats]
+nsv_set markd_conn_test abort ""
+conn_test_abort serve=abort
+
+# wait for the served request to finish
+for { set i 0 } { $i < 30 && [nsv_get markd_conn_test abort] == "" } { incr i } {
+    ns_sleep 1
+}
+array set after [ns_ora stats]
+
+conn_test_check [list [nsv_get markd_conn_test abort] \
+                     [expr {$after(lob_aborts) - $before(lob_aborts)}] \
+                     [expr {$after(lob_reopens) - $before(lob_reopens)}]] \
+    {1 1 0}
+
+
+
+ns_write "<p><li> <b>Starting blob_dml_conn -part tests</b>"
+
+ns_write "<li> a part, with the boundary quoted. "
+
+conn_test_check [conn_test_post serve=part&name=photo&lob_id=10 \
+                     "xyzzy 42" 1 \
+                     [list {name="caption"} "a caption" \
+                           {name="photo"; filename="me.jpg"} "PHOTO DATA"]] \
+    "PHOTO DATA"
+
+
+ns_write "<li> a part, with the boundary unquoted. "
+
+conn_test_check [conn_test_post serve=part&name=photo&lob_id=11 \
+                     xyzzy 0 \
+                     [list {name="photo"} "PHOTO DATA" \
+                           {name="caption"} "a caption"]] \
+    "PHOTO DATA"
+
+
+ns_write "<li> name=\"x\" isn't filename=\"x\". "
+
+conn_test_check [conn_test_post serve=part&name=x&lob_id=12 \
+                     xyzzy 0 \
+                     [list {name="file"; filename="x"} "wrong part" \
+                           {name="x"} "right part"]] \
+    "right part"
+
+
+ns_write "<li> an empty part. "
+
+conn_test_check [conn_test_post serve=part&name=empty&lob_id=13 \
+                     xyzzy 0 \
+                     [list {name="empty"} "" \
+                           {name="caption"} "a caption"]] \
+    ""
+
+
+ns_write "<li> a part missing from the request. "
+
+conn_test_check [conn_test_post serve=part&name=photo&lob_id=14 \
+                     xyzzy 0 \
+                     [list {name="caption"} "a caption"]] \
+    "error: no part named \"photo\" in the request"
+
+
+ns_write "<li> a body without the closing delimiter. "
+
+conn_test_check [conn_test_post serve=part&name=photo&lob_id=15 \
+                     xyzzy 0 \
+                     [list {name="photo"} "PHOTO DATA"] 0] \
+    "error: no part named \"photo\" in the request"
+
+
+ns_write "<li> a request that isn't multipart. "
+
+conn_test_check [lindex [conn_test_request POST serve=part&name=photo&lob_id=16 \
+                             [list Content-Type application/x-www-form-urlencoded] \
+                             "photo=PHOTO+DATA"] 2] \
+    "error: no part named \"photo\" in the request"
+
+
+set db [ns_db gethandle]
+
+
+
+# wrap it up
+
+ns_write "<p><li> cleaning up test table"
+
+ns_db dml $db "drop table markd_conn_test"
+catch { exec rm -f $range_file_name $big_file_name }
+
+
+ns_write "<li> explicitly releasing handle"
+
+ns_db releasehandle $db
+
+
+ns_write "
+</ul>
+</blockquote>
+<hr>
+<address><a href=\"mailto:markd@ardigita.com\">markd@arsdigita.com</a></address>
+</body>
+</html>
+"
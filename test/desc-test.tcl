@@ -0,0 +1,185 @@
+# desc-test.tcl -- exercise the PL/SQL package describe cache
+# $Id$
+
+# The file tests need DescribeCacheFile set in the driver's section;
+# loading the file again on restart isn't tested here.
+
+
+# the last line DescribeCacheFile has for the package, or "" if the
+# file isn't configured or doesn't mention it
+proc desc_test_last_line { db package } {
+    set path [ns_config ns/db/driver/[ns_db driver $db] DescribeCacheFile]
+    if { $path == "" || ![file exists $path] } {
+        return ""
+    }
+
+    set f [open $path r]
+    set lines [split [read $f] "\n"]
+    close $f
+
+    set last ""
+    foreach line $lines {
+        if { ![catch { lindex $line 2 } name] && $name == $package } {
+            set last $line
+        }
+    }
+    return $last
+}
+
+
+# checks a value against what was expected
+proc desc_test_check { value expected } {
+    if { [string compare $value $expected] == 0 } {
+        ns_write "they match"
+    } else {
+        ns_write "<font color=red>they don't match: got [ns_quotehtml $value]</font>"
+    }
+}
+
+
+ReturnHeaders
+
+ns_write "
+<html>
+<head>
+    <title>Oracle Driver Describe Cache Tests</title>
+</head>
+
+<body bgcolor=white>
+<h2>Oracle Driver Describe Cache Tests</h2>
+<hr>
+
+<blockquote>
+
+This outputs what it will be doing before it actually does it.
+If an error happens, look for the prior &lt;li&gt;
+
+<ul>
+"
+
+
+
+ns_write "<li> getting db handle"
+
+set db [ns_db gethandle]
+set pool [ns_db poolname $db]
+set file_p [string length [ns_config ns/db/driver/[ns_db driver $db] DescribeCacheFile]]
+
+# descriptions outlive the package, so each run describes a new one
+set package markd_desc_[clock seconds]
+
+
+
+ns_write "<li> setting up test package"
+
+ns_db dml $db "
+create or replace package $package as
+  function f (p_a number) return number;
+end $package;"
+
+ns_db dml $db "
+create or replace package body $package as
+  function f (p_a number) return number is
+  begin
+    return p_a;
+  end;
+end $package;"
+
+
+
+ns_write "<p><li> <b>Starting describe cache tests</b>"
+
+ns_write "<li> desc_cached with a handle describes the package as desc does. "
+
+desc_test_check [ns_ora desc_cached $pool $package $db] \
+    [ns_ora desc $db $package]
+
+
+ns_write "<li> desc_cached without a handle finds it. "
+
+desc_test_check [ns_ora desc_cached $pool $package] \
+    [ns_ora desc $db $package]
+
+
+ns_write "<li> the description is added to the end of DescribeCacheFile. "
+
+if { !$file_p } {
+    ns_write "skipped, DescribeCacheFile isn't set"
+} else {
+    set line [desc_test_last_line $db [string toupper $package]]
+    desc_test_check [list [llength $line] [lindex $line 4]] \
+        [list 5 [ns_ora desc $db $package]]
+}
+
+
+
+ns_write "<p><li> <b>Starting invalidation tests</b>"
+
+ns_write "<li> ns_ora call uses the cached description. "
+
+desc_test_check [ns_ora call $db ${package}.f 7] 7
+
+
+ns_write "<li> a call to a package changed since it was described fails. "
+
+ns_db dml $db "
+create or replace package $package as
+  function f (p_a number, p_b number) return number;
+end $package;"
+
+ns_db dml $db "
+create or replace package body $package as
+  function f (p_a number, p_b number) return number is
+  begin
+    return p_a + p_b;
+  end;
+end $package;"
+
+if { [catch { ns_ora call $db ${package}.f 7 } errmsg]
+     && [string match "*ORA-06550*" $errmsg] } {
+    ns_write "it does"
+} else {
+    ns_write "<font color=red>it doesn't: [ns_quotehtml $errmsg]</font>"
+}
+
+
+ns_write "<li> the failed call dropped the package from the cache. "
+
+desc_test_check [ns_ora desc_cached $pool $package] ""
+
+
+ns_write "<li> DescribeCacheFile ends with a line dropping it. "
+
+if { !$file_p } {
+    ns_write "skipped, DescribeCacheFile isn't set"
+} else {
+    desc_test_check [llength [desc_test_last_line $db [string toupper $package]]] 3
+}
+
+
+ns_write "<li> the next call describes the new package. "
+
+desc_test_check [ns_ora call $db ${package}.f 7 8] 15
+
+
+
+# wrap it up
+
+ns_write "<p><li> cleaning up test package"
+
+ns_db dml $db "drop package $package"
+
+
+ns_write "<li> explicitly releasing handle"
+
+ns_db releasehandle $db
+
+
+ns_write "
+</ul>
+</blockquote>
+<hr>
+<address><a href=\"mailto:markd@ardigita.com\">markd@arsdigita.com</a></address>
+</body>
+</html>
+"
@@ -0,0 +1,255 @@
+# load-test.tcl -- exercise ns_ora load and ns_ora load_file
+# $Id$
+
+
+# these will be created by this script
+set csv_file_name "/tmp/markd-load.csv"
+set bad_file_name "/tmp/markd-load.csv.bad"
+
+
+# writes a file, as is
+proc load_test_file { path contents } {
+    set f [open $path w]
+    fconfigure $f -translation binary
+    puts -nonewline $f $contents
+    close $f
+}
+
+
+# reads a file back
+proc load_test_read { path } {
+    set f [open $path r]
+    fconfigure $f -translation binary
+    set contents [read $f]
+    close $f
+    return $contents
+}
+
+
+# the table's rows, in id order, as a list of lists
+proc load_test_rows { db } {
+    set rows [list]
+    set selection [ns_db select $db "select id, name, note from markd_load_test order by id"]
+    while { [ns_db getrow $db $selection] } {
+        lappend rows [list [ns_set get $selection id] \
+                          [ns_set get $selection name] \
+                          [ns_set get $selection note]]
+    }
+    return $rows
+}
+
+
+# checks a value against what was expected
+proc load_test_check { value expected } {
+    if { [string compare $value $expected] == 0 } {
+        ns_write "they match"
+    } else {
+        ns_write "<font color=red>they don't match: got [ns_quotehtml $value]</font>"
+    }
+}
+
+
+ReturnHeaders
+
+ns_write "
+<html>
+<head>
+    <title>Oracle Driver Load Tests</title>
+</head>
+
+<body bgcolor=white>
+<h2>Oracle Driver Load Tests</h2>
+<hr>
+
+<blockquote>
+
+This outputs what it will be doing before it actually does it.
+If an error happens, look for the prior &lt;li&gt;
+
+<ul>
+"
+
+
+
+ns_write "<li> getting db handle"
+
+set db [ns_db gethandle]
+
+
+
+ns_write "<li> setting up test table"
+
+catch { ns_db dml $db "drop table markd_load_test" }
+ns_db dml $db "create table markd_load_test (id integer, name varchar2(20), note varchar2(100))"
+
+
+
+ns_write "<p><li> <b>Starting load_file CSV parsing tests</b>"
+
+ns_write "<li> loading a CSV file with quoted fields and a short row. "
+
+load_test_file $csv_file_name "id,name,note
+1,plain,no quotes
+2,\"a, b\",quoted delimiter
+3,\"say \"\"hi\"\"\",doubled quotes
+4,lines,\"first
+second\"
+5,short
+6,,
+"
+catch { exec rm -f $bad_file_name }
+
+array set stats [ns_ora load_file $db markd_load_test $csv_file_name]
+
+load_test_check [list $stats(rows) $stats(rejected)] {5 1}
+
+
+ns_write "<li> a quoted delimiter stays in the field. "
+
+load_test_check [database_to_tcl_string $db "select name from markd_load_test where id = 2"] \
+    "a, b"
+
+
+ns_write "<li> doubled quotes are one quote. "
+
+load_test_check [database_to_tcl_string $db "select name from markd_load_test where id = 3"] \
+    {say "hi"}
+
+
+ns_write "<li> a quoted field can span lines. "
+
+load_test_check [database_to_tcl_string $db "select note from markd_load_test where id = 4"] \
+    "first\nsecond"
+
+
+ns_write "<li> empty fields are NULL. "
+
+load_test_check [database_to_tcl_string $db "select count(*) from markd_load_test where id = 6 and name is null and note is null"] \
+    1
+
+
+ns_write "<li> the short row went to the bad file. "
+
+load_test_check [load_test_read $bad_file_name] "5,short\n"
+
+
+ns_write "<li> a header naming a quoted identifier. "
+
+ns_db dml $db "delete from markd_load_test"
+load_test_file $csv_file_name "id,\"\"\"NAME\"\"\"
+7,quoted
+"
+
+array set stats [ns_ora load_file $db markd_load_test $csv_file_name]
+
+load_test_check [database_to_tcl_string $db "select name from markd_load_test where id = 7"] \
+    quoted
+
+
+ns_write "<li> making sure a header that isn't a column name stops the load. "
+
+ns_db dml $db "delete from markd_load_test"
+load_test_file $csv_file_name "id,name from dual; --,note
+8,bad,header
+"
+
+if { [catch { ns_ora load_file $db markd_load_test $csv_file_name } errmsg]
+     && [string match "invalid column name*" $errmsg]
+     && [database_to_tcl_string $db "select count(*) from markd_load_test"] == 0 } {
+    ns_write "it does"
+} else {
+    ns_write "<font color=red>it doesn't</font>"
+}
+
+
+ns_write "<li> making sure -columns are checked too. "
+
+if { [catch { ns_ora load_file $db markd_load_test $csv_file_name -columns {id 1name note} } errmsg]
+     && [string match "invalid column name*" $errmsg] } {
+    ns_write "they are"
+} else {
+    ns_write "<font color=red>they aren't</font>"
+}
+
+
+
+
+ns_write "<p><li> <b>Starting round trip tests</b>"
+
+set load_rows [list \
+    [list 1 alpha "first note"] \
+    [list 2 beta ""] \
+    [list 3 "" third]]
+
+ns_write "<li> ns_ora load of a list of rows. "
+
+ns_db dml $db "delete from markd_load_test"
+array set stats [ns_ora load $db markd_load_test {id name note} $load_rows]
+
+load_test_check [list $stats(rows) [load_test_rows $db]] [list 3 $load_rows]
+
+
+ns_write "<li> ns_ora load of a file, with -delimiter. "
+
+ns_db dml $db "delete from markd_load_test"
+load_test_file $csv_file_name "1,alpha,first note
+2,beta,
+3,,third
+"
+array set stats [ns_ora load $db -file $csv_file_name -delimiter , markd_load_test {id name note}]
+
+load_test_check [list $stats(rows) [load_test_rows $db]] [list 3 $load_rows]
+
+
+ns_write "<li> ns_ora load_file of a TSV file, with -columns, across batches. "
+
+ns_db dml $db "delete from markd_load_test"
+load_test_file $csv_file_name "alpha\t1\tfirst note
+beta\t2\t
+\t3\tthird
+"
+array set stats [ns_ora load_file $db markd_load_test $csv_file_name -format tsv -columns {name id note} -batch 2]
+
+load_test_check [list $stats(rows) $stats(rejected) [load_test_rows $db]] \
+    [list 3 0 $load_rows]
+
+
+ns_write "<li> ns_ora load_file keeps the rest of a batch Oracle rejects a row of. "
+
+ns_db dml $db "delete from markd_load_test"
+catch { exec rm -f $bad_file_name }
+load_test_file $csv_file_name "id,name,note
+1,alpha,first note
+x,bad,not a number
+2,beta,
+3,,third
+"
+array set stats [ns_ora load_file $db markd_load_test $csv_file_name -batch 3]
+
+load_test_check [list $stats(rows) $stats(rejected) [load_test_rows $db] \
+                     [load_test_read $bad_file_name]] \
+    [list 3 1 $load_rows "x,bad,not a number\n"]
+
+
+
+# wrap it up
+
+ns_write "<p><li> cleaning up test table"
+
+ns_db dml $db "drop table markd_load_test"
+catch { exec rm -f $csv_file_name $bad_file_name }
+
+
+ns_write "<li> explicitly releasing handle"
+
+ns_db releasehandle $db
+
+
+ns_write "
+</ul>
+</blockquote>
+<hr>
+<address><a href=\"mailto:markd@ardigita.com\">markd@arsdigita.com</a></address>
+</body>
+</html>
+"
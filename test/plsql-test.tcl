@@ -0,0 +1,564 @@
+# plsql-test.tcl -- exercise the ns_ora plsql bind options
+# $Id$
+
+
+# this will be created by this script
+set lob_file_name "/tmp/markd-plsql.bin"
+
+
+# reads a file back
+proc plsql_test_read { path } {
+    set f [open $path r]
+    fconfigure $f -translation binary
+    set contents [read $f]
+    close $f
+    return $contents
+}
+
+
+# an array as a list sorted by element name, for comparing
+proc plsql_test_array { array_name } {
+    upvar $array_name array
+    set result [list]
+    foreach name [lsort [array names array]] {
+        lappend result $name $array($name)
+    }
+    return $result
+}
+
+
+# checks a value against what was expected
+proc plsql_test_check { value expected } {
+    if { [string compare $value $expected] == 0 } {
+        ns_write "they match"
+    } else {
+        ns_write "<font color=red>they don't match: got [ns_quotehtml $value]</font>"
+    }
+}
+
+
+ReturnHeaders
+
+ns_write "
+<html>
+<head>
+    <title>Oracle Driver PL/SQL Tests</title>
+</head>
+
+<body bgcolor=white>
+<h2>Oracle Driver PL/SQL Tests</h2>
+<hr>
+
+<blockquote>
+
+This outputs what it will be doing before it actually does it.
+If an error happens, look for the prior &lt;li&gt;
+
+<ul>
+"
+
+
+
+ns_write "<li> getting db handle"
+
+set db [ns_db gethandle]
+
+
+
+ns_write "<li> setting up test package"
+
+ns_db dml $db "
+create or replace package markd_plsql_test as
+  type num_table is table of number index by binary_integer;
+  type str_table is table of varchar2(4000) index by binary_integer;
+
+  procedure total (p_ids in num_table, p_total out number);
+  procedure names (p_ids in num_table, p_names out str_table);
+  procedure copy (p_in in str_table, p_out out str_table);
+  procedure nulls (p_in in str_table, p_count out number);
+  procedure fill (p_length in number, p_value in out varchar2);
+  procedure clob_length (p_doc in clob, p_length out number);
+  procedure clob_copy (p_in in clob, p_out out clob);
+  procedure clob_upper (p_doc in out clob);
+  procedure clob_null (p_out out clob);
+  procedure blob_copy (p_in in blob, p_out out blob);
+  procedure cursors (p_count in number, p_rows out sys_refcursor,
+                     p_letters out sys_refcursor, 
+                     p_none out sys_refcursor);
+end markd_plsql_test;"
+
+ns_db dml $db "
+create or replace package body markd_plsql_test as
+  procedure total (p_ids in num_table, p_total out number) is
+  begin
+    p_total := 0;
+    for i in 1 .. p_ids.count loop
+      p_total := p_total + p_ids(i);
+    end loop;
+  end;
+
+  procedure names (p_ids in num_table, p_names out str_table) is
+  begin
+    for i in 1 .. p_ids.count loop
+      p_names(i) := 'name ' || p_ids(i);
+    end loop;
+  end;
+
+  procedure copy (p_in in str_table, p_out out str_table) is
+  begin
+    for i in 1 .. p_in.count loop
+      p_out(i) := p_in(i);
+    end loop;
+  end;
+
+  procedure nulls (p_in in str_table, p_count out number) is
+  begin
+    p_count := 0;
+    for i in 1 .. p_in.count loop
+      if p_in(i) is null then
+        p_count := p_count + 1;
+      end if;
+    end loop;
+  end;
+
+  procedure fill (p_length in number, p_value in out varchar2) is
+  begin
+    p_value := rpad(nvl(p_value, 'x'), p_length, 'x');
+  end;
+
+  procedure clob_length (p_doc in clob, p_length out number) is
+  begin
+    p_length := dbms_lob.getlength(p_doc);
+  end;
+
+  procedure clob_copy (p_in in clob, p_out out clob) is
+  begin
+    p_out := p_in;
+  end;
+
+  procedure clob_upper (p_doc in out clob) is
+  begin
+    p_doc := upper(p_doc);
+  end;
+
+  procedure clob_null (p_out out clob) is
+  begin
+    p_out := null;
+  end;
+
+  procedure blob_copy (p_in in blob, p_out out blob) is
+  begin
+    p_out := p_in;
+  end;
+
+  procedure cursors (p_count in number, p_rows out sys_refcursor,
+                     p_letters out sys_refcursor, 
+                     p_none out sys_refcursor) is
+  begin
+    open p_rows for
+      select level as n, 'row ' || level as label
+        from dual connect by level <= p_count;
+    open p_letters for
+      select chr(96 + level) as letter, null as nothing
+        from dual connect by level <= 2;
+    open p_none for
+      select 1 as n from dual where 1 = 0;
+  end;
+end markd_plsql_test;"
+
+
+
+ns_write "<p><li> <b>Starting -array tests</b>"
+
+ns_write "<li> an IN table. "
+
+set ids {1 2 3 4}
+set total ""
+ns_ora plsql $db -array {ids} "begin markd_plsql_test.total(:ids, :total); end;"
+
+plsql_test_check $total 10
+
+
+ns_write "<li> an OUT table, its variable not set beforehand. "
+
+catch { unset names }
+ns_ora plsql $db -array {ids names} "begin markd_plsql_test.names(:ids, :names); end;"
+
+plsql_test_check $names {{name 1} {name 2} {name 3} {name 4}}
+
+
+ns_write "<li> an IN table comes back unchanged. "
+
+plsql_test_check $ids {1 2 3 4}
+
+
+ns_write "<li> empty elements are NULL. "
+
+set strs {a "" c ""}
+set count ""
+ns_ora plsql $db -array {strs} "begin markd_plsql_test.nulls(:strs, :count); end;"
+
+plsql_test_check $count 2
+
+
+ns_write "<li> an OUT table bigger than the default 1000 elements. "
+
+set strs [list]
+for { set i 1 } { $i <= 3000 } { incr i } {
+    lappend strs "value $i"
+}
+catch { unset copied }
+ns_ora plsql $db -array [list strs {copied 3000}] "begin markd_plsql_test.copy(:strs, :copied); end;"
+
+plsql_test_check $copied $strs
+
+
+ns_write "<li> making sure an OUT element longer than its size is an error. "
+
+set strs {abcdefgh}
+catch { unset copied }
+if { [catch { ns_ora plsql $db -array {strs {copied 10 5}} "begin markd_plsql_test.copy(:strs, :copied); end;" } errmsg]
+     && [string match "*ORA-06502*" $errmsg] } {
+    ns_write "it is"
+} else {
+    ns_write "<font color=red>it isn't</font>"
+}
+
+
+ns_write "<li> making sure a list longer than max_elements is refused. "
+
+set strs {a b c d}
+if { [catch { ns_ora plsql $db -array {{strs 2}} "begin markd_plsql_test.nulls(:strs, :count); end;" } errmsg]
+     && [string match "*does not fit*" $errmsg] } {
+    ns_write "it is"
+} else {
+    ns_write "<font color=red>it isn't</font>"
+}
+
+
+
+ns_write "<p><li> <b>Starting OUT buffer tests</b>"
+
+set long_value [string repeat x 32767]
+
+ns_write "<li> an IN OUT value growing from 5 bytes to 32767. "
+
+set length 32767
+set value xxxxx
+ns_ora plsql $db "begin markd_plsql_test.fill(:length, :value); end;"
+
+plsql_test_check $value $long_value
+
+
+ns_write "<li> an OUT value of 32767 bytes from exec_plsql. "
+
+plsql_test_check [ns_ora exec_plsql $db "begin :1 := rpad('x', 32767, 'x'); end;"] \
+    $long_value
+
+
+ns_write "<li> an OUT value of 32767 bytes from exec_plsql_bind. "
+
+plsql_test_check [ns_ora exec_plsql_bind $db "begin :1 := rpad('x', 32767, 'x'); end;" 1] \
+    $long_value
+
+
+ns_write "<li> making sure a value past MaxPLSQLBufferSize is an error. "
+
+set cap [ns_config ns/db/driver/[ns_db driver $db] MaxPLSQLBufferSize 5000000]
+if { $cap >= 32767 } {
+    ns_write "skipped, MaxPLSQLBufferSize is $cap"
+} else {
+    set value x
+    if { [catch { ns_ora plsql $db "begin markd_plsql_test.fill(:length, :value); end;" }] } {
+        ns_write "it is"
+    } else {
+        ns_write "<font color=red>it isn't</font>"
+    }
+}
+
+
+
+ns_write "<p><li> <b>Starting -clob and -blob tests</b>"
+
+# past the 32K a VARCHAR2 bind can take
+set doc [string repeat "abcdefghij" 10000]
+
+ns_write "<li> an IN CLOB of 100000 characters. "
+
+set length ""
+ns_ora plsql $db -clob {{doc in}} "begin markd_plsql_test.clob_length(:doc, :length); end;"
+
+plsql_test_check $length 100000
+
+
+ns_write "<li> an OUT CLOB, its variable not set beforehand. "
+
+catch { unset copy }
+ns_ora plsql $db -clob {{doc in} {copy out}} "begin markd_plsql_test.clob_copy(:doc, :copy); end;"
+
+plsql_test_check $copy $doc
+
+
+ns_write "<li> an IN OUT CLOB. "
+
+set upper $doc
+ns_ora plsql $db -clob {upper} "begin markd_plsql_test.clob_upper(:upper); end;"
+
+plsql_test_check $upper [string toupper $doc]
+
+
+ns_write "<li> a NULL OUT CLOB is the empty string. "
+
+set copy "not empty"
+ns_ora plsql $db -clob {{copy out}} "begin markd_plsql_test.clob_null(:copy); end;"
+
+plsql_test_check $copy ""
+
+
+# every byte value, nulls included
+set bytes ""
+for { set i 0 } { $i < 256 } { incr i } {
+    append bytes [binary format c $i]
+}
+set bin [string repeat $bytes 200]
+
+ns_write "<li> a binary BLOB in and out. "
+
+catch { unset copy }
+ns_ora plsql $db -blob {{bin in} {copy out}} "begin markd_plsql_test.blob_copy(:bin, :copy); end;"
+
+plsql_test_check [string equal $copy $bin] 1
+
+
+ns_write "<li> an OUT BLOB written to a file. "
+
+catch { exec rm -f $lob_file_name }
+ns_ora plsql $db -blob [list {bin in} [list copy out $lob_file_name]] \
+    "begin markd_plsql_test.blob_copy(:bin, :copy); end;"
+
+plsql_test_check [string equal [plsql_test_read $lob_file_name] $bin] 1
+
+
+ns_write "<li> making sure a bad mode is refused. "
+
+if { [catch { ns_ora plsql $db -clob {{doc sideways}} "begin markd_plsql_test.clob_length(:doc, :length); end;" } errmsg]
+     && [string match "invalid mode*" $errmsg] } {
+    ns_write "it is"
+} else {
+    ns_write "<font color=red>it isn't</font>"
+}
+
+
+
+ns_write "<p><li> <b>Starting -cursors tests</b>"
+
+set count 5
+set rows_list {{n label} {1 {row 1}} {2 {row 2}} {3 {row 3}} {4 {row 4}} {5 {row 5}}}
+
+ns_write "<li> three cursors in list format, two rows per fetch. "
+
+ns_ora plsql $db -cursors {rows letters none} -materialize list -fetchsize 2 \
+    "begin markd_plsql_test.cursors(:count, :rows, :letters, :none); end;"
+
+plsql_test_check [list $rows $letters $none] \
+    [list $rows_list {{letter nothing} {a {}} {b {}}} {n}]
+
+
+ns_write "<li> three cursors in dict format. "
+
+ns_ora plsql $db -cursors {rows letters none} -materialize dict \
+    "begin markd_plsql_test.cursors(:count, :rows, :letters, :none); end;"
+
+plsql_test_check [list [lindex $rows 0] $letters $none] \
+    [list {n 1 label {row 1}} {{letter a nothing {}} {letter b nothing {}}} {}]
+
+
+ns_write "<li> a cursor read with ns_ora fetch, a few rows at a time. "
+
+ns_ora plsql $db -cursors {rows letters none} \
+    "begin markd_plsql_test.cursors(:count, :rows, :letters, :none); end;"
+
+set first [ns_ora fetch $db $rows -max 2]
+set rest [ns_ora fetch $db $rows -fetchsize 2]
+
+plsql_test_check [list $first $rest] \
+    [list [lrange $rows_list 0 2] [concat [lrange $rows_list 0 0] [lrange $rows_list 3 end]]]
+
+
+ns_write "<li> making sure a cursor read to the end is closed. "
+
+if { [catch { ns_ora fetch $db $rows }] } {
+    ns_write "it is"
+} else {
+    ns_write "<font color=red>it isn't</font>"
+}
+
+
+ns_write "<li> making sure the next plsql call closes the last one's cursors. "
+
+set old_letters $letters
+ns_ora plsql $db -cursors {rows letters none} -materialize list \
+    "begin markd_plsql_test.cursors(:count, :rows, :letters, :none); end;"
+
+if { [catch { ns_ora fetch $db $old_letters }] } {
+    ns_write "it does"
+} else {
+    ns_write "<font color=red>it doesn't</font>"
+}
+
+
+ns_write "<li> the ref argument still leaves a cursor for ns_db getrow. "
+
+set labels [list]
+ns_ora plsql $db -cursors {letters none} \
+    "begin markd_plsql_test.cursors(:count, :rows, :letters, :none); end;" rows
+set selection [ns_db bindrow $db]
+while { [ns_db getrow $db $selection] } {
+    lappend labels [ns_set get $selection label]
+}
+
+plsql_test_check $labels {{row 1} {row 2} {row 3} {row 4} {row 5}}
+
+
+
+ns_write "<p><li> <b>Starting fetch_dbo tests</b>"
+
+set rows_dbo {1:label {row 1} 1:n 1 2:label {row 2} 2:n 2 3:label {row 3} 3:n 3 4:label {row 4} 4:n 4 5:label {row 5} 5:n 5 columns {n label} list {1 2 3 4 5}}
+
+ns_write "<li> the REF CURSOR left on the handle. "
+
+ns_ora plsql $db -cursors {letters none} \
+    "begin markd_plsql_test.cursors(:count, :rows, :letters, :none); end;" rows
+catch { unset dbo }
+array set dbo [ns_ora fetch_dbo $db]
+
+plsql_test_check [plsql_test_array dbo] $rows_dbo
+
+
+ns_write "<li> making sure the handle's cursor is gone afterwards. "
+
+if { [catch { ns_ora fetch_dbo $db } errmsg]
+     && [string match "no REF CURSOR*" $errmsg] } {
+    ns_write "it is"
+} else {
+    ns_write "<font color=red>it isn't</font>"
+}
+
+
+ns_write "<li> one of the -cursors, two rows per fetch. "
+
+ns_ora plsql $db -cursors {rows letters none} \
+    "begin markd_plsql_test.cursors(:count, :rows, :letters, :none); end;"
+catch { unset dbo }
+array set dbo [ns_ora fetch_dbo $db $rows -fetchsize 2]
+
+plsql_test_check [plsql_test_array dbo] $rows_dbo
+
+
+ns_write "<li> an empty cursor. "
+
+catch { unset dbo }
+array set dbo [ns_ora fetch_dbo $db $none]
+
+plsql_test_check [plsql_test_array dbo] {columns n list {}}
+
+
+ns_write "<li> NULL values. "
+
+catch { unset dbo }
+array set dbo [ns_ora fetch_dbo $db $letters]
+
+plsql_test_check [plsql_test_array dbo] \
+    {1:letter a 1:nothing {} 2:letter b 2:nothing {} columns {letter nothing} list {1 2}}
+
+
+if { [info commands ::plsql::ref_cursor_hook] != "" } {
+    ns_write "<li> the same DBO plsql::ref_cursor_hook builds. "
+
+    ns_ora plsql $db -cursors {letters none} \
+        "begin markd_plsql_test.cursors(:count, :rows, :letters, :none); end;" rows
+    catch { unset dbo }
+    plsql::ref_cursor_hook $db [ns_db bindrow $db] dbo 1
+
+    plsql_test_check [plsql_test_array dbo] $rows_dbo
+}
+
+
+
+ns_write "<p><li> <b>Starting -results tests</b>"
+
+set results_block "
+declare
+  c1 sys_refcursor;
+  c2 sys_refcursor;
+begin
+  open c1 for select level as n from dual connect by level <= 3;
+  dbms_sql.return_result(c1);
+  open c2 for select 'x' as letter from dual;
+  dbms_sql.return_result(c2);
+end;"
+
+ns_write "<li> two result sets in list format, two rows per fetch. "
+
+catch { unset sets }
+if { [catch { ns_ora plsql $db -results sets -fetchsize 2 $results_block } errmsg] } {
+    if { [string match "implicit results need*" $errmsg]
+         || [string match "*PLS-00302*" $errmsg] } {
+        # the client libraries or the server are older than 12c
+        ns_write "skipped: [ns_quotehtml $errmsg]"
+    } else {
+        ns_write "<font color=red>it failed: [ns_quotehtml $errmsg]</font>"
+    }
+} else {
+    plsql_test_check $sets {{n 1 2 3} {letter x}}
+
+
+    ns_write "<li> two result sets in dict format. "
+
+    ns_ora plsql $db -results sets -materialize dict $results_block
+
+    plsql_test_check $sets {{{n 1} {n 2} {n 3}} {{letter x}}}
+
+
+    ns_write "<li> a block without result sets. "
+
+    ns_ora plsql $db -results sets "begin null; end;"
+
+    plsql_test_check $sets {}
+
+
+    ns_write "<li> result sets alongside an OUT variable. "
+
+    set total ""
+    ns_ora plsql $db -results sets "
+begin
+  $results_block
+  :total := 3;
+end;"
+
+    plsql_test_check [list $total [llength $sets]] {3 2}
+}
+
+
+
+# wrap it up
+
+ns_write "<p><li> cleaning up test package"
+
+ns_db dml $db "drop package markd_plsql_test"
+catch { exec rm -f $lob_file_name }
+
+
+ns_write "<li> explicitly releasing handle"
+
+ns_db releasehandle $db
+
+
+ns_write "
+</ul>
+</blockquote>
+<hr>
+<address><a href=\"mailto:markd@ardigita.com\">markd@arsdigita.com</a></address>
+</body>
+</html>
+"
@@ -0,0 +1,203 @@
+# wrapper-test.tcl -- exercise the procs plsql::init makes
+# $Id$
+
+# Needs plsql.tcl in the server's Tcl library.  The wrappers share the
+# connection's handle (see plsql::conn_handle), so this page holds no
+# other handle from the default pool while it calls them.  The page
+# also requests itself, so the server needs at least two connection
+# threads.
+
+
+# the served requests
+
+switch -- [ns_set get [ns_parsequery [ns_conn query]] serve] {
+    hold {
+        # takes the connection's handle and leaves it to ns_atclose
+        plsql::conn_handle
+        ns_return 200 text/plain ok
+        return
+    }
+    all {
+        # every handle of the default pool, which can't be had while
+        # an earlier request still holds one
+        set pool [plsql::pool_name {}]
+        set n [ns_config ns/db/pool/$pool connections 2]
+        if { [catch { ns_db gethandle -timeout 10 $pool $n } handles] } {
+            ns_return 200 text/plain "error: $handles"
+        } else {
+            foreach handle $handles {
+                ns_db releasehandle $handle
+            }
+            ns_return 200 text/plain ok
+        }
+        return
+    }
+}
+
+
+# checks a value against what was expected
+proc wrapper_test_check { value expected } {
+    if { [string compare $value $expected] == 0 } {
+        ns_write "they match"
+    } else {
+        ns_write "<font color=red>they don't match: got [ns_quotehtml $value]</font>"
+    }
+}
+
+
+ReturnHeaders
+
+ns_write "
+<html>
+<head>
+    <title>Oracle Driver PL/SQL Wrapper Tests</title>
+</head>
+
+<body bgcolor=white>
+<h2>Oracle Driver PL/SQL Wrapper Tests</h2>
+<hr>
+
+<blockquote>
+
+This outputs what it will be doing before it actually does it.
+If an error happens, look for the prior &lt;li&gt;
+
+<ul>
+"
+
+
+
+# a wrapper namespace outlives the package, so each run makes a new one
+set package markd_wrap_[clock seconds]
+
+ns_write "<li> setting up test package"
+
+set db [ns_db gethandle]
+
+ns_db dml $db "
+create or replace package $package as
+  function add (p_a number, p_b number) return number;
+  function echo (p_value varchar2) return varchar2;
+  function bump return number;
+end $package;"
+
+ns_db dml $db "
+create or replace package body $package as
+  g_count number := 0;
+
+  function add (p_a number, p_b number) return number is
+  begin
+    return p_a + p_b;
+  end;
+
+  function echo (p_value varchar2) return varchar2 is
+  begin
+    return p_value;
+  end;
+
+  function bump return number is
+  begin
+    g_count := g_count + 1;
+    return g_count;
+  end;
+end $package;"
+
+ns_db releasehandle $db
+
+
+
+ns_write "<p><li> <b>Starting plsql::init -lazy tests</b>"
+
+ns_write "<li> nothing is described or made by plsql::init. "
+
+wrapper_test_check [list [plsql::init $package -lazy add] \
+                        [info procs ::${package}::*]] \
+    {{} {}}
+
+
+ns_write "<li> the first call makes the wrapper. "
+
+wrapper_test_check [::${package}::add 2 3] 5
+
+
+ns_write "<li> only the procedure called was made. "
+
+wrapper_test_check [info procs ::${package}::*] [list ::${package}::add]
+
+
+ns_write "<li> the wrapper it made is used from then on. "
+
+wrapper_test_check [::${package}::add 4 5] 9
+
+
+ns_write "<li> making sure a procedure that wasn't asked for isn't made. "
+
+if { [catch { ::${package}::echo hello } errmsg]
+     && [string match "invalid command name*" $errmsg]
+     && [info procs ::${package}::echo] == "" } {
+    ns_write "it isn't"
+} else {
+    ns_write "<font color=red>it is</font>"
+}
+
+
+
+ns_write "<p><li> <b>Starting connection handle tests</b>"
+
+ns_write "<li> plsql::conn_handle gives the same handle each time. "
+
+set db [plsql::conn_handle]
+
+wrapper_test_check [plsql::conn_handle] $db
+
+
+ns_write "<li> wrappers called without -handle use it. "
+
+plsql::init $package
+set first [::${package}::bump]
+set second [::${package}::bump]
+
+wrapper_test_check [list $first $second [ns_ora call $db ${package}.bump]] \
+    {1 2 3}
+
+
+ns_write "<li> plsql::use_conn_handle 0 turns it off. "
+
+plsql::use_conn_handle 0
+set off [plsql::conn_handle]
+plsql::use_conn_handle 1
+
+wrapper_test_check $off {}
+
+
+ns_write "<li> a request's handle goes back to the pool when it's done. "
+
+plsql::release_conn_handles
+set url [ns_conn location][ns_conn url]
+ns_httpget $url?serve=hold
+
+wrapper_test_check [ns_httpget $url?serve=all] ok
+
+
+
+# wrap it up
+
+ns_write "<p><li> cleaning up test package"
+
+set db [plsql::conn_handle]
+ns_db dml $db "drop package $package"
+namespace delete ::$package
+nsv_unset plsql_lazy $package
+
+
+ns_write "<li> the connection's handle is released when the page is done"
+
+
+ns_write "
+</ul>
+</blockquote>
+<hr>
+<address><a href=\"mailto:markd@ardigita.com\">markd@arsdigita.com</a></address>
+</body>
+</html>
+"